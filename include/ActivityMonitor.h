@@ -0,0 +1,48 @@
+#ifndef ACTIVITYMONITOR_H
+#define ACTIVITYMONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Tracks foreground (login) traffic so background work can run only when
+// the store is idle. Shared by every Database that serves logins; all
+// methods are lock-free.
+class ActivityMonitor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ActivityMonitor() : active(0), lastActivityNs(now()) {}
+
+    void begin() {
+        active.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    void end() {
+        lastActivityNs.store(now(), std::memory_order_release);
+        active.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    int inFlight() const {
+        return active.load(std::memory_order_acquire);
+    }
+
+    // True when nothing is running and nothing has finished for `quiet`.
+    bool isIdle(std::chrono::milliseconds quiet) const {
+        if (inFlight() > 0) {
+            return false;
+        }
+        int64_t quietNs = std::chrono::duration_cast<std::chrono::nanoseconds>(quiet).count();
+        return now() - lastActivityNs.load(std::memory_order_acquire) >= quietNs;
+    }
+
+private:
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<int> active;
+    std::atomic<int64_t> lastActivityNs;
+};
+
+#endif
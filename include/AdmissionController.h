@@ -0,0 +1,108 @@
+#ifndef ADMISSIONCONTROLLER_H
+#define ADMISSIONCONTROLLER_H
+
+#include "AuthPipeline.h"
+#include "LatencyHistogram.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+struct AdmissionOptions {
+    // Logins allowed into the database at once; the rest queue.
+    size_t maxInFlight = 4;
+    // Queueing delay the controller aims for. While the logins admitted
+    // over a whole interval all waited longer, a fresh one waits at most
+    // twice this long.
+    std::chrono::microseconds target = std::chrono::milliseconds(5);
+    // How long the queue may stay standing before shedding starts; also the
+    // longest any login waits while the database keeps up.
+    std::chrono::milliseconds interval = std::chrono::milliseconds(100);
+};
+
+struct AdmissionStats {
+    uint64_t admitted;
+    uint64_t shed;
+    // Of the above, logins that carried a session.
+    uint64_t sessionAdmitted;
+    uint64_t sessionShed;
+    // Time from arrival to admission, admitted logins only.
+    LatencyHistogram queueDelay;
+
+    double shedRatio() const {
+        uint64_t total = admitted + shed;
+        return total ? static_cast<double>(shed) / total : 0.0;
+    }
+};
+
+// Bounds the logins waiting on the database, CoDel style. A login takes
+// one of maxInFlight slots or queues for it, and waits up to `interval`.
+// When even the shortest wait over an interval exceeded `target`, the
+// queue is standing: the database is behind, and a fresh login that has
+// waited twice `target` is shed rather than served after its client has
+// given up. Logins with a session (LoginRequest::hasSession) go ahead of
+// fresh ones and keep the longer wait. Shared by every thread.
+class AdmissionController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit AdmissionController(const AdmissionOptions& options = AdmissionOptions());
+    AdmissionController(const AdmissionController&) = delete;
+    AdmissionController& operator=(const AdmissionController&) = delete;
+
+    // Takes a slot; false if the login is shed. Never waits past `deadline`
+    // (Clock::time_point() for none). The wait is counted from `received`
+    // if the login queued before it got here, so a stale one is shed even
+    // with a slot free. A true return must be paired with release().
+    bool acquire(bool hasSession, Clock::time_point deadline = Clock::time_point(),
+                 Clock::time_point received = Clock::time_point());
+    void release();
+
+    // Every login admitted (or shed) over the last interval waited beyond
+    // target.
+    bool overloaded() const;
+    AdmissionStats stats() const;
+
+private:
+    // Starts a new interval once the current one is over.
+    void rollOver(Clock::time_point now);
+    void admit(bool hasSession, Clock::duration waited);
+    void sample(Clock::duration waited);
+    // Hands a free slot to the next waiting login.
+    void wakeNext();
+
+    AdmissionOptions options;
+    mutable std::mutex mutex;
+    std::condition_variable sessionTurn;
+    std::condition_variable freshTurn;
+    size_t inFlight;
+    size_t waitingSession;
+    size_t waitingFresh;
+    Clock::time_point intervalStart;
+    // Shortest wait in the current interval, of the logins admitted and of
+    // those shed after waiting at least target.
+    Clock::duration minDelay;
+    uint64_t intervalSamples;
+    bool shedding;
+    AdmissionStats counters;
+};
+
+// Admits the login through an AdmissionController before storage, and
+// ends it with Overloaded if it is shed. The slot is held until the
+// outcome is known. Cheaper stages (caches, rate limit) still answer a
+// shed-prone login first. The controller must outlive the stage.
+class AdmissionStage : public AuthStage {
+public:
+    explicit AdmissionStage(AdmissionController& controller) : controller(controller), holding(false) {}
+
+    const char* name() const override { return "admission"; }
+    int cost() const override { return 90; }
+    bool decide(LoginContext& context) override;
+    void observe(const LoginContext& context) override;
+
+private:
+    AdmissionController& controller;
+    bool holding;
+};
+
+#endif
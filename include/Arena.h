@@ -0,0 +1,53 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Bump allocator for the temporary data of one request: allocations are
+// carved out of large blocks and all released together by reset(). reset()
+// keeps a single block sized for what the request used, so once a request
+// of a given shape has run, running it again takes nothing from the heap.
+// Not thread-safe; give each thread or request its own.
+class Arena {
+public:
+    // `minimumBytes` is the smallest block ever kept; nothing is allocated
+    // until the first allocate().
+    explicit Arena(size_t minimumBytes = 1024);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Copies `text` into the arena; the view is valid until reset().
+    std::string_view copy(std::string_view text);
+
+    // Frees everything allocated since the last reset().
+    void reset();
+
+    // Bytes held from the heap, used or not.
+    size_t capacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    void addBlock(size_t bytes);
+
+    size_t minimumBytes;
+    std::vector<Block> blocks;  // allocations come from the last one
+    size_t offset;
+    // Bytes requested since the last reset(), alignment padding included.
+    size_t demand;
+};
+
+#endif
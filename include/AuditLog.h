@@ -0,0 +1,152 @@
+#ifndef AUDITLOG_H
+#define AUDITLOG_H
+
+#include "LoginOutcome.h"
+#include "MpscRingBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Durable append-only audit trail of login outcomes.
+//
+// append() copies the record into a lock-free ring and returns immediately;
+// a background writer drains the ring in groups, writes them to the current
+// segment file and issues one fsync per group. When the ring is full the
+// record is dropped (and counted) rather than stalling the login path.
+//
+// Segment files are named audit-NNNNNN.seg inside the log directory:
+//   "AUDT", version byte
+//   per record: u32 payload length, u32 CRC-32 of payload, payload
+//   payload:    u64 wall-clock ns, u8 event, u8 outcome, u32 attempt,
+//               account bytes
+// Integers are little-endian. A torn tail record fails its CRC and ends
+// iteration of that segment.
+
+enum class AuditEvent : uint8_t {
+    Login = 0,
+    Lockout = 1
+};
+
+struct AuditRecord {
+    uint64_t timestampNs;
+    AuditEvent event;
+    LoginOutcome outcome;
+    uint32_t attempt;
+    std::string account;
+};
+
+struct AuditLogOptions {
+    std::string directory = "audit";
+    size_t ringCapacity = 1 << 16;
+    uint64_t maxSegmentBytes = 16ull << 20;
+    size_t maxGroupRecords = 4096;
+    int idleWaitMs = 2;
+    bool syncOnCommit = true;
+};
+
+struct AuditLogStats {
+    uint64_t appended;
+    uint64_t dropped;
+    uint64_t written;
+    // Records whose write or sync failed; never counted as written.
+    uint64_t failed;
+    uint64_t groupCommits;
+    uint64_t segments;
+};
+
+class AuditLog {
+public:
+    explicit AuditLog(const AuditLogOptions& options = AuditLogOptions());
+    ~AuditLog();
+
+    bool start();
+    // Drains everything appended so far, then stops the writer.
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+    // Lock-free and allocation-free. Accounts longer than kMaxAccountLength
+    // are truncated. Returns false if the record was dropped.
+    bool append(std::string_view account, LoginOutcome outcome,
+                uint32_t attempt = 0, AuditEvent event = AuditEvent::Login);
+
+    // Blocks until every record appended before the call has been committed
+    // or has failed. False once any group commit has failed: records were
+    // lost, not made durable.
+    bool flush();
+
+    AuditLogStats stats() const;
+
+    static constexpr size_t kMaxAccountLength = 96;
+
+private:
+    struct Entry {
+        uint64_t timestampNs;
+        AuditEvent event;
+        LoginOutcome outcome;
+        uint32_t attempt;
+        uint8_t accountLength;
+        char account[kMaxAccountLength];
+    };
+
+    AuditLog(const AuditLog&) = delete;
+    AuditLog& operator=(const AuditLog&) = delete;
+
+    void writerLoop();
+    bool openNextSegment();
+    // Closes the segment; the next commit starts a new one, so records after
+    // a torn write stay readable.
+    void abandonSegment();
+    void commitGroup(const std::vector<unsigned char>& group, uint64_t records);
+
+    AuditLogOptions options;
+    MpscRingBuffer<Entry> ring;
+    std::thread writer;
+    std::atomic<bool> running;
+    std::atomic<bool> stopRequested;
+
+    FILE* segment;
+    uint64_t segmentBytes;
+    uint64_t nextSegmentNumber;
+
+    std::atomic<uint64_t> appended;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> groupCommits;
+    std::atomic<uint64_t> segments;
+
+    std::mutex flushMutex;
+    std::condition_variable flushed;
+};
+
+// Iterates every record in a log directory, oldest segment first.
+class AuditLogReader {
+public:
+    explicit AuditLogReader(const std::string& directory);
+    ~AuditLogReader();
+
+    bool next(AuditRecord& record);
+
+    size_t segmentCount() const { return segmentPaths.size(); }
+    // Records skipped because of a bad length or CRC (torn writes).
+    uint64_t corruptRecords() const { return corrupt; }
+
+private:
+    AuditLogReader(const AuditLogReader&) = delete;
+    AuditLogReader& operator=(const AuditLogReader&) = delete;
+
+    bool openSegment(size_t index);
+
+    std::vector<std::string> segmentPaths;
+    size_t currentSegment;
+    FILE* file;
+    uint64_t corrupt;
+};
+
+#endif
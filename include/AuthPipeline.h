@@ -0,0 +1,265 @@
+#ifndef AUTHPIPELINE_H
+#define AUTHPIPELINE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "LoginOutcome.h"
+#include "Sha256.h"
+
+class AuditLog;
+class Database;
+class LoginTraceWriter;
+class ShardedDatabase;
+
+// Interactive logins (someone waiting at AuthScreen) are scheduled ahead
+// of batch work such as re-validating stored credentials.
+enum class AuthPriority : uint8_t {
+    Interactive = 0,
+    Batch = 1
+};
+
+struct LoginRequest {
+    using Clock = std::chrono::steady_clock;
+
+    std::string_view email;
+    std::string_view password;
+    // Attempt number within the session, for the audit trail; LockoutStage
+    // fills in 0 from the account's failures so far.
+    uint32_t attempt = 0;
+    // The caller already holds a valid session for the account (a repeated
+    // login to confirm a sensitive change, say); AdmissionController lets
+    // these through ahead of fresh logins.
+    bool hasSession = false;
+    // Left at zero, storage applies DatabaseOptions::queryTimeoutMs.
+    Clock::time_point deadline = Clock::time_point();
+    // When the request reached the server, if it queued before the
+    // pipeline; AdmissionController counts that wait too.
+    Clock::time_point received = Clock::time_point();
+    // Application the login comes from, for FairScheduler; empty is the
+    // default tenant.
+    std::string_view tenant;
+    AuthPriority priority = AuthPriority::Interactive;
+};
+
+class AuthStage;
+
+// One login as it travels through the pipeline. Stages may narrow
+// request.email (NormalizeStage does); the views stay in the caller's bytes.
+struct LoginContext {
+    LoginRequest request;
+    LoginOutcome outcome;
+    // Stage that decided; nullptr if none did.
+    const AuthStage* decidedBy;
+    // Set by StorageStage: Database has already traced this login.
+    bool storageConsulted;
+};
+
+// One step of the login decision. decide() either settles the outcome or
+// passes the login on; observe() then sees the final outcome at every
+// stage, whichever decided it, so caches and counters can learn from it.
+// Stages are not thread-safe; like Database, keep one pipeline per thread.
+class AuthStage {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~AuthStage() = default;
+    virtual const char* name() const = 0;
+    // Rough cost class; the pipeline asks cheaper stages first, and stages
+    // of equal cost in the order they were added.
+    virtual int cost() const = 0;
+    // Returns true after setting context.outcome to end the login here.
+    virtual bool decide(LoginContext& context) {
+        (void)context;
+        return false;
+    }
+    virtual void observe(const LoginContext& context) {
+        (void)context;
+    }
+};
+
+struct AuthStageStats {
+    const char* name;
+    uint64_t evaluated;
+    uint64_t decided;
+    // decide() time, one sample per login the stage was asked about.
+    LatencyHistogram latency;
+    // observe() time, one sample per login.
+    LatencyHistogram observeLatency;
+
+    double hitRatio() const { return evaluated ? static_cast<double>(decided) / evaluated : 0.0; }
+};
+
+// The single entry point for a login decision. Stages run in cost order
+// and the first decisive one ends the login, so a cheap check never waits
+// behind an expensive one. Hit ratio and latency are kept per stage.
+class AuthPipeline {
+public:
+    AuthPipeline() = default;
+    AuthPipeline(const AuthPipeline&) = delete;
+    AuthPipeline& operator=(const AuthPipeline&) = delete;
+
+    void add(std::unique_ptr<AuthStage> stage);
+    // StorageError if no stage decides (a pipeline without StorageStage).
+    LoginOutcome authenticate(const LoginRequest& request);
+
+    std::vector<AuthStageStats> stats() const;
+    void resetStats();
+
+private:
+    struct Entry {
+        std::unique_ptr<AuthStage> stage;
+        AuthStageStats stats;
+    };
+
+    std::vector<Entry> stages;
+};
+
+// Trims surrounding whitespace from the email; an empty or overlong one
+// cannot name an account and is answered at once.
+class NormalizeStage : public AuthStage {
+public:
+    static constexpr size_t kMaxEmailLength = 254;
+
+    const char* name() const override { return "normalize"; }
+    int cost() const override { return 0; }
+    bool decide(LoginContext& context) override;
+    // The email without surrounding whitespace, as the other stages see it.
+    static std::string_view trim(std::string_view email);
+};
+
+// PasswordValidator's policy, before anything touches storage.
+class PolicyStage : public AuthStage {
+public:
+    const char* name() const override { return "policy"; }
+    int cost() const override { return 1; }
+    bool decide(LoginContext& context) override;
+};
+
+// Turns an account away (RateLimited) after maxFailures failed logins
+// within window, until the window runs out. Counters live in a fixed table
+// indexed by account hash; a colliding account takes the slot over.
+class RateLimitStage : public AuthStage {
+public:
+    RateLimitStage(int maxFailures = 5, std::chrono::milliseconds window = std::chrono::minutes(5),
+                   size_t slots = 4096);
+
+    const char* name() const override { return "rate-limit"; }
+    int cost() const override { return 2; }
+    bool decide(LoginContext& context) override;
+    void observe(const LoginContext& context) override;
+
+private:
+    struct Slot {
+        uint64_t account;
+        uint32_t failures;
+        Clock::time_point windowStart;
+    };
+
+    int maxFailures;
+    Clock::duration window;
+    std::vector<Slot> table;
+};
+
+// Remembers accounts storage reported as unknown, for ttl. Accounts added
+// meanwhile by another process stay unknown here until their entry expires,
+// unless forget() is called. A hit skips Database, and with it the dummy
+// hash and StuffingDetector: it answers faster than a real account, so keep
+// it out of pipelines that serve untrusted clients.
+class NegativeCacheStage : public AuthStage {
+public:
+    explicit NegativeCacheStage(std::chrono::milliseconds ttl = std::chrono::seconds(5), size_t slots = 4096);
+
+    const char* name() const override { return "negative-cache"; }
+    int cost() const override { return 3; }
+    bool decide(LoginContext& context) override;
+    void observe(const LoginContext& context) override;
+    void forget(std::string_view email);
+
+private:
+    struct Slot {
+        uint64_t account;
+        Clock::time_point expires;
+    };
+
+    Clock::duration ttl;
+    std::vector<Slot> table;
+};
+
+// Skips the password hash for a repeat of a login that succeeded within
+// ttl. Only a SHA-256 of email and password under a per-process random key is
+// kept. A password changed or reset by another process is still accepted
+// until the entry expires, and a hit skips the lazy rehash and quarantine
+// checks in Database; a failed login on the account drops it, as does
+// forget(). Keep it out of pipelines where a reset must take effect at once.
+class PositiveCacheStage : public AuthStage {
+public:
+    explicit PositiveCacheStage(std::chrono::milliseconds ttl = std::chrono::seconds(60), size_t slots = 4096);
+
+    const char* name() const override { return "positive-cache"; }
+    int cost() const override { return 4; }
+    bool decide(LoginContext& context) override;
+    void observe(const LoginContext& context) override;
+    void forget(std::string_view email);
+
+private:
+    struct Slot {
+        uint64_t account;
+        uint8_t digest[Sha256::kDigestSize];
+        Clock::time_point expires;
+    };
+
+    void digest(const LoginContext& context, uint8_t out[Sha256::kDigestSize]) const;
+
+    Clock::duration ttl;
+    uint8_t key[Sha256::kDigestSize];
+    std::vector<Slot> table;
+};
+
+// Database::authenticate; always decisive. The Database (or, sharded, the
+// ShardedDatabase) must outlive the stage.
+class StorageStage : public AuthStage {
+public:
+    explicit StorageStage(Database& db) : db(&db), sharded(nullptr) {}
+    explicit StorageStage(ShardedDatabase& sharded) : db(nullptr), sharded(&sharded) {}
+
+    const char* name() const override { return "storage"; }
+    int cost() const override { return 100; }
+    bool decide(LoginContext& context) override;
+
+private:
+    Database* db;
+    ShardedDatabase* sharded;
+};
+
+// Appends every outcome to the audit trail.
+class AuditStage : public AuthStage {
+public:
+    explicit AuditStage(AuditLog& audit) : audit(audit) {}
+
+    const char* name() const override { return "audit"; }
+    int cost() const override { return 1000; }
+    void observe(const LoginContext& context) override;
+
+private:
+    AuditLog& audit;
+};
+
+// Traces logins decided before storage; Database traces the rest itself.
+class TraceStage : public AuthStage {
+public:
+    explicit TraceStage(LoginTraceWriter& trace) : trace(trace) {}
+
+    const char* name() const override { return "trace"; }
+    int cost() const override { return 1000; }
+    void observe(const LoginContext& context) override;
+
+private:
+    LoginTraceWriter& trace;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef AUTHSCHEMA_H
+#define AUTHSCHEMA_H
+
+#include "SchemaMigrator.h"
+#include <vector>
+
+// Schema history of auth.db. Append new migrations with the next version;
+// never edit one that has shipped.
+//
+//   1  usuarios (id INTEGER PRIMARY KEY AUTOINCREMENT, usuario UNIQUE, clave)
+//   2  usuarios rebuilt WITHOUT ROWID, keyed by usuario
+//   3  usuarios.actualizado_en (unix time of the last password change)
+//   4  recuperaciones (password reset tokens, keyed by their SHA-256)
+//   5  estado_login (failures, lockout and last login per account)
+//   6  cambios (change log of usuarios, filled by triggers) and replicacion
+//      (role and position; see Replication.h). A future rebuild of usuarios
+//      drops the triggers: recreate them in its afterSwapSql.
+std::vector<Migration> authSchemaMigrations();
+
+// Files written before versioning have user_version 0 and the v1 table.
+const int kAuthSchemaUnversioned = 1;
+
+#endif
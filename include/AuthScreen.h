@@ -3,32 +3,89 @@
 
 #include <SFML/Graphics.hpp>
 #include <string>
+#include "ActivityMonitor.h"
+#include "AuditLog.h"
+#include "AuthPipeline.h"
+#include "CredentialPrefetcher.h"
 #include "Database.h"
+#include "IntegrityVerifier.h"
+#include "LoginStateStore.h"
+#include "LoginTrace.h"
+#include "MaintenanceScheduler.h"
+#include "PasswordRecovery.h"
+#include "PasswordValidator.h"
+#include "SharedCredentialCache.h"
+#include "StuffingDetector.h"
+#include "WarmState.h"
 
 class AuthScreen {
 public:
-    AuthScreen();
+    // When tracePath is set, every login attempt is recorded there for
+    // offline replay (see AuthReplay).
+    explicit AuthScreen(const std::string& tracePath = "");
     void run();
     
 private:
     void handleEvents();
     void render();
-    bool validatePassword(const std::string& password);
     void handleMouseClick(int x, int y);
+    // Pushes the inputs and message into their texts; run on changes only,
+    // so drawing a frame does not rebuild any string.
+    void refreshTexts();
+    // Focus moves to the password field; the account is prefetched.
+    void focusPassword();
+    void clearPassword();
     
     sf::RenderWindow window;
+    // Declared before db, which keeps a pointer to it.
+    SharedCredentialCache credentialCache;
     Database db;
+    LoginTraceWriter trace;
+    AuditLog audit;
+    ActivityMonitor activity;
+    MaintenanceScheduler maintenance;
+    IntegrityVerifier verifier;
+    StuffingDetector stuffing;
+    // Reads the account as soon as the email field is left.
+    CredentialPrefetcher prefetcher;
+    // Failures, lockout and last login per account, kept across restarts.
+    LoginStateStore loginState;
+    // Hot accounts and cached pages of auth.db, reloaded on the next start.
+    WarmState warmState;
+    // Every login decision; its stages refer to db, prefetcher, loginState,
+    // warmState, audit and trace.
+    AuthPipeline pipeline;
+    // Owned by pipeline; the account's state after each login, for the message.
+    LockoutStage* lockout;
+    SpoolTransport outbox;
+    PasswordRecovery recovery;
     sf::Font font;
     
     std::string emailInput;
     std::string passwordInput;
+    // Follows passwordInput keystroke by keystroke.
+    PasswordPolicyState passwordPolicy;
+    std::string maskedPassword;
     std::string message;
-    int attempts;
     bool emailFieldActive;
     
     sf::RectangleShape emailBox;
     sf::RectangleShape passwordBox;
     sf::RectangleShape recoveryButton;
+    sf::RectangleShape strengthBar;
+    
+    sf::Text title;
+    sf::Text emailLabel;
+    sf::Text emailText;
+    sf::Text passwordLabel;
+    sf::Text passwordText;
+    // One indicator per policy rule, green once it is met.
+    sf::Text lengthRule;
+    sf::Text upperRule;
+    sf::Text specialRule;
+    sf::Text recoveryText;
+    sf::Text messageText;
+    sf::Text instructions;
 };
 
 #endif
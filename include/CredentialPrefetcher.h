@@ -0,0 +1,122 @@
+#ifndef CREDENTIALPREFETCHER_H
+#define CREDENTIALPREFETCHER_H
+
+#include "AuthPipeline.h"
+#include "Database.h"
+#include "ShardedDatabase.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct PrefetchOptions {
+    // Same layout as the store the logins go to (see ShardedDatabase).
+    int shards = 1;
+    // How long a fetched record may answer a login. A password changed in
+    // between is only noticed once the entry is gone, so keep this short.
+    std::chrono::milliseconds ttl = std::chrono::seconds(10);
+    // Records kept at once; a newer prefetch takes the oldest slot.
+    size_t slots = 16;
+    // Prefetches waiting for the thread; beyond this the oldest is dropped.
+    size_t maxPending = 16;
+};
+
+struct PrefetchStats {
+    uint64_t requested;
+    uint64_t fetched;
+    uint64_t dropped;  // no room in the queue, or a failed lookup
+    uint64_t used;     // taken by a login
+    uint64_t expired;
+};
+
+// Reads an account's stored hash in the background as soon as its email is
+// known, so that the login only has to check the password. A thread with
+// its own connection runs the lookups; take() hands a record out once and
+// waits for one still being read rather than reading it again.
+class CredentialPrefetcher {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CredentialPrefetcher(const std::string& dbPath, const DatabaseOptions& databaseOptions = DatabaseOptions(),
+                         const PrefetchOptions& options = PrefetchOptions());
+    ~CredentialPrefetcher();
+
+    bool start();
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Queues a lookup; returns at once. Surrounding whitespace is ignored,
+    // as NormalizeStage does.
+    void prefetch(std::string_view email);
+
+    // Moves the record for `email` into `fetched` and forgets it. Waits up
+    // to `deadline` for a lookup in flight; false if there is no usable one.
+    bool take(std::string_view email, FetchedCredential& fetched, Clock::time_point deadline);
+
+    PrefetchStats stats() const;
+
+private:
+    enum class SlotState { Empty, Pending, Fetching, Ready };
+
+    struct Slot {
+        SlotState state = SlotState::Empty;
+        std::string email;
+        FetchedCredential credential;
+        Clock::time_point since;
+    };
+
+    CredentialPrefetcher(const CredentialPrefetcher&) = delete;
+    CredentialPrefetcher& operator=(const CredentialPrefetcher&) = delete;
+
+    void run();
+    Slot* find(std::string_view email);
+    // nullptr if every slot is being fetched.
+    Slot* claim(Clock::time_point now);
+
+    std::string dbPath;
+    DatabaseOptions databaseOptions;
+    PrefetchOptions options;
+    // Used by the prefetch thread only.
+    std::unique_ptr<ShardedDatabase> db;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable ready;
+    std::vector<Slot> slots;
+    // Indices into slots, oldest first.
+    std::vector<size_t> pending;
+    std::thread worker;
+    bool running;
+    bool stopRequested;
+    PrefetchStats counters;
+};
+
+// Answers a login from a record CredentialPrefetcher has already read, so
+// only the password check is left; logins nobody prefetched go on to
+// StorageStage. The Database (or ShardedDatabase) and the prefetcher must
+// outlive the stage.
+class PrefetchStage : public AuthStage {
+public:
+    PrefetchStage(CredentialPrefetcher& prefetcher, Database& db)
+        : prefetcher(prefetcher), db(&db), sharded(nullptr) {}
+    PrefetchStage(CredentialPrefetcher& prefetcher, ShardedDatabase& sharded)
+        : prefetcher(prefetcher), db(nullptr), sharded(&sharded) {}
+
+    const char* name() const override { return "prefetch"; }
+    int cost() const override { return 5; }
+    bool decide(LoginContext& context) override;
+
+private:
+    CredentialPrefetcher& prefetcher;
+    Database* db;
+    ShardedDatabase* sharded;
+    // Reused between logins.
+    FetchedCredential fetched;
+};
+
+#endif
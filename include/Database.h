@@ -1,20 +1,271 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <random>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <sqlite3.h>
+#include "Arena.h"
+#include "LoginOutcome.h"
+#include "PasswordHasher.h"
+#include "SchemaMigrator.h"
+
+class ActivityMonitor;
+class HashingPool;
+class LoginTraceWriter;
+class SharedCredentialCache;
+class StuffingDetector;
+
+struct DatabaseOptions {
+    // Upper bound for one authenticate() call, including time spent waiting
+    // for another connection's lock. 0 disables the deadline.
+    int queryTimeoutMs = 2000;
+    // Busy backoff starts around the observed typical lock wait (bounded by
+    // these limits) and doubles, with jitter, on every retry.
+    int minBusyBackoffUs = 100;
+    int maxBusyBackoffUs = 50000;
+    // Opens the file in WAL mode so readers never wait for the writer;
+    // checkpoints are then run by MaintenanceScheduler.
+    bool walMode = false;
+    // Longest a single copy batch of an online table rebuild may hold the
+    // write lock during a schema upgrade.
+    int migrationBatchMs = 20;
+    // Called as schema migrations make progress; unset for silent upgrades.
+    SchemaMigrator::ProgressCallback migrationProgress;
+    // scrypt cost for new and upgraded password hashes. The default (logN 0)
+    // is calibrated once per process, on first use, so that one hash takes
+    // about hashTargetMs on this machine. Stored hashes with other
+    // parameters are rehashed on the next successful login.
+    HashCost hashCost;
+    double hashTargetMs = 50;
+    // Hashing runs here rather than on the calling thread; nullptr uses
+    // HashingPool::shared(). Must outlive this Database.
+    HashingPool* hashingPool = nullptr;
+    // Optional host-wide cache of stored credentials shared with other
+    // processes; writes through this Database invalidate it. Must outlive
+    // this Database.
+    SharedCredentialCache* sharedCache = nullptr;
+};
+
+// Integrity digest of one usuarios row; see Database::digestRows().
+struct RowDigest {
+    std::string usuario;
+    std::string digest;  // hex SHA-256 or HMAC-SHA-256
+};
+
+// One usuarios row as stored: the hash is copied verbatim, never rehashed.
+struct StoredUser {
+    std::string usuario;
+    std::string clave;
+    int64_t actualizadoEn;
+};
+
+// An account's stored hash, read ahead of its login; see
+// Database::fetchCredential().
+struct FetchedCredential {
+    bool found = false;
+    std::string clave;
+};
+
+// A password reset token as stored; the token itself is only ever sent.
+struct ResetToken {
+    std::string email;
+    std::string tokenHash;  // Database::hashResetToken() of the token
+    int64_t expiresAt;      // unix seconds
+};
+
+// Lockout and last-login state of one account; see LoginStateStore.
+struct LoginState {
+    std::string email;
+    // Failed logins since the last success.
+    uint32_t failures = 0;
+    // Unix seconds; the account is locked until then.
+    int64_t lockedUntil = 0;
+    // Unix seconds of the last successful login; 0 if none.
+    int64_t lastLogin = 0;
+};
+
+struct BackupOptions {
+    // Pages copied per sqlite3_backup_step(). Each step holds the source
+    // read lock, so this bounds how long a writer can be kept waiting.
+    int pagesPerStep = 256;
+    // Pause between steps, leaving the file to logins and writers.
+    int pauseMs = 1;
+    // VACUUM the copy before compressing it when at least a tenth of its
+    // pages are free.
+    bool compact = true;
+    // Outside WAL mode every write by another connection restarts the copy;
+    // give up after this many restarts.
+    int maxRestarts = 100;
+};
+
+struct BackupReport {
+    uint64_t databaseBytes;
+    uint64_t snapshotBytes;
+    uint64_t steps;
+    uint64_t restarts;
+    double maxStepMs;
+    double copySeconds;
+    double totalSeconds;
+    // databaseBytes over totalSeconds, in MB (2^20 bytes) per second.
+    double megabytesPerSecond;
+};
+
+struct DatabaseStats {
+    uint64_t queries;
+    uint64_t timeouts;
+    uint64_t storageErrors;
+    uint64_t busyRetries;
+    uint64_t busyWaitUs;
+    uint64_t rehashes;
+    uint64_t cacheHits;
+};
 
 class Database {
 public:
-    Database(const std::string& dbPath);
+    using Clock = std::chrono::steady_clock;
+    
+    Database(const std::string& dbPath, const DatabaseOptions& options = DatabaseOptions());
     ~Database();
     
     bool initialize();
-    bool validateUser(const std::string& email, const std::string& password);
+    bool validateUser(std::string_view email, std::string_view password);
+    LoginOutcome authenticate(std::string_view email, std::string_view password);
+    // Returns TimedOut if the lookup cannot finish before `deadline`, either
+    // because the query runs too long (progress handler) or because another
+    // connection holds the lock (busy handler).
+    // Once warm, a login that needs no rehash makes no heap allocation: the
+    // lookup statement is prepared once and binds the caller's bytes, and
+    // temporary copies live in a per-request arena.
+    // An unknown account pays for one password hash too, so it answers no
+    // sooner than a wrong password; a malformed stored hash is StorageError.
+    LoginOutcome authenticate(std::string_view email, std::string_view password,
+                              Clock::time_point deadline);
+    // The lookup half of authenticate(), for reading an account while the
+    // user is still typing the password (see CredentialPrefetcher). Success
+    // once the lookup has run, whether or not the account exists; not a
+    // login, so nothing is traced or reported as a failure.
+    LoginOutcome fetchCredential(std::string_view email, FetchedCredential& fetched);
+    LoginOutcome fetchCredential(std::string_view email, FetchedCredential& fetched,
+                                 Clock::time_point deadline);
+    // The rest of authenticate() against an earlier fetchCredential(): only
+    // the password check is left, so no query runs on this connection.
+    LoginOutcome authenticateFetched(std::string_view email, std::string_view password,
+                                     const FetchedCredential& fetched);
+    LoginOutcome authenticateFetched(std::string_view email, std::string_view password,
+                                     const FetchedCredential& fetched, Clock::time_point deadline);
+    bool addUser(const std::string& email, const std::string& password);
+    // Inserts all users in a single transaction; used to provision large test
+    // and load-generation databases.
+    bool addUsers(const std::vector<std::pair<std::string, std::string>>& users);
+    // Replaces the password of an existing account; false if there is none.
+    // The hash is computed before the write lock is taken.
+    bool changePassword(const std::string& email, const std::string& newPassword);
+    // Hands every usuarios row to `visit` in key order; stops early, and
+    // returns false, if `visit` does. For copying accounts between files.
+    bool exportUsers(const std::function<bool(const StoredUser&)>& visit);
+    // Inserts or replaces stored rows as they are, in a single transaction.
+    bool importUsers(const std::vector<StoredUser>& users);
+    // Stores reset tokens in one transaction, skipping those whose email
+    // names no account; issued[i] tells whether tokens[i] was stored.
+    bool storeResetTokens(const std::vector<ResetToken>& tokens, std::vector<bool>& issued);
+    // Sets a new password with a token from PasswordRecovery. Uses up the
+    // token and every other one outstanding for the account; false if the
+    // token is unknown, already used or expired.
+    bool redeemResetToken(std::string_view token, const std::string& newPassword);
+    // Deletes used and expired tokens; returns how many, or -1 on error.
+    int purgeResetTokens();
+    static std::string hashResetToken(std::string_view token);
+    // The stored state of `email`, or a clean one if there is none.
+    bool loadLoginState(std::string_view email, LoginState& state);
+    // Writes the states in one transaction, skipping those whose email
+    // names no account.
+    bool storeLoginStates(const std::vector<LoginState>& states);
+    // Digests every usuarios row (usuario, clave, actualizado_en) in key
+    // order for the nightly integrity check. Rows are hashed in batches with
+    // sha256Batch(); a non-empty key makes the digests HMAC-SHA-256.
+    bool digestRows(std::vector<RowDigest>& rows, const std::string& key = "");
+    // Online backup into a compressed snapshot (see Snapshot.h). Pages are
+    // copied on a separate connection with sqlite3_backup_step(), a few at a
+    // time with a pause in between, so other connections wait at most one
+    // step. In WAL mode the copy reads a single consistent snapshot and never
+    // blocks writers; otherwise a concurrent write restarts it.
+    bool backup(const std::string& snapshotPath, const BackupOptions& backupOptions = BackupOptions(),
+                BackupReport* report = nullptr);
+    // Replaces the database file with a snapshot. It is expanded and checked
+    // beside the file, then renamed over it, so a failed restore leaves the
+    // old file in place. Reopens this connection, running any migrations an
+    // older snapshot needs; all other connections must be closed first.
+    bool restore(const std::string& snapshotPath);
+    
+    // Optional: every authenticate() call is appended to the trace. The
+    // writer must outlive this Database; pass nullptr to stop recording.
+    void setTraceRecorder(LoginTraceWriter* recorder);
+    // Optional: reports every lookup as foreground traffic so background
+    // maintenance can stay out of its way. Must outlive this Database.
+    void setActivityMonitor(ActivityMonitor* monitor);
+    // Optional: failed logins (unknown user or wrong password) are fed to
+    // the detector, attributed to `source`. Must outlive this Database.
+    void setStuffingDetector(StuffingDetector* detector, const std::string& source);
+    
+    // True once IntegrityVerifier has quarantined the file: the connection
+    // is then query_only, logins still work and writes fail.
+    bool isQuarantined() const { return quarantined; }
+    // True for a replica kept by ReplicaFollower: the connection is then
+    // query_only, logins work and writes fail.
+    bool isReplica() const { return replica; }
+    
+    DatabaseStats stats() const { return counters; }
+    // What the last initialize() had to do to bring the schema up to date.
+    const MigrationReport& schemaReport() const { return migration; }
     
 private:
+    static int progressCallback(void* self);
+    static int busyCallback(void* self, int retries);
+    Clock::time_point defaultDeadline() const;
+    LoginOutcome classifyFailure(int rc);
+    HashingPool& hashing() const;
+    void beginRequest(Clock::time_point deadline);
+    void endRequest();
+    // UnknownUser unless the lookup failed; `stored` lives in requestArena.
+    LoginOutcome lookupClave(std::string_view email, bool& found, std::string_view& stored);
+    void recordLogin(std::string_view email, std::string_view password, LoginOutcome outcome);
+    LoginOutcome checkPassword(std::string_view email, std::string_view password,
+                               std::string_view stored, Clock::time_point deadline);
+    // The cost of checkPassword() for an account that does not exist.
+    LoginOutcome checkUnknown(std::string_view password, Clock::time_point deadline);
+    void rehash(std::string_view email, std::string_view password,
+                std::string_view stored, Clock::time_point deadline);
+    void finalizeStatements();
+    bool refreshQuarantine();
+    bool hashPasswords(const std::vector<std::pair<std::string, std::string>>& users,
+                       std::vector<std::string>& hashed);
+    
     sqlite3* db;
+    // Prepared on first use and kept for the life of the connection.
+    sqlite3_stmt* selectClave;
+    // Temporary data of the authenticate() call in progress.
+    Arena requestArena;
     std::string dbPath;
+    DatabaseOptions options;
+    LoginTraceWriter* traceRecorder;
+    ActivityMonitor* activityMonitor;
+    StuffingDetector* stuffingDetector;
+    std::string stuffingSource;
+    bool quarantined;
+    bool replica;
+    
+    Clock::time_point activeDeadline;
+    Clock::time_point busySince;
+    double typicalBusyWaitUs;
+    std::minstd_rand jitter;
+    DatabaseStats counters;
+    MigrationReport migration;
 };
 
 #endif
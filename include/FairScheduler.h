@@ -0,0 +1,110 @@
+#ifndef FAIRSCHEDULER_H
+#define FAIRSCHEDULER_H
+
+#include "AuthPipeline.h"
+#include "LatencyHistogram.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct TenantStats {
+    std::string name;
+    uint32_t weight;
+    uint64_t granted;
+    uint64_t timedOut;
+    // Arrival to grant.
+    LatencyHistogram queueDelay;
+    // Arrival to release: the wait plus the storage work.
+    LatencyHistogram latency;
+};
+
+// Shares storage slots between tenants (applications using the same
+// credential store) by deficit round robin. Every tenant has a queue per
+// priority class; interactive logins are always served before batch ones.
+// Within a class, the tenants with logins waiting take turns, each taking
+// up to its weight in logins per turn, so one flooding the store only
+// lengthens its own queue. Shared by every thread.
+class FairScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Ticket {
+        size_t tenant = 0;
+        Clock::time_point arrival;
+    };
+
+    explicit FairScheduler(size_t slots = 4);
+    FairScheduler(const FairScheduler&) = delete;
+    FairScheduler& operator=(const FairScheduler&) = delete;
+
+    // Logins per turn; a tenant not set here has weight 1.
+    void setWeight(std::string_view tenant, uint32_t weight);
+
+    // Waits for a slot in the tenant's turn; false at `deadline`
+    // (Clock::time_point() for none). A true return must be paired with
+    // release() of the same ticket.
+    bool acquire(std::string_view tenant, AuthPriority priority, Clock::time_point deadline, Ticket& ticket);
+    void release(const Ticket& ticket);
+
+    std::vector<TenantStats> stats() const;
+
+private:
+    static const int kClasses = 2;
+
+    struct Waiter {
+        std::condition_variable turn;
+        bool granted = false;
+    };
+
+    struct Tenant {
+        TenantStats stats;
+        std::deque<Waiter*> queues[kClasses];
+        bool inRing[kClasses] = {false, false};
+    };
+
+    // Tenants with logins waiting in one class, in turn order.
+    struct Ring {
+        std::vector<size_t> tenants;
+        size_t current = 0;
+        // Logins left in the current tenant's turn (its deficit).
+        uint32_t remaining = 0;
+    };
+
+    size_t tenantIndex(std::string_view name);
+    // Grants free slots to waiting logins, interactive first.
+    void dispatch();
+    Waiter* next(int priorityClass);
+
+    size_t slots;
+    size_t inFlight;
+    mutable std::mutex mutex;
+    std::vector<Tenant> tenants;
+    std::unordered_map<std::string, size_t> byName;
+    Ring rings[kClasses];
+};
+
+// Waits for the login's tenant's turn at a storage slot before storage
+// and holds the slot until the outcome is known; a login still waiting at
+// its deadline ends as TimedOut. The scheduler must outlive the stage.
+class FairStage : public AuthStage {
+public:
+    explicit FairStage(FairScheduler& scheduler) : scheduler(scheduler), holding(false) {}
+
+    const char* name() const override { return "fair-share"; }
+    int cost() const override { return 95; }
+    bool decide(LoginContext& context) override;
+    void observe(const LoginContext& context) override;
+
+private:
+    FairScheduler& scheduler;
+    FairScheduler::Ticket ticket;
+    bool holding;
+};
+
+#endif
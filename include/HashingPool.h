@@ -0,0 +1,175 @@
+#ifndef HASHINGPOOL_H
+#define HASHINGPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "Arena.h"
+
+struct HashingPoolStats {
+    uint64_t completed;
+    // Queued jobs dropped because their caller's deadline passed first.
+    uint64_t expired;
+    // submit() and run() calls that found no room before their deadline.
+    uint64_t rejected;
+    size_t maxQueueDepth;
+};
+
+// Fixed set of threads for password hashing, kept apart from the threads
+// that do I/O so a burst of expensive hashes cannot starve them. The queue
+// is bounded: when it is full, submitters wait (up to their deadline)
+// instead of piling up work that would finish too late to matter.
+class HashingPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 0 threads: one per hardware thread. 0 capacity: four jobs per thread.
+    explicit HashingPool(int threads = 0, size_t queueCapacity = 0);
+    ~HashingPool();
+
+    // Process-wide pool used when no other is configured.
+    static HashingPool& shared();
+
+    // Queues `job`. It is called with expired=true instead of doing its work
+    // if `deadline` passes while it waits in the queue.
+    bool submit(std::function<void(bool expired)> job, Clock::time_point deadline);
+
+    class Call;
+
+    // Runs `work` on the pool and waits for it until `deadline`. Returns
+    // false on timeout or overload; the result is then discarded. `work` is
+    // kept by value in a pool slot, so whatever it captures must stay valid
+    // even if the caller gives up; use Call to stage borrowed inputs.
+    template <typename T, typename Work>
+    bool run(Work work, Clock::time_point deadline, T& result);
+
+    int threadCount() const { return static_cast<int>(workers.size()); }
+    HashingPoolStats stats() const;
+
+private:
+    // Room for a call's work and result without going to the heap.
+    static constexpr size_t kInlineBytes = 192;
+
+    // One call in progress. Slots are made up front (one per queue entry
+    // and per thread) and recycled, together with their arenas.
+    struct Slot {
+        Arena arena;
+        alignas(std::max_align_t) unsigned char storage[kInlineBytes];
+        void (*invoke)(void* storage, bool expired);
+        void (*destroy)(void* storage);
+        // The caller and, once queued, the worker; the last one out frees it.
+        int references;
+        bool finished;
+        bool abandoned;
+        std::condition_variable done;
+    };
+
+    template <typename T, typename Work>
+    struct Bound {
+        Work work;
+        std::optional<T> value;
+
+        static void invoke(void* storage, bool expired) {
+            Bound* bound = static_cast<Bound*>(storage);
+            if (!expired) {
+                bound->value.emplace(bound->work());
+            }
+        }
+        static void destroy(void* storage) {
+            static_cast<Bound*>(storage)->~Bound();
+        }
+    };
+
+    struct Job {
+        std::function<void(bool)> run;
+        Slot* slot;
+        Clock::time_point deadline;
+    };
+
+    HashingPool(const HashingPool&) = delete;
+    HashingPool& operator=(const HashingPool&) = delete;
+
+    Slot* acquire(Clock::time_point deadline);
+    bool enqueue(Slot* slot, Clock::time_point deadline);
+    bool await(Slot* slot, Clock::time_point deadline);
+    void release(Slot* slot);
+    bool push(Job job, Clock::time_point deadline, std::unique_lock<std::mutex>& lock);
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    size_t capacity;
+    // Ring buffer of `capacity` jobs.
+    std::vector<Job> queue;
+    size_t queueHead;
+    size_t queued;
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<Slot*> freeSlots;
+    bool stopping;
+    mutable std::mutex mutex;
+    std::condition_variable hasWork;
+    std::condition_variable hasRoom;
+    std::condition_variable hasSlot;
+    HashingPoolStats counters;
+};
+
+// A run() whose inputs are copied into a per-call arena first:
+//
+//     HashingPool::Call call(pool, deadline);
+//     std::string_view text = call.arena().copy(borrowed);
+//     call.run([text] { return work(text); }, result);
+//
+// If the caller gives up at its deadline, the arena lives on with the slot
+// until the worker is done with it. Slots and arenas are recycled, so once
+// warm a call makes no heap allocation.
+class HashingPool::Call {
+public:
+    // Waits until `deadline` for a free slot; false-y if none came.
+    Call(HashingPool& pool, Clock::time_point deadline);
+    ~Call();
+    Call(const Call&) = delete;
+    Call& operator=(const Call&) = delete;
+
+    explicit operator bool() const { return slot != nullptr; }
+    Arena& arena() { return slot->arena; }
+
+    // At most once per Call.
+    template <typename T, typename Work>
+    bool run(Work work, T& result) {
+        using Task = Bound<T, Work>;
+        static_assert(sizeof(Task) <= kInlineBytes && alignof(Task) <= alignof(std::max_align_t),
+                      "work and result must fit in a slot");
+        if (!slot) {
+            return false;
+        }
+        Task* task = new (slot->storage) Task{std::move(work), std::nullopt};
+        slot->invoke = &Task::invoke;
+        slot->destroy = &Task::destroy;
+        if (!pool.enqueue(slot, deadline) || !pool.await(slot, deadline) || !task->value) {
+            return false;
+        }
+        result = std::move(*task->value);
+        return true;
+    }
+
+private:
+    HashingPool& pool;
+    Slot* slot;
+    Clock::time_point deadline;
+};
+
+template <typename T, typename Work>
+bool HashingPool::run(Work work, Clock::time_point deadline, T& result) {
+    Call call(*this, deadline);
+    return call.run(std::move(work), result);
+}
+
+#endif
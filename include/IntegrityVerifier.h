@@ -0,0 +1,135 @@
+#ifndef INTEGRITYVERIFIER_H
+#define INTEGRITYVERIFIER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ActivityMonitor;
+
+struct IntegrityOptions {
+    // Hard cap on one step; a step also stops as soon as a login arrives.
+    int stepBudgetMs = 5;
+    // Average share of one core the verifier may use: after a step of t ms
+    // it rests t * (1 / cpuShare - 1) ms.
+    double cpuShare = 0.05;
+    // Rest between complete passes.
+    int passIntervalMs = 60 * 60 * 1000;
+    // Put the store in read-only quarantine as soon as corruption is found.
+    bool quarantineOnCorruption = true;
+};
+
+struct IntegrityFinding {
+    // Table or index whose B-tree could not be read.
+    std::string btree;
+    // Last key read intact before the failure; empty if it failed at once.
+    std::string afterKey;
+    int code;  // SQLite extended result code
+    std::string message;
+};
+
+struct IntegrityProgress {
+    uint64_t passesCompleted;
+    uint64_t steps;
+    uint64_t interruptedSteps;
+    uint64_t entriesChecked;
+    // Share of the current pass done, estimated from the previous pass's
+    // entry count; 0 during the first pass.
+    double passFraction;
+    double maxStepMs;
+    std::string btree;
+    bool quarantined;
+};
+
+// Background integrity check for auth.db that replaces a full PRAGMA
+// integrity_check at startup. Every table and index B-tree is walked in key
+// order, a slice at a time: each step reads entries until its budget runs
+// out and remembers the last key, and the next step resumes after it.
+// Reading each entry (overflow pages included) through SQLite runs its
+// page-level corruption checks, so a damaged page is found in the
+// background instead of by a failing login.
+//
+// Runs on its own read-only connection, pauses while logins are in flight
+// and stays within options.cpuShare. Not walked: expression, partial,
+// descending or non-BINARY-collated indexes, and the freelist.
+class IntegrityVerifier {
+public:
+    using Clock = std::chrono::steady_clock;
+    using FindingCallback = std::function<void(const IntegrityFinding&)>;
+
+    IntegrityVerifier(const std::string& dbPath, const IntegrityOptions& options = IntegrityOptions(),
+                      ActivityMonitor* activity = nullptr);
+    ~IntegrityVerifier();
+
+    bool start();
+    void stop();
+
+    // Runs one budgeted step now; returns true if entries were checked.
+    // Used by the background thread and by tests.
+    bool runStep();
+    // Runs steps back to back until the current pass completes.
+    bool runPass();
+
+    // Called on the verifier's thread for every new finding.
+    void setFindingCallback(FindingCallback callback);
+    IntegrityProgress progress() const;
+    std::vector<IntegrityFinding> findings() const;
+
+    // Read-only quarantine, shared by every process through a marker file
+    // beside the database. Database checks it when it opens the file and
+    // before each write, and sets PRAGMA query_only; logins keep working.
+    static bool quarantine(const std::string& dbPath, const std::string& reason);
+    static bool isQuarantined(const std::string& dbPath);
+    static bool clearQuarantine(const std::string& dbPath);
+
+private:
+    // One B-tree walk: a table by its key, or an index by its columns plus
+    // the table key that makes each entry unique.
+    struct Walk {
+        std::string name;
+        std::string firstSql;
+        std::string resumeSql;
+        size_t keyColumns;
+    };
+
+    IntegrityVerifier(const IntegrityVerifier&) = delete;
+    IntegrityVerifier& operator=(const IntegrityVerifier&) = delete;
+
+    bool open();
+    void loop();
+    bool planPass();
+    int walkSlice(const Walk& walk);
+    void report(const Walk& walk, int rc);
+    void clearResumeKey();
+    static int progressCallback(void* self);
+
+    std::string dbPath;
+    IntegrityOptions options;
+    ActivityMonitor* activity;
+    sqlite3* db;
+
+    std::thread worker;
+    bool stopRequested;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+
+    std::vector<Walk> walks;
+    size_t walkIndex;
+    std::vector<sqlite3_value*> resumeKey;
+    uint64_t passEntries;
+    uint64_t previousPassEntries;
+    Clock::time_point stepDeadline;
+    Clock::time_point nextStep;
+    bool interrupted;
+    FindingCallback onFinding;
+    std::vector<IntegrityFinding> found;
+    IntegrityProgress counters;
+};
+
+#endif
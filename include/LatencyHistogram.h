@@ -0,0 +1,41 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Log-linear latency histogram (HdrHistogram style): each power-of-two range
+// is split into 32 linear sub-buckets, so any recorded value is reported with
+// ~3% relative error. Values are nanoseconds. Not thread-safe; keep one per
+// thread and merge() at the end.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t valueNs);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return totalCount; }
+    uint64_t min() const { return totalCount ? minValue : 0; }
+    uint64_t max() const { return maxValue; }
+    double mean() const;
+    uint64_t percentile(double p) const;
+
+    // Plain-text form: one "<bucketValueNs> <count>" line per non-empty bucket.
+    bool saveToFile(const std::string& path) const;
+    bool loadFromFile(const std::string& path);
+
+private:
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketValue(size_t index);
+
+    std::vector<uint64_t> counts;
+    uint64_t totalCount;
+    uint64_t minValue;
+    uint64_t maxValue;
+    long double sum;
+};
+
+#endif
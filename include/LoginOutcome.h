@@ -0,0 +1,30 @@
+#ifndef LOGINOUTCOME_H
+#define LOGINOUTCOME_H
+
+#include <cstdint>
+
+// Result class of one login attempt. Values are stored in login traces, so
+// only append new ones.
+enum class LoginOutcome : uint8_t {
+    Success = 0,
+    UnknownUser = 1,
+    WrongPassword = 2,
+    PolicyRejected = 3,
+    // The lookup hit its deadline (slow query or lock held by another
+    // connection); the credentials were not checked.
+    TimedOut = 4,
+    // The store could not answer (I/O error, corruption, closed handle).
+    StorageError = 5,
+    // Too many recent failures on the account; the credentials were not
+    // checked (see RateLimitStage).
+    RateLimited = 6,
+    // The database was too far behind to take the login in time; it was
+    // shed unchecked (see AdmissionController).
+    Overloaded = 7
+};
+
+const int kLoginOutcomeCount = 8;
+
+const char* loginOutcomeName(LoginOutcome outcome);
+
+#endif
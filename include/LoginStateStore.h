@@ -0,0 +1,195 @@
+#ifndef LOGINSTATESTORE_H
+#define LOGINSTATESTORE_H
+
+#include "AuthPipeline.h"
+#include "Database.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct LoginStateOptions {
+    // Failed logins in a row that lock the account, and for how long.
+    uint32_t maxFailures = 5;
+    int lockoutSeconds = 15 * 60;
+    // Changes reach the database at most this long after they are made, so
+    // a crash loses at most this much (plus a write in progress). 0 writes
+    // every change before returning, in its own transaction.
+    int flushIntervalMs = 100;
+    // Accounts changed since the last write that trigger one early.
+    size_t maxBatch = 256;
+    // Accounts kept in memory; unchanged ones beyond this are dropped to
+    // make room, least recently used first, and read again when next needed.
+    size_t maxEntries = 100000;
+    // Accounts found without stored state (unknown emails among them),
+    // remembered by hash in a fixed table so they are not read again. The
+    // failures of emails with no account are counted there too.
+    size_t absentSlots = 16384;
+    // Connections reading accounts not in memory; a login takes a free one
+    // and only queues when all are busy.
+    size_t readers = 4;
+};
+
+struct LoginStateStats {
+    uint64_t updates;
+    // Updates to an account already waiting to be written.
+    uint64_t coalesced;
+    // Accounts read from the database.
+    uint64_t loads;
+    // Lookups answered by the record of accounts without stored state.
+    uint64_t absentHits;
+    uint64_t flushes;
+    uint64_t rowsWritten;
+    uint64_t flushFailures;
+    double maxFlushMs;
+    // Accounts held in memory now, at most maxEntries plus unwritten ones.
+    size_t entries;
+};
+
+// Per-account failure count, lockout and last login, kept in auth.db
+// (estado_login) through a write-behind buffer. A login only changes the
+// account's entry in memory; a writer thread with its own connection
+// stores every changed account in one transaction each flushIntervalMs,
+// or sooner once maxBatch accounts have changed. Repeated changes to one
+// account between writes cost a single row. Accounts are read from the
+// database the first time they are needed; one with nothing stored is only
+// remembered by hash, so made-up emails cost neither memory nor another
+// read. Shared by every thread.
+class LoginStateStore {
+public:
+    LoginStateStore(const std::string& dbPath, const LoginStateOptions& options = LoginStateOptions(),
+                    const DatabaseOptions& databaseOptions = DatabaseOptions());
+    ~LoginStateStore();
+
+    bool start();
+    // Writes what is pending, then stops the writer.
+    void stop();
+    bool isRunning() const { return running; }
+
+    LoginState state(std::string_view email);
+    bool isLocked(std::string_view email);
+    // Counts a failed login; the state afterwards, locked once the failures
+    // reach maxFailures. A lockout that has run out starts the count anew.
+    LoginState recordFailure(std::string_view email);
+    // The same for an email with no account, so it locks like a real one
+    // and a lockout does not tell which emails exist. Kept in memory only,
+    // by hash; lost on restart or when the slot is needed for another.
+    LoginState recordUnknownFailure(std::string_view email);
+    // Clears failures and lockout and sets the last login; returns the
+    // state before, so the previous last login can be shown.
+    LoginState recordSuccess(std::string_view email);
+
+    // Writes every pending change now; false if the write failed.
+    bool flush();
+
+    uint32_t maxFailures() const { return options.maxFailures; }
+
+    LoginStateStats stats() const;
+
+private:
+    struct Entry {
+        LoginState state;
+        bool dirty = false;
+        // Place in `clean` while not dirty.
+        std::list<std::string>::iterator cleanPosition;
+    };
+
+    // An account with nothing stored; 0 marks a free slot. failures and
+    // lockedUntil only ever count for emails with no account.
+    struct AbsentSlot {
+        uint64_t account;
+        uint32_t failures;
+        int64_t lockedUntil;
+        int64_t touched;
+    };
+
+    struct Reader {
+        std::unique_ptr<Database> db;
+        std::mutex mutex;
+    };
+
+    LoginStateStore(const LoginStateStore&) = delete;
+    LoginStateStore& operator=(const LoginStateStore&) = delete;
+
+    void writerLoop();
+    // Called with `lock` held; may release it to read the account.
+    LoginState lookup(std::string_view email, std::unique_lock<std::mutex>& lock);
+    // As lookup(), for an account about to change: it is kept in entries.
+    Entry& entry(std::string_view email, std::unique_lock<std::mutex>& lock);
+    // Reads the account on any free reader; false if nothing could be read.
+    bool read(std::string_view email, LoginState& state);
+    Entry& insert(std::string key, const LoginState& state);
+    // Moves an unchanged entry to the back of `clean`, last to be dropped.
+    void touch(Entry& used);
+    AbsentSlot* findAbsent(uint64_t account);
+    AbsentSlot& rememberAbsent(uint64_t account);
+    // Applies one failure at `now`.
+    void countFailure(uint32_t& failures, int64_t& lockedUntil, int64_t now) const;
+    // Asks the writer for an early write once maxBatch accounts changed.
+    void afterChange(std::unique_lock<std::mutex>& lock);
+    void markDirty(Entry& entry);
+    bool writePending();
+
+    std::string dbPath;
+    LoginStateOptions options;
+    DatabaseOptions databaseOptions;
+    // Read accounts not in memory, each guarded by its own mutex. Created
+    // by start() and kept until destruction; stop() closes the connections.
+    std::vector<std::unique_ptr<Reader>> readers;
+    std::atomic<size_t> nextReader;
+    // Guarded by writeMutex.
+    std::unique_ptr<Database> writer;
+    std::mutex writeMutex;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<std::string, Entry> entries;
+    // Entries with nothing to write, least recently used first: insert()
+    // drops from the front without looking at the changed ones.
+    std::list<std::string> clean;
+    // Indexed by account hash, probed over a few slots.
+    std::vector<AbsentSlot> absent;
+    std::vector<std::string> pending;
+    std::thread worker;
+    bool running;
+    bool stopRequested;
+    LoginStateStats counters;
+};
+
+// Turns a locked account away (RateLimited) before the caches and storage,
+// and records the outcome of every login that was not: a wrong password,
+// or an email with no account, counts toward the lockout, a success
+// clears it and sets the last login.
+// A request without an attempt number gets the account's failures so far
+// plus one. The store must outlive the stage.
+class LockoutStage : public AuthStage {
+public:
+    explicit LockoutStage(LoginStateStore& store) : store(store), checked(false) {}
+
+    const char* name() const override { return "lockout"; }
+    int cost() const override { return 2; }
+    bool decide(LoginContext& context) override;
+    void observe(const LoginContext& context) override;
+
+    // The account as the last login through this stage left it, for the
+    // caller to answer from: after a wrong password, the failures and any
+    // lockout it caused; after a success, the state before it, with the
+    // previous last login; when turned away, the lockout. Empty if that
+    // login ended before reaching this stage.
+    const LoginState& last() const { return recorded; }
+
+private:
+    LoginStateStore& store;
+    LoginState recorded;
+    // decide() ran for the login being observed.
+    bool checked;
+};
+
+#endif
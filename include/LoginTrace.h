@@ -0,0 +1,78 @@
+#ifndef LOGINTRACE_H
+#define LOGINTRACE_H
+
+#include "LoginOutcome.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Compact binary trace of login requests, used to replay real traffic.
+//
+// File layout: "ATRC", version byte, u64 wall-clock start (ns since epoch),
+// then one record per request:
+//   varint  ns since the previous record
+//   u64     hashed account key (emails are never written)
+//   u8      LoginOutcome
+// Integers are little-endian. A typical record takes 11-13 bytes.
+
+struct LoginTraceRecord {
+    uint64_t timestampNs;  // since the start of the trace
+    uint64_t accountKey;
+    LoginOutcome outcome;
+};
+
+// FNV-1a 64 of the account name; stable across builds and platforms.
+uint64_t hashAccountKey(std::string_view email);
+
+class LoginTraceWriter {
+public:
+    LoginTraceWriter();
+    ~LoginTraceWriter();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    // Thread-safe. The timestamp is taken under the lock so records are
+    // always in non-decreasing time order.
+    void record(uint64_t accountKey, LoginOutcome outcome);
+
+    uint64_t recordCount() const { return records; }
+
+private:
+    LoginTraceWriter(const LoginTraceWriter&) = delete;
+    LoginTraceWriter& operator=(const LoginTraceWriter&) = delete;
+
+    std::mutex mutex;
+    FILE* file;
+    std::chrono::steady_clock::time_point start;
+    uint64_t lastOffsetNs;
+    uint64_t records;
+};
+
+class LoginTraceReader {
+public:
+    LoginTraceReader();
+    ~LoginTraceReader();
+
+    bool open(const std::string& path);
+    void close();
+
+    // Returns false at end of trace or on a truncated record.
+    bool next(LoginTraceRecord& record);
+
+    uint64_t startTimeNs() const { return wallStartNs; }
+
+private:
+    LoginTraceReader(const LoginTraceReader&) = delete;
+    LoginTraceReader& operator=(const LoginTraceReader&) = delete;
+
+    FILE* file;
+    uint64_t wallStartNs;
+    uint64_t offsetNs;
+};
+
+#endif
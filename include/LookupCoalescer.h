@@ -0,0 +1,113 @@
+#ifndef LOOKUPCOALESCER_H
+#define LOOKUPCOALESCER_H
+
+#include "AuthPipeline.h"
+#include "Database.h"
+#include "ShardedDatabase.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct CoalescerStats {
+    uint64_t lookups;
+    // Lookups that ran a query others could join.
+    uint64_t leaders;
+    // Lookups answered by another thread's query.
+    uint64_t coalesced;
+    // Ran their own query because the slot was busy with another account.
+    uint64_t bypassed;
+    // Found the query for their account older than hedgeAfter and ran a
+    // second one; the first of the two to end answers every waiter.
+    uint64_t hedged;
+    // Joined a query that ended TimedOut or StorageError and, with time
+    // left before their own deadline, looked the account up again.
+    uint64_t retried;
+
+    double coalescingRatio() const { return lookups ? static_cast<double>(coalesced) / lookups : 0.0; }
+};
+
+// Single flight for credential lookups shared by threads that each own a
+// Database connection. The first thread to ask for an account runs the
+// query; threads asking for the same account meanwhile wait for it and get
+// a copy of the record, then check their own password. In-flight lookups
+// live in a fixed table indexed by account hash; an account whose slot is
+// taken by another one simply runs its own query. A query is joined for as
+// long as it runs, each waiter bounded by its own deadline: a query waiting
+// out a writer's lock is exactly when a pile-up forms. Such a query may be
+// deep in its busy backoff, though, and sleep well past the lock's release
+// with everyone waiting on it; so once it is older than hedgeAfter, the
+// next thread for the account runs a second query, and the first of the
+// two to end answers all the waiters. Only a finished lookup (the account
+// found or not) is handed on: a waiter whose query timed out or failed
+// looks again, as long as its own deadline allows.
+class LookupCoalescer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LookupCoalescer(size_t slots = 256,
+                             std::chrono::microseconds hedgeAfter = std::chrono::milliseconds(5));
+    LookupCoalescer(const LookupCoalescer&) = delete;
+    LookupCoalescer& operator=(const LookupCoalescer&) = delete;
+
+    // Database::fetchCredential() on `db`, or on whichever connection is
+    // already reading `email`. A waiting thread gives up at `deadline`
+    // (TimedOut); Clock::time_point::max() waits for the query to end.
+    LoginOutcome fetch(std::string_view email, Database& db, FetchedCredential& fetched,
+                       Clock::time_point deadline);
+
+    CoalescerStats stats() const;
+
+private:
+    struct Flight {
+        bool active = false;
+        // Threads still to copy the result of the last query.
+        uint32_t readers = 0;
+        uint64_t generation = 0;
+        // A second query is running (or ran) for this flight.
+        bool hedged = false;
+        Clock::time_point started;
+        std::string email;
+        LoginOutcome outcome = LoginOutcome::StorageError;
+        FetchedCredential result;
+        // Per flight, so an ending query wakes only its own waiters.
+        std::condition_variable done;
+    };
+
+    // Ends the flight with this result, unless the other query of a hedged
+    // flight already did.
+    void finish(Flight& flight, uint64_t generation, LoginOutcome outcome, const FetchedCredential& fetched);
+
+    mutable std::mutex mutex;
+    std::vector<Flight> flights;
+    Clock::duration hedgeAfter;
+    CoalescerStats counters;
+};
+
+// StorageStage with the lookup shared through a LookupCoalescer: the
+// password is still checked by every login on its own. Give each thread
+// its own stage and connection and all of them the same coalescer, which
+// must outlive the stage, as must the Database (or ShardedDatabase).
+class CoalescedStorageStage : public AuthStage {
+public:
+    CoalescedStorageStage(LookupCoalescer& coalescer, Database& db)
+        : coalescer(coalescer), db(&db), sharded(nullptr) {}
+    CoalescedStorageStage(LookupCoalescer& coalescer, ShardedDatabase& sharded)
+        : coalescer(coalescer), db(nullptr), sharded(&sharded) {}
+
+    const char* name() const override { return "storage"; }
+    int cost() const override { return 100; }
+    bool decide(LoginContext& context) override;
+
+private:
+    LookupCoalescer& coalescer;
+    Database* db;
+    ShardedDatabase* sharded;
+    // Reused between logins.
+    FetchedCredential fetched;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef MAINTENANCESCHEDULER_H
+#define MAINTENANCESCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+
+class ActivityMonitor;
+
+struct MaintenanceOptions {
+    // Login traffic must have been quiet this long before a step starts.
+    int idleThresholdMs = 200;
+    // How often the background thread looks for an idle window.
+    int pollIntervalMs = 100;
+    // Hard cap on one step. A step holds the write lock for at most this
+    // long, which bounds the delay it can add to a foreground query; it is
+    // also interrupted as soon as a login arrives.
+    int stepBudgetMs = 5;
+    // PRAGMA optimize cadence.
+    int optimizeIntervalMs = 60 * 60 * 1000;
+    // Initial incremental_vacuum batch; adapted to fit the step budget.
+    int vacuumPagesPerStep = 64;
+    // WAL size above which a TRUNCATE checkpoint is attempted instead of a
+    // PASSIVE one.
+    int64_t walTruncateBytes = 4ll << 20;
+};
+
+struct MaintenanceReport {
+    uint64_t steps;
+    uint64_t interruptedSteps;
+    uint64_t optimizeRuns;
+    uint64_t vacuumSteps;
+    uint64_t pagesReclaimed;
+    uint64_t bytesReclaimed;
+    uint64_t checkpoints;
+    uint64_t truncatingCheckpoints;
+    uint64_t framesCheckpointed;
+    double maxStepMs;
+};
+
+// Background upkeep for auth.db: PRAGMA optimize, incremental vacuum and WAL
+// checkpoints, run in small budgeted steps on its own connection and only
+// while the shared ActivityMonitor reports no login traffic.
+class MaintenanceScheduler {
+public:
+    MaintenanceScheduler(const std::string& dbPath, ActivityMonitor& activity,
+                         const MaintenanceOptions& options = MaintenanceOptions());
+    ~MaintenanceScheduler();
+
+    bool start();
+    void stop();
+
+    // Runs one step now if the store is idle; returns true if work was done.
+    // Used by the background thread and by tests.
+    bool runStep();
+
+    MaintenanceReport report() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    MaintenanceScheduler(const MaintenanceScheduler&) = delete;
+    MaintenanceScheduler& operator=(const MaintenanceScheduler&) = delete;
+
+    bool open();
+    void loop();
+    bool runOptimize();
+    bool runVacuum();
+    bool runCheckpoint();
+    int64_t pragmaInt(const char* sql);
+    int64_t walBytes() const;
+    static int progressCallback(void* self);
+
+    std::string dbPath;
+    ActivityMonitor& activity;
+    MaintenanceOptions options;
+    sqlite3* db;
+
+    std::thread worker;
+    bool stopRequested;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+
+    Clock::time_point stepDeadline;
+    Clock::time_point lastOptimize;
+    bool optimizeDone;
+    int vacuumPages;
+    bool walBackfilled;
+    bool interrupted;
+    MaintenanceReport counters;
+};
+
+#endif
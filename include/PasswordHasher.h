@@ -0,0 +1,85 @@
+#ifndef PASSWORDHASHER_H
+#define PASSWORDHASHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// scrypt parameters: N = 2^logN iterations over 128 * r bytes, p lanes.
+// Memory per hash is 128 * r * N bytes (16 MiB for logN=14, r=8).
+struct HashCost {
+    // 0 means "not chosen yet": see PasswordHasher::calibrated().
+    int logN = 0;
+    int r = 8;
+    int p = 1;
+
+    bool operator==(const HashCost& other) const {
+        return logN == other.logN && r == other.r && p == other.p;
+    }
+    bool operator!=(const HashCost& other) const { return !(*this == other); }
+    // Compares the work of one hash, N * r * p. Parameters that differ but
+    // cost the same are neither weaker nor stronger.
+    bool weakerThan(const HashCost& other) const {
+        return (static_cast<uint64_t>(r) * p << logN) < (static_cast<uint64_t>(other.r) * other.p << other.logN);
+    }
+};
+
+struct PasswordCheck {
+    bool match;
+    // The stored value costs less than the current cost (or is a plaintext
+    // password from before hashing); rehash it after a match. A stronger
+    // stored hash is left alone, so processes calibrated to different costs
+    // do not rewrite each other's hashes.
+    bool needsRehash;
+    // The stored value has the $scrypt$ prefix but does not parse (truncated,
+    // corrupted, parameters out of range). Never matches.
+    bool malformed;
+};
+
+// scrypt (RFC 7914) over PBKDF2-HMAC-SHA-256.
+void scrypt(const void* password, size_t passwordLength, const void* salt, size_t saltLength,
+            const HashCost& cost, uint8_t* out, size_t outLength);
+
+// Encodes and checks stored passwords as
+//   $scrypt$ln=<logN>,r=<r>,p=<p>$<base64 salt>$<base64 key>
+// A stored value without the $scrypt$ prefix is a plaintext password written
+// before hashing was introduced; it still verifies and is flagged for rehash.
+// A value with the prefix that does not parse is reported malformed instead.
+class PasswordHasher {
+public:
+    static constexpr size_t kSaltSize = 16;
+    static constexpr size_t kKeySize = 32;
+
+    explicit PasswordHasher(const HashCost& cost);
+
+    std::string hash(std::string_view password) const;
+    std::string hash(std::string_view password, std::string_view salt) const;
+    // Allocation-free. Salts and keys longer than 64 bytes are not parsed.
+    PasswordCheck verify(std::string_view password, std::string_view stored) const;
+    // A well-formed value at this cost that no password matches. Verifying
+    // against it costs what a real check does, so an unknown account does not
+    // answer faster than a known one.
+    std::string dummy() const;
+
+    const HashCost& cost() const { return hashCost; }
+
+    // Picks the largest logN (with the given r and p) whose hash takes no
+    // more than targetMs on this machine; never below kMinCalibratedLogN.
+    // Each step is timed several times and judged on the median.
+    static HashCost calibrate(double targetMs, int r = 8, int p = 1);
+    // calibrate(), measured once per process and target.
+    static HashCost calibrated(double targetMs, int r = 8, int p = 1);
+    // Returns `cost` itself when logN is set, calibrated() otherwise.
+    static HashCost resolve(const HashCost& cost, double targetMs);
+
+    static bool parse(const std::string& stored, HashCost& cost, std::string& salt, std::string& key);
+
+    static constexpr int kMinCalibratedLogN = 10;
+    static constexpr int kMaxLogN = 22;
+
+private:
+    HashCost hashCost;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef PASSWORDRECOVERY_H
+#define PASSWORDRECOVERY_H
+
+#include "Database.h"
+#include "MpscRingBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct OutboundMessage {
+    std::string to;
+    std::string subject;
+    std::string body;
+};
+
+// Hands batches of messages to whatever delivers mail. deliver() is only
+// called from PasswordRecovery's sender thread.
+class MessageTransport {
+public:
+    virtual ~MessageTransport() = default;
+    // All or nothing: on false the whole batch is offered again later.
+    virtual bool deliver(const std::vector<OutboundMessage>& batch) = 0;
+};
+
+// Writes every batch as one file in a spool directory, for a mail agent to
+// pick up. Files are written under a temporary name, synced and then
+// renamed, so a reader never sees half a batch:
+//   spool-<unix ns>-<seq>.txt, one message after another as
+//   "To: ...\nSubject: ...\nContent-Length: N\n\n" followed by N body bytes.
+class SpoolTransport : public MessageTransport {
+public:
+    explicit SpoolTransport(const std::string& directory);
+    bool deliver(const std::vector<OutboundMessage>& batch) override;
+
+private:
+    std::string directory;
+    uint64_t nextBatch;
+};
+
+// Keeps delivered messages in memory; the local stand-in for tests.
+class MemoryTransport : public MessageTransport {
+public:
+    bool deliver(const std::vector<OutboundMessage>& batch) override;
+    // While failing, every delivery is refused.
+    void setFailing(bool failing);
+    std::vector<OutboundMessage> messages() const;
+    size_t batchCount() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<OutboundMessage> delivered;
+    size_t batches = 0;
+    bool failing = false;
+};
+
+struct RecoveryOptions {
+    int tokenTtlSeconds = 30 * 60;
+    // At most maxPerAccount messages per account within windowSeconds;
+    // further requests are dropped without telling the requester.
+    int maxPerAccount = 3;
+    int windowSeconds = 15 * 60;
+    size_t queueCapacity = 1 << 14;
+    // Requests turned into tokens (one transaction) and messages handed to
+    // the transport at once.
+    size_t maxBatch = 512;
+    int idleWaitMs = 5;
+    // A batch the transport refuses is retried with doubling pauses, then
+    // dropped; its tokens stay valid until they expire.
+    int maxDeliveryAttempts = 5;
+    int retryBackoffMs = 100;
+    // Used and expired tokens are deleted this often.
+    int purgeIntervalSeconds = 10 * 60;
+    std::string resetUrl = "https://auth.example/reset?token=";
+    std::string subject = "Recuperacion de clave";
+};
+
+struct RecoveryStats {
+    uint64_t requested;
+    uint64_t dropped;          // queue full or too long an email
+    uint64_t rateLimited;
+    uint64_t unknownAccounts;
+    uint64_t issued;
+    uint64_t delivered;
+    uint64_t deliveryFailures; // messages given up on
+    uint64_t storageErrors;    // requests whose token could not be stored
+    uint64_t batches;
+};
+
+// Password recovery off the UI thread. request() only copies the email
+// into a lock-free ring; a sender thread with its own Database connection
+// rate-limits per account, stores single-use expiring tokens (only their
+// hash) in batches and passes the messages to the transport in batches.
+// Unknown accounts get no message, but request() answers the same, so the
+// screen cannot be used to find out which emails have an account. Tokens
+// are redeemed with Database::redeemResetToken().
+class PasswordRecovery {
+public:
+    // The transport must outlive this object.
+    PasswordRecovery(const std::string& dbPath, MessageTransport& transport,
+                     const RecoveryOptions& options = RecoveryOptions(),
+                     const DatabaseOptions& databaseOptions = DatabaseOptions());
+    ~PasswordRecovery();
+
+    bool start();
+    // Handles every request queued so far, then stops the sender.
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+    // Lock-free and allocation-free. False if the request was dropped.
+    bool request(std::string_view email);
+
+    // Blocks until every request made before the call has been handled.
+    void flush();
+
+    RecoveryStats stats() const;
+
+    static constexpr size_t kMaxEmailLength = 254;
+
+private:
+    struct Request {
+        uint8_t length;
+        char email[kMaxEmailLength];
+    };
+
+    struct Window {
+        int64_t start;
+        int count;
+    };
+
+    PasswordRecovery(const PasswordRecovery&) = delete;
+    PasswordRecovery& operator=(const PasswordRecovery&) = delete;
+
+    void senderLoop();
+    bool allow(const std::string& email, int64_t now);
+    void issue(std::vector<std::string>& emails, int64_t now);
+    void deliverOutbox();
+    std::string newToken();
+
+    std::string dbPath;
+    MessageTransport& transport;
+    RecoveryOptions options;
+    DatabaseOptions databaseOptions;
+    // Used by the sender thread only.
+    std::unique_ptr<Database> db;
+    std::unordered_map<uint64_t, Window> windows;
+    std::vector<OutboundMessage> outbox;
+
+    MpscRingBuffer<Request> ring;
+    std::thread sender;
+    std::atomic<bool> running;
+    std::atomic<bool> stopRequested;
+
+    std::atomic<uint64_t> requested;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> handled;
+    std::atomic<uint64_t> rateLimited;
+    std::atomic<uint64_t> unknownAccounts;
+    std::atomic<uint64_t> issued;
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> deliveryFailures;
+    std::atomic<uint64_t> storageErrors;
+    std::atomic<uint64_t> batches;
+
+    std::mutex flushMutex;
+    std::condition_variable flushed;
+};
+
+#endif
@@ -1,15 +1,53 @@
 #ifndef PASSWORDVALIDATOR_H
 #define PASSWORDVALIDATOR_H
 
-#include <string>
+#include <cstddef>
+#include <string_view>
 
 class PasswordValidator {
 public:
-    static bool validate(const std::string& password);
-    static bool hasMinLength(const std::string& password);
-    static bool hasMaxLength(const std::string& password);
-    static bool hasUpperCase(const std::string& password);
-    static bool hasSpecialChar(const std::string& password);
+    static constexpr size_t kMinLength = 5;
+    static constexpr size_t kMaxLength = 10;
+
+    static bool validate(std::string_view password);
+    static bool hasMinLength(std::string_view password);
+    static bool hasMaxLength(std::string_view password);
+    static bool hasUpperCase(std::string_view password);
+    static bool hasSpecialChar(std::string_view password);
+
+    // How each character counts towards the rules above.
+    static bool isUpperCase(char c);
+    static bool isSpecialChar(char c);
+};
+
+// The same policy kept up to date while the password is typed: push() and
+// pop() adjust per-rule counters in O(1) instead of rescanning the string,
+// so the screen can show every rule and hold back submission until
+// valid(). pop() must be given the character being removed.
+class PasswordPolicyState {
+public:
+    void push(char c);
+    void pop(char removed);
+    void clear();
+
+    size_t length() const { return characters; }
+    bool hasMinLength() const { return characters >= PasswordValidator::kMinLength; }
+    bool hasMaxLength() const { return characters <= PasswordValidator::kMaxLength; }
+    bool hasUpperCase() const { return upper > 0; }
+    bool hasSpecialChar() const { return special > 0; }
+    bool valid() const { return hasMinLength() && hasMaxLength() && hasUpperCase() && hasSpecialChar(); }
+
+    // 0 (empty) to 4, from the kinds of character used (lowercase,
+    // uppercase, digit, special) and the length; only a guide for the user,
+    // valid() alone decides what may be submitted.
+    int strength() const;
+
+private:
+    size_t characters = 0;
+    size_t upper = 0;
+    size_t lower = 0;
+    size_t digits = 0;
+    size_t special = 0;
 };
 
 #endif
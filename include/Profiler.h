@@ -0,0 +1,121 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "MpscRingBuffer.h"
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// In-process sampling CPU profiler, for hosts where attaching perf or gdb is
+// not allowed. setitimer(ITIMER_PROF) sends SIGPROF every 1/frequencyHz of
+// CPU time used by the process, to whichever thread is running; the handler
+// captures the stack and pushes it into a lock-free ring. A background
+// thread drains the ring into a table of stacks and counts.
+//
+// On Linux x86-64 and AArch64 the handler walks the frame pointer chain from
+// the interrupted registers: no locks, no allocation, no unwind tables, well
+// under a microsecond per sample. The build keeps frame pointers for this
+// (-fno-omit-frame-pointer); frames of code built without them, such as
+// most system libraries, are skipped up to the next frame that has one, or
+// end the stack. A frame pointer such code left behind is never followed
+// off the thread's stack, or into unmapped memory (see registerThread()).
+// Elsewhere it falls back to backtrace(), loaded by start(),
+// which is only async-signal-safe from glibc 2.35 with GCC 12's unwinder.
+//
+// Profiles use the legacy binary CPU profile format of gperftools, which
+// pprof reads:
+//   header:  0, 3, 0, sampling period in us, 0
+//   per distinct stack: count, depth, program counters (innermost first)
+//   trailer: 0, 1, 0
+//   then the text of /proc/self/maps, for symbolization
+// Words are native-endian uintptr_t. Symbolize against the same binary:
+//   pprof -top ./AuthLoadGen auth.prof
+// Only one profiler can run in a process. Not available on Windows.
+
+// Frames kept per sample; deeper stacks lose their outermost frames.
+const int kProfileMaxDepth = 64;
+
+struct ProfileSample {
+    uint32_t depth;
+    uintptr_t pcs[kProfileMaxDepth];
+};
+
+struct ProfilerOptions {
+    int frequencyHz = 100;
+    // Samples held between drains; when full, samples are dropped (counted).
+    size_t ringCapacity = 4096;
+    int drainIntervalMs = 100;
+    // Written by stop(), and whenever dumpSignal arrives. Empty: only
+    // writeProfile() writes.
+    std::string outputPath;
+    // 0 disables the signal.
+#ifndef _WIN32
+    int dumpSignal = SIGUSR2;
+#else
+    int dumpSignal = 0;
+#endif
+};
+
+struct ProfilerStats {
+    uint64_t samples;
+    uint64_t dropped;
+    // Time spent in the signal handler; against samples * period, the share
+    // of CPU the profiler itself costs.
+    uint64_t captureNs;
+    uint64_t stacks;
+    uint64_t profilesWritten;
+};
+
+class CpuProfiler {
+public:
+    explicit CpuProfiler(const ProfilerOptions& options = ProfilerOptions());
+    ~CpuProfiler();
+
+    // Installs the handlers and starts the timer. False if another profiler
+    // is running, or on Windows.
+    bool start();
+    // Stops sampling and writes outputPath, if set.
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Records the calling thread's stack bounds, so the handler walks its
+    // frames without leaving the stack. start() registers its own thread;
+    // samples of other threads probe each frame with a system call instead.
+    static void registerThread();
+
+    // Every sample since start(). Can be called while running.
+    bool writeProfile(const std::string& path);
+
+    ProfilerStats stats() const;
+
+private:
+    CpuProfiler(const CpuProfiler&) = delete;
+    CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+    void loop();
+    // Moves the ring into stacks; caller holds mutex.
+    void drain();
+
+    ProfilerOptions options;
+    MpscRingBuffer<ProfileSample> ring;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    bool running;
+    bool stopRequested;
+    std::map<std::vector<uintptr_t>, uint64_t> stacks;
+    // Sample counts kept by the signal handler while running, frozen here
+    // by stop().
+    uint64_t samples;
+    uint64_t dropped;
+    uint64_t captureNs;
+    uint64_t profilesWritten;
+};
+
+#endif
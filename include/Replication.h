@@ -0,0 +1,164 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "LatencyHistogram.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+
+class SharedCredentialCache;
+
+// Log-shipping replication of usuarios (schema v6). On the primary,
+// triggers append every committed insert, update and delete of an account
+// to the cambios table; ChangeShipper moves those rows into numbered
+// segment files in a log directory and trims them from the table. Each
+// replica node gets a copy of the directory (shared, rsync, ...) and a
+// ReplicaFollower applies the segments, in order, to its own auth.db.
+//
+// A segment is named "<first seq>-<last seq>.log" (20 digits each) and
+// written to a temporary name, synced and renamed, so a follower only ever
+// sees whole segments; its CRC-32 catches the rest. Applying is
+// idempotent: a follower skips changes up to its stored position, so a
+// segment written twice after a crash does no harm.
+//
+// Stored hashes are shipped as they are in usuarios, so the log directory
+// needs the same protection as auth.db.
+
+struct ShipperOptions {
+    // How often the change log is polled.
+    int intervalMs = 50;
+    // Changes per segment; a longer backlog is shipped in several.
+    size_t maxRecords = 10000;
+    // Segments kept in the directory; older ones are deleted. A replica that
+    // falls further behind must be seeded again (ReplicaFollower::seed).
+    size_t maxSegments = 1000;
+};
+
+struct ShipperStats {
+    // Last change written to a segment.
+    uint64_t position;
+    uint64_t segments;
+    uint64_t changes;
+    uint64_t failures;
+    double maxShipMs;
+};
+
+// Ships the change log of the primary auth.db. Shared by every thread.
+class ChangeShipper {
+public:
+    ChangeShipper(const std::string& dbPath, const std::string& logDirectory,
+                  const ShipperOptions& options = ShipperOptions());
+    ~ChangeShipper();
+
+    // Marks the file as a primary, the first time logging every account as
+    // it stands, and starts shipping. Fails on a replica.
+    bool start();
+    // Ships what is left, then stops.
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Writes one segment with up to maxRecords changes; how many, or -1 on
+    // error. Used by the background thread and by tests.
+    int shipOnce();
+
+    ShipperStats stats() const;
+
+private:
+    ChangeShipper(const ChangeShipper&) = delete;
+    ChangeShipper& operator=(const ChangeShipper&) = delete;
+
+    bool open();
+    void loop();
+    void pruneSegments();
+
+    std::string dbPath;
+    std::string logDirectory;
+    ShipperOptions options;
+    // Guarded by shipMutex.
+    sqlite3* db;
+    std::mutex shipMutex;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    bool running;
+    bool stopRequested;
+    ShipperStats counters;
+};
+
+struct FollowerOptions {
+    // How often the log directory is listed.
+    int pollIntervalMs = 20;
+    // Opens the replica in WAL mode so logins never wait for an apply.
+    bool walMode = true;
+    // Cache of the replica node; every applied account is invalidated.
+    // Must outlive the follower.
+    SharedCredentialCache* sharedCache = nullptr;
+};
+
+struct ReplicaStatus {
+    // Last change applied; stored in the replica, so it survives restarts.
+    uint64_t position;
+    uint64_t applied;
+    uint64_t segments;
+    uint64_t failures;
+    // The next change has already been pruned from the directory: seed the
+    // replica again from a backup of the primary.
+    bool gap;
+    // Primary commit to replica commit, per change. Across machines this
+    // includes their clock difference.
+    LatencyHistogram lag;
+    double lastLagMs;
+};
+
+// Keeps a read-only replica of auth.db up to date from a log directory.
+// Database opens a replica query_only, so only the follower writes to it.
+class ReplicaFollower {
+public:
+    ReplicaFollower(const std::string& replicaPath, const std::string& logDirectory,
+                    const FollowerOptions& options = FollowerOptions());
+    ~ReplicaFollower();
+
+    // Replaces the replica with a backup of the primary (Database::backup)
+    // and continues from the last change in it. Call before start().
+    bool seed(const std::string& snapshotPath);
+    // Creates the replica if there is none, then tails the directory. Fails
+    // on a primary.
+    bool start();
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Applies every complete segment past the position, one transaction
+    // each; changes applied, or -1 on error or gap.
+    int applyOnce();
+
+    ReplicaStatus status() const;
+
+private:
+    ReplicaFollower(const ReplicaFollower&) = delete;
+    ReplicaFollower& operator=(const ReplicaFollower&) = delete;
+
+    bool open();
+    // Turns the file into a replica positioned after its last logged change.
+    bool makeReplica();
+    void loop();
+
+    std::string replicaPath;
+    std::string logDirectory;
+    FollowerOptions options;
+    // Guarded by applyMutex.
+    sqlite3* db;
+    std::mutex applyMutex;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    bool running;
+    bool stopRequested;
+    ReplicaStatus current;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SCHEMAMIGRATOR_H
+#define SCHEMAMIGRATOR_H
+
+#include <functional>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+// Rebuilds `table` into a new definition (e.g. WITHOUT ROWID) by copying the
+// listed columns. Columns must exist under the same name on both sides and
+// `key` must be indexed in the old table and the primary key of the new one.
+struct TableRebuild {
+    std::string table;
+    // CREATE TABLE statement for the new layout; "{table}" is replaced by the
+    // name of the shadow table.
+    std::string createSql;
+    std::vector<std::string> columns;
+    std::string key;
+    // Statements run after the swap (indexes etc.); "{table}" -> table.
+    std::vector<std::string> afterSwapSql;
+};
+
+struct Migration {
+    int version;
+    std::string description;
+    std::string sql;           // plain DDL/DML, or...
+    TableRebuild rebuild;      // ...used when sql is empty
+
+    bool isRebuild() const { return sql.empty(); }
+};
+
+struct MigrationProgress {
+    int version;
+    const std::string* description;
+    long long rowsCopied;
+    long long rowsTotal;
+    bool finished;
+};
+
+struct MigrationReport {
+    int fromVersion;
+    int toVersion;
+    int applied;
+    long long rowsCopied;
+    int copyBatches;
+    double maxBatchMs;
+};
+
+// Applies versioned migrations keyed on PRAGMA user_version.
+//
+// - Current schema: one PRAGMA read, no DDL.
+// - New database: every migration runs in a single transaction.
+// - Existing database: if the first pending migration is a table rebuild,
+//   its rows are first copied online into a shadow table in short batches
+//   (each batch is its own transaction, sized to stay under maxBatchMs) while
+//   triggers mirror concurrent writes. Then the swap and every remaining
+//   migration commit together with the new user_version in one transaction.
+// - Several processes opening the same file: user_version is read again
+//   under the write lock, so the first one migrates and the others find it
+//   done. Each copies into a shadow table named after itself.
+class SchemaMigrator {
+public:
+    using ProgressCallback = std::function<void(const MigrationProgress&)>;
+
+    SchemaMigrator(sqlite3* db, std::vector<Migration> migrations);
+
+    void setProgressCallback(ProgressCallback callback) { progress = std::move(callback); }
+    void setMaxBatchMs(int ms) { maxBatchMs = ms; }
+    // Databases created before user_version was tracked report 0; if
+    // `table` already exists such a file is treated as being at `version`.
+    void adoptUnversioned(const std::string& table, int version);
+    // Run before the first migration on a new database, outside the
+    // transaction (PRAGMA auto_vacuum cannot change inside one).
+    void setCreationPragmas(const std::string& sql) { creationPragmas = sql; }
+
+    bool migrate();
+
+    int currentVersion();
+    int latestVersion() const;
+    const MigrationReport& report() const { return result; }
+
+private:
+    bool exec(const std::string& sql);
+    // `version` with adoptUnversioned() applied.
+    int adopted(int version);
+    std::vector<Migration>::const_iterator pending(int version) const;
+    // True, with the report updated, if the file is already at the latest
+    // version.
+    bool upToDate();
+    std::string shadowName(const TableRebuild& rebuild) const;
+    bool tableExists(const std::string& table);
+    long long countRows(const std::string& table);
+    bool copyOnline(const Migration& migration);
+    bool finishRebuild(const Migration& migration, bool copyInline);
+    void dropShadow(const TableRebuild& rebuild);
+    void notify(const Migration& migration, long long copied, long long total, bool finished);
+
+    sqlite3* db;
+    std::vector<Migration> migrations;
+    ProgressCallback progress;
+    int maxBatchMs;
+    std::string creationPragmas;
+    std::string adoptTable;
+    int adoptVersion;
+    // Random; tells this migrator's shadow tables from other processes'.
+    std::string owner;
+    MigrationReport result;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Round constants and initial hash value, shared with Sha256Batch.
+extern const uint32_t kSha256RoundConstants[64];
+extern const uint32_t kSha256InitialState[8];
+
+// SHA-256 (FIPS 180-4). Feed data with update() and read the digest with
+// finish(); the object can be reused after reset().
+class Sha256 {
+public:
+    static constexpr size_t kDigestSize = 32;
+    static constexpr size_t kBlockSize = 64;
+
+    Sha256();
+    void reset();
+    void update(const void* data, size_t length);
+    void finish(uint8_t digest[kDigestSize]);
+
+    static void digest(const void* data, size_t length, uint8_t out[kDigestSize]);
+
+private:
+    void compress(const uint8_t* block);
+
+    uint32_t state[8];
+    uint8_t buffer[kBlockSize];
+    size_t buffered;
+    uint64_t totalBytes;
+};
+
+// HMAC-SHA-256 (RFC 2104).
+void hmacSha256(const void* key, size_t keyLength, const void* data, size_t dataLength,
+                uint8_t out[Sha256::kDigestSize]);
+
+// PBKDF2 with HMAC-SHA-256 as the PRF (RFC 8018).
+void pbkdf2HmacSha256(const void* password, size_t passwordLength, const void* salt, size_t saltLength,
+                      uint32_t iterations, uint8_t* out, size_t outLength);
+
+std::string toHex(const uint8_t* data, size_t length);
+
+#endif
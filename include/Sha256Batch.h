@@ -0,0 +1,47 @@
+#ifndef SHA256BATCH_H
+#define SHA256BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Sha256.h"
+
+// Hashes many independent messages per call. The kernel is chosen at run
+// time from what the CPU supports:
+//
+//   ShaNi   x86 SHA extensions, one message at a time in hardware
+//   Avx512  16 messages in lock step, one per 32-bit lane
+//   Avx2    8 messages in lock step
+//   Scalar  portable fallback (also used off x86 and without GCC/Clang)
+//
+// Every kernel produces the same digests; results only differ in speed.
+enum class Sha256Kernel {
+    Scalar,
+    Avx2,
+    Avx512,
+    ShaNi
+};
+
+struct Sha256Input {
+    const void* data;
+    size_t length;
+};
+
+using Sha256Digest = uint8_t[Sha256::kDigestSize];
+
+bool sha256KernelSupported(Sha256Kernel kernel);
+// Fastest supported kernel on this machine, measured once on first use.
+Sha256Kernel sha256BestKernel();
+const char* sha256KernelName(Sha256Kernel kernel);
+
+// digests[i] = SHA-256(inputs[i]). Without a kernel, batches of fewer than
+// four messages skip the lane kernels.
+void sha256Batch(const Sha256Input* inputs, size_t count, Sha256Digest* digests);
+void sha256Batch(const Sha256Input* inputs, size_t count, Sha256Digest* digests, Sha256Kernel kernel);
+
+// digests[i] = HMAC-SHA-256(key, inputs[i]).
+void hmacSha256Batch(const void* key, size_t keyLength, const Sha256Input* inputs, size_t count,
+                     Sha256Digest* digests);
+void hmacSha256Batch(const void* key, size_t keyLength, const Sha256Input* inputs, size_t count,
+                     Sha256Digest* digests, Sha256Kernel kernel);
+
+#endif
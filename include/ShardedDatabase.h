@@ -0,0 +1,61 @@
+#ifndef SHARDEDDATABASE_H
+#define SHARDEDDATABASE_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Database.h"
+
+// Spreads accounts over several SQLite files, one Database connection per
+// file. SQLite lets only one connection write a file at a time, so with N
+// shards up to N password changes or provisioning batches commit at once
+// instead of queueing on a single lock.
+//
+// An account's shard is fixed by a hash of its email, trimmed and
+// lowercased, and the shard count; changing the count needs AuthReshard.
+// With one shard the file is `basePath` itself, so an unsharded auth.db is
+// a valid one-shard store. Like Database, not thread-safe: give every
+// thread its own ShardedDatabase.
+class ShardedDatabase {
+public:
+    using Clock = Database::Clock;
+
+    ShardedDatabase(const std::string& basePath, int shardCount,
+                    const DatabaseOptions& options = DatabaseOptions());
+
+    // Initializes (and if needed creates or migrates) every shard.
+    bool initialize();
+    LoginOutcome authenticate(std::string_view email, std::string_view password);
+    LoginOutcome authenticate(std::string_view email, std::string_view password,
+                              Clock::time_point deadline);
+    bool addUser(const std::string& email, const std::string& password);
+    // Splits the users by shard and writes the shards in parallel, one
+    // transaction each. On failure some shards may have committed.
+    bool addUsers(const std::vector<std::pair<std::string, std::string>>& users);
+    bool changePassword(const std::string& email, const std::string& newPassword);
+
+    int shardCount() const { return static_cast<int>(shards.size()); }
+    Database& shard(int index) { return *shards[index]; }
+    Database& shardFor(std::string_view email) { return *shards[shardIndex(email, shardCount())]; }
+
+    // Forwarded to every shard; see Database.
+    void setTraceRecorder(LoginTraceWriter* recorder);
+    void setActivityMonitor(ActivityMonitor* monitor);
+    void setStuffingDetector(StuffingDetector* detector, const std::string& source);
+
+    // Sum over the shards.
+    DatabaseStats stats() const;
+
+    // Shard of `email` among `shardCount` (jump consistent hash, so going
+    // from N to N+1 shards moves only about 1/(N+1) of the accounts).
+    static int shardIndex(std::string_view email, int shardCount);
+    // "auth.db" for a single shard, otherwise "auth.db.2-of-4" and so on.
+    static std::string shardPath(const std::string& basePath, int index, int shardCount);
+
+private:
+    std::vector<std::unique_ptr<Database>> shards;
+};
+
+#endif
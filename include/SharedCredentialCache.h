@@ -0,0 +1,97 @@
+#ifndef SHAREDCREDENTIALCACHE_H
+#define SHAREDCREDENTIALCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+struct SharedCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t fills;
+    uint64_t invalidations;
+    // Entries taken over from a writer that died, or stalled, mid-fill.
+    uint64_t takeovers;
+};
+
+// Host-wide cache of credential rows (usuario -> clave) in a POSIX shared
+// memory segment (shm_open + mmap), so every process using the same auth.db
+// shares one warm cache. Entries carry no database identity: name segments
+// with segmentName(), so processes using different files never share one.
+//
+// The segment is a fixed-size open-addressing table. Each entry is guarded
+// by a seqlock: writers make the sequence odd, write, and make it even
+// again; readers copy the entry and retry if the sequence moved. Nothing
+// blocks, and a writer that finds an entry busy simply skips it. A writer
+// claims an entry under its pid and stamps the time; if that process is gone,
+// or has held the entry for over a second, the next writer takes it over, so
+// a process killed mid-fill does not leave the entry busy for good.
+//
+// Invalidation is by generation. Keys hash onto stripes, each with its own
+// generation, plus one global generation; an entry is valid only while both
+// still match the values it was filled under. Writers bump the stripe after
+// committing a change to a key (invalidate), or the global generation after
+// bulk changes (invalidateAll). A reader takes a ticket before reading the
+// row, so a write that lands between its read and its fill voids the fill.
+//
+// Only writes made through Database invalidate entries; changing auth.db by
+// other means requires invalidateAll(). Not available on Windows, where
+// attach() fails and the cache stays empty.
+class SharedCredentialCache {
+public:
+    static constexpr size_t kMaxKeyLength = 96;
+    static constexpr size_t kMaxValueLength = 160;
+    static constexpr size_t kDefaultCapacity = 8192;
+
+    SharedCredentialCache();
+    ~SharedCredentialCache();
+    SharedCredentialCache(const SharedCredentialCache&) = delete;
+    SharedCredentialCache& operator=(const SharedCredentialCache&) = delete;
+
+    // `prefix` (e.g. "/authscreen-cache") followed by a hash of the
+    // canonical path of `dbPath`: the segment of that database file.
+    static std::string segmentName(const std::string& prefix, const std::string& dbPath);
+
+    // Creates the segment `name` (see segmentName()) or attaches to the
+    // existing one, which must have the same capacity.
+    bool attach(const std::string& name, size_t capacity = kDefaultCapacity);
+    void detach();
+    bool isAttached() const { return segment != nullptr; }
+    // Removes the name; processes already attached keep their mapping.
+    static bool unlink(const std::string& name);
+
+    bool lookup(std::string_view key, std::string& value);
+    // Copies the value into `value`, which has room for kMaxValueLength
+    // bytes; allocation-free.
+    bool lookup(std::string_view key, char* value, size_t& valueLength);
+    uint64_t fillTicket(std::string_view key) const;
+    // Stores the value read after fillTicket(); ignored if the key was
+    // invalidated since, or if key or value are too long to cache.
+    void fill(std::string_view key, std::string_view value, uint64_t ticket);
+    void invalidate(std::string_view key);
+    void invalidateAll();
+
+    SharedCacheStats stats() const;
+    size_t capacity() const;
+
+private:
+    struct Segment;
+    struct Entry;
+
+    uint64_t currentTicket(uint64_t hash) const;
+    // Makes the entry's sequence odd under this process, taking it over if
+    // its writer abandoned it; returns the claimed sequence, or 0 if busy.
+    uint64_t claim(Entry& entry);
+    bool abandoned(const Entry& entry, uint64_t sequence) const;
+    // Copies key and value, back to back, into `bytes` when it is set.
+    bool readEntry(const Entry& entry, uint64_t& hash, uint64_t& ticket, char* bytes, size_t& keyLength,
+                   size_t& valueLength) const;
+
+    Segment* segment;
+    Entry* entries;
+    size_t mappedBytes;
+    size_t mask;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct SnapshotInfo {
+    uint64_t rawBytes;
+    uint64_t storedBytes;
+};
+
+// Compressed copy of a file, used for auth.db backups. The file is split
+// into 256 KB blocks, each compressed with a small LZ77 codec (LZ4-style
+// sequences: literal run, 16-bit offset, match length) and stored with its
+// CRC-32; blocks that do not shrink are stored as-is. A trailer carries the
+// total size and a CRC-32 over the block CRCs.
+//
+// Both functions write to `path` + ".tmp", fsync it and rename it into
+// place, so a crash never leaves a partial file under the final name.
+bool writeSnapshot(const std::string& sourcePath, const std::string& snapshotPath,
+                   SnapshotInfo* info = nullptr);
+// Fails, leaving `outputPath` untouched, if any checksum does not match.
+bool readSnapshot(const std::string& snapshotPath, const std::string& outputPath,
+                  SnapshotInfo* info = nullptr);
+
+// The block codec. `out` must hold lzCompressBound(length) bytes.
+size_t lzCompressBound(size_t length);
+size_t lzCompress(const uint8_t* in, size_t length, uint8_t* out);
+// Returns false on malformed input or if the output is not exactly
+// `outLength` bytes.
+bool lzDecompress(const uint8_t* in, size_t length, uint8_t* out, size_t outLength);
+
+#endif
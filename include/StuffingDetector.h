@@ -0,0 +1,119 @@
+#ifndef STUFFINGDETECTOR_H
+#define STUFFINGDETECTOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What a failed login is counted against.
+enum class StuffingKey {
+    Account,
+    Source,
+    // Prefix of SHA-256(password): one password sprayed over many accounts.
+    PasswordPrefix
+};
+
+const int kStuffingKeyCount = 3;
+
+const char* stuffingKeyName(StuffingKey kind);
+
+struct StuffingDetectorOptions {
+    // Total for all sketches and heavy-hitter tables; fixed at construction.
+    size_t memoryBytes = 4u << 20;
+    // Count-min rows; the estimate errs with probability ~ 2^-depth.
+    int depth = 4;
+    // A failure loses half its weight every halfLife.
+    std::chrono::milliseconds halfLife = std::chrono::seconds(60);
+    // Heavy hitters kept per key kind (Space-Saving counters).
+    size_t trackedKeys = 256;
+    // Bytes of SHA-256(password) kept as the password key. Short prefixes
+    // group unrelated passwords and never identify one.
+    size_t passwordPrefixBytes = 3;
+};
+
+struct StuffingOffender {
+    std::string key;
+    // Time-decayed failures; never below the true value.
+    double failures;
+    // failures - error is a lower bound on the true value.
+    double error;
+};
+
+// Streaming detector for credential stuffing and password spraying. Every
+// failed login updates, per key kind, a count-min sketch (estimates for any
+// key) and a Space-Saving table (the current top offenders) that only
+// takes in keys the sketch already counts above its smallest entry. Counts decay
+// exponentially with forward decay: new events get a growing weight instead
+// of old ones being scaled down, so an update touches only depth counters.
+// Keys longer than kMaxKeyLength are truncated in reports. Thread-safe.
+class StuffingDetector {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kMaxKeyLength = 64;
+
+    explicit StuffingDetector(const StuffingDetectorOptions& options = StuffingDetectorOptions());
+
+    void recordFailure(const std::string& account, const std::string& source, const std::string& password,
+                       Clock::time_point now = Clock::now());
+    void record(StuffingKey kind, const std::string& key, Clock::time_point now = Clock::now());
+
+    double estimate(StuffingKey kind, const std::string& key, Clock::time_point now = Clock::now()) const;
+    // Highest decayed counts first.
+    std::vector<StuffingOffender> topOffenders(StuffingKey kind, size_t count,
+                                               Clock::time_point now = Clock::now()) const;
+
+    uint64_t events() const;
+    // Bytes allocated for counters; within options.memoryBytes unless that
+    // is too small for the minimum sketch width.
+    size_t memoryBytes() const;
+    size_t sketchWidth() const { return width; }
+
+    static std::string passwordKey(const std::string& password, size_t prefixBytes);
+
+private:
+    struct Slot {
+        uint64_t hash;
+        double count;
+        double error;
+        uint32_t heapIndex;
+        uint8_t keyLength;
+        char key[kMaxKeyLength];
+    };
+
+    // Space-Saving counters in a min-heap on count, found by hash through an
+    // open-addressing index.
+    struct HeavyHitters {
+        std::vector<Slot> slots;
+        std::vector<uint32_t> heap;
+        std::vector<uint32_t> index;
+        size_t used = 0;
+    };
+
+    void prefetch(int kind, uint64_t hash) const;
+    void add(int kind, uint64_t hash, const std::string& key, double weight);
+    double weightAt(Clock::time_point now) const;
+    double decayAt(Clock::time_point now) const;
+    void rescale(Clock::time_point now);
+    void addHeavyHitter(HeavyHitters& table, uint64_t hash, const std::string& key, double weight,
+                        double estimate);
+    uint32_t* findIndex(HeavyHitters& table, uint64_t hash);
+    void eraseIndex(HeavyHitters& table, uint64_t hash);
+    void siftUp(HeavyHitters& table, size_t position);
+    void siftDown(HeavyHitters& table, size_t position);
+    void swapHeap(HeavyHitters& table, size_t a, size_t b);
+
+    StuffingDetectorOptions options;
+    size_t width;
+    size_t indexMask;
+    std::vector<double> sketches[kStuffingKeyCount];
+    HeavyHitters heavy[kStuffingKeyCount];
+    Clock::time_point landmark;
+    uint64_t eventCount;
+    mutable std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef WARMSTATE_H
+#define WARMSTATE_H
+
+#include "AuthPipeline.h"
+#include "Database.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct WarmStateOptions {
+    // Hot accounts written to the file; the tracker keeps twice as many
+    // candidates.
+    size_t maxAccounts = 4096;
+    // How often the file is rewritten while running; 0 writes it only on
+    // stop().
+    int saveIntervalMs = 5 * 60 * 1000;
+    // Cap on the auth.db pages read ahead on restore.
+    uint64_t maxPrefetchBytes = 256ull << 20;
+};
+
+struct WarmStateReport {
+    // The file was there and intact.
+    bool loaded;
+    // auth.db has not been written since the file was saved, so its page
+    // hints were used.
+    bool pagesMatched;
+    uint64_t accounts;
+    // Hot accounts read back from auth.db (and into the shared cache).
+    uint64_t accountsWarmed;
+    uint64_t pagesPrefetched;
+    double restoreMs;
+};
+
+// Warm-restart state for auth.db. While running it counts the accounts that
+// log in; save() writes the hottest ones, with a map of the auth.db pages
+// the OS has cached (mincore), to a small file. restore() reads the file
+// back at startup: if auth.db is unchanged since (size, mtime and SQLite's
+// change counter) the cached pages are read ahead, and every hot account is
+// looked up on a connection of its own, which pulls its pages in and fills
+// the shared credential cache, if one is set in the DatabaseOptions.
+//
+// Only account keys and page numbers are kept in the file. Stored hashes
+// always come from auth.db, so a stale file costs some reads but never lets
+// an old password in.
+//
+// The file is a fixed header followed by fixed-width records and the page
+// bitmap, so it is mapped and read in place. Shared by every thread.
+class WarmState {
+public:
+    static constexpr size_t kMaxKeyLength = 96;
+
+    WarmState(const std::string& dbPath, const std::string& statePath,
+              const WarmStateOptions& options = WarmStateOptions(),
+              const DatabaseOptions& databaseOptions = DatabaseOptions());
+    ~WarmState();
+
+    // Restores in the background, then saves every saveIntervalMs.
+    bool start();
+    // Saves once more and stops the thread.
+    void stop();
+    bool isRunning() const { return running; }
+    // True once the restore started by start() has finished.
+    bool isWarm() const;
+
+    // Counts a login on `email`; allocation-free.
+    void touch(std::string_view email);
+    // Tracked accounts, hottest first.
+    std::vector<std::string> hotAccounts() const;
+
+    bool save();
+    WarmStateReport restore();
+    // Of the last restore().
+    WarmStateReport report() const;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        uint32_t count;
+        uint32_t length;
+        char key[kMaxKeyLength];
+    };
+
+    WarmState(const WarmState&) = delete;
+    WarmState& operator=(const WarmState&) = delete;
+
+    // touch() `times` over; restore() seeds the tracker with saved counts.
+    void add(std::string_view email, uint32_t times);
+    bool stopping() const;
+    void loop();
+
+    std::string dbPath;
+    std::string statePath;
+    WarmStateOptions options;
+    DatabaseOptions databaseOptions;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    // Direct-mapped; a different account on a taken slot wears its count
+    // down by one and takes it over at zero, so frequent accounts stay.
+    std::vector<Slot> slots;
+    WarmStateReport lastRestore;
+    bool warm;
+    bool running;
+    bool stopRequested;
+    std::thread worker;
+};
+
+// Tells the WarmState which accounts log in. Sees every login after the
+// fact and never decides. The WarmState must outlive the stage.
+class WarmStateStage : public AuthStage {
+public:
+    explicit WarmStateStage(WarmState& state) : state(state) {}
+
+    const char* name() const override { return "warm-state"; }
+    int cost() const override { return 1000; }
+    void observe(const LoginContext& context) override;
+
+private:
+    WarmState& state;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef ZIPFGENERATOR_H
+#define ZIPFGENERATOR_H
+
+#include <cstdint>
+#include <random>
+
+// Draws ranks in [0, n) with P(k) proportional to 1 / (k + 1)^exponent.
+// Uses rejection-inversion sampling (Hoermann & Derflinger), which is O(1)
+// per draw and needs no per-element table, so it works for 10M+ accounts.
+// An exponent of 0 gives a uniform distribution.
+class ZipfGenerator {
+public:
+    ZipfGenerator(uint64_t n, double exponent);
+
+    uint64_t next(std::mt19937_64& rng);
+
+    uint64_t size() const { return n; }
+    double getExponent() const { return exponent; }
+
+private:
+    double h(double x) const;
+    double hIntegral(double x) const;
+    double hIntegralInverse(double x) const;
+
+    uint64_t n;
+    double exponent;
+    double hIntegralX1;
+    double hIntegralN;
+    double squeeze;
+};
+
+#endif
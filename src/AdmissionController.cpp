@@ -0,0 +1,143 @@
+#include "AdmissionController.h"
+#include <algorithm>
+
+AdmissionController::AdmissionController(const AdmissionOptions& options)
+    : options(options), inFlight(0), waitingSession(0), waitingFresh(0), intervalStart(Clock::now()),
+      minDelay(Clock::duration::max()), intervalSamples(0), shedding(false), counters() {
+    this->options.maxInFlight = std::max<size_t>(1, options.maxInFlight);
+}
+
+bool AdmissionController::acquire(bool hasSession, Clock::time_point deadline, Clock::time_point received) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point now = Clock::now();
+    // Time queued before the pipeline, in an accept queue say, counts too.
+    Clock::time_point arrival = received != Clock::time_point() && received < now ? received : now;
+    size_t& waiting = hasSession ? waitingSession : waitingFresh;
+    std::condition_variable& turn = hasSession ? sessionTurn : freshTurn;
+    auto mayTake = [&]() { return inFlight < options.maxInFlight && (hasSession || waitingSession == 0); };
+
+    bool queued = false;
+    bool admitted = false;
+    while (true) {
+        // Shedding may start while this login waits; look again every target.
+        rollOver(now);
+        Clock::time_point giveUp = arrival + (shedding && !hasSession
+            ? Clock::duration(2 * options.target) : Clock::duration(options.interval));
+        if (deadline != Clock::time_point() && deadline < giveUp) {
+            giveUp = deadline;
+        }
+        if (now >= giveUp) {
+            break;
+        }
+        // No queue jumping: a free slot goes to those already waiting.
+        if ((queued || waiting == 0) && mayTake()) {
+            admitted = true;
+            break;
+        }
+        if (!queued) {
+            waiting++;
+            queued = true;
+        }
+        turn.wait_until(lock, std::min(giveUp, now + options.target));
+        now = Clock::now();
+    }
+    if (queued) {
+        waiting--;
+    }
+
+    if (!admitted) {
+        // A login that gave up before target says nothing about the queue.
+        if (now - arrival >= options.target) {
+            sample(now - arrival);
+        }
+        counters.shed++;
+        if (hasSession) {
+            counters.sessionShed++;
+        }
+        // This one may have been woken for a slot it no longer wants.
+        wakeNext();
+        return false;
+    }
+    admit(hasSession, now - arrival);
+    return true;
+}
+
+void AdmissionController::release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    inFlight--;
+    wakeNext();
+}
+
+bool AdmissionController::overloaded() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return shedding;
+}
+
+AdmissionStats AdmissionController::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void AdmissionController::rollOver(Clock::time_point now) {
+    if (now - intervalStart < options.interval) {
+        return;
+    }
+    if (intervalSamples > 0) {
+        shedding = minDelay > options.target;
+    } else {
+        // Nobody got in or gave up for a whole interval: the queue is
+        // standing if anybody is in it.
+        shedding = waitingSession + waitingFresh > 0;
+    }
+    intervalStart = now;
+    minDelay = Clock::duration::max();
+    intervalSamples = 0;
+}
+
+void AdmissionController::admit(bool hasSession, Clock::duration waited) {
+    inFlight++;
+    counters.admitted++;
+    if (hasSession) {
+        counters.sessionAdmitted++;
+    }
+    counters.queueDelay.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count()));
+    sample(waited);
+}
+
+void AdmissionController::sample(Clock::duration waited) {
+    minDelay = std::min(minDelay, waited);
+    intervalSamples++;
+}
+
+void AdmissionController::wakeNext() {
+    if (inFlight >= options.maxInFlight) {
+        return;
+    }
+    if (waitingSession > 0) {
+        sessionTurn.notify_one();
+    } else if (waitingFresh > 0) {
+        freshTurn.notify_one();
+    }
+}
+
+// ============================================
+// AdmissionStage
+// ============================================
+
+bool AdmissionStage::decide(LoginContext& context) {
+    if (!controller.acquire(context.request.hasSession, context.request.deadline, context.request.received)) {
+        context.outcome = LoginOutcome::Overloaded;
+        return true;
+    }
+    holding = true;
+    return false;
+}
+
+void AdmissionStage::observe(const LoginContext& context) {
+    (void)context;
+    if (holding) {
+        controller.release();
+        holding = false;
+    }
+}
@@ -0,0 +1,67 @@
+#include "Arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+Arena::Arena(size_t minimumBytes)
+    : minimumBytes(std::max<size_t>(minimumBytes, 64)),
+      offset(0),
+      demand(0) {}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    demand += bytes + alignment - 1;
+    if (!blocks.empty()) {
+        Block& block = blocks.back();
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (start + bytes <= block.size) {
+            offset = start + bytes;
+            return block.data.get() + start;
+        }
+    }
+    // Doubling keeps the number of blocks small when a request grows.
+    size_t previous = blocks.empty() ? 0 : blocks.back().size;
+    addBlock(std::max({bytes + alignment, 2 * previous, minimumBytes}));
+    Block& block = blocks.back();
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+    size_t start = ((base + alignment - 1) & ~(alignment - 1)) - base;
+    offset = start + bytes;
+    return block.data.get() + start;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    if (text.empty()) {
+        return std::string_view();
+    }
+    char* bytes = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(bytes, text.data(), text.size());
+    return std::string_view(bytes, text.size());
+}
+
+void Arena::reset() {
+    size_t wanted = std::max(demand, minimumBytes);
+    // One block that fits the whole request next time. A block much larger
+    // than the request is given back, so one oversized request (such as a
+    // calibration run) does not pin its memory for good.
+    bool refit = blocks.size() > 1 ||
+        (blocks.size() == 1 && demand > 0 && blocks[0].size > minimumBytes && wanted * 4 < blocks[0].size * 3);
+    if (refit) {
+        blocks.clear();
+        addBlock(wanted);
+    }
+    offset = 0;
+    demand = 0;
+}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (const Block& block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+void Arena::addBlock(size_t bytes) {
+    blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[bytes]), bytes});
+    offset = 0;
+}
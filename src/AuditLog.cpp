@@ -0,0 +1,357 @@
+#include "AuditLog.h"
+#include "Checksum.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    const char kMagic[4] = {'A', 'U', 'D', 'T'};
+    const uint8_t kVersion = 1;
+    const size_t kHeaderSize = 5;
+    const size_t kFixedPayload = 8 + 1 + 1 + 4;
+    const uint32_t kMaxPayload = kFixedPayload + 255;
+
+    void putU32(unsigned char* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    void putU64(unsigned char* out, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    uint32_t getU32(const unsigned char* in) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t getU64(const unsigned char* in) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    bool syncFile(FILE* file) {
+        if (std::fflush(file) != 0) {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // Parses "audit-000042.seg" into 42; returns false for other names.
+    bool parseSegmentNumber(const std::string& name, uint64_t& number) {
+        const std::string prefix = "audit-";
+        const std::string suffix = ".seg";
+        if (name.size() <= prefix.size() + suffix.size() ||
+            name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            return false;
+        }
+        std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+        if (digits.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        number = std::stoull(digits);
+        return true;
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> listSegments(const std::string& directory) {
+        std::vector<std::pair<uint64_t, std::string>> found;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            uint64_t number = 0;
+            if (entry.is_regular_file() && parseSegmentNumber(entry.path().filename().string(), number)) {
+                found.emplace_back(number, entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+}
+
+// ============================================
+// AuditLog
+// ============================================
+
+AuditLog::AuditLog(const AuditLogOptions& options)
+    : options(options),
+      ring(options.ringCapacity),
+      running(false),
+      stopRequested(false),
+      segment(nullptr),
+      segmentBytes(0),
+      nextSegmentNumber(1),
+      appended(0),
+      dropped(0),
+      written(0),
+      failed(0),
+      groupCommits(0),
+      segments(0) {}
+
+AuditLog::~AuditLog() {
+    stop();
+}
+
+bool AuditLog::start() {
+    if (running.load()) {
+        return true;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(options.directory, ec);
+    if (ec) {
+        std::cerr << "Error creando directorio de auditoria: " << ec.message() << std::endl;
+        return false;
+    }
+
+    auto existing = listSegments(options.directory);
+    nextSegmentNumber = existing.empty() ? 1 : existing.back().first + 1;
+    if (!openNextSegment()) {
+        return false;
+    }
+
+    stopRequested.store(false);
+    running.store(true);
+    writer = std::thread(&AuditLog::writerLoop, this);
+    return true;
+}
+
+void AuditLog::stop() {
+    if (!running.load()) {
+        return;
+    }
+    stopRequested.store(true);
+    writer.join();
+    running.store(false);
+    if (segment) {
+        std::fclose(segment);
+        segment = nullptr;
+    }
+    flushed.notify_all();
+}
+
+bool AuditLog::append(std::string_view account, LoginOutcome outcome, uint32_t attempt, AuditEvent event) {
+    Entry entry;
+    entry.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    entry.event = event;
+    entry.outcome = outcome;
+    entry.attempt = attempt;
+    size_t length = std::min(account.size(), kMaxAccountLength);
+    entry.accountLength = static_cast<uint8_t>(length);
+    std::memcpy(entry.account, account.data(), length);
+
+    if (!ring.tryPush(entry)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    appended.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool AuditLog::flush() {
+    uint64_t target = appended.load();
+    std::unique_lock<std::mutex> lock(flushMutex);
+    flushed.wait(lock, [&]() {
+        return written.load() + failed.load() >= target || !running.load();
+    });
+    return failed.load() == 0 && written.load() >= target;
+}
+
+AuditLogStats AuditLog::stats() const {
+    AuditLogStats result;
+    result.appended = appended.load();
+    result.dropped = dropped.load();
+    result.written = written.load();
+    result.failed = failed.load();
+    result.groupCommits = groupCommits.load();
+    result.segments = segments.load();
+    return result;
+}
+
+void AuditLog::writerLoop() {
+    std::vector<unsigned char> group;
+    group.reserve(options.maxGroupRecords * 64);
+
+    while (true) {
+        group.clear();
+        uint64_t records = 0;
+        Entry entry;
+        while (records < options.maxGroupRecords && ring.tryPop(entry)) {
+            unsigned char payload[kMaxPayload];
+            putU64(payload, entry.timestampNs);
+            payload[8] = static_cast<unsigned char>(entry.event);
+            payload[9] = static_cast<unsigned char>(entry.outcome);
+            putU32(payload + 10, entry.attempt);
+            std::memcpy(payload + kFixedPayload, entry.account, entry.accountLength);
+            uint32_t length = static_cast<uint32_t>(kFixedPayload + entry.accountLength);
+
+            unsigned char prefix[8];
+            putU32(prefix, length);
+            putU32(prefix + 4, crc32(payload, length));
+            group.insert(group.end(), prefix, prefix + sizeof(prefix));
+            group.insert(group.end(), payload, payload + length);
+            records++;
+        }
+
+        if (records > 0) {
+            commitGroup(group, records);
+        } else if (stopRequested.load()) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.idleWaitMs));
+        }
+    }
+}
+
+bool AuditLog::openNextSegment() {
+    if (segment) {
+        std::fclose(segment);
+        segment = nullptr;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "audit-%06llu.seg", static_cast<unsigned long long>(nextSegmentNumber));
+    std::string path = (std::filesystem::path(options.directory) / name).string();
+
+    segment = std::fopen(path.c_str(), "wb");
+    if (!segment) {
+        std::cerr << "Error abriendo segmento de auditoria: " << path << std::endl;
+        return false;
+    }
+    nextSegmentNumber++;
+    unsigned char header[kHeaderSize];
+    std::memcpy(header, kMagic, 4);
+    header[4] = kVersion;
+    if (std::fwrite(header, 1, sizeof(header), segment) != sizeof(header)) {
+        std::cerr << "Error escribiendo segmento de auditoria: " << path << std::endl;
+        abandonSegment();
+        return false;
+    }
+    segmentBytes = kHeaderSize;
+    segments.fetch_add(1);
+    return true;
+}
+
+void AuditLog::abandonSegment() {
+    if (segment) {
+        std::fclose(segment);
+        segment = nullptr;
+    }
+}
+
+void AuditLog::commitGroup(const std::vector<unsigned char>& group, uint64_t records) {
+    if (segment && segmentBytes > kHeaderSize && segmentBytes + group.size() > options.maxSegmentBytes) {
+        // Every earlier group was already synced (or flushed) by its own commit.
+        if (!syncFile(segment)) {
+            std::cerr << "Error sincronizando segmento de auditoria" << std::endl;
+        }
+        openNextSegment();
+    } else if (!segment) {
+        openNextSegment();
+    }
+    bool ok = segment && std::fwrite(group.data(), 1, group.size(), segment) == group.size();
+    if (ok) {
+        ok = options.syncOnCommit ? syncFile(segment) : std::fflush(segment) == 0;
+    }
+    if (ok) {
+        segmentBytes += group.size();
+    } else {
+        std::cerr << "Error escribiendo " << records << " registros de auditoria" << std::endl;
+        abandonSegment();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        (ok ? written : failed).fetch_add(records);
+        groupCommits.fetch_add(1);
+    }
+    flushed.notify_all();
+}
+
+// ============================================
+// AuditLogReader
+// ============================================
+
+AuditLogReader::AuditLogReader(const std::string& directory)
+    : currentSegment(0), file(nullptr), corrupt(0) {
+    for (const auto& segmentEntry : listSegments(directory)) {
+        segmentPaths.push_back(segmentEntry.second);
+    }
+    openSegment(0);
+}
+
+AuditLogReader::~AuditLogReader() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool AuditLogReader::openSegment(size_t index) {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    currentSegment = index;
+    while (currentSegment < segmentPaths.size()) {
+        file = std::fopen(segmentPaths[currentSegment].c_str(), "rb");
+        unsigned char header[kHeaderSize];
+        if (file && std::fread(header, 1, sizeof(header), file) == sizeof(header) &&
+            std::memcmp(header, kMagic, 4) == 0 && header[4] == kVersion) {
+            return true;
+        }
+        if (file) {
+            std::fclose(file);
+            file = nullptr;
+        }
+        currentSegment++;
+    }
+    return false;
+}
+
+bool AuditLogReader::next(AuditRecord& record) {
+    while (file) {
+        unsigned char prefix[8];
+        size_t got = std::fread(prefix, 1, sizeof(prefix), file);
+        if (got == sizeof(prefix)) {
+            uint32_t length = getU32(prefix);
+            uint32_t checksum = getU32(prefix + 4);
+            unsigned char payload[kMaxPayload];
+            if (length >= kFixedPayload && length <= kMaxPayload &&
+                std::fread(payload, 1, length, file) == length &&
+                crc32(payload, length) == checksum) {
+                record.timestampNs = getU64(payload);
+                record.event = static_cast<AuditEvent>(payload[8]);
+                record.outcome = static_cast<LoginOutcome>(payload[9]);
+                record.attempt = getU32(payload + 10);
+                record.account.assign(reinterpret_cast<const char*>(payload + kFixedPayload),
+                                      length - kFixedPayload);
+                return true;
+            }
+            // Torn or corrupt record: nothing after it in this segment can be trusted.
+            corrupt++;
+        } else if (got != 0) {
+            corrupt++;
+        }
+        openSegment(currentSegment + 1);
+    }
+    return false;
+}
@@ -0,0 +1,258 @@
+#include "AuthPipeline.h"
+#include "AuditLog.h"
+#include "Database.h"
+#include "LoginTrace.h"
+#include "PasswordValidator.h"
+#include "ShardedDatabase.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+    uint64_t elapsedNs(AuthStage::Clock::time_point from, AuthStage::Clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+
+    bool isFailure(LoginOutcome outcome) {
+        return outcome == LoginOutcome::WrongPassword || outcome == LoginOutcome::UnknownUser;
+    }
+
+    // Fixed tables are indexed by the account hash; never empty.
+    template <typename Slot>
+    Slot& slotFor(std::vector<Slot>& table, uint64_t account) {
+        return table[account % table.size()];
+    }
+}
+
+// ============================================
+// AuthPipeline
+// ============================================
+
+void AuthPipeline::add(std::unique_ptr<AuthStage> stage) {
+    Entry entry;
+    entry.stats.name = stage->name();
+    entry.stats.evaluated = 0;
+    entry.stats.decided = 0;
+    entry.stage = std::move(stage);
+    // Stable, so equal costs keep the order they were added in.
+    auto at = std::upper_bound(stages.begin(), stages.end(), entry.stage->cost(),
+                               [](int cost, const Entry& other) { return cost < other.stage->cost(); });
+    stages.insert(at, std::move(entry));
+}
+
+LoginOutcome AuthPipeline::authenticate(const LoginRequest& request) {
+    LoginContext context{request, LoginOutcome::StorageError, nullptr, false};
+    for (Entry& entry : stages) {
+        AuthStage::Clock::time_point started = AuthStage::Clock::now();
+        bool decided = entry.stage->decide(context);
+        entry.stats.latency.record(elapsedNs(started, AuthStage::Clock::now()));
+        entry.stats.evaluated++;
+        if (decided) {
+            entry.stats.decided++;
+            context.decidedBy = entry.stage.get();
+            break;
+        }
+    }
+
+    for (Entry& entry : stages) {
+        AuthStage::Clock::time_point started = AuthStage::Clock::now();
+        entry.stage->observe(context);
+        entry.stats.observeLatency.record(elapsedNs(started, AuthStage::Clock::now()));
+    }
+    return context.outcome;
+}
+
+std::vector<AuthStageStats> AuthPipeline::stats() const {
+    std::vector<AuthStageStats> result;
+    for (const Entry& entry : stages) {
+        result.push_back(entry.stats);
+    }
+    return result;
+}
+
+void AuthPipeline::resetStats() {
+    for (Entry& entry : stages) {
+        entry.stats.evaluated = 0;
+        entry.stats.decided = 0;
+        entry.stats.latency.reset();
+        entry.stats.observeLatency.reset();
+    }
+}
+
+// ============================================
+// Stages
+// ============================================
+
+std::string_view NormalizeStage::trim(std::string_view email) {
+    const char* kSpace = " \t\r\n";
+    size_t first = email.find_first_not_of(kSpace);
+    if (first == std::string_view::npos) {
+        return std::string_view();
+    }
+    return email.substr(first, email.find_last_not_of(kSpace) - first + 1);
+}
+
+bool NormalizeStage::decide(LoginContext& context) {
+    std::string_view& email = context.request.email;
+    email = trim(email);
+    if (email.empty() || email.size() > kMaxEmailLength) {
+        context.outcome = LoginOutcome::UnknownUser;
+        return true;
+    }
+    return false;
+}
+
+bool PolicyStage::decide(LoginContext& context) {
+    if (PasswordValidator::validate(context.request.password)) {
+        return false;
+    }
+    context.outcome = LoginOutcome::PolicyRejected;
+    return true;
+}
+
+RateLimitStage::RateLimitStage(int maxFailures, std::chrono::milliseconds window, size_t slots)
+    : maxFailures(maxFailures),
+      window(window),
+      table(std::max<size_t>(slots, 1), Slot{0, 0, Clock::time_point()}) {}
+
+bool RateLimitStage::decide(LoginContext& context) {
+    uint64_t account = hashAccountKey(context.request.email);
+    const Slot& slot = slotFor(table, account);
+    if (slot.account != account || slot.failures < static_cast<uint32_t>(maxFailures) ||
+        Clock::now() - slot.windowStart >= window) {
+        return false;
+    }
+    context.outcome = LoginOutcome::RateLimited;
+    return true;
+}
+
+void RateLimitStage::observe(const LoginContext& context) {
+    uint64_t account = hashAccountKey(context.request.email);
+    Slot& slot = slotFor(table, account);
+    if (context.outcome == LoginOutcome::Success) {
+        if (slot.account == account) {
+            slot.failures = 0;
+        }
+    } else if (isFailure(context.outcome)) {
+        Clock::time_point now = Clock::now();
+        if (slot.account != account || now - slot.windowStart >= window) {
+            slot = Slot{account, 0, now};
+        }
+        slot.failures++;
+    }
+}
+
+NegativeCacheStage::NegativeCacheStage(std::chrono::milliseconds ttl, size_t slots)
+    : ttl(ttl),
+      table(std::max<size_t>(slots, 1), Slot{0, Clock::time_point()}) {}
+
+bool NegativeCacheStage::decide(LoginContext& context) {
+    uint64_t account = hashAccountKey(context.request.email);
+    const Slot& slot = slotFor(table, account);
+    if (slot.account != account || Clock::now() >= slot.expires) {
+        return false;
+    }
+    context.outcome = LoginOutcome::UnknownUser;
+    return true;
+}
+
+void NegativeCacheStage::observe(const LoginContext& context) {
+    // Only storage's word counts: NormalizeStage also answers UnknownUser.
+    if (!context.storageConsulted) {
+        return;
+    }
+    uint64_t account = hashAccountKey(context.request.email);
+    Slot& slot = slotFor(table, account);
+    if (context.outcome == LoginOutcome::UnknownUser) {
+        slot = Slot{account, Clock::now() + ttl};
+    } else if (slot.account == account) {
+        slot.expires = Clock::time_point();
+    }
+}
+
+void NegativeCacheStage::forget(std::string_view email) {
+    uint64_t account = hashAccountKey(email);
+    Slot& slot = slotFor(table, account);
+    if (slot.account == account) {
+        slot.expires = Clock::time_point();
+    }
+}
+
+PositiveCacheStage::PositiveCacheStage(std::chrono::milliseconds ttl, size_t slots)
+    : ttl(ttl),
+      table(std::max<size_t>(slots, 1), Slot{0, {}, Clock::time_point()}) {
+    std::random_device entropy;
+    for (size_t i = 0; i < sizeof(key); i += 4) {
+        uint32_t word = entropy();
+        std::copy(reinterpret_cast<const uint8_t*>(&word), reinterpret_cast<const uint8_t*>(&word) + 4, key + i);
+    }
+}
+
+void PositiveCacheStage::digest(const LoginContext& context, uint8_t out[Sha256::kDigestSize]) const {
+    const uint8_t separator = 0;
+    Sha256 hash;
+    hash.update(key, sizeof(key));
+    hash.update(context.request.email.data(), context.request.email.size());
+    hash.update(&separator, 1);
+    hash.update(context.request.password.data(), context.request.password.size());
+    hash.finish(out);
+}
+
+bool PositiveCacheStage::decide(LoginContext& context) {
+    uint64_t account = hashAccountKey(context.request.email);
+    const Slot& slot = slotFor(table, account);
+    if (slot.account != account || Clock::now() >= slot.expires) {
+        return false;
+    }
+    uint8_t expected[Sha256::kDigestSize];
+    digest(context, expected);
+    // No early exit: timing must not tell how much of the digest matched.
+    uint8_t diff = 0;
+    for (size_t i = 0; i < sizeof(expected); i++) {
+        diff |= expected[i] ^ slot.digest[i];
+    }
+    if (diff != 0) {
+        return false;
+    }
+    context.outcome = LoginOutcome::Success;
+    return true;
+}
+
+void PositiveCacheStage::observe(const LoginContext& context) {
+    uint64_t account = hashAccountKey(context.request.email);
+    Slot& slot = slotFor(table, account);
+    if (context.outcome == LoginOutcome::Success && context.storageConsulted) {
+        slot.account = account;
+        digest(context, slot.digest);
+        slot.expires = Clock::now() + ttl;
+    } else if (isFailure(context.outcome) && slot.account == account) {
+        slot.expires = Clock::time_point();
+    }
+}
+
+void PositiveCacheStage::forget(std::string_view email) {
+    uint64_t account = hashAccountKey(email);
+    Slot& slot = slotFor(table, account);
+    if (slot.account == account) {
+        slot.expires = Clock::time_point();
+    }
+}
+
+bool StorageStage::decide(LoginContext& context) {
+    const LoginRequest& request = context.request;
+    Database& target = sharded ? sharded->shardFor(request.email) : *db;
+    context.outcome = request.deadline == Clock::time_point()
+        ? target.authenticate(request.email, request.password)
+        : target.authenticate(request.email, request.password, request.deadline);
+    context.storageConsulted = true;
+    return true;
+}
+
+void AuditStage::observe(const LoginContext& context) {
+    audit.append(context.request.email, context.outcome, context.request.attempt);
+}
+
+void TraceStage::observe(const LoginContext& context) {
+    if (!context.storageConsulted) {
+        trace.record(hashAccountKey(context.request.email), context.outcome);
+    }
+}
@@ -0,0 +1,107 @@
+#include "AuthSchema.h"
+
+std::vector<Migration> authSchemaMigrations() {
+    std::vector<Migration> migrations;
+
+    Migration initial;
+    initial.version = 1;
+    initial.description = "crear tabla usuarios";
+    initial.sql =
+        "CREATE TABLE IF NOT EXISTS usuarios ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "usuario TEXT NOT NULL UNIQUE,"
+        "clave TEXT NOT NULL"
+        ");";
+    migrations.push_back(initial);
+
+    // A WITHOUT ROWID table stores the row in the primary-key B-tree, so a
+    // login is one lookup instead of the unique index plus the rowid table.
+    Migration clustered;
+    clustered.version = 2;
+    clustered.description = "usuarios WITHOUT ROWID";
+    clustered.rebuild.table = "usuarios";
+    clustered.rebuild.createSql =
+        "CREATE TABLE {table} ("
+        "usuario TEXT NOT NULL PRIMARY KEY,"
+        "clave TEXT NOT NULL"
+        ") WITHOUT ROWID;";
+    clustered.rebuild.columns = {"usuario", "clave"};
+    clustered.rebuild.key = "usuario";
+    migrations.push_back(clustered);
+
+    Migration updatedAt;
+    updatedAt.version = 3;
+    updatedAt.description = "usuarios.actualizado_en";
+    updatedAt.sql = "ALTER TABLE usuarios ADD COLUMN actualizado_en INTEGER NOT NULL DEFAULT 0;";
+    migrations.push_back(updatedAt);
+
+    // Keyed by the SHA-256 of the token, so the table never holds a token
+    // that could be used as it stands.
+    Migration resetTokens;
+    resetTokens.version = 4;
+    resetTokens.description = "tabla recuperaciones";
+    resetTokens.sql =
+        "CREATE TABLE recuperaciones ("
+        "token TEXT NOT NULL PRIMARY KEY,"
+        "usuario TEXT NOT NULL,"
+        "expira_en INTEGER NOT NULL,"
+        "usado_en INTEGER NOT NULL DEFAULT 0"
+        ") WITHOUT ROWID;"
+        "CREATE INDEX recuperaciones_usuario ON recuperaciones (usuario);";
+    migrations.push_back(resetTokens);
+
+    // Apart from usuarios, so the frequent writes of LoginStateStore never
+    // touch the rows every login reads.
+    Migration loginState;
+    loginState.version = 5;
+    loginState.description = "tabla estado_login";
+    loginState.sql =
+        "CREATE TABLE estado_login ("
+        "usuario TEXT NOT NULL PRIMARY KEY,"
+        "fallos INTEGER NOT NULL DEFAULT 0,"
+        "bloqueado_hasta INTEGER NOT NULL DEFAULT 0,"
+        "ultimo_login INTEGER NOT NULL DEFAULT 0"
+        ") WITHOUT ROWID;";
+    migrations.push_back(loginState);
+
+    // Logging only starts once ChangeShipper marks the file as a primary, so
+    // files that are never replicated pay one lookup per write. Times are
+    // unix milliseconds, for the replication lag.
+    Migration changeLog;
+    changeLog.version = 6;
+    changeLog.description = "registro de cambios de usuarios";
+    changeLog.sql =
+        "CREATE TABLE replicacion ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "rol TEXT NOT NULL,"
+        "posicion INTEGER NOT NULL DEFAULT 0"
+        ");"
+        "CREATE TABLE cambios ("
+        "seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "usuario TEXT NOT NULL,"
+        "clave TEXT,"
+        "actualizado_en INTEGER NOT NULL DEFAULT 0,"
+        "registrado_ms INTEGER NOT NULL"
+        ");"
+        "CREATE TRIGGER cambios_insert AFTER INSERT ON usuarios "
+        "WHEN (SELECT rol FROM replicacion) = 'primario' BEGIN "
+        "INSERT INTO cambios (usuario, clave, actualizado_en, registrado_ms) VALUES "
+        "(NEW.usuario, NEW.clave, NEW.actualizado_en, CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER));"
+        "END;"
+        "CREATE TRIGGER cambios_update AFTER UPDATE ON usuarios "
+        "WHEN (SELECT rol FROM replicacion) = 'primario' BEGIN "
+        "INSERT INTO cambios (usuario, clave, actualizado_en, registrado_ms) SELECT "
+        "OLD.usuario, NULL, 0, CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER) "
+        "WHERE OLD.usuario <> NEW.usuario;"
+        "INSERT INTO cambios (usuario, clave, actualizado_en, registrado_ms) VALUES "
+        "(NEW.usuario, NEW.clave, NEW.actualizado_en, CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER));"
+        "END;"
+        "CREATE TRIGGER cambios_delete AFTER DELETE ON usuarios "
+        "WHEN (SELECT rol FROM replicacion) = 'primario' BEGIN "
+        "INSERT INTO cambios (usuario, clave, actualizado_en, registrado_ms) VALUES "
+        "(OLD.usuario, NULL, 0, CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER));"
+        "END;";
+    migrations.push_back(changeLog);
+
+    return migrations;
+}
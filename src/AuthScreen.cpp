@@ -1,14 +1,106 @@
 #include "AuthScreen.h"
-#include "PasswordValidator.h"
+#include "PasswordHasher.h"
+#include <ctime>
 #include <iostream>
+#include <memory>
 
-AuthScreen::AuthScreen() 
+namespace {
+    // Every kiosk and daemon on the host using the same auth.db shares this
+    // cache segment (see SharedCredentialCache::segmentName).
+    const char* kCredentialCacheName = "/authscreen-cache";
+    // Recovery emails are left here for the host's mail agent.
+    const char* kOutboxDirectory = "outbox";
+    const char* kWarmStatePath = "auth.warm";
+
+    void setUpText(sf::Text& text, const sf::Font& font, const char* string, unsigned size, sf::Color color,
+                   float x, float y) {
+        text.setFont(font);
+        text.setString(string);
+        text.setCharacterSize(size);
+        text.setFillColor(color);
+        text.setPosition(x, y);
+    }
+
+    DatabaseOptions screenOptions(SharedCredentialCache* cache) {
+        DatabaseOptions options;
+        options.sharedCache = cache;
+        return options;
+    }
+
+    // Appends `format` (strftime) applied to a Unix time in seconds.
+    void appendTime(std::string& message, const char* format, int64_t seconds) {
+        std::time_t when = static_cast<std::time_t>(seconds);
+        char text[64];
+        std::strftime(text, sizeof(text), format, std::localtime(&when));
+        message += text;
+    }
+}
+
+AuthScreen::AuthScreen(const std::string& tracePath) 
     : window(sf::VideoMode(800, 600), "Pantalla de Autenticacion"),
-      db("auth.db"),
-      attempts(0),
+      db("auth.db", screenOptions(&credentialCache)),
+      maintenance("auth.db", activity),
+      verifier("auth.db", IntegrityOptions(), &activity),
+      prefetcher("auth.db", screenOptions(&credentialCache)),
+      loginState("auth.db"),
+      warmState("auth.db", kWarmStatePath, WarmStateOptions(), screenOptions(&credentialCache)),
+      lockout(nullptr),
+      outbox(kOutboxDirectory),
+      recovery("auth.db", outbox),
       emailFieldActive(true),
       message("") {
+    // Optional: without the segment every login reads auth.db directly.
+    credentialCache.attach(SharedCredentialCache::segmentName(kCredentialCacheName, "auth.db"));
     db.initialize();
+    // Measure the hashing cost for this machine now instead of on the first login.
+    DatabaseOptions defaults;
+    PasswordHasher::resolve(defaults.hashCost, defaults.hashTargetMs);
+    
+    if (!audit.start()) {
+        std::cerr << "Error iniciando log de auditoria" << std::endl;
+    }
+    
+    db.setActivityMonitor(&activity);
+    db.setStuffingDetector(&stuffing, "local");
+    
+    // Cheap checks first; storage is only reached by a login nothing else settles.
+    pipeline.add(std::make_unique<NormalizeStage>());
+    pipeline.add(std::make_unique<PolicyStage>());
+    auto lockoutStage = std::make_unique<LockoutStage>(loginState);
+    lockout = lockoutStage.get();
+    pipeline.add(std::move(lockoutStage));
+    // No NegativeCacheStage: unknown accounts must still pay for the dummy
+    // hash and reach the stuffing detector through Database. No
+    // PositiveCacheStage either: it would keep accepting a password reset or
+    // changed elsewhere, and skip rehash and quarantine checks.
+    pipeline.add(std::make_unique<PrefetchStage>(prefetcher, db));
+    pipeline.add(std::make_unique<StorageStage>(db));
+    pipeline.add(std::make_unique<AuditStage>(audit));
+    pipeline.add(std::make_unique<TraceStage>(trace));
+    pipeline.add(std::make_unique<WarmStateStage>(warmState));
+    maintenance.start();
+    verifier.start();
+    if (!prefetcher.start()) {
+        std::cerr << "Error iniciando precarga de credenciales" << std::endl;
+    }
+    if (!loginState.start()) {
+        std::cerr << "Error iniciando estado de login" << std::endl;
+    }
+    // Warms auth.db in the background while the window comes up.
+    if (!warmState.start()) {
+        std::cerr << "Error iniciando arranque en caliente" << std::endl;
+    }
+    if (!recovery.start()) {
+        std::cerr << "Error iniciando recuperacion de clave" << std::endl;
+    }
+    
+    if (!tracePath.empty()) {
+        if (trace.open(tracePath)) {
+            db.setTraceRecorder(&trace);
+        } else {
+            std::cerr << "Error abriendo traza: " << tracePath << std::endl;
+        }
+    }
     
     if (!font.loadFromFile("C:/Windows/Fonts/arial.ttf")) {
         std::cerr << "Error cargando fuente" << std::endl;
@@ -34,6 +126,20 @@ AuthScreen::AuthScreen()
     recoveryButton.setFillColor(sf::Color(70, 70, 70));
     recoveryButton.setOutlineThickness(2);
     recoveryButton.setOutlineColor(sf::Color(100, 100, 100));
+    
+    setUpText(title, font, "AUTENTICACION", 48, sf::Color(100, 200, 255), 250, 80);
+    setUpText(emailLabel, font, "Email:", 20, sf::Color::White, 200, 170);
+    setUpText(emailText, font, "", 24, sf::Color::White, 210, 210);
+    setUpText(passwordLabel, font, "Contrasena:", 20, sf::Color::White, 200, 250);
+    setUpText(passwordText, font, "", 24, sf::Color::White, 210, 290);
+    setUpText(lengthRule, font, "5-10 caracteres", 14, sf::Color(150, 150, 150), 200, 335);
+    setUpText(upperRule, font, "1 mayuscula", 14, sf::Color(150, 150, 150), 340, 335);
+    setUpText(specialRule, font, "1 especial", 14, sf::Color(150, 150, 150), 460, 335);
+    strengthBar.setPosition(400, 258);
+    strengthBar.setSize(sf::Vector2f(0, 8));
+    setUpText(recoveryText, font, "Recuperar Clave", 18, sf::Color::White, 320, 370);
+    setUpText(messageText, font, "", 16, sf::Color(255, 100, 100), 150, 450);
+    setUpText(instructions, font, "Tab para cambiar campo | Enter para enviar", 14, sf::Color(150, 150, 150), 220, 520);
 }
 
 void AuthScreen::run() {
@@ -45,6 +151,7 @@ void AuthScreen::run() {
 
 void AuthScreen::handleEvents() {
     sf::Event event;
+    bool changed = false;
     while (window.pollEvent(event)) {
         if (event.type == sf::Event::Closed) {
             window.close();
@@ -57,6 +164,7 @@ void AuthScreen::handleEvents() {
         }
         
         if (event.type == sf::Event::TextEntered) {
+            changed = true;
             if (event.text.unicode < 128) {
                 char c = static_cast<char>(event.text.unicode);
                 
@@ -64,53 +172,108 @@ void AuthScreen::handleEvents() {
                     if (emailFieldActive && !emailInput.empty()) {
                         emailInput.pop_back();
                     } else if (!emailFieldActive && !passwordInput.empty()) {
+                        passwordPolicy.pop(passwordInput.back());
                         passwordInput.pop_back();
                     }
                 } else if (c == '\r' || c == '\n') {
                     if (emailFieldActive) {
-                        emailFieldActive = false;
-                        passwordBox.setOutlineColor(sf::Color(100, 200, 255));
-                        emailBox.setOutlineColor(sf::Color(150, 150, 150));
+                        focusPassword();
+                    } else if (!passwordPolicy.valid()) {
+                        // Held back: the indicators show which rule is missing.
+                        message = "La contrasena no cumple la politica";
                     } else {
-                        if (validatePassword(passwordInput)) {
-                            if (db.validateUser(emailInput, passwordInput)) {
-                                message = "Autenticacion exitosa!";
-                                std::cout << message << std::endl;
-                            } else {
-                                attempts++;
-                                message = "Credenciales invalidas. Intentos: " + std::to_string(attempts) + "/5";
-                                if (attempts >= 5) {
-                                    message = "Maximo de intentos alcanzado.";
-                                    std::cout << message << std::endl;
-                                    sf::sleep(sf::seconds(2));
-                                    window.close();
-                                }
-                                passwordInput.clear();
+                        LoginRequest request;
+                        request.email = emailInput;
+                        request.password = passwordInput;
+                        LoginOutcome outcome = pipeline.authenticate(request);
+                        // Failures and lockout as LoginStateStore keeps them,
+                        // across restarts and other screens on the same file.
+                        const LoginState& account = lockout->last();
+                        if (outcome == LoginOutcome::Success) {
+                            message = "Autenticacion exitosa!";
+                            if (account.lastLogin > 0) {
+                                appendTime(message, " Ultimo acceso: %d/%m/%Y %H:%M", account.lastLogin);
                             }
-                        } else {
+                        } else if (outcome == LoginOutcome::RateLimited) {
+                            message = "Cuenta bloqueada hasta las";
+                            appendTime(message, " %H:%M", account.lockedUntil);
+                            clearPassword();
+                        } else if (outcome == LoginOutcome::TimedOut || outcome == LoginOutcome::StorageError ||
+                                   outcome == LoginOutcome::Overloaded) {
+                            // The credentials were not checked; the password
+                            // stays so that Enter tries it again.
+                            message = "Servicio no disponible, intente de nuevo";
+                        } else if (outcome == LoginOutcome::PolicyRejected) {
                             message = "Contrasena debe tener 5-10 chars, 1 mayuscula, 1 especial";
-                            passwordInput.clear();
+                            clearPassword();
+                        } else if ((outcome == LoginOutcome::WrongPassword || outcome == LoginOutcome::UnknownUser) &&
+                                   account.lockedUntil > 0) {
+                            // This failure locked the account; emails with no
+                            // account lock too, so the texts never tell them apart.
+                            message = "Maximo de intentos alcanzado. Cuenta bloqueada hasta las";
+                            appendTime(message, " %H:%M", account.lockedUntil);
+                            audit.append(account.email, outcome, account.failures, AuditEvent::Lockout);
+                            clearPassword();
+                        } else {
+                            // The same answer whether or not the account exists.
+                            message = "Credenciales invalidas";
+                            clearPassword();
                         }
                     }
                 } else if (c == '\t') {
-                    emailFieldActive = !emailFieldActive;
                     if (emailFieldActive) {
+                        focusPassword();
+                    } else {
+                        emailFieldActive = true;
                         emailBox.setOutlineColor(sf::Color(100, 200, 255));
                         passwordBox.setOutlineColor(sf::Color(150, 150, 150));
-                    } else {
-                        passwordBox.setOutlineColor(sf::Color(100, 200, 255));
-                        emailBox.setOutlineColor(sf::Color(150, 150, 150));
                     }
                 } else {
                     if (emailFieldActive) {
                         emailInput += c;
-                    } else if (passwordInput.length() < 10) {
+                    } else if (passwordInput.length() < PasswordValidator::kMaxLength) {
                         passwordInput += c;
+                        passwordPolicy.push(c);
                     }
                 }
             }
         }
     }
+    if (changed) {
+        refreshTexts();
+    }
+}
+
+void AuthScreen::refreshTexts() {
+    maskedPassword.assign(passwordInput.length(), '*');
+    emailText.setString(emailInput);
+    passwordText.setString(maskedPassword);
+    messageText.setString(message);
+    
+    const sf::Color met(100, 220, 120);
+    const sf::Color unmet(150, 150, 150);
+    lengthRule.setFillColor(passwordPolicy.hasMinLength() && passwordPolicy.hasMaxLength() ? met : unmet);
+    upperRule.setFillColor(passwordPolicy.hasUpperCase() ? met : unmet);
+    specialRule.setFillColor(passwordPolicy.hasSpecialChar() ? met : unmet);
+    static const sf::Color strengthColors[] = {
+        sf::Color(0, 0, 0, 0), sf::Color(220, 80, 80), sf::Color(230, 160, 60),
+        sf::Color(200, 210, 80), sf::Color(100, 220, 120)};
+    int strength = passwordPolicy.strength();
+    strengthBar.setSize(sf::Vector2f(50.0f * strength, 8));
+    strengthBar.setFillColor(strengthColors[strength]);
+}
+
+void AuthScreen::clearPassword() {
+    passwordInput.clear();
+    passwordPolicy.clear();
+}
+
+void AuthScreen::focusPassword() {
+    emailFieldActive = false;
+    passwordBox.setOutlineColor(sf::Color(100, 200, 255));
+    emailBox.setOutlineColor(sf::Color(150, 150, 150));
+    // Read while the password is typed, so Enter only has to check it.
+    prefetcher.prefetch(emailInput);
 }
 
 void AuthScreen::handleMouseClick(int x, int y) {
@@ -119,75 +282,45 @@ void AuthScreen::handleMouseClick(int x, int y) {
         emailBox.setOutlineColor(sf::Color(100, 200, 255));
         passwordBox.setOutlineColor(sf::Color(150, 150, 150));
     } else if (passwordBox.getGlobalBounds().contains(x, y)) {
-        emailFieldActive = false;
-        passwordBox.setOutlineColor(sf::Color(100, 200, 255));
-        emailBox.setOutlineColor(sf::Color(150, 150, 150));
+        if (emailFieldActive) {
+            focusPassword();
+        }
     } else if (recoveryButton.getGlobalBounds().contains(x, y)) {
-        message = "Recuperacion de clave via email: " + emailInput;
-        std::cout << message << std::endl;
+        // Queued for the sender thread; the same answer whether or not the
+        // account exists.
+        if (emailInput.empty()) {
+            message = "Escribe tu email para recuperar la clave";
+        } else if (recovery.request(emailInput)) {
+            message = "Si la cuenta existe, recibiras un email de recuperacion";
+        } else {
+            message = "Recuperacion no disponible, intentalo mas tarde";
+        }
+        refreshTexts();
     }
 }
 
 void AuthScreen::render() {
     window.clear(sf::Color(30, 30, 30));
     
-    // Title
-    sf::Text title("AUTENTICACION", font, 48);
-    title.setFillColor(sf::Color(100, 200, 255));
-    title.setPosition(250, 80);
     window.draw(title);
-    
-    // Email label
-    sf::Text emailLabel("Email:", font, 20);
-    emailLabel.setFillColor(sf::Color::White);
-    emailLabel.setPosition(200, 170);
     window.draw(emailLabel);
-    
-    // Email box and text
     window.draw(emailBox);
-    sf::Text emailText(emailInput, font, 24);
-    emailText.setFillColor(sf::Color::White);
-    emailText.setPosition(210, 210);
     window.draw(emailText);
-    
-    // Password label
-    sf::Text passwordLabel("Contrasena:", font, 20);
-    passwordLabel.setFillColor(sf::Color::White);
-    passwordLabel.setPosition(200, 250);
     window.draw(passwordLabel);
-    
-    // Password box and text (masked)
+    // Masked password
     window.draw(passwordBox);
-    std::string maskedPassword(passwordInput.length(), '*');
-    sf::Text passwordText(maskedPassword, font, 24);
-    passwordText.setFillColor(sf::Color::White);
-    passwordText.setPosition(210, 290);
     window.draw(passwordText);
-    
-    // Recovery button
+    window.draw(strengthBar);
+    window.draw(lengthRule);
+    window.draw(upperRule);
+    window.draw(specialRule);
     window.draw(recoveryButton);
-    sf::Text recoveryText("Recuperar Clave", font, 18);
-    recoveryText.setFillColor(sf::Color::White);
-    recoveryText.setPosition(320, 370);
     window.draw(recoveryText);
-    
-    // Message
     if (!message.empty()) {
-        sf::Text messageText(message, font, 16);
-        messageText.setFillColor(sf::Color(255, 100, 100));
-        messageText.setPosition(150, 450);
         window.draw(messageText);
     }
-    
-    // Instructions
-    sf::Text instructions("Tab para cambiar campo | Enter para enviar", font, 14);
-    instructions.setFillColor(sf::Color(150, 150, 150));
-    instructions.setPosition(220, 520);
     window.draw(instructions);
     
     window.display();
 }
 
-bool AuthScreen::validatePassword(const std::string& password) {
-    return PasswordValidator::validate(password);
-}
@@ -0,0 +1,44 @@
+#include "Checksum.h"
+
+namespace {
+    // Slicing-by-8: entries[k][b] is the CRC of byte b followed by k zero
+    // bytes, so eight input bytes are folded in per step.
+    struct Crc32Table {
+        uint32_t entries[8][256];
+
+        Crc32Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[0][i] = c;
+            }
+            for (int k = 1; k < 8; k++) {
+                for (uint32_t i = 0; i < 256; i++) {
+                    uint32_t c = entries[k - 1][i];
+                    entries[k][i] = entries[0][c & 0xff] ^ (c >> 8);
+                }
+            }
+        }
+    };
+
+    const Crc32Table kTable;
+}
+
+uint32_t crc32(const void* data, size_t length, uint32_t crc) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const auto& t = kTable.entries;
+    crc = ~crc;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint32_t low = crc ^ (bytes[i] | bytes[i + 1] << 8 | bytes[i + 2] << 16 |
+                              static_cast<uint32_t>(bytes[i + 3]) << 24);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+              t[3][bytes[i + 4]] ^ t[2][bytes[i + 5]] ^ t[1][bytes[i + 6]] ^ t[0][bytes[i + 7]];
+    }
+    for (; i < length; i++) {
+        crc = t[0][(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,223 @@
+#include "CredentialPrefetcher.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+CredentialPrefetcher::CredentialPrefetcher(const std::string& dbPath, const DatabaseOptions& databaseOptions,
+                                           const PrefetchOptions& options)
+    : dbPath(dbPath),
+      databaseOptions(databaseOptions),
+      options(options),
+      slots(std::max<size_t>(1, options.slots)),
+      running(false),
+      stopRequested(false),
+      counters() {
+    pending.reserve(slots.size());
+}
+
+CredentialPrefetcher::~CredentialPrefetcher() {
+    stop();
+}
+
+bool CredentialPrefetcher::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return true;
+    }
+    db = std::make_unique<ShardedDatabase>(dbPath, options.shards, databaseOptions);
+    if (!db->initialize()) {
+        std::cerr << "Error abriendo la base para la precarga de credenciales" << std::endl;
+        db.reset();
+        return false;
+    }
+    stopRequested = false;
+    running = true;
+    worker = std::thread(&CredentialPrefetcher::run, this);
+    return true;
+}
+
+void CredentialPrefetcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        stopRequested = true;
+    }
+    wake.notify_all();
+    worker.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+    pending.clear();
+    for (Slot& slot : slots) {
+        slot.state = SlotState::Empty;
+    }
+    db.reset();
+    ready.notify_all();
+}
+
+void CredentialPrefetcher::prefetch(std::string_view email) {
+    email = NormalizeStage::trim(email);
+    if (email.empty() || email.size() > NormalizeStage::kMaxEmailLength) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        counters.requested++;
+        Slot* slot = find(email);
+        if (slot && (slot->state != SlotState::Ready || now - slot->since < options.ttl)) {
+            // Already read, or on its way.
+            return;
+        }
+        if (slot) {
+            counters.expired++;
+        }
+        if (!slot) {
+            slot = claim(now);
+        }
+        if (!slot) {
+            counters.dropped++;
+            return;
+        }
+        slot->state = SlotState::Pending;
+        slot->email.assign(email.data(), email.size());
+        slot->since = now;
+        pending.push_back(static_cast<size_t>(slot - slots.data()));
+        if (pending.size() > options.maxPending) {
+            slots[pending.front()].state = SlotState::Empty;
+            pending.erase(pending.begin());
+            counters.dropped++;
+        }
+    }
+    wake.notify_one();
+}
+
+bool CredentialPrefetcher::take(std::string_view email, FetchedCredential& fetched, Clock::time_point deadline) {
+    email = NormalizeStage::trim(email);
+    std::unique_lock<std::mutex> lock(mutex);
+    Slot* slot = find(email);
+    if (!slot) {
+        return false;
+    }
+    if (slot->state == SlotState::Pending) {
+        // Not started yet: the caller's own lookup is no slower.
+        pending.erase(std::find(pending.begin(), pending.end(), static_cast<size_t>(slot - slots.data())));
+        slot->state = SlotState::Empty;
+        return false;
+    }
+    auto settled = [&]() {
+        return slot->state != SlotState::Fetching || slot->email != email;
+    };
+    if (deadline == Clock::time_point::max()) {
+        ready.wait(lock, settled);
+    } else {
+        ready.wait_until(lock, deadline, settled);
+    }
+    if (slot->state != SlotState::Ready || slot->email != email) {
+        return false;
+    }
+    slot->state = SlotState::Empty;
+    if (Clock::now() - slot->since >= options.ttl) {
+        counters.expired++;
+        return false;
+    }
+    std::swap(fetched, slot->credential);
+    counters.used++;
+    return true;
+}
+
+PrefetchStats CredentialPrefetcher::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+CredentialPrefetcher::Slot* CredentialPrefetcher::find(std::string_view email) {
+    for (Slot& slot : slots) {
+        if (slot.state != SlotState::Empty && slot.email == email) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+CredentialPrefetcher::Slot* CredentialPrefetcher::claim(Clock::time_point now) {
+    // An empty slot, else the oldest read record, else the oldest queued
+    // lookup. A slot being fetched is never taken over.
+    Slot* oldest = nullptr;
+    for (Slot& slot : slots) {
+        if (slot.state == SlotState::Empty) {
+            return &slot;
+        }
+        if (slot.state == SlotState::Ready && (!oldest || slot.since < oldest->since)) {
+            oldest = &slot;
+        }
+    }
+    if (oldest) {
+        if (now - oldest->since >= options.ttl) {
+            counters.expired++;
+        }
+        oldest->state = SlotState::Empty;
+        return oldest;
+    }
+    if (!pending.empty()) {
+        Slot& queued = slots[pending.front()];
+        pending.erase(pending.begin());
+        counters.dropped++;
+        queued.state = SlotState::Empty;
+        return &queued;
+    }
+    return nullptr;
+}
+
+void CredentialPrefetcher::run() {
+    std::string email;
+    FetchedCredential fetched;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() {
+            return stopRequested || !pending.empty();
+        });
+        if (stopRequested) {
+            break;
+        }
+        Slot& slot = slots[pending.front()];
+        pending.erase(pending.begin());
+        slot.state = SlotState::Fetching;
+        email = slot.email;
+        lock.unlock();
+
+        LoginOutcome outcome = db->shardFor(email).fetchCredential(email, fetched);
+
+        lock.lock();
+        if (outcome == LoginOutcome::Success) {
+            std::swap(slot.credential, fetched);
+            slot.state = SlotState::Ready;
+            slot.since = Clock::now();
+            counters.fetched++;
+        } else {
+            // Timed out or failed: the login will read the account itself.
+            slot.state = SlotState::Empty;
+            counters.dropped++;
+        }
+        ready.notify_all();
+    }
+}
+
+bool PrefetchStage::decide(LoginContext& context) {
+    const LoginRequest& request = context.request;
+    Clock::time_point deadline = request.deadline == Clock::time_point() ? Clock::time_point::max() : request.deadline;
+    if (!prefetcher.take(request.email, fetched, deadline)) {
+        return false;
+    }
+    Database& target = sharded ? sharded->shardFor(request.email) : *db;
+    context.outcome = request.deadline == Clock::time_point()
+        ? target.authenticateFetched(request.email, request.password, fetched)
+        : target.authenticateFetched(request.email, request.password, fetched, request.deadline);
+    context.storageConsulted = true;
+    return true;
+}
@@ -1,55 +1,1105 @@
 #include "Database.h"
+#include "ActivityMonitor.h"
+#include "AuthSchema.h"
+#include "HashingPool.h"
+#include "IntegrityVerifier.h"
+#include "LoginTrace.h"
+#include "Sha256Batch.h"
+#include "SharedCredentialCache.h"
+#include "Snapshot.h"
+#include "StuffingDetector.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <thread>
 
-Database::Database(const std::string& dbPath) : db(nullptr), dbPath(dbPath) {}
+namespace {
+    // Progress callback granularity in VM instructions; a point lookup runs
+    // well under this, so the clock is read only for long-running statements.
+    const int kProgressOps = 1000;
+    // Rows handed to sha256Batch() at once by digestRows().
+    const size_t kDigestBatchRows = 1024;
+
+    void appendField(std::string& out, const void* data, size_t length) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>((length >> shift) & 0xff));
+        }
+        out.append(static_cast<const char*>(data), length);
+    }
+
+    // First column of the first row of `sql` as text; empty on error.
+    std::string queryText(sqlite3* conn, const char* sql) {
+        std::string value;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+                value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            }
+            sqlite3_finalize(stmt);
+        }
+        return value;
+    }
+
+    int64_t queryInt(sqlite3* conn, const char* sql) {
+        int64_t value = 0;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                value = sqlite3_column_int64(stmt, 0);
+            }
+            sqlite3_finalize(stmt);
+        }
+        return value;
+    }
+
+    // Binds the caller's bytes without a copy; they must outlive the step.
+    int bindView(sqlite3_stmt* stmt, int index, std::string_view text) {
+        return sqlite3_bind_text(stmt, index, text.data() ? text.data() : "", static_cast<int>(text.size()),
+                                 SQLITE_STATIC);
+    }
+
+    void removeDatabaseFiles(const std::string& path) {
+        std::error_code ec;
+        for (const char* suffix : {"", "-wal", "-shm", "-journal"}) {
+            std::filesystem::remove(path + suffix, ec);
+        }
+    }
+}
+
+Database::Database(const std::string& dbPath, const DatabaseOptions& options)
+    : db(nullptr),
+      selectClave(nullptr),
+      dbPath(dbPath),
+      options(options),
+      traceRecorder(nullptr),
+      activityMonitor(nullptr),
+      stuffingDetector(nullptr),
+      quarantined(false),
+      replica(false),
+      activeDeadline(Clock::time_point::max()),
+      typicalBusyWaitUs(options.minBusyBackoffUs),
+      jitter(static_cast<unsigned>(reinterpret_cast<uintptr_t>(this))),
+      counters(),
+      migration() {}
 
 Database::~Database() {
+    finalizeStatements();
     if (db) {
         sqlite3_close(db);
     }
 }
 
+void Database::finalizeStatements() {
+    sqlite3_finalize(selectClave);
+    selectClave = nullptr;
+}
+
 bool Database::initialize() {
+    finalizeStatements();
     if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
         std::cerr << "Error opening database: " << sqlite3_errmsg(db) << std::endl;
         return false;
     }
     
-    const char* createTableSQL = 
-        "CREATE TABLE IF NOT EXISTS usuarios ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "usuario TEXT NOT NULL UNIQUE,"
-        "clave TEXT NOT NULL"
-        ");";
+    sqlite3_busy_handler(db, &Database::busyCallback, this);
+    sqlite3_progress_handler(db, kProgressOps, &Database::progressCallback, this);
+    quarantined = false;
+    refreshQuarantine();
+    
+    // An up-to-date file costs one PRAGMA user_version read here.
+    SchemaMigrator migrator(db, authSchemaMigrations());
+    migrator.adoptUnversioned("usuarios", kAuthSchemaUnversioned);
+    // Only takes effect on a new file; lets MaintenanceScheduler hand free
+    // pages back to the OS with PRAGMA incremental_vacuum.
+    migrator.setCreationPragmas("PRAGMA auto_vacuum = INCREMENTAL;");
+    migrator.setMaxBatchMs(options.migrationBatchMs);
+    migrator.setProgressCallback(options.migrationProgress);
     
-    char* errMsg = nullptr;
-    if (sqlite3_exec(db, createTableSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
-        std::cerr << "Error creating table: " << errMsg << std::endl;
-        sqlite3_free(errMsg);
+    // An upgrade must run to completion; it is bounded per batch instead.
+    activeDeadline = Clock::time_point::max();
+    bool ok = migrator.migrate();
+    migration = migrator.report();
+    if (!ok) {
+        std::cerr << "Error migrating schema to version " << migrator.latestVersion() << std::endl;
         return false;
     }
+    if (migration.applied > 0 && options.sharedCache) {
+        // Rows may have been rewritten; nothing cached before still holds.
+        options.sharedCache->invalidateAll();
+    }
+    
+    // After the migrations: a new file must get auto_vacuum before WAL
+    // writes its first page. The journal mode is persistent, so later opens
+    // find it already set.
+    activeDeadline = defaultDeadline();
+    if (options.walMode && !quarantined &&
+        sqlite3_exec(db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Error enabling WAL: " << sqlite3_errmsg(db) << std::endl;
+    }
+    activeDeadline = Clock::time_point::max();
+    
+    // Changes reach a replica only from its follower.
+    replica = false;
+    sqlite3_stmt* role = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT rol FROM replicacion;", -1, &role, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(role) == SQLITE_ROW) {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(role, 0));
+            replica = text && std::strcmp(text, "replica") == 0;
+        }
+        sqlite3_finalize(role);
+    }
+    if (replica) {
+        sqlite3_exec(db, "PRAGMA query_only = ON;", nullptr, nullptr, nullptr);
+    }
     
     return true;
 }
 
-bool Database::validateUser(const std::string& email, const std::string& password) {
+bool Database::validateUser(std::string_view email, std::string_view password) {
+    return authenticate(email, password) == LoginOutcome::Success;
+}
+
+LoginOutcome Database::authenticate(std::string_view email, std::string_view password) {
+    return authenticate(email, password, defaultDeadline());
+}
+
+LoginOutcome Database::authenticate(std::string_view email, std::string_view password,
+                                    Clock::time_point deadline) {
+    counters.queries++;
+    beginRequest(deadline);
+    
+    LoginOutcome outcome = LoginOutcome::UnknownUser;
+    if (Clock::now() >= deadline) {
+        counters.timeouts++;
+        outcome = LoginOutcome::TimedOut;
+    } else {
+        bool found = false;
+        std::string_view stored;
+        outcome = lookupClave(email, found, stored);
+        if (found) {
+            outcome = checkPassword(email, password, stored, deadline);
+        } else if (outcome == LoginOutcome::UnknownUser) {
+            outcome = checkUnknown(password, deadline);
+        }
+    }
+    
+    endRequest();
+    recordLogin(email, password, outcome);
+    return outcome;
+}
+
+LoginOutcome Database::fetchCredential(std::string_view email, FetchedCredential& fetched) {
+    return fetchCredential(email, fetched, defaultDeadline());
+}
+
+LoginOutcome Database::fetchCredential(std::string_view email, FetchedCredential& fetched,
+                                       Clock::time_point deadline) {
+    counters.queries++;
+    beginRequest(deadline);
+    fetched.found = false;
+    fetched.clave.clear();
+    
+    LoginOutcome outcome = LoginOutcome::TimedOut;
+    if (Clock::now() >= deadline) {
+        counters.timeouts++;
+    } else {
+        std::string_view stored;
+        outcome = lookupClave(email, fetched.found, stored);
+        if (outcome == LoginOutcome::UnknownUser) {
+            // The lookup ran; fetched.found tells whether there is an account.
+            fetched.clave.assign(stored.data(), stored.size());
+            outcome = LoginOutcome::Success;
+        }
+    }
+    
+    endRequest();
+    return outcome;
+}
+
+LoginOutcome Database::authenticateFetched(std::string_view email, std::string_view password,
+                                           const FetchedCredential& fetched) {
+    return authenticateFetched(email, password, fetched, defaultDeadline());
+}
+
+LoginOutcome Database::authenticateFetched(std::string_view email, std::string_view password,
+                                           const FetchedCredential& fetched, Clock::time_point deadline) {
+    beginRequest(deadline);
+    LoginOutcome outcome = fetched.found
+        ? checkPassword(email, password, fetched.clave, deadline)
+        : checkUnknown(password, deadline);
+    endRequest();
+    recordLogin(email, password, outcome);
+    return outcome;
+}
+
+void Database::beginRequest(Clock::time_point deadline) {
+    if (activityMonitor) {
+        activityMonitor->begin();
+    }
+    activeDeadline = deadline;
+    busySince = Clock::time_point();
+    requestArena.reset();
+}
+
+void Database::endRequest() {
+    if (busySince != Clock::time_point()) {
+        // Feed the wait that just ended into the adaptive backoff estimate.
+        double waitedUs = std::chrono::duration<double, std::micro>(Clock::now() - busySince).count();
+        typicalBusyWaitUs = 0.8 * typicalBusyWaitUs + 0.2 * waitedUs;
+    }
+    activeDeadline = Clock::time_point::max();
+    if (activityMonitor) {
+        activityMonitor->end();
+    }
+}
+
+LoginOutcome Database::lookupClave(std::string_view email, bool& found, std::string_view& stored) {
+    LoginOutcome outcome = LoginOutcome::UnknownUser;
+    found = false;
+    SharedCredentialCache* cache = options.sharedCache;
+    char* cached = cache ? requestArena.allocateArray<char>(SharedCredentialCache::kMaxValueLength) : nullptr;
+    size_t cachedLength = 0;
+    if (cache && cache->lookup(email, cached, cachedLength)) {
+        found = true;
+        stored = std::string_view(cached, cachedLength);
+        counters.cacheHits++;
+        return outcome;
+    }
+    
+    // Taken before the read: a write to this row in between voids the fill.
+    uint64_t ticket = cache ? cache->fillTicket(email) : 0;
     const char* selectSQL = "SELECT clave FROM usuarios WHERE usuario = ?;";
+    
+    int rc = SQLITE_OK;
+    if (!selectClave) {
+        rc = sqlite3_prepare_v3(db, selectSQL, -1, SQLITE_PREPARE_PERSISTENT, &selectClave, nullptr);
+    }
+    if (rc == SQLITE_OK) {
+        bindView(selectClave, 1, email);
+        
+        rc = sqlite3_step(selectClave);
+        if (rc == SQLITE_ROW) {
+            const char* storedPassword = reinterpret_cast<const char*>(sqlite3_column_text(selectClave, 0));
+            found = true;
+            // Copied out so the read transaction can end before hashing.
+            stored = requestArena.copy(std::string_view(storedPassword ? storedPassword : "",
+                                                        sqlite3_column_bytes(selectClave, 0)));
+        } else if (rc != SQLITE_DONE) {
+            outcome = classifyFailure(rc);
+        }
+        sqlite3_reset(selectClave);
+        sqlite3_clear_bindings(selectClave);
+    } else {
+        outcome = classifyFailure(rc);
+    }
+    if (found && cache) {
+        cache->fill(email, stored, ticket);
+    }
+    return outcome;
+}
+
+void Database::recordLogin(std::string_view email, std::string_view password, LoginOutcome outcome) {
+    if (traceRecorder) {
+        traceRecorder->record(hashAccountKey(email), outcome);
+    }
+    if (stuffingDetector && (outcome == LoginOutcome::UnknownUser || outcome == LoginOutcome::WrongPassword)) {
+        stuffingDetector->recordFailure(std::string(email), stuffingSource, std::string(password));
+    }
+}
+
+LoginOutcome Database::checkPassword(std::string_view email, std::string_view password,
+                                     std::string_view stored, Clock::time_point deadline) {
+    // The hash runs on the pool; this thread only waits, up to the deadline.
+    // Resolving the cost there too keeps a first-use calibration off it.
+    HashCost cost = options.hashCost;
+    double targetMs = options.hashTargetMs;
+    PasswordCheck check;
+    {
+        // The inputs go into the call's arena: if this thread gives up at its
+        // deadline, the pool may still be reading them.
+        HashingPool::Call call(hashing(), deadline);
+        std::string_view stagedPassword;
+        std::string_view stagedStored;
+        if (call) {
+            stagedPassword = call.arena().copy(password);
+            stagedStored = call.arena().copy(stored);
+        }
+        if (!call.run([stagedPassword, stagedStored, cost, targetMs]() {
+                return PasswordHasher(PasswordHasher::resolve(cost, targetMs)).verify(stagedPassword, stagedStored);
+            }, check)) {
+            counters.timeouts++;
+            return LoginOutcome::TimedOut;
+        }
+    }
+    if (check.malformed) {
+        // By the account's trace key: the address itself stays out of the logs.
+        std::cerr << "Stored password hash is malformed for account " << std::hex << hashAccountKey(email)
+                  << std::dec << std::endl;
+        return LoginOutcome::StorageError;
+    }
+    if (!check.match) {
+        return LoginOutcome::WrongPassword;
+    }
+    if (check.needsRehash) {
+        rehash(email, password, stored, deadline);
+    }
+    return LoginOutcome::Success;
+}
+
+LoginOutcome Database::checkUnknown(std::string_view password, Clock::time_point deadline) {
+    // Same hash, same pool, same deadline as checkPassword(), result
+    // discarded: answering at once would tell which accounts exist.
+    HashCost cost = options.hashCost;
+    double targetMs = options.hashTargetMs;
+    PasswordCheck check;
+    HashingPool::Call call(hashing(), deadline);
+    std::string_view stagedPassword;
+    if (call) {
+        stagedPassword = call.arena().copy(password);
+    }
+    if (!call.run([stagedPassword, cost, targetMs]() {
+            PasswordHasher hasher(PasswordHasher::resolve(cost, targetMs));
+            // Built once per pool thread and cost, so a warm login still
+            // does not allocate.
+            thread_local HashCost dummyCost;
+            thread_local std::string dummy;
+            if (dummy.empty() || dummyCost != hasher.cost()) {
+                dummyCost = hasher.cost();
+                dummy = hasher.dummy();
+            }
+            return hasher.verify(stagedPassword, dummy);
+        }, check)) {
+        counters.timeouts++;
+        return LoginOutcome::TimedOut;
+    }
+    return LoginOutcome::UnknownUser;
+}
+
+void Database::rehash(std::string_view email, std::string_view password,
+                      std::string_view stored, Clock::time_point deadline) {
+    // Best effort: if it does not fit in this login's deadline, the next
+    // successful login tries again.
+    if (replica || refreshQuarantine()) {
+        return;
+    }
+    HashCost cost = options.hashCost;
+    double targetMs = options.hashTargetMs;
+    std::string updated;
+    HashingPool::Call call(hashing(), deadline);
+    if (!call) {
+        return;
+    }
+    std::string_view staged = call.arena().copy(password);
+    if (!call.run([staged, cost, targetMs]() {
+            return PasswordHasher(PasswordHasher::resolve(cost, targetMs)).hash(staged);
+        }, updated)) {
+        return;
+    }
+    
+    // Only replace the value that was verified, in case the password was
+    // changed meanwhile.
+    const char* updateSQL =
+        "UPDATE usuarios SET clave = ?, actualizado_en = strftime('%s', 'now') "
+        "WHERE usuario = ? AND clave = ?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, updateSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        return;
+    }
+    bindView(stmt, 1, updated);
+    bindView(stmt, 2, email);
+    bindView(stmt, 3, stored);
+    if (sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db) == 1) {
+        counters.rehashes++;
+        if (options.sharedCache) {
+            options.sharedCache->invalidate(email);
+        }
+    }
+    sqlite3_finalize(stmt);
+}
+
+bool Database::refreshQuarantine() {
+    if (!quarantined && IntegrityVerifier::isQuarantined(dbPath)) {
+        // Enforced by SQLite itself, so no write path can slip past it.
+        sqlite3_exec(db, "PRAGMA query_only = ON;", nullptr, nullptr, nullptr);
+        quarantined = true;
+        std::cerr << "Database " << dbPath << " is quarantined: read-only" << std::endl;
+    }
+    return quarantined;
+}
+
+HashingPool& Database::hashing() const {
+    return options.hashingPool ? *options.hashingPool : HashingPool::shared();
+}
+
+bool Database::hashPasswords(const std::vector<std::pair<std::string, std::string>>& users,
+                             std::vector<std::string>& hashed) {
+    HashCost cost = options.hashCost;
+    double targetMs = options.hashTargetMs;
+    std::vector<std::future<std::string>> pending;
+    pending.reserve(users.size());
+    for (const auto& user : users) {
+        auto task = std::make_shared<std::packaged_task<std::string()>>([password = user.second, cost, targetMs]() {
+            return PasswordHasher(PasswordHasher::resolve(cost, targetMs)).hash(password);
+        });
+        pending.push_back(task->get_future());
+        if (!hashing().submit([task](bool) { (*task)(); }, Clock::time_point::max())) {
+            return false;
+        }
+    }
+    hashed.clear();
+    hashed.reserve(users.size());
+    for (auto& result : pending) {
+        hashed.push_back(result.get());
+    }
+    return true;
+}
+
+void Database::setTraceRecorder(LoginTraceWriter* recorder) {
+    traceRecorder = recorder;
+}
+
+void Database::setActivityMonitor(ActivityMonitor* monitor) {
+    activityMonitor = monitor;
+}
+
+void Database::setStuffingDetector(StuffingDetector* detector, const std::string& source) {
+    stuffingDetector = detector;
+    stuffingSource = source;
+}
+
+Database::Clock::time_point Database::defaultDeadline() const {
+    if (options.queryTimeoutMs <= 0) {
+        return Clock::time_point::max();
+    }
+    return Clock::now() + std::chrono::milliseconds(options.queryTimeoutMs);
+}
+
+LoginOutcome Database::classifyFailure(int rc) {
+    int primary = rc & 0xff;
+    if (primary == SQLITE_INTERRUPT ||
+        (primary == SQLITE_BUSY && Clock::now() >= activeDeadline)) {
+        counters.timeouts++;
+        return LoginOutcome::TimedOut;
+    }
+    counters.storageErrors++;
+    return LoginOutcome::StorageError;
+}
+
+int Database::progressCallback(void* self) {
+    Database* database = static_cast<Database*>(self);
+    if (database->activeDeadline == Clock::time_point::max()) {
+        return 0;
+    }
+    return Clock::now() >= database->activeDeadline ? 1 : 0;
+}
+
+int Database::busyCallback(void* self, int retries) {
+    Database* database = static_cast<Database*>(self);
+    Clock::time_point now = Clock::now();
+    if (retries == 0) {
+        database->busySince = now;
+    }
+    if (now >= database->activeDeadline) {
+        return 0;
+    }
+    
+    // Exponential backoff with equal jitter, starting from a fraction of the
+    // lock hold times seen recently so short holders are retried quickly.
+    double base = std::max<double>(database->options.minBusyBackoffUs, database->typicalBusyWaitUs / 4);
+    double window = std::min<double>(database->options.maxBusyBackoffUs,
+                                     base * static_cast<double>(1u << std::min(retries, 16)));
+    std::uniform_real_distribution<double> spread(window / 2, window);
+    auto sleep = std::chrono::microseconds(static_cast<int64_t>(spread(database->jitter)));
+    if (database->activeDeadline != Clock::time_point::max()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(database->activeDeadline - now);
+        sleep = std::min(sleep, remaining);
+    }
+    
+    std::this_thread::sleep_for(sleep);
+    database->counters.busyRetries++;
+    database->counters.busyWaitUs += static_cast<uint64_t>(sleep.count());
+    return 1;
+}
+
+bool Database::addUser(const std::string& email, const std::string& password) {
+    return addUsers({{email, password}});
+}
+
+bool Database::addUsers(const std::vector<std::pair<std::string, std::string>>& users) {
+    if (!db) {
+        return false;
+    }
+    if (refreshQuarantine()) {
+        std::cerr << "Database is quarantined (read-only); users not added" << std::endl;
+        return false;
+    }
+    
+    // Hash before taking the write lock so other connections are not kept
+    // waiting on CPU work.
+    std::vector<std::string> hashed;
+    if (!hashPasswords(users, hashed)) {
+        return false;
+    }
+    
+    // Wait for the write lock under the normal deadline, then let the
+    // inserts run to completion.
+    activeDeadline = defaultDeadline();
+    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    activeDeadline = Clock::time_point::max();
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+    
+    const char* insertSQL = "INSERT INTO usuarios (usuario, clave, actualizado_en) VALUES (?, ?, strftime('%s', 'now'));";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, insertSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    
+    bool ok = true;
+    for (size_t i = 0; i < users.size(); i++) {
+        sqlite3_bind_text(stmt, 1, users[i].first.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, hashed[i].c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Error inserting user: " << sqlite3_errmsg(db) << std::endl;
+            ok = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    
+    sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (ok && options.sharedCache) {
+        for (const auto& user : users) {
+            options.sharedCache->invalidate(user.first);
+        }
+    }
+    return ok;
+}
+
+bool Database::changePassword(const std::string& email, const std::string& newPassword) {
+    if (!db) {
+        return false;
+    }
+    if (refreshQuarantine()) {
+        std::cerr << "Database is quarantined (read-only); password not changed" << std::endl;
+        return false;
+    }
+    
+    std::vector<std::string> hashed;
+    if (!hashPasswords({{email, newPassword}}, hashed)) {
+        return false;
+    }
+    
+    const char* updateSQL =
+        "UPDATE usuarios SET clave = ?, actualizado_en = strftime('%s', 'now') WHERE usuario = ?;";
     sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, updateSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    bindView(stmt, 1, hashed[0]);
+    bindView(stmt, 2, email);
+    // A single statement: waiting for the write lock is bounded by the
+    // normal deadline, the update itself is one row.
+    activeDeadline = defaultDeadline();
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db) == 1;
+    activeDeadline = Clock::time_point::max();
+    sqlite3_finalize(stmt);
     
+    if (ok && options.sharedCache) {
+        options.sharedCache->invalidate(email);
+    }
+    return ok;
+}
+
+bool Database::exportUsers(const std::function<bool(const StoredUser&)>& visit) {
+    if (!db) {
+        return false;
+    }
+    const char* selectSQL = "SELECT usuario, clave, actualizado_en FROM usuarios ORDER BY usuario;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Error preparing statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    
+    activeDeadline = Clock::time_point::max();
+    StoredUser user;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        user.usuario.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                            static_cast<size_t>(sqlite3_column_bytes(stmt, 0)));
+        user.clave.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                          static_cast<size_t>(sqlite3_column_bytes(stmt, 1)));
+        user.actualizadoEn = sqlite3_column_int64(stmt, 2);
+        if (!visit(user)) {
+            sqlite3_finalize(stmt);
+            return false;
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        std::cerr << "Error reading users: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Database::importUsers(const std::vector<StoredUser>& users) {
+    if (!db) {
+        return false;
+    }
+    if (refreshQuarantine()) {
+        std::cerr << "Database is quarantined (read-only); users not imported" << std::endl;
+        return false;
+    }
+    
+    activeDeadline = defaultDeadline();
+    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    activeDeadline = Clock::time_point::max();
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+    
+    const char* insertSQL = "INSERT OR REPLACE INTO usuarios (usuario, clave, actualizado_en) VALUES (?, ?, ?);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, insertSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    
+    bool ok = true;
+    for (const StoredUser& user : users) {
+        bindView(stmt, 1, user.usuario);
+        bindView(stmt, 2, user.clave);
+        sqlite3_bind_int64(stmt, 3, user.actualizadoEn);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Error importing user: " << sqlite3_errmsg(db) << std::endl;
+            ok = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    
+    sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (ok && options.sharedCache) {
+        for (const StoredUser& user : users) {
+            options.sharedCache->invalidate(user.usuario);
+        }
+    }
+    return ok;
+}
+
+std::string Database::hashResetToken(std::string_view token) {
+    uint8_t digest[Sha256::kDigestSize];
+    Sha256::digest(token.data(), token.size(), digest);
+    return toHex(digest, sizeof(digest));
+}
+
+bool Database::storeResetTokens(const std::vector<ResetToken>& tokens, std::vector<bool>& issued) {
+    issued.assign(tokens.size(), false);
+    if (!db) {
+        return false;
+    }
+    if (refreshQuarantine()) {
+        std::cerr << "Database is quarantined (read-only); reset tokens not stored" << std::endl;
+        return false;
+    }
+    
+    activeDeadline = defaultDeadline();
+    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    activeDeadline = Clock::time_point::max();
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+    
+    // Inserts nothing when the account does not exist.
+    const char* insertSQL =
+        "INSERT INTO recuperaciones (token, usuario, expira_en) "
+        "SELECT ?, usuario, ? FROM usuarios WHERE usuario = ?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, insertSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    
+    bool ok = true;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        bindView(stmt, 1, tokens[i].tokenHash);
+        sqlite3_bind_int64(stmt, 2, tokens[i].expiresAt);
+        bindView(stmt, 3, tokens[i].email);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Error storing reset token: " << sqlite3_errmsg(db) << std::endl;
+            ok = false;
+            break;
+        }
+        issued[i] = sqlite3_changes(db) == 1;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    
+    sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (!ok) {
+        issued.assign(tokens.size(), false);
+    }
+    return ok;
+}
+
+bool Database::redeemResetToken(std::string_view token, const std::string& newPassword) {
+    if (!db) {
+        return false;
+    }
+    if (refreshQuarantine()) {
+        std::cerr << "Database is quarantined (read-only); password not reset" << std::endl;
+        return false;
+    }
+    
+    std::string tokenHash = hashResetToken(token);
+    std::vector<std::string> hashed;
+    if (!hashPasswords({{std::string(), newPassword}}, hashed)) {
+        return false;
+    }
+    
+    activeDeadline = defaultDeadline();
+    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    activeDeadline = Clock::time_point::max();
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+    
+    std::string email;
+    sqlite3_stmt* stmt;
+    const char* selectSQL =
+        "SELECT usuario FROM recuperaciones "
+        "WHERE token = ? AND usado_en = 0 AND expira_en > strftime('%s', 'now');";
+    if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) == SQLITE_OK) {
+        bindView(stmt, 1, tokenHash);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            email = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    
+    bool ok = !email.empty();
+    const char* useSQL =
+        "UPDATE recuperaciones SET usado_en = strftime('%s', 'now') WHERE usuario = ? AND usado_en = 0;";
+    if (ok && sqlite3_prepare_v2(db, useSQL, -1, &stmt, nullptr) == SQLITE_OK) {
+        bindView(stmt, 1, email);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+    } else {
+        ok = false;
+    }
+    const char* updateSQL =
+        "UPDATE usuarios SET clave = ?, actualizado_en = strftime('%s', 'now') WHERE usuario = ?;";
+    if (ok && sqlite3_prepare_v2(db, updateSQL, -1, &stmt, nullptr) == SQLITE_OK) {
+        bindView(stmt, 1, hashed[0]);
+        bindView(stmt, 2, email);
+        ok = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db) == 1;
+        sqlite3_finalize(stmt);
+    } else {
+        ok = false;
+    }
+    
+    // A failed COMMIT rolls back; the cache is dropped only for a stored change.
+    ok = ok && sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    if (options.sharedCache) {
+        options.sharedCache->invalidate(email);
+    }
+    return true;
+}
+
+int Database::purgeResetTokens() {
+    if (!db || replica || refreshQuarantine()) {
+        return -1;
+    }
+    activeDeadline = defaultDeadline();
+    int rc = sqlite3_exec(db, "DELETE FROM recuperaciones WHERE usado_en != 0 OR expira_en <= strftime('%s', 'now');",
+                          nullptr, nullptr, nullptr);
+    activeDeadline = Clock::time_point::max();
+    return rc == SQLITE_OK ? sqlite3_changes(db) : -1;
+}
+
+bool Database::loadLoginState(std::string_view email, LoginState& state) {
+    state = LoginState();
+    state.email.assign(email.data(), email.size());
+    if (!db) {
+        return false;
+    }
+    
+    const char* selectSQL = "SELECT fallos, bloqueado_hasta, ultimo_login FROM estado_login WHERE usuario = ?;";
+    sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Error preparing statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    bindView(stmt, 1, email);
+    activeDeadline = defaultDeadline();
+    int rc = sqlite3_step(stmt);
+    activeDeadline = Clock::time_point::max();
+    if (rc == SQLITE_ROW) {
+        state.failures = static_cast<uint32_t>(sqlite3_column_int64(stmt, 0));
+        state.lockedUntil = sqlite3_column_int64(stmt, 1);
+        state.lastLogin = sqlite3_column_int64(stmt, 2);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW || rc == SQLITE_DONE;
+}
+
+bool Database::storeLoginStates(const std::vector<LoginState>& states) {
+    if (!db) {
+        return false;
+    }
+    if (refreshQuarantine()) {
+        std::cerr << "Database is quarantined (read-only); login state not stored" << std::endl;
+        return false;
+    }
+    
+    activeDeadline = defaultDeadline();
+    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    activeDeadline = Clock::time_point::max();
+    if (rc != SQLITE_OK) {
         return false;
     }
     
-    sqlite3_bind_text(stmt, 1, email.c_str(), -1, SQLITE_TRANSIENT);
+    // Writes nothing when the account does not exist.
+    const char* upsertSQL =
+        "INSERT OR REPLACE INTO estado_login (usuario, fallos, bloqueado_hasta, ultimo_login) "
+        "SELECT usuario, ?, ?, ? FROM usuarios WHERE usuario = ?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, upsertSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
     
-    bool isValid = false;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        const char* storedPassword = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        if (storedPassword && password == storedPassword) {
-            isValid = true;
+    bool ok = true;
+    for (const LoginState& state : states) {
+        sqlite3_bind_int64(stmt, 1, state.failures);
+        sqlite3_bind_int64(stmt, 2, state.lockedUntil);
+        sqlite3_bind_int64(stmt, 3, state.lastLogin);
+        bindView(stmt, 4, state.email);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Error storing login state: " << sqlite3_errmsg(db) << std::endl;
+            ok = false;
+            break;
         }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    
+    sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+    return ok;
+}
+
+bool Database::digestRows(std::vector<RowDigest>& rows, const std::string& key) {
+    rows.clear();
+    if (!db) {
+        return false;
+    }
+    
+    const char* selectSQL = "SELECT usuario, clave, actualizado_en FROM usuarios ORDER BY usuario;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Error preparing statement: " << sqlite3_errmsg(db) << std::endl;
+        return false;
     }
     
+    // Each row is serialized as length-prefixed usuario and clave followed
+    // by actualizado_en as a big-endian 64-bit integer.
+    std::vector<std::string> records;
+    std::vector<Sha256Input> inputs;
+    std::vector<uint8_t> digestBytes(kDigestBatchRows * Sha256::kDigestSize);
+    Sha256Digest* digests = reinterpret_cast<Sha256Digest*>(digestBytes.data());
+    auto flush = [&]() {
+        inputs.clear();
+        for (const std::string& record : records) {
+            inputs.push_back({record.data(), record.size()});
+        }
+        if (key.empty()) {
+            sha256Batch(inputs.data(), inputs.size(), digests);
+        } else {
+            hmacSha256Batch(key.data(), key.size(), inputs.data(), inputs.size(), digests);
+        }
+        for (size_t i = 0; i < inputs.size(); i++) {
+            rows[rows.size() - inputs.size() + i].digest = toHex(digests[i], Sha256::kDigestSize);
+        }
+        records.clear();
+    };
+    
+    activeDeadline = Clock::time_point::max();
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        std::string record;
+        for (int column = 0; column < 2; column++) {
+            appendField(record, sqlite3_column_blob(stmt, column),
+                        static_cast<size_t>(sqlite3_column_bytes(stmt, column)));
+        }
+        uint64_t updated = static_cast<uint64_t>(sqlite3_column_int64(stmt, 2));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            record.push_back(static_cast<char>((updated >> shift) & 0xff));
+        }
+        rows.push_back({reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), ""});
+        records.push_back(std::move(record));
+        if (records.size() == kDigestBatchRows) {
+            flush();
+        }
+    }
     sqlite3_finalize(stmt);
-    return isValid;
+    if (rc != SQLITE_DONE) {
+        std::cerr << "Error reading users: " << sqlite3_errmsg(db) << std::endl;
+        rows.clear();
+        return false;
+    }
+    flush();
+    return true;
+}
+
+bool Database::backup(const std::string& snapshotPath, const BackupOptions& backupOptions, BackupReport* report) {
+    BackupReport result = {};
+    Clock::time_point started = Clock::now();
+    std::string copyPath = snapshotPath + ".copy";
+    removeDatabaseFiles(copyPath);
+    
+    // Separate connections: this one's deadline handlers must not cut the
+    // copy short, and it stays free for logins meanwhile. Busy steps are
+    // retried after a pause instead of waiting inside SQLite.
+    sqlite3* source = nullptr;
+    sqlite3* copy = nullptr;
+    if (sqlite3_open_v2(dbPath.c_str(), &source, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK ||
+        sqlite3_open(copyPath.c_str(), &copy) != SQLITE_OK) {
+        std::cerr << "Error opening database for backup: "
+                  << sqlite3_errmsg(copy ? copy : source) << std::endl;
+        sqlite3_close(source);
+        sqlite3_close(copy);
+        removeDatabaseFiles(copyPath);
+        return false;
+    }
+    
+    // The copy is scratch until it is compressed: no journal, no fsyncs.
+    sqlite3_exec(copy, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;", nullptr, nullptr, nullptr);
+    
+    // In WAL mode an open read transaction pins one snapshot for the whole
+    // copy without blocking writers, so it never restarts.
+    bool pinned = queryText(source, "PRAGMA journal_mode;") == "wal" &&
+                  sqlite3_exec(source, "BEGIN; SELECT count(*) FROM sqlite_master;", nullptr, nullptr,
+                               nullptr) == SQLITE_OK;
+    
+    sqlite3_backup* job = sqlite3_backup_init(copy, "main", source, "main");
+    int rc = job ? SQLITE_OK : SQLITE_ERROR;
+    int lastRemaining = -1;
+    while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+        Clock::time_point stepStart = Clock::now();
+        rc = sqlite3_backup_step(job, std::max(1, backupOptions.pagesPerStep));
+        double stepMs = std::chrono::duration<double, std::milli>(Clock::now() - stepStart).count();
+        result.maxStepMs = std::max(result.maxStepMs, stepMs);
+        result.steps++;
+        if (rc == SQLITE_DONE) {
+            break;
+        }
+        int remaining = sqlite3_backup_remaining(job);
+        if (lastRemaining >= 0 && remaining > lastRemaining &&
+            ++result.restarts > static_cast<uint64_t>(backupOptions.maxRestarts)) {
+            std::cerr << "Backup abandoned: restarted by concurrent writes " << result.restarts << " times" << std::endl;
+            break;
+        }
+        lastRemaining = remaining;
+        std::this_thread::sleep_for(std::chrono::milliseconds(backupOptions.pauseMs));
+    }
+    if (job) {
+        result.databaseBytes = static_cast<uint64_t>(sqlite3_backup_pagecount(job));
+        sqlite3_backup_finish(job);
+    }
+    if (pinned) {
+        sqlite3_exec(source, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+    sqlite3_close(source);
+    result.copySeconds = std::chrono::duration<double>(Clock::now() - started).count();
+    
+    bool ok = rc == SQLITE_DONE;
+    if (!ok) {
+        std::cerr << "Error copying database: " << sqlite3_errstr(rc) << std::endl;
+    } else {
+        result.databaseBytes *= static_cast<uint64_t>(queryInt(copy, "PRAGMA page_size;"));
+        // Rewriting the whole copy only pays off once a good share of it is free.
+        bool worthCompacting = queryInt(copy, "PRAGMA freelist_count;") * 10 > queryInt(copy, "PRAGMA page_count;");
+        if (backupOptions.compact && worthCompacting &&
+            sqlite3_exec(copy, "VACUUM;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Error compacting backup: " << sqlite3_errmsg(copy) << std::endl;
+            ok = false;
+        }
+    }
+    sqlite3_close(copy);
+    
+    SnapshotInfo info = {};
+    ok = ok && writeSnapshot(copyPath, snapshotPath, &info);
+    removeDatabaseFiles(copyPath);
+    if (!ok) {
+        return false;
+    }
+    result.snapshotBytes = info.storedBytes;
+    result.totalSeconds = std::chrono::duration<double>(Clock::now() - started).count();
+    result.megabytesPerSecond = result.databaseBytes / (1024.0 * 1024.0) / std::max(result.totalSeconds, 1e-9);
+    if (report) {
+        *report = result;
+    }
+    return true;
+}
+
+bool Database::restore(const std::string& snapshotPath) {
+    std::string stagedPath = dbPath + ".restore";
+    removeDatabaseFiles(stagedPath);
+    if (!readSnapshot(snapshotPath, stagedPath)) {
+        return false;
+    }
+    
+    // The checksums prove the snapshot is intact; this proves it is a
+    // usable database before it replaces anything.
+    sqlite3* staged = nullptr;
+    bool valid = sqlite3_open_v2(stagedPath.c_str(), &staged, SQLITE_OPEN_READWRITE, nullptr) == SQLITE_OK &&
+                 queryText(staged, "PRAGMA quick_check;") == "ok";
+    sqlite3_close(staged);
+    if (!valid) {
+        std::cerr << "Snapshot " << snapshotPath << " does not contain a valid database" << std::endl;
+        removeDatabaseFiles(stagedPath);
+        return false;
+    }
+    
+    finalizeStatements();
+    if (db) {
+        // Moves every commit into the old file itself and empties its WAL,
+        // so a WAL that outlives the swap has nothing to replay.
+        sqlite3_exec(db, "PRAGMA wal_checkpoint(TRUNCATE);", nullptr, nullptr, nullptr);
+        sqlite3_close(db);
+        db = nullptr;
+    }
+    std::error_code ec;
+    std::filesystem::rename(stagedPath, dbPath, ec);
+    if (ec) {
+        // The old file and its WAL are still in place, untouched.
+        std::cerr << "Error replacing " << dbPath << ": " << ec.message() << std::endl;
+        removeDatabaseFiles(stagedPath);
+        initialize();
+        return false;
+    }
+    // Only now: the old file's WAL must not be replayed onto the restored
+    // pages, but until the swap it may hold commits the old file lacks.
+    std::filesystem::remove(dbPath + "-wal", ec);
+    std::filesystem::remove(dbPath + "-shm", ec);
+    // The snapshot passed quick_check; whatever got the old file quarantined
+    // is gone with it.
+    IntegrityVerifier::clearQuarantine(dbPath);
+    if (options.sharedCache) {
+        options.sharedCache->invalidateAll();
+    }
+    return initialize();
 }
@@ -0,0 +1,147 @@
+#include "FairScheduler.h"
+#include <algorithm>
+
+namespace {
+    uint64_t elapsedNs(FairScheduler::Clock::time_point from, FairScheduler::Clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+}
+
+FairScheduler::FairScheduler(size_t slots) : slots(std::max<size_t>(1, slots)), inFlight(0) {}
+
+void FairScheduler::setWeight(std::string_view tenant, uint32_t weight) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tenants[tenantIndex(tenant)].stats.weight = std::max<uint32_t>(1, weight);
+}
+
+bool FairScheduler::acquire(std::string_view tenant, AuthPriority priority, Clock::time_point deadline,
+                            Ticket& ticket) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ticket.tenant = tenantIndex(tenant);
+    ticket.arrival = Clock::now();
+    int priorityClass = static_cast<int>(priority);
+
+    Waiter waiter;
+    Tenant& queued = tenants[ticket.tenant];
+    queued.queues[priorityClass].push_back(&waiter);
+    if (!queued.inRing[priorityClass]) {
+        queued.inRing[priorityClass] = true;
+        rings[priorityClass].tenants.push_back(ticket.tenant);
+    }
+    dispatch();
+
+    auto granted = [&]() { return waiter.granted; };
+    if (deadline == Clock::time_point()) {
+        waiter.turn.wait(lock, granted);
+    } else if (!waiter.turn.wait_until(lock, deadline, granted)) {
+        // Still queued: a granted waiter always takes its slot.
+        std::deque<Waiter*>& queue = tenants[ticket.tenant].queues[priorityClass];
+        queue.erase(std::find(queue.begin(), queue.end(), &waiter));
+        tenants[ticket.tenant].stats.timedOut++;
+        return false;
+    }
+    TenantStats& stats = tenants[ticket.tenant].stats;
+    stats.granted++;
+    stats.queueDelay.record(elapsedNs(ticket.arrival, Clock::now()));
+    return true;
+}
+
+void FairScheduler::release(const Ticket& ticket) {
+    std::lock_guard<std::mutex> lock(mutex);
+    inFlight--;
+    tenants[ticket.tenant].stats.latency.record(elapsedNs(ticket.arrival, Clock::now()));
+    dispatch();
+}
+
+std::vector<TenantStats> FairScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<TenantStats> result;
+    for (const Tenant& tenant : tenants) {
+        result.push_back(tenant.stats);
+    }
+    return result;
+}
+
+size_t FairScheduler::tenantIndex(std::string_view name) {
+    std::string key(name);
+    auto found = byName.find(key);
+    if (found != byName.end()) {
+        return found->second;
+    }
+    Tenant tenant;
+    tenant.stats.name = key;
+    tenant.stats.weight = 1;
+    tenant.stats.granted = 0;
+    tenant.stats.timedOut = 0;
+    tenants.push_back(std::move(tenant));
+    byName.emplace(std::move(key), tenants.size() - 1);
+    return tenants.size() - 1;
+}
+
+void FairScheduler::dispatch() {
+    while (inFlight < slots) {
+        Waiter* waiter = next(static_cast<int>(AuthPriority::Interactive));
+        if (!waiter) {
+            waiter = next(static_cast<int>(AuthPriority::Batch));
+        }
+        if (!waiter) {
+            return;
+        }
+        waiter->granted = true;
+        inFlight++;
+        waiter->turn.notify_one();
+    }
+}
+
+FairScheduler::Waiter* FairScheduler::next(int priorityClass) {
+    Ring& ring = rings[priorityClass];
+    while (!ring.tenants.empty()) {
+        if (ring.current >= ring.tenants.size()) {
+            ring.current = 0;
+        }
+        Tenant& tenant = tenants[ring.tenants[ring.current]];
+        std::deque<Waiter*>& queue = tenant.queues[priorityClass];
+        if (ring.remaining == 0) {
+            ring.remaining = tenant.stats.weight;
+        }
+        Waiter* waiter = nullptr;
+        if (!queue.empty()) {
+            waiter = queue.front();
+            queue.pop_front();
+            ring.remaining--;
+        }
+        if (queue.empty()) {
+            // Leaves the ring, and its unused turn with it.
+            tenant.inRing[priorityClass] = false;
+            ring.tenants.erase(ring.tenants.begin() + static_cast<std::ptrdiff_t>(ring.current));
+            ring.remaining = 0;
+        } else if (ring.remaining == 0) {
+            ring.current++;
+        }
+        if (waiter) {
+            return waiter;
+        }
+    }
+    return nullptr;
+}
+
+// ============================================
+// FairStage
+// ============================================
+
+bool FairStage::decide(LoginContext& context) {
+    if (!scheduler.acquire(context.request.tenant, context.request.priority, context.request.deadline, ticket)) {
+        context.outcome = LoginOutcome::TimedOut;
+        return true;
+    }
+    holding = true;
+    return false;
+}
+
+void FairStage::observe(const LoginContext& context) {
+    (void)context;
+    if (holding) {
+        scheduler.release(ticket);
+        holding = false;
+    }
+}
@@ -0,0 +1,176 @@
+#include "HashingPool.h"
+#include <algorithm>
+
+HashingPool::HashingPool(int threads, size_t queueCapacity)
+    : capacity(queueCapacity),
+      queueHead(0),
+      queued(0),
+      stopping(false),
+      counters() {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (capacity == 0) {
+        capacity = 4 * static_cast<size_t>(threads);
+    }
+    queue.resize(capacity);
+    // Every queued call and every running one has a slot of its own.
+    for (size_t i = 0; i < capacity + static_cast<size_t>(threads); i++) {
+        slots.push_back(std::unique_ptr<Slot>(new Slot()));
+        freeSlots.push_back(slots.back().get());
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&HashingPool::workerLoop, this);
+    }
+}
+
+HashingPool::~HashingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    hasWork.notify_all();
+    hasRoom.notify_all();
+    hasSlot.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+HashingPool& HashingPool::shared() {
+    static HashingPool pool;
+    return pool;
+}
+
+bool HashingPool::submit(std::function<void(bool expired)> job, Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return push(Job{std::move(job), nullptr, deadline}, deadline, lock);
+}
+
+bool HashingPool::push(Job job, Clock::time_point deadline, std::unique_lock<std::mutex>& lock) {
+    auto hasFree = [&]() { return stopping || queued < capacity; };
+    if (deadline == Clock::time_point::max()) {
+        hasRoom.wait(lock, hasFree);
+    } else if (!hasRoom.wait_until(lock, deadline, hasFree)) {
+        counters.rejected++;
+        return false;
+    }
+    if (stopping) {
+        return false;
+    }
+    queue[(queueHead + queued) % capacity] = std::move(job);
+    queued++;
+    counters.maxQueueDepth = std::max(counters.maxQueueDepth, queued);
+    lock.unlock();
+    hasWork.notify_one();
+    return true;
+}
+
+HashingPool::Slot* HashingPool::acquire(Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto available = [&]() { return stopping || !freeSlots.empty(); };
+    if (deadline == Clock::time_point::max()) {
+        hasSlot.wait(lock, available);
+    } else if (!hasSlot.wait_until(lock, deadline, available)) {
+        counters.rejected++;
+        return nullptr;
+    }
+    if (stopping) {
+        return nullptr;
+    }
+    Slot* slot = freeSlots.back();
+    freeSlots.pop_back();
+    slot->invoke = nullptr;
+    slot->destroy = nullptr;
+    slot->references = 1;
+    slot->finished = false;
+    slot->abandoned = false;
+    return slot;
+}
+
+bool HashingPool::enqueue(Slot* slot, Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex);
+    slot->references++;
+    if (!push(Job{nullptr, slot, deadline}, deadline, lock)) {
+        slot->references--;
+        return false;
+    }
+    return true;
+}
+
+bool HashingPool::await(Slot* slot, Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto finished = [&]() { return slot->finished; };
+    if (deadline == Clock::time_point::max()) {
+        slot->done.wait(lock, finished);
+        return true;
+    }
+    return slot->done.wait_until(lock, deadline, finished);
+}
+
+void HashingPool::release(Slot* slot) {
+    // Called with the mutex held.
+    if (--slot->references > 0) {
+        return;
+    }
+    if (slot->destroy) {
+        slot->destroy(slot->storage);
+    }
+    slot->arena.reset();
+    freeSlots.push_back(slot);
+    hasSlot.notify_one();
+}
+
+HashingPool::Call::Call(HashingPool& pool, Clock::time_point deadline)
+    : pool(pool),
+      slot(pool.acquire(deadline)),
+      deadline(deadline) {}
+
+HashingPool::Call::~Call() {
+    if (!slot) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    // Still queued: the worker skips it instead of hashing for nobody.
+    slot->abandoned = !slot->finished;
+    pool.release(slot);
+}
+
+HashingPoolStats HashingPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void HashingPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        hasWork.wait(lock, [&]() { return stopping || queued > 0; });
+        if (queued == 0) {
+            return;
+        }
+        Job job = std::move(queue[queueHead]);
+        queueHead = (queueHead + 1) % capacity;
+        queued--;
+        bool expired = Clock::now() >= job.deadline || (job.slot && job.slot->abandoned);
+        lock.unlock();
+        hasRoom.notify_one();
+
+        if (job.slot) {
+            job.slot->invoke(job.slot->storage, expired);
+        } else {
+            job.run(expired);
+        }
+
+        lock.lock();
+        if (expired) {
+            counters.expired++;
+        } else {
+            counters.completed++;
+        }
+        if (job.slot) {
+            job.slot->finished = true;
+            job.slot->done.notify_one();
+            release(job.slot);
+        }
+    }
+}
@@ -0,0 +1,420 @@
+#include "IntegrityVerifier.h"
+#include "ActivityMonitor.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const int kProgressOps = 100;
+    // Entries read between clock checks.
+    const int kClockCheckEntries = 32;
+    // Retry delay after a step was skipped for a login or a lock.
+    const int kRetryMs = 10;
+
+    std::string quoted(const std::string& identifier) {
+        std::string out = "\"";
+        for (char c : identifier) {
+            out += c;
+            if (c == '"') {
+                out += '"';
+            }
+        }
+        return out + "\"";
+    }
+
+    std::string quarantinePath(const std::string& dbPath) {
+        return dbPath + ".quarantine";
+    }
+
+    bool isCorruption(int rc) {
+        int primary = rc & 0xff;
+        return primary == SQLITE_CORRUPT || primary == SQLITE_NOTADB;
+    }
+
+    std::vector<std::string> columnTexts(sqlite3* db, const char* sql, const std::string& argument,
+                                         int* rcOut = nullptr) {
+        std::vector<std::string> values;
+        sqlite3_stmt* stmt = nullptr;
+        int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+        if (rc == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, argument.c_str(), -1, SQLITE_TRANSIENT);
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                const unsigned char* text = sqlite3_column_text(stmt, 0);
+                values.push_back(text ? reinterpret_cast<const char*>(text) : "");
+            }
+        }
+        sqlite3_finalize(stmt);
+        if (rcOut) {
+            *rcOut = rc == SQLITE_DONE ? SQLITE_OK : rc;
+        }
+        return values;
+    }
+
+    // SELECT <columns> FROM <table> [INDEXED BY <index>] ORDER BY <key>,
+    // plus the same resuming after a given key.
+    void buildWalkSql(const std::string& table, const std::string& index, const std::vector<std::string>& key,
+                      bool allColumns, std::string& firstSql, std::string& resumeSql) {
+        std::string keyList;
+        std::string placeholders;
+        for (size_t i = 0; i < key.size(); i++) {
+            keyList += (i ? ", " : "") + key[i];
+            placeholders += i ? ", ?" : "?";
+        }
+        std::string from = " FROM " + quoted(table) + (index.empty() ? "" : " INDEXED BY " + quoted(index));
+        std::string select = "SELECT " + keyList + (allColumns ? ", *" : "") + from;
+        std::string order = " ORDER BY " + keyList + ";";
+        firstSql = select + order;
+        resumeSql = select + " WHERE (" + keyList + ") > (" + placeholders + ")" + order;
+    }
+}
+
+IntegrityVerifier::IntegrityVerifier(const std::string& dbPath, const IntegrityOptions& options,
+                                     ActivityMonitor* activity)
+    : dbPath(dbPath),
+      options(options),
+      activity(activity),
+      db(nullptr),
+      stopRequested(false),
+      walkIndex(0),
+      passEntries(0),
+      previousPassEntries(0),
+      stepDeadline(Clock::time_point::max()),
+      nextStep(Clock::now()),
+      interrupted(false),
+      counters() {}
+
+IntegrityVerifier::~IntegrityVerifier() {
+    stop();
+    clearResumeKey();
+    if (db) {
+        sqlite3_close(db);
+    }
+}
+
+bool IntegrityVerifier::open() {
+    if (db) {
+        return true;
+    }
+    if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+        std::cerr << "Error opening database for verification: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    // Never writes, and never waits for a lock: a busy step is retried later.
+    sqlite3_exec(db, "PRAGMA query_only = ON;", nullptr, nullptr, nullptr);
+    sqlite3_busy_timeout(db, 0);
+    sqlite3_progress_handler(db, kProgressOps, &IntegrityVerifier::progressCallback, this);
+    return true;
+}
+
+bool IntegrityVerifier::start() {
+    if (worker.joinable()) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!open()) {
+            return false;
+        }
+        stopRequested = false;
+    }
+    worker = std::thread(&IntegrityVerifier::loop, this);
+    return true;
+}
+
+void IntegrityVerifier::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void IntegrityVerifier::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        wake.wait_until(lock, nextStep);
+        if (stopRequested) {
+            break;
+        }
+        if (Clock::now() < nextStep) {
+            continue;
+        }
+        lock.unlock();
+        runStep();
+        lock.lock();
+        nextStep = std::max(nextStep, Clock::now() + std::chrono::milliseconds(kRetryMs));
+    }
+}
+
+void IntegrityVerifier::setFindingCallback(FindingCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    onFinding = std::move(callback);
+}
+
+IntegrityProgress IntegrityVerifier::progress() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+std::vector<IntegrityFinding> IntegrityVerifier::findings() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return found;
+}
+
+bool IntegrityVerifier::planPass() {
+    walks.clear();
+    walkIndex = 0;
+    clearResumeKey();
+
+    int rc;
+    std::vector<std::string> tables = columnTexts(
+        db, "SELECT name FROM sqlite_schema WHERE type = 'table' AND rootpage > 0 ORDER BY name;", "", &rc);
+    if (isCorruption(rc)) {
+        // Nothing else can be planned; the pass ends with this finding.
+        report(Walk{"sqlite_schema", "", "", 0}, rc);
+        return true;
+    }
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+
+    for (const std::string& table : tables) {
+        // WITHOUT ROWID tables are keyed by their primary key columns.
+        sqlite3_stmt* probe = nullptr;
+        bool hasRowid = sqlite3_prepare_v2(db, ("SELECT rowid FROM " + quoted(table) + " LIMIT 0;").c_str(),
+                                           -1, &probe, nullptr) == SQLITE_OK;
+        sqlite3_finalize(probe);
+        std::vector<std::string> key;
+        if (hasRowid) {
+            key.push_back("rowid");
+        } else {
+            for (const std::string& column :
+                 columnTexts(db, "SELECT name FROM pragma_table_info(?) WHERE pk > 0 ORDER BY pk;", table)) {
+                key.push_back(quoted(column));
+            }
+        }
+        Walk walk{table, "", "", key.size()};
+        buildWalkSql(table, "", key, true, walk.firstSql, walk.resumeSql);
+        walks.push_back(walk);
+
+        // A WITHOUT ROWID table's primary key index is the table itself.
+        std::vector<std::string> indexes = columnTexts(
+            db, hasRowid ? "SELECT name FROM pragma_index_list(?) WHERE partial = 0 ORDER BY name;"
+                         : "SELECT name FROM pragma_index_list(?) WHERE partial = 0 AND origin <> 'pk' ORDER BY name;",
+            table);
+        for (const std::string& index : indexes) {
+            sqlite3_stmt* info = nullptr;
+            const char* infoSql = "SELECT cid, name, desc, coll FROM pragma_index_xinfo(?) ORDER BY seqno;";
+            if (sqlite3_prepare_v2(db, infoSql, -1, &info, nullptr) != SQLITE_OK) {
+                continue;
+            }
+            sqlite3_bind_text(info, 1, index.c_str(), -1, SQLITE_TRANSIENT);
+            std::vector<std::string> columns;
+            bool walkable = true;
+            while (sqlite3_step(info) == SQLITE_ROW) {
+                int cid = sqlite3_column_int(info, 0);
+                const unsigned char* name = sqlite3_column_text(info, 1);
+                const unsigned char* collation = sqlite3_column_text(info, 3);
+                if (cid == -2 || sqlite3_column_int(info, 2) != 0 ||
+                    (collation && std::string(reinterpret_cast<const char*>(collation)) != "BINARY")) {
+                    walkable = false;
+                }
+                columns.push_back(cid == -1 || !name ? "rowid" : quoted(reinterpret_cast<const char*>(name)));
+            }
+            sqlite3_finalize(info);
+            if (!walkable || columns.empty()) {
+                continue;
+            }
+            Walk indexWalk{index, "", "", columns.size()};
+            buildWalkSql(table, index, columns, false, indexWalk.firstSql, indexWalk.resumeSql);
+            walks.push_back(indexWalk);
+        }
+    }
+    return true;
+}
+
+int IntegrityVerifier::walkSlice(const Walk& walk) {
+    const std::string& sql = resumeKey.empty() ? walk.firstSql : walk.resumeSql;
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return rc;
+    }
+    for (size_t i = 0; i < resumeKey.size(); i++) {
+        sqlite3_bind_value(stmt, static_cast<int>(i + 1), resumeKey[i]);
+    }
+
+    int entries = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        // Touching every value reads the whole record, overflow pages included.
+        int columns = sqlite3_column_count(stmt);
+        for (int c = 0; c < columns; c++) {
+            sqlite3_column_bytes(stmt, c);
+        }
+        clearResumeKey();
+        for (size_t i = 0; i < walk.keyColumns; i++) {
+            resumeKey.push_back(sqlite3_value_dup(sqlite3_column_value(stmt, static_cast<int>(i))));
+        }
+        counters.entriesChecked++;
+        passEntries++;
+        if (++entries % kClockCheckEntries == 0 && Clock::now() >= stepDeadline) {
+            rc = SQLITE_INTERRUPT;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+void IntegrityVerifier::report(const Walk& walk, int rc) {
+    IntegrityFinding finding;
+    finding.btree = walk.name;
+    for (size_t i = 0; i < resumeKey.size(); i++) {
+        const unsigned char* text = sqlite3_value_text(resumeKey[i]);
+        finding.afterKey += (i ? "," : "") + std::string(text ? reinterpret_cast<const char*>(text) : "");
+    }
+    finding.code = rc;
+    finding.message = sqlite3_errmsg(db);
+    found.push_back(finding);
+    std::cerr << "Corrupcion en " << finding.btree << " despues de '" << finding.afterKey
+              << "': " << finding.message << std::endl;
+    if (options.quarantineOnCorruption && !counters.quarantined) {
+        counters.quarantined = quarantine(dbPath, finding.btree + ": " + finding.message);
+    }
+}
+
+bool IntegrityVerifier::runStep() {
+    if (activity && activity->inFlight() > 0) {
+        return false;
+    }
+
+    size_t reported;
+    FindingCallback callback;
+    std::vector<IntegrityFinding> fresh;
+    bool worked = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!open()) {
+            return false;
+        }
+        reported = found.size();
+        Clock::time_point started = Clock::now();
+        stepDeadline = started + std::chrono::milliseconds(options.stepBudgetMs);
+        interrupted = false;
+
+        bool planned = walkIndex < walks.size() || planPass();
+        while (planned && walkIndex < walks.size() && Clock::now() < stepDeadline && !interrupted) {
+            const Walk& walk = walks[walkIndex];
+            counters.btree = walk.name;
+            uint64_t before = counters.entriesChecked;
+            int rc = walkSlice(walk);
+            worked = worked || counters.entriesChecked > before;
+            int primary = rc & 0xff;
+            if (primary == SQLITE_INTERRUPT || primary == SQLITE_BUSY || primary == SQLITE_LOCKED) {
+                break;
+            }
+            if (isCorruption(rc)) {
+                report(walk, rc);
+                worked = true;
+            } else if (rc != SQLITE_DONE) {
+                std::cerr << "Error verifying " << walk.name << ": " << sqlite3_errmsg(db) << std::endl;
+            }
+            // Done, or nothing more can be read from this B-tree this pass.
+            walkIndex++;
+            clearResumeKey();
+        }
+        stepDeadline = Clock::time_point::max();
+
+        Clock::time_point now = Clock::now();
+        double elapsedMs = std::chrono::duration<double, std::milli>(now - started).count();
+        if (worked || interrupted) {
+            counters.steps++;
+            counters.maxStepMs = std::max(counters.maxStepMs, elapsedMs);
+            if (interrupted) {
+                counters.interruptedSteps++;
+            }
+        }
+        if (planned && walkIndex >= walks.size()) {
+            counters.passesCompleted++;
+            previousPassEntries = passEntries;
+            passEntries = 0;
+            walks.clear();
+            walkIndex = 0;
+            counters.btree.clear();
+            nextStep = now + std::chrono::milliseconds(options.passIntervalMs);
+        } else {
+            double share = std::min(1.0, std::max(options.cpuShare, 1e-3));
+            nextStep = now + std::chrono::microseconds(static_cast<int64_t>(elapsedMs * 1000 * (1 / share - 1)));
+        }
+        counters.passFraction = previousPassEntries == 0
+            ? 0.0 : std::min(1.0, static_cast<double>(passEntries) / previousPassEntries);
+
+        fresh.assign(found.begin() + static_cast<std::ptrdiff_t>(reported), found.end());
+        callback = onFinding;
+    }
+    if (callback) {
+        for (const IntegrityFinding& finding : fresh) {
+            callback(finding);
+        }
+    }
+    return worked;
+}
+
+bool IntegrityVerifier::runPass() {
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!open()) {
+            return false;
+        }
+        target = counters.passesCompleted + 1;
+    }
+    while (progress().passesCompleted < target) {
+        if (!runStep()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return true;
+}
+
+void IntegrityVerifier::clearResumeKey() {
+    for (sqlite3_value* value : resumeKey) {
+        sqlite3_value_free(value);
+    }
+    resumeKey.clear();
+}
+
+int IntegrityVerifier::progressCallback(void* self) {
+    IntegrityVerifier* verifier = static_cast<IntegrityVerifier*>(self);
+    if (verifier->stepDeadline == Clock::time_point::max()) {
+        return 0;
+    }
+    if (verifier->activity && verifier->activity->inFlight() > 0) {
+        verifier->interrupted = true;
+        return 1;
+    }
+    return Clock::now() >= verifier->stepDeadline ? 1 : 0;
+}
+
+bool IntegrityVerifier::quarantine(const std::string& dbPath, const std::string& reason) {
+    std::ofstream marker(quarantinePath(dbPath), std::ios::trunc);
+    marker << reason << std::endl;
+    return static_cast<bool>(marker);
+}
+
+bool IntegrityVerifier::isQuarantined(const std::string& dbPath) {
+    std::error_code ec;
+    return std::filesystem::exists(quarantinePath(dbPath), ec);
+}
+
+bool IntegrityVerifier::clearQuarantine(const std::string& dbPath) {
+    std::error_code ec;
+    return std::filesystem::remove(quarantinePath(dbPath), ec);
+}
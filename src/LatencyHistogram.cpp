@@ -0,0 +1,129 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace {
+    // Values below kLinearLimit get one bucket each; above it every
+    // power-of-two range is split into kSubBuckets buckets.
+    const unsigned kSubBits = 5;
+    const uint64_t kSubBuckets = 1ull << kSubBits;
+    const uint64_t kLinearLimit = kSubBuckets * 2;
+    const size_t kBucketCount = kLinearLimit + (64 - (kSubBits + 1)) * kSubBuckets;
+
+    unsigned highestBit(uint64_t value) {
+        unsigned bit = 0;
+        while (value >>= 1) {
+            bit++;
+        }
+        return bit;
+    }
+}
+
+LatencyHistogram::LatencyHistogram()
+    : counts(kBucketCount, 0),
+      totalCount(0),
+      minValue(std::numeric_limits<uint64_t>::max()),
+      maxValue(0),
+      sum(0) {}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < kLinearLimit) {
+        return static_cast<size_t>(value);
+    }
+    unsigned magnitude = highestBit(value);
+    unsigned shift = magnitude - kSubBits;
+    uint64_t sub = (value >> shift) - kSubBuckets;
+    return static_cast<size_t>(kLinearLimit + (magnitude - (kSubBits + 1)) * kSubBuckets + sub);
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t index) {
+    if (index < kLinearLimit) {
+        return index;
+    }
+    size_t offset = index - kLinearLimit;
+    unsigned magnitude = static_cast<unsigned>(offset / kSubBuckets) + kSubBits + 1;
+    uint64_t sub = offset % kSubBuckets + kSubBuckets;
+    unsigned shift = magnitude - kSubBits;
+    // Midpoint of the bucket's range.
+    return (sub << shift) + ((1ull << shift) >> 1);
+}
+
+void LatencyHistogram::record(uint64_t valueNs) {
+    counts[bucketIndex(valueNs)]++;
+    totalCount++;
+    minValue = std::min(minValue, valueNs);
+    maxValue = std::max(maxValue, valueNs);
+    sum += valueNs;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts.size(); i++) {
+        counts[i] += other.counts[i];
+    }
+    totalCount += other.totalCount;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+    sum += other.sum;
+}
+
+void LatencyHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    totalCount = 0;
+    minValue = std::numeric_limits<uint64_t>::max();
+    maxValue = 0;
+    sum = 0;
+}
+
+double LatencyHistogram::mean() const {
+    return totalCount ? static_cast<double>(sum / totalCount) : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (totalCount == 0) {
+        return 0;
+    }
+    p = std::min(std::max(p, 0.0), 100.0);
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(totalCount) + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(std::max(bucketValue(i), minValue), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+bool LatencyHistogram::saveToFile(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] != 0) {
+            out << bucketValue(i) << ' ' << counts[i] << '\n';
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+bool LatencyHistogram::loadFromFile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    reset();
+    uint64_t value = 0;
+    uint64_t count = 0;
+    while (in >> value >> count) {
+        counts[bucketIndex(value)] += count;
+        totalCount += count;
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+        sum += static_cast<long double>(value) * count;
+    }
+    return true;
+}
@@ -0,0 +1,15 @@
+#include "LoginOutcome.h"
+
+const char* loginOutcomeName(LoginOutcome outcome) {
+    switch (outcome) {
+        case LoginOutcome::Success: return "success";
+        case LoginOutcome::UnknownUser: return "unknown-user";
+        case LoginOutcome::WrongPassword: return "wrong-password";
+        case LoginOutcome::PolicyRejected: return "policy-rejected";
+        case LoginOutcome::TimedOut: return "timed-out";
+        case LoginOutcome::StorageError: return "storage-error";
+        case LoginOutcome::RateLimited: return "rate-limited";
+        case LoginOutcome::Overloaded: return "overloaded";
+    }
+    return "unknown";
+}
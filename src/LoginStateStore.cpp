@@ -0,0 +1,421 @@
+#include "LoginStateStore.h"
+#include "LoginTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+    // Slots examined per account in the absent table.
+    const size_t kAbsentProbe = 4;
+
+    int64_t unixNow() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // 0 marks a free absent slot.
+    uint64_t absentKey(std::string_view email) {
+        uint64_t account = hashAccountKey(email);
+        return account ? account : 1;
+    }
+
+    bool isEmpty(const LoginState& state) {
+        return state.failures == 0 && state.lockedUntil == 0 && state.lastLogin == 0;
+    }
+}
+
+LoginStateStore::LoginStateStore(const std::string& dbPath, const LoginStateOptions& options,
+                                 const DatabaseOptions& databaseOptions)
+    : dbPath(dbPath), options(options), databaseOptions(databaseOptions), nextReader(0),
+      absent(std::max(options.absentSlots, kAbsentProbe), AbsentSlot{0, 0, 0, 0}), running(false),
+      stopRequested(false), counters() {}
+
+LoginStateStore::~LoginStateStore() {
+    stop();
+}
+
+bool LoginStateStore::start() {
+    if (running) {
+        return true;
+    }
+    if (readers.empty()) {
+        for (size_t i = 0; i < std::max<size_t>(options.readers, 1); i++) {
+            readers.push_back(std::make_unique<Reader>());
+        }
+    }
+    bool opened = true;
+    for (auto& reader : readers) {
+        std::lock_guard<std::mutex> readLock(reader->mutex);
+        reader->db = std::make_unique<Database>(dbPath, databaseOptions);
+        opened = reader->db->initialize() && opened;
+    }
+    writer = std::make_unique<Database>(dbPath, databaseOptions);
+    if (!opened || !writer->initialize()) {
+        std::cerr << "Error opening login state store: " << dbPath << std::endl;
+        for (auto& reader : readers) {
+            std::lock_guard<std::mutex> readLock(reader->mutex);
+            reader->db.reset();
+        }
+        writer.reset();
+        return false;
+    }
+    stopRequested = false;
+    running = true;
+    // Written through by the callers otherwise.
+    if (options.flushIntervalMs > 0) {
+        worker = std::thread(&LoginStateStore::writerLoop, this);
+    }
+    return true;
+}
+
+void LoginStateStore::stop() {
+    if (!running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    flush();
+    running = false;
+    for (auto& reader : readers) {
+        std::lock_guard<std::mutex> readLock(reader->mutex);
+        reader->db.reset();
+    }
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    writer.reset();
+}
+
+LoginState LoginStateStore::state(std::string_view email) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return lookup(email, lock);
+}
+
+bool LoginStateStore::isLocked(std::string_view email) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return lookup(email, lock).lockedUntil > unixNow();
+}
+
+LoginState LoginStateStore::recordFailure(std::string_view email) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Entry& current = entry(email, lock);
+    countFailure(current.state.failures, current.state.lockedUntil, unixNow());
+    markDirty(current);
+    LoginState after = current.state;
+    afterChange(lock);
+    return after;
+}
+
+LoginState LoginStateStore::recordUnknownFailure(std::string_view email) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto found = entries.find(std::string(email));
+    if (found != entries.end()) {
+        // Read while the account existed; counted as before.
+        Entry& current = found->second;
+        countFailure(current.state.failures, current.state.lockedUntil, unixNow());
+        markDirty(current);
+        LoginState after = current.state;
+        afterChange(lock);
+        return after;
+    }
+    uint64_t account = absentKey(email);
+    AbsentSlot* slot = findAbsent(account);
+    if (!slot) {
+        slot = &rememberAbsent(account);
+    }
+    int64_t now = unixNow();
+    countFailure(slot->failures, slot->lockedUntil, now);
+    slot->touched = now;
+    counters.updates++;
+    LoginState after;
+    after.email.assign(email.data(), email.size());
+    after.failures = slot->failures;
+    after.lockedUntil = slot->lockedUntil;
+    return after;
+}
+
+LoginState LoginStateStore::recordSuccess(std::string_view email) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Entry& current = entry(email, lock);
+    int64_t now = unixNow();
+    LoginState before = current.state;
+    // Another success within the same second changes nothing.
+    if (before.failures == 0 && before.lockedUntil == 0 && before.lastLogin == now) {
+        return before;
+    }
+    current.state.failures = 0;
+    current.state.lockedUntil = 0;
+    current.state.lastLogin = now;
+    markDirty(current);
+    afterChange(lock);
+    return before;
+}
+
+void LoginStateStore::countFailure(uint32_t& failures, int64_t& lockedUntil, int64_t now) const {
+    if (lockedUntil != 0 && lockedUntil <= now) {
+        failures = 0;
+        lockedUntil = 0;
+    }
+    failures++;
+    if (failures >= options.maxFailures) {
+        lockedUntil = now + options.lockoutSeconds;
+    }
+}
+
+void LoginStateStore::afterChange(std::unique_lock<std::mutex>& lock) {
+    bool full = pending.size() >= options.maxBatch;
+    lock.unlock();
+    if (options.flushIntervalMs <= 0) {
+        flush();
+    } else if (full) {
+        wake.notify_one();
+    }
+}
+
+bool LoginStateStore::flush() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return writePending();
+}
+
+LoginStateStats LoginStateStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    LoginStateStats result = counters;
+    result.entries = entries.size();
+    return result;
+}
+
+void LoginStateStore::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        wake.wait_for(lock, std::chrono::milliseconds(options.flushIntervalMs),
+                      [this]() { return stopRequested || pending.size() >= options.maxBatch; });
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+LoginState LoginStateStore::lookup(std::string_view email, std::unique_lock<std::mutex>& lock) {
+    std::string key(email);
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        touch(found->second);
+        return found->second.state;
+    }
+    uint64_t account = absentKey(email);
+    if (AbsentSlot* slot = findAbsent(account)) {
+        slot->touched = unixNow();
+        counters.absentHits++;
+        LoginState state;
+        state.email = std::move(key);
+        state.failures = slot->failures;
+        state.lockedUntil = slot->lockedUntil;
+        return state;
+    }
+
+    // Read without holding up logins on other accounts.
+    lock.unlock();
+    LoginState loaded;
+    bool read = this->read(email, loaded);
+    loaded.email = key;
+    lock.lock();
+    if (read) {
+        counters.loads++;
+    }
+    found = entries.find(key);
+    if (found != entries.end()) {
+        // Another thread read or changed it meanwhile.
+        return found->second.state;
+    }
+    if (!read || !isEmpty(loaded)) {
+        return insert(std::move(key), loaded).state;
+    }
+    rememberAbsent(account);
+    return loaded;
+}
+
+LoginStateStore::Entry& LoginStateStore::entry(std::string_view email, std::unique_lock<std::mutex>& lock) {
+    std::string key(email);
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        return found->second;
+    }
+    if (AbsentSlot* slot = findAbsent(absentKey(email))) {
+        // Nothing stored: starts from the slot, and is now kept as an entry.
+        LoginState state;
+        state.email = key;
+        state.failures = slot->failures;
+        state.lockedUntil = slot->lockedUntil;
+        slot->account = 0;
+        return insert(std::move(key), state);
+    }
+    LoginState loaded = lookup(email, lock);
+    found = entries.find(key);
+    if (found != entries.end()) {
+        return found->second;
+    }
+    if (AbsentSlot* slot = findAbsent(absentKey(email))) {
+        slot->account = 0;
+    }
+    return insert(std::move(key), loaded);
+}
+
+bool LoginStateStore::read(std::string_view email, LoginState& state) {
+    if (readers.empty()) {
+        return false;
+    }
+    // Any free connection; queue on one only when all are busy.
+    size_t first = nextReader.fetch_add(1, std::memory_order_relaxed) % readers.size();
+    for (size_t i = 0; i < readers.size(); i++) {
+        Reader& reader = *readers[(first + i) % readers.size()];
+        std::unique_lock<std::mutex> readLock(reader.mutex, std::try_to_lock);
+        if (readLock.owns_lock()) {
+            return reader.db && reader.db->loadLoginState(email, state);
+        }
+    }
+    Reader& reader = *readers[first];
+    std::lock_guard<std::mutex> readLock(reader.mutex);
+    return reader.db && reader.db->loadLoginState(email, state);
+}
+
+LoginStateStore::Entry& LoginStateStore::insert(std::string key, const LoginState& state) {
+    // Room is made from unchanged entries; changed ones wait for their write.
+    while (entries.size() >= options.maxEntries && !clean.empty()) {
+        entries.erase(clean.front());
+        clean.pop_front();
+    }
+    Entry& inserted = entries[key];
+    inserted.state = state;
+    inserted.cleanPosition = clean.insert(clean.end(), std::move(key));
+    return inserted;
+}
+
+void LoginStateStore::touch(Entry& used) {
+    if (!used.dirty) {
+        clean.splice(clean.end(), clean, used.cleanPosition);
+    }
+}
+
+LoginStateStore::AbsentSlot* LoginStateStore::findAbsent(uint64_t account) {
+    for (size_t i = 0; i < kAbsentProbe; i++) {
+        AbsentSlot& slot = absent[(account + i) % absent.size()];
+        if (slot.account == account) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+LoginStateStore::AbsentSlot& LoginStateStore::rememberAbsent(uint64_t account) {
+    // A free slot, else one counting no failures, else the one left alone
+    // longest: guessing emails that share slots should not reset a count.
+    int64_t now = unixNow();
+    auto rank = [now](const AbsentSlot& slot) {
+        bool counting = slot.failures > 0 && (slot.lockedUntil == 0 || slot.lockedUntil > now);
+        return slot.account == 0 ? 0 : counting ? 2 : 1;
+    };
+    AbsentSlot* victim = &absent[account % absent.size()];
+    for (size_t i = 1; i < kAbsentProbe; i++) {
+        AbsentSlot& slot = absent[(account + i) % absent.size()];
+        if (rank(slot) < rank(*victim) || (rank(slot) == rank(*victim) && slot.touched < victim->touched)) {
+            victim = &slot;
+        }
+    }
+    *victim = AbsentSlot{account, 0, 0, now};
+    return *victim;
+}
+
+void LoginStateStore::markDirty(Entry& changed) {
+    counters.updates++;
+    if (changed.dirty) {
+        counters.coalesced++;
+        return;
+    }
+    changed.dirty = true;
+    clean.erase(changed.cleanPosition);
+    pending.push_back(changed.state.email);
+}
+
+bool LoginStateStore::writePending() {
+    std::vector<LoginState> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string& email : pending) {
+            auto found = entries.find(email);
+            if (found != entries.end() && found->second.dirty) {
+                batch.push_back(found->second.state);
+                found->second.dirty = false;
+                found->second.cleanPosition = clean.insert(clean.end(), email);
+            }
+        }
+        pending.clear();
+    }
+    if (batch.empty()) {
+        return true;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    bool ok = writer && writer->storeLoginStates(batch);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.flushes++;
+    counters.maxFlushMs = std::max(counters.maxFlushMs, ms);
+    if (ok) {
+        counters.rowsWritten += batch.size();
+    } else {
+        // Left for the next write, unless they have changed again since.
+        counters.flushFailures++;
+        for (const LoginState& state : batch) {
+            auto found = entries.find(state.email);
+            if (found != entries.end() && !found->second.dirty) {
+                found->second.dirty = true;
+                clean.erase(found->second.cleanPosition);
+                pending.push_back(state.email);
+            }
+        }
+    }
+    return ok;
+}
+
+// ============================================
+// LockoutStage
+// ============================================
+
+bool LockoutStage::decide(LoginContext& context) {
+    recorded = store.state(context.request.email);
+    checked = true;
+    int64_t now = unixNow();
+    if (recorded.lockedUntil > now) {
+        context.outcome = LoginOutcome::RateLimited;
+        return true;
+    }
+    if (context.request.attempt == 0) {
+        // A lockout that has run out starts the count anew.
+        bool expired = recorded.lockedUntil != 0;
+        context.request.attempt = expired ? 1 : recorded.failures + 1;
+    }
+    return false;
+}
+
+void LockoutStage::observe(const LoginContext& context) {
+    bool ran = checked;
+    checked = false;
+    if (context.decidedBy == this) {
+        return;
+    }
+    if (context.outcome == LoginOutcome::WrongPassword) {
+        recorded = store.recordFailure(context.request.email);
+    } else if (context.outcome == LoginOutcome::UnknownUser && ran) {
+        // Locks like a wrong password, so the answers never differ.
+        recorded = store.recordUnknownFailure(context.request.email);
+    } else if (context.outcome == LoginOutcome::Success) {
+        recorded = store.recordSuccess(context.request.email);
+    } else if (!ran) {
+        recorded = LoginState();
+    }
+}
@@ -0,0 +1,159 @@
+#include "LoginTrace.h"
+#include <cstring>
+
+namespace {
+    const char kMagic[4] = {'A', 'T', 'R', 'C'};
+    const uint8_t kVersion = 1;
+
+    void putU64(unsigned char* out, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    uint64_t getU64(const unsigned char* in) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+}
+
+uint64_t hashAccountKey(std::string_view email) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : email) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// ============================================
+// LoginTraceWriter
+// ============================================
+
+LoginTraceWriter::LoginTraceWriter() : file(nullptr), lastOffsetNs(0), records(0) {}
+
+LoginTraceWriter::~LoginTraceWriter() {
+    close();
+}
+
+bool LoginTraceWriter::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file) {
+        return false;
+    }
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+
+    start = std::chrono::steady_clock::now();
+    uint64_t wallStart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    unsigned char header[13];
+    std::memcpy(header, kMagic, 4);
+    header[4] = kVersion;
+    putU64(header + 5, wallStart);
+    std::fwrite(header, 1, sizeof(header), file);
+
+    lastOffsetNs = 0;
+    records = 0;
+    return true;
+}
+
+void LoginTraceWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+void LoginTraceWriter::record(uint64_t accountKey, LoginOutcome outcome) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file) {
+        return;
+    }
+    uint64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    uint64_t delta = offset - lastOffsetNs;
+    lastOffsetNs = offset;
+
+    unsigned char buffer[19];
+    size_t length = 0;
+    while (delta >= 0x80) {
+        buffer[length++] = static_cast<unsigned char>(delta | 0x80);
+        delta >>= 7;
+    }
+    buffer[length++] = static_cast<unsigned char>(delta);
+    putU64(buffer + length, accountKey);
+    length += 8;
+    buffer[length++] = static_cast<unsigned char>(outcome);
+    std::fwrite(buffer, 1, length, file);
+    records++;
+}
+
+// ============================================
+// LoginTraceReader
+// ============================================
+
+LoginTraceReader::LoginTraceReader() : file(nullptr), wallStartNs(0), offsetNs(0) {}
+
+LoginTraceReader::~LoginTraceReader() {
+    close();
+}
+
+bool LoginTraceReader::open(const std::string& path) {
+    close();
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+
+    unsigned char header[13];
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        std::memcmp(header, kMagic, 4) != 0 || header[4] != kVersion) {
+        close();
+        return false;
+    }
+    wallStartNs = getU64(header + 5);
+    offsetNs = 0;
+    return true;
+}
+
+void LoginTraceReader::close() {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+bool LoginTraceReader::next(LoginTraceRecord& record) {
+    if (!file) {
+        return false;
+    }
+    uint64_t delta = 0;
+    for (int shift = 0; ; shift += 7) {
+        int c = std::fgetc(file);
+        if (c == EOF || shift > 63) {
+            return false;
+        }
+        delta |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            break;
+        }
+    }
+    unsigned char rest[9];
+    if (std::fread(rest, 1, sizeof(rest), file) != sizeof(rest)) {
+        return false;
+    }
+    offsetNs += delta;
+    record.timestampNs = offsetNs;
+    record.accountKey = getU64(rest);
+    record.outcome = static_cast<LoginOutcome>(rest[8]);
+    return true;
+}
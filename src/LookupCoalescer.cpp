@@ -0,0 +1,120 @@
+#include "LookupCoalescer.h"
+#include "LoginTrace.h"
+#include <algorithm>
+
+LookupCoalescer::LookupCoalescer(size_t slots, std::chrono::microseconds hedgeAfter)
+    : flights(std::max<size_t>(1, slots)), hedgeAfter(hedgeAfter), counters() {}
+
+LoginOutcome LookupCoalescer::fetch(std::string_view email, Database& db, FetchedCredential& fetched,
+                                    Clock::time_point deadline) {
+    auto query = [&]() {
+        return deadline == Clock::time_point::max()
+            ? db.fetchCredential(email, fetched)
+            : db.fetchCredential(email, fetched, deadline);
+    };
+    std::unique_lock<std::mutex> lock(mutex);
+    counters.lookups++;
+    Flight& flight = flights[hashAccountKey(email) % flights.size()];
+    uint64_t generation = flight.generation;
+
+    Clock::time_point now = Clock::now();
+    while (flight.active && flight.email == email && (flight.hedged || now - flight.started < hedgeAfter)) {
+        counters.coalesced++;
+        flight.readers++;
+        auto finished = [&]() { return flight.generation != generation; };
+        bool ended = true;
+        if (deadline == Clock::time_point::max()) {
+            flight.done.wait(lock, finished);
+        } else {
+            ended = flight.done.wait_until(lock, deadline, finished);
+        }
+        flight.readers--;
+        if (!ended) {
+            return LoginOutcome::TimedOut;
+        }
+        if (flight.outcome == LoginOutcome::Success) {
+            fetched.found = flight.result.found;
+            fetched.clave.assign(flight.result.clave);
+            return flight.outcome;
+        }
+        // The query gave up at its runner's deadline, or its connection
+        // failed; neither settles the account for a thread with time left.
+        now = Clock::now();
+        if (now >= deadline) {
+            return LoginOutcome::TimedOut;
+        }
+        counters.retried++;
+        generation = flight.generation;
+    }
+    if (flight.active && flight.email == email) {
+        // The query has been at it long enough to be deep in its busy
+        // backoff. A fresh one retries sooner; whichever ends first answers
+        // the waiters, and everyone after this keeps joining.
+        counters.hedged++;
+        flight.hedged = true;
+        lock.unlock();
+        LoginOutcome outcome = query();
+        finish(flight, generation, outcome, fetched);
+        return outcome;
+    }
+
+    // A finished query is kept until its readers have copied it.
+    bool lead = !flight.active && flight.readers == 0;
+    if (lead) {
+        counters.leaders++;
+        flight.active = true;
+        flight.hedged = false;
+        flight.started = now;
+        flight.email.assign(email.data(), email.size());
+    } else {
+        counters.bypassed++;
+    }
+    lock.unlock();
+
+    LoginOutcome outcome = query();
+    if (lead) {
+        finish(flight, generation, outcome, fetched);
+    }
+    return outcome;
+}
+
+void LookupCoalescer::finish(Flight& flight, uint64_t generation, LoginOutcome outcome,
+                             const FetchedCredential& fetched) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (flight.generation != generation) {
+        // The other query of a hedged flight answered first.
+        return;
+    }
+    bool waited = flight.readers > 0;
+    if (waited) {
+        flight.outcome = outcome;
+        flight.result.found = fetched.found;
+        flight.result.clave.assign(fetched.clave);
+    }
+    flight.active = false;
+    flight.generation++;
+    lock.unlock();
+    if (waited) {
+        flight.done.notify_all();
+    }
+}
+
+CoalescerStats LookupCoalescer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+bool CoalescedStorageStage::decide(LoginContext& context) {
+    const LoginRequest& request = context.request;
+    Database& target = sharded ? sharded->shardFor(request.email) : *db;
+    bool bounded = request.deadline != Clock::time_point();
+    context.outcome = coalescer.fetch(request.email, target, fetched,
+                                      bounded ? request.deadline : Clock::time_point::max());
+    if (context.outcome == LoginOutcome::Success) {
+        context.outcome = bounded
+            ? target.authenticateFetched(request.email, request.password, fetched, request.deadline)
+            : target.authenticateFetched(request.email, request.password, fetched);
+    }
+    context.storageConsulted = true;
+    return true;
+}
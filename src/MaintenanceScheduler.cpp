@@ -0,0 +1,240 @@
+#include "MaintenanceScheduler.h"
+#include "ActivityMonitor.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    const int kProgressOps = 100;
+    const int kMaxVacuumPages = 4096;
+}
+
+MaintenanceScheduler::MaintenanceScheduler(const std::string& dbPath, ActivityMonitor& activity,
+                                           const MaintenanceOptions& options)
+    : dbPath(dbPath),
+      activity(activity),
+      options(options),
+      db(nullptr),
+      stopRequested(false),
+      stepDeadline(Clock::time_point::max()),
+      optimizeDone(false),
+      vacuumPages(std::max(1, options.vacuumPagesPerStep)),
+      walBackfilled(false),
+      interrupted(false),
+      counters() {}
+
+MaintenanceScheduler::~MaintenanceScheduler() {
+    stop();
+    if (db) {
+        sqlite3_close(db);
+    }
+}
+
+bool MaintenanceScheduler::open() {
+    if (db) {
+        return true;
+    }
+    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "Error opening database for maintenance: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    // No busy handler: if a login holds a lock, the step is skipped, never waited on.
+    sqlite3_busy_timeout(db, 0);
+    sqlite3_progress_handler(db, kProgressOps, &MaintenanceScheduler::progressCallback, this);
+    return true;
+}
+
+bool MaintenanceScheduler::start() {
+    if (worker.joinable()) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!open()) {
+            return false;
+        }
+        stopRequested = false;
+    }
+    worker = std::thread(&MaintenanceScheduler::loop, this);
+    return true;
+}
+
+void MaintenanceScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void MaintenanceScheduler::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        wake.wait_for(lock, std::chrono::milliseconds(options.pollIntervalMs));
+        if (stopRequested) {
+            break;
+        }
+        lock.unlock();
+        runStep();
+        lock.lock();
+    }
+}
+
+MaintenanceReport MaintenanceScheduler::report() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+bool MaintenanceScheduler::runStep() {
+    if (!activity.isIdle(std::chrono::milliseconds(options.idleThresholdMs))) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!open()) {
+        return false;
+    }
+
+    Clock::time_point started = Clock::now();
+    stepDeadline = started + std::chrono::milliseconds(options.stepBudgetMs);
+    interrupted = false;
+
+    bool optimizeDue = !optimizeDone ||
+        started - lastOptimize >= std::chrono::milliseconds(options.optimizeIntervalMs);
+    bool worked = false;
+    if (optimizeDue) {
+        worked = runOptimize();
+    }
+    if (!worked) {
+        worked = runVacuum();
+    }
+    if (!worked) {
+        worked = runCheckpoint();
+    }
+    stepDeadline = Clock::time_point::max();
+
+    if (worked || interrupted) {
+        double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+        counters.steps++;
+        counters.maxStepMs = std::max(counters.maxStepMs, elapsedMs);
+        if (interrupted) {
+            counters.interruptedSteps++;
+        }
+    }
+    return worked;
+}
+
+bool MaintenanceScheduler::runOptimize() {
+    int rc = sqlite3_exec(db, "PRAGMA optimize;", nullptr, nullptr, nullptr);
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+    optimizeDone = true;
+    lastOptimize = Clock::now();
+    counters.optimizeRuns++;
+    return true;
+}
+
+bool MaintenanceScheduler::runVacuum() {
+    if (pragmaInt("PRAGMA auto_vacuum;") != 2) {
+        return false;
+    }
+    int64_t freeBefore = pragmaInt("PRAGMA freelist_count;");
+    if (freeBefore <= 0) {
+        return false;
+    }
+
+    Clock::time_point started = Clock::now();
+    std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(vacuumPages) + ");";
+    // incremental_vacuum returns one row per freed page; drain them all.
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    if (rc == SQLITE_OK) {
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        }
+    }
+    sqlite3_finalize(stmt);
+    double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+
+    // Fit the batch to the budget: grow while well under it, halve on overrun.
+    if (rc != SQLITE_DONE || elapsedMs > options.stepBudgetMs) {
+        vacuumPages = std::max(1, vacuumPages / 2);
+    } else if (elapsedMs < options.stepBudgetMs / 2.0) {
+        vacuumPages = std::min(kMaxVacuumPages, vacuumPages * 2);
+    }
+    if (rc != SQLITE_DONE) {
+        return false;
+    }
+
+    int64_t freeAfter = pragmaInt("PRAGMA freelist_count;");
+    int64_t pageSize = pragmaInt("PRAGMA page_size;");
+    if (freeAfter >= 0 && freeAfter < freeBefore) {
+        counters.pagesReclaimed += static_cast<uint64_t>(freeBefore - freeAfter);
+        counters.bytesReclaimed += static_cast<uint64_t>((freeBefore - freeAfter) * std::max<int64_t>(pageSize, 0));
+    }
+    counters.vacuumSteps++;
+    return true;
+}
+
+bool MaintenanceScheduler::runCheckpoint() {
+    int64_t wal = walBytes();
+    if (wal <= 0) {
+        return false;
+    }
+    // Once everything has been copied back, truncate the WAL so an idle
+    // store does not keep a large -wal file around.
+    bool truncate = wal > options.walTruncateBytes || walBackfilled;
+    int mode = truncate ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE;
+    int logFrames = 0;
+    int checkpointed = 0;
+    int rc = sqlite3_wal_checkpoint_v2(db, nullptr, mode, &logFrames, &checkpointed);
+    if (rc == SQLITE_BUSY && truncate) {
+        // A reader is still on the WAL; copy what we can without waiting.
+        mode = SQLITE_CHECKPOINT_PASSIVE;
+        rc = sqlite3_wal_checkpoint_v2(db, nullptr, mode, &logFrames, &checkpointed);
+    }
+    if (rc != SQLITE_OK || logFrames < 0) {
+        return false;
+    }
+
+    walBackfilled = checkpointed == logFrames;
+    counters.checkpoints++;
+    if (mode == SQLITE_CHECKPOINT_TRUNCATE) {
+        counters.truncatingCheckpoints++;
+    }
+    counters.framesCheckpointed += static_cast<uint64_t>(std::max(checkpointed, 0));
+    return true;
+}
+
+int64_t MaintenanceScheduler::pragmaInt(const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    int64_t value = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+int64_t MaintenanceScheduler::walBytes() const {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(dbPath + "-wal", ec);
+    return ec ? 0 : static_cast<int64_t>(size);
+}
+
+int MaintenanceScheduler::progressCallback(void* self) {
+    MaintenanceScheduler* scheduler = static_cast<MaintenanceScheduler*>(self);
+    if (scheduler->stepDeadline == Clock::time_point::max()) {
+        return 0;
+    }
+    if (scheduler->activity.inFlight() > 0 || Clock::now() >= scheduler->stepDeadline) {
+        scheduler->interrupted = true;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,339 @@
+#include "PasswordHasher.h"
+#include "Arena.h"
+#include "Sha256.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <tuple>
+
+namespace {
+    const char kPrefix[] = "$scrypt$";
+    const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    // Timings per calibration step; the median is kept.
+    constexpr int kCalibrationRuns = 5;
+
+    inline uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void salsa208(uint32_t block[16]) {
+        uint32_t x[16];
+        std::memcpy(x, block, sizeof(x));
+        for (int round = 0; round < 8; round += 2) {
+            x[4] ^= rotl(x[0] + x[12], 7);   x[8] ^= rotl(x[4] + x[0], 9);
+            x[12] ^= rotl(x[8] + x[4], 13);  x[0] ^= rotl(x[12] + x[8], 18);
+            x[9] ^= rotl(x[5] + x[1], 7);    x[13] ^= rotl(x[9] + x[5], 9);
+            x[1] ^= rotl(x[13] + x[9], 13);  x[5] ^= rotl(x[1] + x[13], 18);
+            x[14] ^= rotl(x[10] + x[6], 7);  x[2] ^= rotl(x[14] + x[10], 9);
+            x[6] ^= rotl(x[2] + x[14], 13);  x[10] ^= rotl(x[6] + x[2], 18);
+            x[3] ^= rotl(x[15] + x[11], 7);  x[7] ^= rotl(x[3] + x[15], 9);
+            x[11] ^= rotl(x[7] + x[3], 13);  x[15] ^= rotl(x[11] + x[7], 18);
+            x[1] ^= rotl(x[0] + x[3], 7);    x[2] ^= rotl(x[1] + x[0], 9);
+            x[3] ^= rotl(x[2] + x[1], 13);   x[0] ^= rotl(x[3] + x[2], 18);
+            x[6] ^= rotl(x[5] + x[4], 7);    x[7] ^= rotl(x[6] + x[5], 9);
+            x[4] ^= rotl(x[7] + x[6], 13);   x[5] ^= rotl(x[4] + x[7], 18);
+            x[11] ^= rotl(x[10] + x[9], 7);  x[8] ^= rotl(x[11] + x[10], 9);
+            x[9] ^= rotl(x[8] + x[11], 13);  x[10] ^= rotl(x[9] + x[8], 18);
+            x[12] ^= rotl(x[15] + x[14], 7); x[13] ^= rotl(x[12] + x[15], 9);
+            x[14] ^= rotl(x[13] + x[12], 13); x[15] ^= rotl(x[14] + x[13], 18);
+        }
+        for (int i = 0; i < 16; i++) {
+            block[i] += x[i];
+        }
+    }
+
+    // scryptBlockMix: `in` and `out` hold 2r 64-byte blocks as words.
+    void blockMix(const uint32_t* in, uint32_t* out, int r) {
+        uint32_t x[16];
+        std::memcpy(x, in + (2 * r - 1) * 16, sizeof(x));
+        for (int i = 0; i < 2 * r; i++) {
+            for (int k = 0; k < 16; k++) {
+                x[k] ^= in[i * 16 + k];
+            }
+            salsa208(x);
+            // Even blocks go to the first half of the output, odd to the second.
+            std::memcpy(out + ((i / 2) + (i % 2) * r) * 16, x, sizeof(x));
+        }
+    }
+
+    // `x` and `y` are 32r-word work areas, `v` holds n * 32r words.
+    void roMix(uint8_t* block, int r, uint64_t n, uint32_t* v, uint32_t* x, uint32_t* y) {
+        const size_t words = 32 * static_cast<size_t>(r);
+        for (size_t i = 0; i < words; i++) {
+            const uint8_t* p = block + 4 * i;
+            x[i] = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            std::memcpy(&v[i * words], x, words * 4);
+            blockMix(x, y, r);
+            std::swap(x, y);
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t j = x[(2 * r - 1) * 16] & (n - 1);
+            const uint32_t* vj = &v[j * words];
+            for (size_t k = 0; k < words; k++) {
+                x[k] ^= vj[k];
+            }
+            blockMix(x, y, r);
+            std::swap(x, y);
+        }
+        for (size_t i = 0; i < words; i++) {
+            uint8_t* p = block + 4 * i;
+            p[0] = static_cast<uint8_t>(x[i]);
+            p[1] = static_cast<uint8_t>(x[i] >> 8);
+            p[2] = static_cast<uint8_t>(x[i] >> 16);
+            p[3] = static_cast<uint8_t>(x[i] >> 24);
+        }
+    }
+
+    // scrypt's working memory (16 MiB at logN 14, r 8), kept per thread so
+    // that hashing on the pool's threads does not go back to the heap for
+    // every login.
+    Arena& scryptScratch() {
+        thread_local Arena scratch;
+        return scratch;
+    }
+
+    std::string encodeBase64(std::string_view data) {
+        std::string out;
+        uint32_t bits = 0;
+        int count = 0;
+        for (unsigned char c : data) {
+            bits = (bits << 8) | c;
+            count += 8;
+            while (count >= 6) {
+                count -= 6;
+                out.push_back(kBase64[(bits >> count) & 0x3f]);
+            }
+        }
+        if (count > 0) {
+            out.push_back(kBase64[(bits << (6 - count)) & 0x3f]);
+        }
+        return out;
+    }
+
+    // Decodes into `out` (room for `capacity` bytes); false on a character
+    // outside the alphabet or if the result does not fit.
+    bool decodeBase64(std::string_view text, uint8_t* out, size_t capacity, size_t& length) {
+        length = 0;
+        uint32_t bits = 0;
+        int count = 0;
+        for (char c : text) {
+            const char* at = std::strchr(kBase64, c);
+            if (c == '\0' || !at) {
+                return false;
+            }
+            bits = (bits << 6) | static_cast<uint32_t>(at - kBase64);
+            count += 6;
+            if (count >= 8) {
+                count -= 8;
+                if (length == capacity) {
+                    return false;
+                }
+                out[length++] = static_cast<uint8_t>((bits >> count) & 0xff);
+            }
+        }
+        return true;
+    }
+
+    // Reads a decimal "name=<value>" followed by `terminator` at `pos`.
+    bool parseParameter(std::string_view text, size_t& pos, std::string_view name, char terminator, int& value) {
+        if (text.compare(pos, name.size(), name) != 0) {
+            return false;
+        }
+        pos += name.size();
+        size_t digits = 0;
+        value = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9' && digits < 6) {
+            value = value * 10 + (text[pos] - '0');
+            pos++;
+            digits++;
+        }
+        if (digits == 0 || pos >= text.size() || text[pos] != terminator) {
+            return false;
+        }
+        pos++;
+        return true;
+    }
+
+    // Salt and key of a stored hash, decoded in place.
+    struct ParsedHash {
+        static constexpr size_t kMaxBytes = 64;
+        HashCost cost;
+        uint8_t salt[kMaxBytes];
+        size_t saltLength;
+        uint8_t key[kMaxBytes];
+        size_t keyLength;
+    };
+
+    bool parseStored(std::string_view stored, ParsedHash& parsed) {
+        const std::string_view prefix(kPrefix, sizeof(kPrefix) - 1);
+        if (stored.substr(0, prefix.size()) != prefix) {
+            return false;
+        }
+        size_t pos = prefix.size();
+        HashCost& cost = parsed.cost;
+        if (!parseParameter(stored, pos, "ln=", ',', cost.logN) || !parseParameter(stored, pos, "r=", ',', cost.r) ||
+            !parseParameter(stored, pos, "p=", '$', cost.p)) {
+            return false;
+        }
+        if (cost.logN < 1 || cost.logN > PasswordHasher::kMaxLogN || cost.r < 1 || cost.r > 64 || cost.p < 1 ||
+            cost.p > 16) {
+            return false;
+        }
+        std::string_view rest = stored.substr(pos);
+        size_t separator = rest.find('$');
+        if (separator == std::string_view::npos) {
+            return false;
+        }
+        return decodeBase64(rest.substr(0, separator), parsed.salt, sizeof(parsed.salt), parsed.saltLength) &&
+            decodeBase64(rest.substr(separator + 1), parsed.key, sizeof(parsed.key), parsed.keyLength) &&
+            parsed.keyLength > 0;
+    }
+
+    // Compares without an early exit so timing does not reveal how many
+    // leading bytes matched.
+    bool constantTimeEquals(std::string_view a, std::string_view b) {
+        unsigned char diff = a.size() == b.size() ? 0 : 1;
+        size_t length = std::min(a.size(), b.size());
+        for (size_t i = 0; i < length; i++) {
+            diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+        }
+        return diff == 0;
+    }
+}
+
+void scrypt(const void* password, size_t passwordLength, const void* salt, size_t saltLength,
+            const HashCost& cost, uint8_t* out, size_t outLength) {
+    const size_t blockBytes = 128 * static_cast<size_t>(cost.r);
+    const size_t words = 32 * static_cast<size_t>(cost.r);
+    const uint64_t n = 1ull << cost.logN;
+    Arena& scratch = scryptScratch();
+    scratch.reset();
+    uint8_t* b = scratch.allocateArray<uint8_t>(blockBytes * cost.p);
+    uint32_t* v = scratch.allocateArray<uint32_t>(static_cast<size_t>(n) * words);
+    uint32_t* x = scratch.allocateArray<uint32_t>(words);
+    uint32_t* y = scratch.allocateArray<uint32_t>(words);
+    pbkdf2HmacSha256(password, passwordLength, salt, saltLength, 1, b, blockBytes * cost.p);
+
+    for (int i = 0; i < cost.p; i++) {
+        roMix(b + i * blockBytes, cost.r, n, v, x, y);
+    }
+    pbkdf2HmacSha256(password, passwordLength, b, blockBytes * cost.p, 1, out, outLength);
+}
+
+PasswordHasher::PasswordHasher(const HashCost& cost) : hashCost(cost) {}
+
+std::string PasswordHasher::hash(std::string_view password) const {
+    std::random_device entropy;
+    std::string salt(kSaltSize, '\0');
+    for (size_t i = 0; i < kSaltSize; i += 4) {
+        uint32_t word = entropy();
+        std::memcpy(&salt[i], &word, std::min<size_t>(4, kSaltSize - i));
+    }
+    return hash(password, salt);
+}
+
+std::string PasswordHasher::hash(std::string_view password, std::string_view salt) const {
+    uint8_t key[kKeySize];
+    scrypt(password.data(), password.size(), salt.data(), salt.size(), hashCost, key, sizeof(key));
+
+    char params[64];
+    std::snprintf(params, sizeof(params), "ln=%d,r=%d,p=%d$", hashCost.logN, hashCost.r, hashCost.p);
+    return std::string(kPrefix) + params + encodeBase64(salt) + "$" +
+        encodeBase64(std::string_view(reinterpret_cast<const char*>(key), sizeof(key)));
+}
+
+PasswordCheck PasswordHasher::verify(std::string_view password, std::string_view stored) const {
+    // Runs on every login: parses in place and hashes in the thread's
+    // scratch arena, so nothing here allocates.
+    PasswordCheck check;
+    check.malformed = false;
+    ParsedHash parsed;
+    if (!parseStored(stored, parsed)) {
+        if (stored.substr(0, sizeof(kPrefix) - 1) == std::string_view(kPrefix, sizeof(kPrefix) - 1)) {
+            check.match = false;
+            check.needsRehash = false;
+            check.malformed = true;
+            return check;
+        }
+        // Plaintext from before hashing was introduced.
+        check.match = constantTimeEquals(password, stored);
+        check.needsRehash = true;
+        return check;
+    }
+
+    uint8_t computed[ParsedHash::kMaxBytes];
+    scrypt(password.data(), password.size(), parsed.salt, parsed.saltLength, parsed.cost, computed,
+           parsed.keyLength);
+    check.match = constantTimeEquals(std::string_view(reinterpret_cast<const char*>(computed), parsed.keyLength),
+                                     std::string_view(reinterpret_cast<const char*>(parsed.key), parsed.keyLength));
+    check.needsRehash = parsed.cost.weakerThan(hashCost);
+    return check;
+}
+
+std::string PasswordHasher::dummy() const {
+    // The key is never produced by scrypt; only the cost and salt size matter.
+    const std::string salt(kSaltSize, 'd');
+    const std::string key(kKeySize, '\0');
+    char params[64];
+    std::snprintf(params, sizeof(params), "ln=%d,r=%d,p=%d$", hashCost.logN, hashCost.r, hashCost.p);
+    return std::string(kPrefix) + params + encodeBase64(salt) + "$" + encodeBase64(key);
+}
+
+bool PasswordHasher::parse(const std::string& stored, HashCost& cost, std::string& salt, std::string& key) {
+    ParsedHash parsed;
+    if (!parseStored(stored, parsed)) {
+        return false;
+    }
+    cost = parsed.cost;
+    salt.assign(reinterpret_cast<const char*>(parsed.salt), parsed.saltLength);
+    key.assign(reinterpret_cast<const char*>(parsed.key), parsed.keyLength);
+    return true;
+}
+
+HashCost PasswordHasher::calibrate(double targetMs, int r, int p) {
+    HashCost cost;
+    cost.logN = kMinCalibratedLogN;
+    cost.r = r;
+    cost.p = p;
+    const std::string salt(kSaltSize, 's');
+    while (cost.logN < kMaxLogN) {
+        // One slow or fast run (a page fault, a preempted thread) must not
+        // decide the cost every login in this process pays.
+        double samples[kCalibrationRuns];
+        for (double& sample : samples) {
+            auto started = std::chrono::steady_clock::now();
+            PasswordHasher(cost).hash("calibracion", salt);
+            sample = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        }
+        std::nth_element(samples, samples + kCalibrationRuns / 2, samples + kCalibrationRuns);
+        double elapsedMs = samples[kCalibrationRuns / 2];
+        // Each step doubles the work; stop before the next one overshoots.
+        if (elapsedMs * 2 > targetMs) {
+            break;
+        }
+        cost.logN++;
+    }
+    return cost;
+}
+
+HashCost PasswordHasher::calibrated(double targetMs, int r, int p) {
+    static std::mutex mutex;
+    static std::map<std::tuple<double, int, int>, HashCost> measured;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto key = std::make_tuple(targetMs, r, p);
+    auto found = measured.find(key);
+    if (found == measured.end()) {
+        found = measured.emplace(key, calibrate(targetMs, r, p)).first;
+    }
+    return found->second;
+}
+
+HashCost PasswordHasher::resolve(const HashCost& cost, double targetMs) {
+    return cost.logN > 0 ? cost : calibrated(targetMs, cost.r, cost.p);
+}
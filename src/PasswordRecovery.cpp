@@ -0,0 +1,324 @@
+#include "PasswordRecovery.h"
+#include "LoginTrace.h"
+#include "Sha256.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    const size_t kTokenBytes = 32;
+    // Windows are pruned once this many accounts are being tracked.
+    const size_t kMaxTrackedAccounts = 1 << 16;
+
+    bool syncFile(FILE* file) {
+        if (std::fflush(file) != 0) {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    int64_t unixNow() {
+        return static_cast<int64_t>(std::time(nullptr));
+    }
+}
+
+// ============================================
+// Transports
+// ============================================
+
+SpoolTransport::SpoolTransport(const std::string& directory) : directory(directory), nextBatch(0) {}
+
+bool SpoolTransport::deliver(const std::vector<OutboundMessage>& batch) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        std::cerr << "Error creando directorio de salida: " << ec.message() << std::endl;
+        return false;
+    }
+    char name[64];
+    std::snprintf(name, sizeof(name), "spool-%lld-%06llu.txt",
+                  static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch()).count()),
+                  static_cast<unsigned long long>(nextBatch++));
+    std::filesystem::path path = std::filesystem::path(directory) / name;
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+
+    FILE* file = std::fopen(temporary.string().c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error abriendo fichero de salida: " << temporary.string() << std::endl;
+        return false;
+    }
+    bool ok = true;
+    for (const OutboundMessage& message : batch) {
+        ok = ok && std::fprintf(file, "To: %s\nSubject: %s\nContent-Length: %zu\n\n", message.to.c_str(),
+                                message.subject.c_str(), message.body.size()) > 0;
+        ok = ok && std::fwrite(message.body.data(), 1, message.body.size(), file) == message.body.size();
+    }
+    ok = syncFile(file) && ok;
+    ok = std::fclose(file) == 0 && ok;
+    if (ok) {
+        std::filesystem::rename(temporary, path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::filesystem::remove(temporary, ec);
+        std::cerr << "Error escribiendo fichero de salida: " << path.string() << std::endl;
+    }
+    return ok;
+}
+
+bool MemoryTransport::deliver(const std::vector<OutboundMessage>& batch) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (failing) {
+        return false;
+    }
+    delivered.insert(delivered.end(), batch.begin(), batch.end());
+    batches++;
+    return true;
+}
+
+void MemoryTransport::setFailing(bool value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    failing = value;
+}
+
+std::vector<OutboundMessage> MemoryTransport::messages() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return delivered;
+}
+
+size_t MemoryTransport::batchCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return batches;
+}
+
+// ============================================
+// PasswordRecovery
+// ============================================
+
+PasswordRecovery::PasswordRecovery(const std::string& dbPath, MessageTransport& transport,
+                                   const RecoveryOptions& options, const DatabaseOptions& databaseOptions)
+    : dbPath(dbPath),
+      transport(transport),
+      options(options),
+      databaseOptions(databaseOptions),
+      ring(options.queueCapacity),
+      running(false),
+      stopRequested(false),
+      requested(0),
+      dropped(0),
+      handled(0),
+      rateLimited(0),
+      unknownAccounts(0),
+      issued(0),
+      delivered(0),
+      deliveryFailures(0),
+      storageErrors(0),
+      batches(0) {}
+
+PasswordRecovery::~PasswordRecovery() {
+    stop();
+}
+
+bool PasswordRecovery::start() {
+    if (running.load()) {
+        return true;
+    }
+    db = std::make_unique<Database>(dbPath, databaseOptions);
+    if (!db->initialize()) {
+        std::cerr << "Error abriendo la base para recuperacion de clave" << std::endl;
+        db.reset();
+        return false;
+    }
+    stopRequested.store(false);
+    running.store(true);
+    sender = std::thread(&PasswordRecovery::senderLoop, this);
+    return true;
+}
+
+void PasswordRecovery::stop() {
+    if (!running.load()) {
+        return;
+    }
+    stopRequested.store(true);
+    sender.join();
+    running.store(false);
+    db.reset();
+    flushed.notify_all();
+}
+
+bool PasswordRecovery::request(std::string_view email) {
+    Request entry;
+    if (email.empty() || email.size() > kMaxEmailLength || !running.load()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    entry.length = static_cast<uint8_t>(email.size());
+    std::memcpy(entry.email, email.data(), email.size());
+    if (!ring.tryPush(entry)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    requested.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void PasswordRecovery::flush() {
+    uint64_t target = requested.load();
+    std::unique_lock<std::mutex> lock(flushMutex);
+    flushed.wait(lock, [&]() {
+        return handled.load() >= target || !running.load();
+    });
+}
+
+RecoveryStats PasswordRecovery::stats() const {
+    RecoveryStats result;
+    result.requested = requested.load();
+    result.dropped = dropped.load();
+    result.rateLimited = rateLimited.load();
+    result.unknownAccounts = unknownAccounts.load();
+    result.issued = issued.load();
+    result.delivered = delivered.load();
+    result.deliveryFailures = deliveryFailures.load();
+    result.storageErrors = storageErrors.load();
+    result.batches = batches.load();
+    return result;
+}
+
+void PasswordRecovery::senderLoop() {
+    std::vector<std::string> emails;
+    emails.reserve(options.maxBatch);
+    int64_t lastPurge = unixNow();
+
+    while (true) {
+        emails.clear();
+        Request entry;
+        while (emails.size() < options.maxBatch && ring.tryPop(entry)) {
+            emails.emplace_back(entry.email, entry.length);
+        }
+
+        if (!emails.empty()) {
+            size_t count = emails.size();
+            issue(emails, unixNow());
+            deliverOutbox();
+            {
+                std::lock_guard<std::mutex> lock(flushMutex);
+                handled.fetch_add(count);
+            }
+            flushed.notify_all();
+        } else if (stopRequested.load()) {
+            break;
+        } else {
+            int64_t now = unixNow();
+            if (now - lastPurge >= options.purgeIntervalSeconds) {
+                db->purgeResetTokens();
+                lastPurge = now;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.idleWaitMs));
+        }
+    }
+}
+
+bool PasswordRecovery::allow(const std::string& email, int64_t now) {
+    if (windows.size() >= kMaxTrackedAccounts) {
+        for (auto it = windows.begin(); it != windows.end();) {
+            it = now - it->second.start >= options.windowSeconds ? windows.erase(it) : std::next(it);
+        }
+    }
+    Window& window = windows[hashAccountKey(email)];
+    if (window.count == 0 || now - window.start >= options.windowSeconds) {
+        window = Window{now, 0};
+    }
+    if (window.count >= options.maxPerAccount) {
+        return false;
+    }
+    window.count++;
+    return true;
+}
+
+void PasswordRecovery::issue(std::vector<std::string>& emails, int64_t now) {
+    std::vector<ResetToken> tokens;
+    std::vector<std::string> plainTokens;
+    tokens.reserve(emails.size());
+    plainTokens.reserve(emails.size());
+    for (std::string& email : emails) {
+        if (!allow(email, now)) {
+            rateLimited.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        plainTokens.push_back(newToken());
+        tokens.push_back(ResetToken{std::move(email), Database::hashResetToken(plainTokens.back()),
+                                    now + options.tokenTtlSeconds});
+    }
+    if (tokens.empty()) {
+        return;
+    }
+
+    std::vector<bool> stored;
+    if (!db->storeResetTokens(tokens, stored)) {
+        storageErrors.fetch_add(tokens.size(), std::memory_order_relaxed);
+        return;
+    }
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (!stored[i]) {
+            unknownAccounts.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        issued.fetch_add(1, std::memory_order_relaxed);
+        OutboundMessage message;
+        message.to = tokens[i].email;
+        message.subject = options.subject;
+        message.body = "Hola,\n\nPara elegir una clave nueva abre este enlace en los proximos " +
+            std::to_string(options.tokenTtlSeconds / 60) + " minutos:\n\n" + options.resetUrl +
+            plainTokens[i] + "\n\nSi no lo has pedido, ignora este mensaje.\n";
+        outbox.push_back(std::move(message));
+    }
+}
+
+void PasswordRecovery::deliverOutbox() {
+    if (outbox.empty()) {
+        return;
+    }
+    int backoffMs = options.retryBackoffMs;
+    for (int attempt = 1; attempt <= options.maxDeliveryAttempts; attempt++) {
+        if (transport.deliver(outbox)) {
+            delivered.fetch_add(outbox.size(), std::memory_order_relaxed);
+            batches.fetch_add(1, std::memory_order_relaxed);
+            outbox.clear();
+            return;
+        }
+        if (attempt < options.maxDeliveryAttempts) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs));
+            backoffMs *= 2;
+        }
+    }
+    std::cerr << "Error entregando " << outbox.size() << " mensajes de recuperacion" << std::endl;
+    deliveryFailures.fetch_add(outbox.size(), std::memory_order_relaxed);
+    outbox.clear();
+}
+
+std::string PasswordRecovery::newToken() {
+    std::random_device entropy;
+    uint8_t bytes[kTokenBytes];
+    for (size_t i = 0; i < kTokenBytes; i += 4) {
+        uint32_t word = entropy();
+        std::memcpy(bytes + i, &word, 4);
+    }
+    return toHex(bytes, sizeof(bytes));
+}
@@ -1,35 +1,89 @@
 #include "PasswordValidator.h"
+#include <algorithm>
 #include <cctype>
 
-bool PasswordValidator::validate(const std::string& password) {
+bool PasswordValidator::validate(std::string_view password) {
     return hasMinLength(password) && 
            hasMaxLength(password) && 
            hasUpperCase(password) && 
            hasSpecialChar(password);
 }
 
-bool PasswordValidator::hasMinLength(const std::string& password) {
-    return password.length() >= 5;
+bool PasswordValidator::hasMinLength(std::string_view password) {
+    return password.length() >= kMinLength;
 }
 
-bool PasswordValidator::hasMaxLength(const std::string& password) {
-    return password.length() <= 10;
+bool PasswordValidator::hasMaxLength(std::string_view password) {
+    return password.length() <= kMaxLength;
 }
 
-bool PasswordValidator::hasUpperCase(const std::string& password) {
+bool PasswordValidator::hasUpperCase(std::string_view password) {
     for (char c : password) {
-        if (std::isupper(c)) {
+        if (isUpperCase(c)) {
             return true;
         }
     }
     return false;
 }
 
-bool PasswordValidator::hasSpecialChar(const std::string& password) {
+bool PasswordValidator::hasSpecialChar(std::string_view password) {
     for (char c : password) {
-        if (!std::isalnum(c)) {
+        if (isSpecialChar(c)) {
             return true;
         }
     }
     return false;
 }
+
+bool PasswordValidator::isUpperCase(char c) {
+    return std::isupper(static_cast<unsigned char>(c)) != 0;
+}
+
+bool PasswordValidator::isSpecialChar(char c) {
+    return !std::isalnum(static_cast<unsigned char>(c));
+}
+
+void PasswordPolicyState::push(char c) {
+    characters++;
+    if (PasswordValidator::isUpperCase(c)) {
+        upper++;
+    } else if (PasswordValidator::isSpecialChar(c)) {
+        special++;
+    } else if (std::isdigit(static_cast<unsigned char>(c))) {
+        digits++;
+    } else {
+        lower++;
+    }
+}
+
+void PasswordPolicyState::pop(char removed) {
+    if (characters == 0) {
+        return;
+    }
+    characters--;
+    if (PasswordValidator::isUpperCase(removed)) {
+        upper--;
+    } else if (PasswordValidator::isSpecialChar(removed)) {
+        special--;
+    } else if (std::isdigit(static_cast<unsigned char>(removed))) {
+        digits--;
+    } else {
+        lower--;
+    }
+}
+
+void PasswordPolicyState::clear() {
+    *this = PasswordPolicyState();
+}
+
+int PasswordPolicyState::strength() const {
+    if (characters == 0) {
+        return 0;
+    }
+    int kinds = (lower > 0) + (upper > 0) + (digits > 0) + (special > 0);
+    int score = kinds + (characters >= 8 ? 1 : 0) - 1;
+    if (!hasMinLength()) {
+        score = std::min(score, 1);
+    }
+    return std::clamp(score, 1, 4);
+}
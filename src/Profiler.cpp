@@ -0,0 +1,391 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // The signal handlers only see this state. The SIGPROF handler stays
+    // installed after stop(), doing nothing, so a signal still in flight
+    // cannot terminate the process.
+    std::atomic<CpuProfiler*> activeProfiler(nullptr);
+    std::atomic<MpscRingBuffer<ProfileSample>*> activeRing(nullptr);
+    std::atomic<int> handlersRunning(0);
+    std::atomic<uint64_t> samplesTaken(0);
+    std::atomic<uint64_t> samplesDropped(0);
+    std::atomic<uint64_t> captureNanos(0);
+    std::atomic<bool> dumpRequested(false);
+
+#ifndef _WIN32
+    struct sigaction previousDump;
+
+    uint64_t monotonicNs() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+    }
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+    // A frame pointer more than this above the stack pointer, or a caller's
+    // frame more than this above its callee's, ends the walk: past it is
+    // most likely a register that never held a frame pointer.
+    const uintptr_t kMaxFrameSpan = 1 << 20;
+
+    // The stack of a thread that called CpuProfiler::registerThread(); high
+    // is 0 until then. initial-exec, so the handler's access never allocates.
+    struct StackBounds {
+        uintptr_t low;
+        uintptr_t high;
+    };
+    thread_local StackBounds threadStack __attribute__((tls_model("initial-exec"))) = {0, 0};
+
+    // For threads whose stack is unknown, and where process_vm_readv is not
+    // allowed: write() copies from an unmapped address with EFAULT instead
+    // of faulting. One handler at a time uses it; the others end their walk.
+    int probePipe[2] = {-1, -1};
+    std::atomic_flag probeBusy = ATOMIC_FLAG_INIT;
+    std::atomic<bool> vmReadDenied(false);
+
+    // Copies the two words of the frame at `fp` (caller's frame pointer and
+    // return address) into `frame`. False when they are not on this
+    // thread's stack or not mapped: `fp` may be whatever a function built
+    // without frame pointers left in the register.
+    bool readFrame(uintptr_t fp, uintptr_t* frame) {
+        const size_t size = 2 * sizeof(uintptr_t);
+        StackBounds stack = threadStack;
+        if (stack.high != 0) {
+            if (fp < stack.low || fp > stack.high - size) {
+                return false;
+            }
+            const uintptr_t* words = reinterpret_cast<const uintptr_t*>(fp);
+            frame[0] = words[0];
+            frame[1] = words[1];
+            return true;
+        }
+        if (!vmReadDenied.load(std::memory_order_relaxed)) {
+            struct iovec local = {frame, size};
+            struct iovec remote = {reinterpret_cast<void*>(fp), size};
+            ssize_t copied = process_vm_readv(getpid(), &local, 1, &remote, 1, 0);
+            if (copied >= 0 || errno == EFAULT) {
+                return copied == static_cast<ssize_t>(size);
+            }
+            vmReadDenied.store(true, std::memory_order_relaxed);
+        }
+        if (probePipe[0] < 0 || probeBusy.test_and_set(std::memory_order_acquire)) {
+            return false;
+        }
+        bool ok = write(probePipe[1], reinterpret_cast<const void*>(fp), size) == static_cast<ssize_t>(size) &&
+            read(probePipe[0], frame, size) == static_cast<ssize_t>(size);
+        if (!ok) {
+            // A partial write leaves bytes behind for the next probe.
+            char discard[2 * sizeof(uintptr_t)];
+            while (read(probePipe[0], discard, sizeof(discard)) > 0) {
+            }
+        }
+        probeBusy.clear(std::memory_order_release);
+        return ok;
+    }
+
+    // Follows the interrupted thread's frame pointer chain, starting from the
+    // registers the kernel saved: each frame holds the caller's frame pointer
+    // and, right above it, the return address. No unwind tables, and on
+    // registered threads no calls, so a sample costs a few hundred
+    // nanoseconds; elsewhere each frame costs a system call.
+    int walkFrames(void* context, uintptr_t* pcs, int maxDepth) {
+        const mcontext_t& registers = static_cast<ucontext_t*>(context)->uc_mcontext;
+#if defined(__x86_64__)
+        uintptr_t pc = static_cast<uintptr_t>(registers.gregs[REG_RIP]);
+        uintptr_t sp = static_cast<uintptr_t>(registers.gregs[REG_RSP]);
+        uintptr_t fp = static_cast<uintptr_t>(registers.gregs[REG_RBP]);
+#else
+        uintptr_t pc = static_cast<uintptr_t>(registers.pc);
+        uintptr_t sp = static_cast<uintptr_t>(registers.sp);
+        uintptr_t fp = static_cast<uintptr_t>(registers.regs[29]);
+#endif
+        int depth = 0;
+        if (pc == 0) {
+            return depth;
+        }
+        pcs[depth++] = pc;
+        if (fp < sp || fp - sp > kMaxFrameSpan) {
+            return depth;
+        }
+        uintptr_t frame[2];
+        while (depth < maxDepth && fp % sizeof(uintptr_t) == 0 && readFrame(fp, frame)) {
+            uintptr_t caller = frame[0];
+            uintptr_t returnAddress = frame[1];
+            if (returnAddress == 0) {
+                break;
+            }
+            pcs[depth++] = returnAddress;
+            // The outermost frame saved 0; stacks grow down, so callers sit
+            // higher up.
+            if (caller <= fp || caller - fp > kMaxFrameSpan) {
+                break;
+            }
+            fp = caller;
+        }
+        return depth;
+    }
+#else
+    // backtrace() from the handler sees the handler and the kernel's signal
+    // trampoline before the interrupted frame.
+    const int kHandlerFrames = 2;
+
+    int walkFrames(void*, uintptr_t* pcs, int maxDepth) {
+        void* frames[kProfileMaxDepth + kHandlerFrames];
+        int found = backtrace(frames, kProfileMaxDepth + kHandlerFrames);
+        int depth = 0;
+        for (int i = kHandlerFrames; i < found && depth < maxDepth; i++) {
+            pcs[depth++] = reinterpret_cast<uintptr_t>(frames[i]);
+        }
+        return depth;
+    }
+#endif
+
+    void onProfSignal(int, siginfo_t*, void* context) {
+        int savedErrno = errno;
+        handlersRunning.fetch_add(1);
+        MpscRingBuffer<ProfileSample>* ring = activeRing.load();
+        if (ring) {
+            uint64_t started = monotonicNs();
+            ProfileSample sample;
+            sample.depth = static_cast<uint32_t>(walkFrames(context, sample.pcs, kProfileMaxDepth));
+            if (sample.depth > 0 && ring->tryPush(sample)) {
+                samplesTaken.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                samplesDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            captureNanos.fetch_add(monotonicNs() - started, std::memory_order_relaxed);
+        }
+        handlersRunning.fetch_sub(1);
+        errno = savedErrno;
+    }
+
+    void onDumpSignal(int) {
+        dumpRequested.store(true);
+    }
+#endif
+}
+
+CpuProfiler::CpuProfiler(const ProfilerOptions& options)
+    : options(options), ring(options.ringCapacity), running(false), stopRequested(false), samples(0),
+      dropped(0), captureNs(0), profilesWritten(0) {}
+
+CpuProfiler::~CpuProfiler() {
+    stop();
+}
+
+bool CpuProfiler::start() {
+#ifdef _WIN32
+    std::cerr << "CPU profiling is not available on Windows" << std::endl;
+    return false;
+#else
+    if (running) {
+        return true;
+    }
+    CpuProfiler* none = nullptr;
+    if (!activeProfiler.compare_exchange_strong(none, this)) {
+        std::cerr << "Another CPU profiler is already running" << std::endl;
+        return false;
+    }
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+    registerThread();
+    if (probePipe[0] < 0 && pipe2(probePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        probePipe[0] = probePipe[1] = -1;
+    }
+#else
+    // Loads the unwinder now, outside any signal handler.
+    void* warmUp[1];
+    backtrace(warmUp, 1);
+#endif
+
+    samplesTaken.store(0);
+    samplesDropped.store(0);
+    captureNanos.store(0);
+    dumpRequested.store(false);
+    activeRing.store(&ring);
+
+    struct sigaction action = {};
+    action.sa_sigaction = onProfSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    bool ok = sigaction(SIGPROF, &action, nullptr) == 0;
+    if (ok && options.dumpSignal != 0) {
+        struct sigaction dump = {};
+        dump.sa_handler = onDumpSignal;
+        dump.sa_flags = SA_RESTART;
+        sigemptyset(&dump.sa_mask);
+        ok = sigaction(options.dumpSignal, &dump, &previousDump) == 0;
+    }
+    int periodUs = 1000000 / std::max(1, options.frequencyHz);
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = periodUs / 1000000;
+    timer.it_interval.tv_usec = periodUs % 1000000;
+    timer.it_value = timer.it_interval;
+    ok = ok && setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+    if (!ok) {
+        std::cerr << "Error starting the CPU profiler timer" << std::endl;
+        activeRing.store(nullptr);
+        activeProfiler.store(nullptr);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = false;
+    }
+    running = true;
+    worker = std::thread(&CpuProfiler::loop, this);
+    return true;
+#endif
+}
+
+void CpuProfiler::stop() {
+#ifndef _WIN32
+    if (!running) {
+        return;
+    }
+    struct itimerval off = {};
+    setitimer(ITIMER_PROF, &off, nullptr);
+    activeRing.store(nullptr);
+    // A handler that already took the ring is still pushing into it.
+    while (handlersRunning.load() > 0) {
+        std::this_thread::yield();
+    }
+    if (options.dumpSignal != 0) {
+        sigaction(options.dumpSignal, &previousDump, nullptr);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        drain();
+        samples = samplesTaken.load();
+        dropped = samplesDropped.load();
+        captureNs = captureNanos.load();
+    }
+    running = false;
+    activeProfiler.store(nullptr);
+    if (!options.outputPath.empty()) {
+        writeProfile(options.outputPath);
+    }
+#endif
+}
+
+void CpuProfiler::registerThread() {
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+    if (threadStack.high != 0) {
+        return;
+    }
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+        return;
+    }
+    void* low = nullptr;
+    size_t size = 0;
+    if (pthread_attr_getstack(&attr, &low, &size) == 0) {
+        // high last: a sample in between still sees an unknown stack.
+        threadStack.low = reinterpret_cast<uintptr_t>(low);
+        std::atomic_signal_fence(std::memory_order_release);
+        threadStack.high = reinterpret_cast<uintptr_t>(low) + size;
+    }
+    pthread_attr_destroy(&attr);
+#endif
+}
+
+void CpuProfiler::drain() {
+    ProfileSample sample;
+    while (ring.tryPop(sample)) {
+        stacks[std::vector<uintptr_t>(sample.pcs, sample.pcs + sample.depth)]++;
+    }
+}
+
+void CpuProfiler::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        wake.wait_for(lock, std::chrono::milliseconds(options.drainIntervalMs),
+                      [this]() { return stopRequested; });
+        drain();
+        if (dumpRequested.exchange(false) && !options.outputPath.empty()) {
+            lock.unlock();
+            writeProfile(options.outputPath);
+            lock.lock();
+        }
+    }
+}
+
+bool CpuProfiler::writeProfile(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    drain();
+
+    uintptr_t periodUs = static_cast<uintptr_t>(1000000 / std::max(1, options.frequencyHz));
+    std::vector<uintptr_t> words = {0, 3, 0, periodUs, 0};
+    for (const auto& stack : stacks) {
+        words.push_back(static_cast<uintptr_t>(stack.second));
+        words.push_back(static_cast<uintptr_t>(stack.first.size()));
+        words.insert(words.end(), stack.first.begin(), stack.first.end());
+    }
+    words.insert(words.end(), {0, 1, 0});
+    std::string maps;
+    std::ifstream mapsFile("/proc/self/maps");
+    maps.assign(std::istreambuf_iterator<char>(mapsFile), std::istreambuf_iterator<char>());
+
+    // Renamed into place, so a reader never sees half a profile.
+    std::string tmpPath = path + ".tmp";
+    FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error writing CPU profile: " << tmpPath << std::endl;
+        return false;
+    }
+    bool ok = std::fwrite(words.data(), sizeof(uintptr_t), words.size(), file) == words.size() &&
+        std::fwrite(maps.data(), 1, maps.size(), file) == maps.size();
+    ok = std::fclose(file) == 0 && ok;
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(tmpPath, path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::cerr << "Error writing CPU profile: " << path << std::endl;
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    profilesWritten++;
+    return true;
+}
+
+ProfilerStats CpuProfiler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ProfilerStats result;
+    result.samples = running ? samplesTaken.load() : samples;
+    result.dropped = running ? samplesDropped.load() : dropped;
+    result.captureNs = running ? captureNanos.load() : captureNs;
+    result.stacks = stacks.size();
+    result.profilesWritten = profilesWritten;
+    return result;
+}
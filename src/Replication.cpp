@@ -0,0 +1,717 @@
+#include "Replication.h"
+#include "Checksum.h"
+#include "Database.h"
+#include "SharedCredentialCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    const char kMagic[4] = {'A', 'C', 'H', 'G'};
+    const uint32_t kVersion = 1;
+    // magic, version, changes, CRC-32 of the records.
+    const size_t kHeaderSize = 16;
+    // seq, logged at (ms), actualizado_en, deleted, usuario and clave lengths.
+    const size_t kRecordHeaderSize = 8 + 8 + 8 + 1 + 4 + 4;
+    const char* kNowMs = "CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER)";
+
+    struct Change {
+        uint64_t seq;
+        uint64_t loggedMs;
+        int64_t updatedAt;
+        bool deleted;
+        std::string usuario;
+        std::string clave;
+    };
+
+    struct Segment {
+        uint64_t first;
+        uint64_t last;
+        std::filesystem::path path;
+    };
+
+    void putU32(unsigned char* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    void putU64(unsigned char* out, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    uint32_t getU32(const unsigned char* in) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t getU64(const unsigned char* in) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t unixNowMs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    bool exec(sqlite3* db, const char* sql) {
+        char* error = nullptr;
+        if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+            std::cerr << "Replication error: " << (error ? error : "unknown") << std::endl;
+            sqlite3_free(error);
+            return false;
+        }
+        return true;
+    }
+
+    std::string columnText(sqlite3_stmt* stmt, int column) {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text ? std::string(text, sqlite3_column_bytes(stmt, column)) : std::string();
+    }
+
+    // Reads replicacion; false if there is no row.
+    bool readRole(sqlite3* db, std::string& role, uint64_t& position) {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT rol, posicion FROM replicacion;", -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+        bool found = sqlite3_step(stmt) == SQLITE_ROW;
+        if (found) {
+            role = columnText(stmt, 0);
+            position = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
+        }
+        sqlite3_finalize(stmt);
+        return found;
+    }
+
+    std::string segmentName(uint64_t first, uint64_t last) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%020llu-%020llu.log", static_cast<unsigned long long>(first),
+                      static_cast<unsigned long long>(last));
+        return name;
+    }
+
+    // Whole segments in `directory`, oldest first.
+    std::vector<Segment> listSegments(const std::string& directory) {
+        std::vector<Segment> segments;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            std::string name = entry.path().filename().string();
+            unsigned long long first = 0;
+            unsigned long long last = 0;
+            char tail[8] = {};
+            if (name.size() == 45 && std::sscanf(name.c_str(), "%20llu-%20llu%4s", &first, &last, tail) == 3 &&
+                std::strcmp(tail, ".log") == 0) {
+                segments.push_back(Segment{first, last, entry.path()});
+            }
+        }
+        std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) {
+            return a.first != b.first ? a.first < b.first : a.last < b.last;
+        });
+        return segments;
+    }
+
+    std::vector<unsigned char> encodeSegment(const std::vector<Change>& changes) {
+        size_t size = kHeaderSize;
+        for (const Change& change : changes) {
+            size += kRecordHeaderSize + change.usuario.size() + change.clave.size();
+        }
+        std::vector<unsigned char> bytes(size);
+        unsigned char* out = bytes.data() + kHeaderSize;
+        for (const Change& change : changes) {
+            putU64(out, change.seq);
+            putU64(out + 8, change.loggedMs);
+            putU64(out + 16, static_cast<uint64_t>(change.updatedAt));
+            out[24] = change.deleted ? 1 : 0;
+            putU32(out + 25, static_cast<uint32_t>(change.usuario.size()));
+            putU32(out + 29, static_cast<uint32_t>(change.clave.size()));
+            out += kRecordHeaderSize;
+            std::memcpy(out, change.usuario.data(), change.usuario.size());
+            out += change.usuario.size();
+            std::memcpy(out, change.clave.data(), change.clave.size());
+            out += change.clave.size();
+        }
+        std::memcpy(bytes.data(), kMagic, sizeof(kMagic));
+        putU32(bytes.data() + 4, kVersion);
+        putU32(bytes.data() + 8, static_cast<uint32_t>(changes.size()));
+        putU32(bytes.data() + 12, crc32(bytes.data() + kHeaderSize, bytes.size() - kHeaderSize));
+        return bytes;
+    }
+
+    bool decodeSegment(const std::filesystem::path& path, std::vector<Change>& changes) {
+        changes.clear();
+        FILE* file = std::fopen(path.string().c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        std::vector<unsigned char> bytes;
+        unsigned char chunk[64 * 1024];
+        size_t read;
+        while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            bytes.insert(bytes.end(), chunk, chunk + read);
+        }
+        std::fclose(file);
+        if (bytes.size() < kHeaderSize || std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) != 0 ||
+            getU32(bytes.data() + 4) != kVersion ||
+            crc32(bytes.data() + kHeaderSize, bytes.size() - kHeaderSize) != getU32(bytes.data() + 12)) {
+            return false;
+        }
+        uint32_t count = getU32(bytes.data() + 8);
+        const unsigned char* in = bytes.data() + kHeaderSize;
+        const unsigned char* end = bytes.data() + bytes.size();
+        for (uint32_t i = 0; i < count; i++) {
+            if (static_cast<size_t>(end - in) < kRecordHeaderSize) {
+                return false;
+            }
+            Change change;
+            change.seq = getU64(in);
+            change.loggedMs = getU64(in + 8);
+            change.updatedAt = static_cast<int64_t>(getU64(in + 16));
+            change.deleted = in[24] != 0;
+            size_t usuarioLength = getU32(in + 25);
+            size_t claveLength = getU32(in + 29);
+            in += kRecordHeaderSize;
+            if (static_cast<size_t>(end - in) < usuarioLength + claveLength) {
+                return false;
+            }
+            change.usuario.assign(reinterpret_cast<const char*>(in), usuarioLength);
+            in += usuarioLength;
+            change.clave.assign(reinterpret_cast<const char*>(in), claveLength);
+            in += claveLength;
+            changes.push_back(std::move(change));
+        }
+        return in == end;
+    }
+
+    // Written beside `path` and renamed over it once synced.
+    bool writeSegment(const std::filesystem::path& path, const std::vector<unsigned char>& bytes) {
+        std::string tmpPath = path.string() + ".tmp";
+        FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Error writing change log segment: " << tmpPath << std::endl;
+            return false;
+        }
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && std::fflush(file) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(file)) == 0;
+#else
+        ok = ok && fsync(fileno(file)) == 0;
+#endif
+        ok = std::fclose(file) == 0 && ok;
+        std::error_code ec;
+        if (ok) {
+            std::filesystem::rename(tmpPath, path, ec);
+            ok = !ec;
+        }
+        if (!ok) {
+            std::cerr << "Error writing change log segment: " << path.string() << std::endl;
+            std::filesystem::remove(tmpPath, ec);
+        }
+        return ok;
+    }
+}
+
+// ============================================
+// ChangeShipper
+// ============================================
+
+ChangeShipper::ChangeShipper(const std::string& dbPath, const std::string& logDirectory,
+                             const ShipperOptions& options)
+    : dbPath(dbPath), logDirectory(logDirectory), options(options), db(nullptr), running(false),
+      stopRequested(false), counters() {}
+
+ChangeShipper::~ChangeShipper() {
+    stop();
+    std::lock_guard<std::mutex> lock(shipMutex);
+    if (db) {
+        sqlite3_close(db);
+    }
+}
+
+bool ChangeShipper::start() {
+    if (running) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(shipMutex);
+        if (!open()) {
+            return false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = false;
+    }
+    running = true;
+    worker = std::thread(&ChangeShipper::loop, this);
+    return true;
+}
+
+void ChangeShipper::stop() {
+    if (!running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    while (shipOnce() > 0) {
+    }
+    running = false;
+}
+
+bool ChangeShipper::open() {
+    if (db) {
+        return true;
+    }
+    {
+        // Brings the file up to the schema with the change log.
+        Database primary(dbPath);
+        if (!primary.initialize()) {
+            return false;
+        }
+    }
+    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "Error opening database for shipping: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    sqlite3_busy_timeout(db, 2000);
+    std::error_code ec;
+    std::filesystem::create_directories(logDirectory, ec);
+
+    std::string role;
+    uint64_t position = 0;
+    bool ok = exec(db, "BEGIN IMMEDIATE;");
+    if (ok && readRole(db, role, position)) {
+        if (role != "primario") {
+            std::cerr << "Cannot ship changes from replica " << dbPath << std::endl;
+            ok = false;
+        }
+    } else if (ok) {
+        // Every account as it stands, so a new replica can start from nothing.
+        std::string enable = std::string(
+            "INSERT INTO replicacion (id, rol, posicion) VALUES (1, 'primario', 0);"
+            "INSERT INTO cambios (usuario, clave, actualizado_en, registrado_ms) "
+            "SELECT usuario, clave, actualizado_en, ") + kNowMs + " FROM usuarios ORDER BY usuario;";
+        ok = exec(db, enable.c_str());
+    }
+    ok = ok && exec(db, "COMMIT;");
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.position = position;
+    return true;
+}
+
+int ChangeShipper::shipOnce() {
+    std::lock_guard<std::mutex> shipLock(shipMutex);
+    if (!open()) {
+        return -1;
+    }
+    uint64_t after;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        after = counters.position;
+    }
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<Change> changes;
+    sqlite3_stmt* select = nullptr;
+    int rc = sqlite3_prepare_v2(db,
+        "SELECT seq, registrado_ms, actualizado_en, clave IS NULL, usuario, clave FROM cambios "
+        "WHERE seq > ? ORDER BY seq LIMIT ?;", -1, &select, nullptr);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(select, 1, static_cast<sqlite3_int64>(after));
+        sqlite3_bind_int64(select, 2, static_cast<sqlite3_int64>(options.maxRecords));
+        while ((rc = sqlite3_step(select)) == SQLITE_ROW) {
+            Change change;
+            change.seq = static_cast<uint64_t>(sqlite3_column_int64(select, 0));
+            change.loggedMs = static_cast<uint64_t>(sqlite3_column_int64(select, 1));
+            change.updatedAt = sqlite3_column_int64(select, 2);
+            change.deleted = sqlite3_column_int(select, 3) != 0;
+            change.usuario = columnText(select, 4);
+            change.clave = columnText(select, 5);
+            changes.push_back(std::move(change));
+        }
+    }
+    sqlite3_finalize(select);
+    if (rc != SQLITE_DONE) {
+        std::cerr << "Error reading change log: " << sqlite3_errmsg(db) << std::endl;
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.failures++;
+        return -1;
+    }
+    if (changes.empty()) {
+        return 0;
+    }
+
+    uint64_t last = changes.back().seq;
+    std::filesystem::path path = std::filesystem::path(logDirectory) / segmentName(changes.front().seq, last);
+    if (!writeSegment(path, encodeSegment(changes))) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.failures++;
+        return -1;
+    }
+
+    // Shipped either way; rows left behind by a failed trim go with the next one.
+    bool trimmed = exec(db, "BEGIN IMMEDIATE;");
+    sqlite3_stmt* trim = nullptr;
+    if (trimmed && sqlite3_prepare_v2(db, "DELETE FROM cambios WHERE seq <= ?1;"
+                                          "", -1, &trim, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(trim, 1, static_cast<sqlite3_int64>(last));
+        trimmed = sqlite3_step(trim) == SQLITE_DONE;
+    } else {
+        trimmed = false;
+    }
+    sqlite3_finalize(trim);
+    sqlite3_stmt* mark = nullptr;
+    if (trimmed && sqlite3_prepare_v2(db, "UPDATE replicacion SET posicion = ?;", -1, &mark, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(mark, 1, static_cast<sqlite3_int64>(last));
+        trimmed = sqlite3_step(mark) == SQLITE_DONE;
+    } else {
+        trimmed = false;
+    }
+    sqlite3_finalize(mark);
+    trimmed = trimmed && exec(db, "COMMIT;");
+    if (!trimmed) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+    pruneSegments();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.position = last;
+    counters.segments++;
+    counters.changes += changes.size();
+    counters.maxShipMs = std::max(counters.maxShipMs, ms);
+    if (!trimmed) {
+        counters.failures++;
+    }
+    return static_cast<int>(changes.size());
+}
+
+ShipperStats ChangeShipper::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void ChangeShipper::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        wake.wait_for(lock, std::chrono::milliseconds(options.intervalMs), [this]() { return stopRequested; });
+        if (stopRequested) {
+            break;
+        }
+        lock.unlock();
+        // A backlog goes out in full segments without waiting in between.
+        int shipped;
+        do {
+            shipped = shipOnce();
+        } while (shipped > 0 && static_cast<size_t>(shipped) == options.maxRecords);
+        lock.lock();
+    }
+}
+
+void ChangeShipper::pruneSegments() {
+    std::vector<Segment> segments = listSegments(logDirectory);
+    std::error_code ec;
+    for (size_t i = 0; i + options.maxSegments < segments.size(); i++) {
+        std::filesystem::remove(segments[i].path, ec);
+    }
+}
+
+// ============================================
+// ReplicaFollower
+// ============================================
+
+ReplicaFollower::ReplicaFollower(const std::string& replicaPath, const std::string& logDirectory,
+                                 const FollowerOptions& options)
+    : replicaPath(replicaPath), logDirectory(logDirectory), options(options), db(nullptr), running(false),
+      stopRequested(false) {
+    current.position = 0;
+    current.applied = 0;
+    current.segments = 0;
+    current.failures = 0;
+    current.gap = false;
+    current.lastLagMs = 0;
+}
+
+ReplicaFollower::~ReplicaFollower() {
+    stop();
+    std::lock_guard<std::mutex> lock(applyMutex);
+    if (db) {
+        sqlite3_close(db);
+    }
+}
+
+bool ReplicaFollower::seed(const std::string& snapshotPath) {
+    if (running) {
+        return false;
+    }
+    std::lock_guard<std::mutex> applyLock(applyMutex);
+    if (db) {
+        sqlite3_close(db);
+        db = nullptr;
+    }
+    {
+        DatabaseOptions databaseOptions;
+        databaseOptions.walMode = options.walMode;
+        Database replica(replicaPath, databaseOptions);
+        if (!replica.initialize() || !replica.restore(snapshotPath)) {
+            return false;
+        }
+    }
+    if (sqlite3_open(replicaPath.c_str(), &db) != SQLITE_OK) {
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    sqlite3_busy_timeout(db, 2000);
+    if (!makeReplica()) {
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    if (options.sharedCache) {
+        options.sharedCache->invalidateAll();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    current.gap = false;
+    return true;
+}
+
+bool ReplicaFollower::start() {
+    if (running) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(applyMutex);
+        if (!open()) {
+            return false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = false;
+    }
+    running = true;
+    worker = std::thread(&ReplicaFollower::loop, this);
+    return true;
+}
+
+void ReplicaFollower::stop() {
+    if (!running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    running = false;
+}
+
+bool ReplicaFollower::open() {
+    if (db) {
+        return true;
+    }
+    {
+        // Creates the file, with the current schema, if there is none.
+        DatabaseOptions databaseOptions;
+        databaseOptions.walMode = options.walMode;
+        Database replica(replicaPath, databaseOptions);
+        if (!replica.initialize()) {
+            return false;
+        }
+    }
+    if (sqlite3_open(replicaPath.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "Error opening replica: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    sqlite3_busy_timeout(db, 2000);
+
+    std::string role;
+    uint64_t position = 0;
+    bool ok = true;
+    if (!readRole(db, role, position)) {
+        ok = makeReplica();
+    } else if (role != "replica") {
+        // Converting it here would silently stop the primary's own log.
+        std::cerr << replicaPath << " is a primary; seed replicas from a backup instead" << std::endl;
+        ok = false;
+    } else {
+        std::lock_guard<std::mutex> lock(mutex);
+        current.position = position;
+    }
+    if (!ok) {
+        sqlite3_close(db);
+        db = nullptr;
+    }
+    return ok;
+}
+
+bool ReplicaFollower::makeReplica() {
+    // Every change logged in this file is already in its usuarios.
+    bool ok = exec(db, "BEGIN IMMEDIATE;"
+                       "DELETE FROM cambios;"
+                       "INSERT OR REPLACE INTO replicacion (id, rol, posicion) VALUES (1, 'replica', "
+                       "COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'cambios'), 0));"
+                       "COMMIT;");
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    std::string role;
+    uint64_t position = 0;
+    readRole(db, role, position);
+    std::lock_guard<std::mutex> lock(mutex);
+    current.position = position;
+    return true;
+}
+
+int ReplicaFollower::applyOnce() {
+    std::lock_guard<std::mutex> applyLock(applyMutex);
+    if (!open()) {
+        return -1;
+    }
+    uint64_t position;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        position = current.position;
+    }
+
+    int applied = 0;
+    std::vector<Change> changes;
+    for (const Segment& segment : listSegments(logDirectory)) {
+        if (segment.last <= position) {
+            continue;
+        }
+        if (segment.first > position + 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            current.gap = true;
+            return -1;
+        }
+        if (!decodeSegment(segment.path, changes)) {
+            std::cerr << "Damaged change log segment: " << segment.path.string() << std::endl;
+            std::lock_guard<std::mutex> lock(mutex);
+            current.failures++;
+            return -1;
+        }
+
+        sqlite3_stmt* upsert = nullptr;
+        sqlite3_stmt* remove = nullptr;
+        sqlite3_stmt* mark = nullptr;
+        bool ok = exec(db, "BEGIN IMMEDIATE;") &&
+            sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO usuarios (usuario, clave, actualizado_en) "
+                                   "VALUES (?, ?, ?);", -1, &upsert, nullptr) == SQLITE_OK &&
+            sqlite3_prepare_v2(db, "DELETE FROM usuarios WHERE usuario = ?;", -1, &remove, nullptr) == SQLITE_OK &&
+            sqlite3_prepare_v2(db, "UPDATE replicacion SET posicion = ?;", -1, &mark, nullptr) == SQLITE_OK;
+        size_t count = 0;
+        for (const Change& change : changes) {
+            if (!ok) {
+                break;
+            }
+            if (change.seq <= position) {
+                continue;
+            }
+            sqlite3_stmt* stmt = change.deleted ? remove : upsert;
+            sqlite3_bind_text(stmt, 1, change.usuario.data(), static_cast<int>(change.usuario.size()),
+                              SQLITE_STATIC);
+            if (!change.deleted) {
+                sqlite3_bind_text(stmt, 2, change.clave.data(), static_cast<int>(change.clave.size()),
+                                  SQLITE_STATIC);
+                sqlite3_bind_int64(stmt, 3, change.updatedAt);
+            }
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+            count++;
+        }
+        if (ok) {
+            sqlite3_bind_int64(mark, 1, static_cast<sqlite3_int64>(segment.last));
+            ok = sqlite3_step(mark) == SQLITE_DONE;
+        }
+        sqlite3_finalize(upsert);
+        sqlite3_finalize(remove);
+        sqlite3_finalize(mark);
+        ok = ok && exec(db, "COMMIT;");
+        if (!ok) {
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            std::lock_guard<std::mutex> lock(mutex);
+            current.failures++;
+            return -1;
+        }
+
+        uint64_t now = unixNowMs();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Change& change : changes) {
+            if (change.seq <= position) {
+                continue;
+            }
+            uint64_t lagMs = now > change.loggedMs ? now - change.loggedMs : 0;
+            current.lag.record(lagMs * 1000000);
+            current.lastLagMs = static_cast<double>(lagMs);
+            if (options.sharedCache) {
+                options.sharedCache->invalidate(change.usuario);
+            }
+        }
+        position = segment.last;
+        current.position = position;
+        current.applied += count;
+        current.segments++;
+        current.gap = false;
+        applied += static_cast<int>(count);
+    }
+    return applied;
+}
+
+ReplicaStatus ReplicaFollower::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+void ReplicaFollower::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        wake.wait_for(lock, std::chrono::milliseconds(options.pollIntervalMs), [this]() { return stopRequested; });
+        if (stopRequested) {
+            break;
+        }
+        lock.unlock();
+        applyOnce();
+        lock.lock();
+    }
+}
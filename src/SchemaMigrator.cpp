@@ -0,0 +1,407 @@
+#include "SchemaMigrator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int kInitialBatchRows = 256;
+    const int kMaxBatchRows = 65536;
+
+    std::string substitute(std::string sql, const std::string& table) {
+        const std::string marker = "{table}";
+        for (size_t at = sql.find(marker); at != std::string::npos; at = sql.find(marker, at + table.size())) {
+            sql.replace(at, marker.size(), table);
+        }
+        return sql;
+    }
+
+    // Shadows of every migrator, including ones an interrupted run left
+    // behind and those named before shadows carried their owner.
+    bool isShadowOf(const std::string& name, const std::string& table) {
+        const std::string prefix = table + "_rebuild";
+        return name.compare(0, prefix.size(), prefix) == 0 &&
+            (name.size() == prefix.size() || name[prefix.size()] == '_');
+    }
+
+    std::string joinColumns(const std::vector<std::string>& columns, const std::string& prefix) {
+        std::string joined;
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (i > 0) {
+                joined += ", ";
+            }
+            joined += prefix + columns[i];
+        }
+        return joined;
+    }
+}
+
+SchemaMigrator::SchemaMigrator(sqlite3* db, std::vector<Migration> migrations)
+    : db(db),
+      migrations(std::move(migrations)),
+      maxBatchMs(20),
+      adoptVersion(0),
+      result() {
+    std::sort(this->migrations.begin(), this->migrations.end(),
+              [](const Migration& a, const Migration& b) { return a.version < b.version; });
+    std::random_device random;
+    char suffix[17];
+    std::snprintf(suffix, sizeof(suffix), "%08x%08x", random(), random());
+    owner = suffix;
+}
+
+void SchemaMigrator::adoptUnversioned(const std::string& table, int version) {
+    adoptTable = table;
+    adoptVersion = version;
+}
+
+int SchemaMigrator::currentVersion() {
+    sqlite3_stmt* stmt = nullptr;
+    int version = -1;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+int SchemaMigrator::latestVersion() const {
+    return migrations.empty() ? 0 : migrations.back().version;
+}
+
+bool SchemaMigrator::migrate() {
+    result = MigrationReport();
+    int version = currentVersion();
+    if (version < 0) {
+        std::cerr << "Error reading schema version: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    int latest = latestVersion();
+    result.fromVersion = version;
+    result.toVersion = version;
+    if (version >= latest) {
+        return true;
+    }
+
+    version = adopted(version);
+    result.fromVersion = version;
+    if (version == 0 && !creationPragmas.empty() && !exec(creationPragmas)) {
+        return false;
+    }
+    auto first = pending(version);
+
+    // Copy the bulk of an existing table before taking the write lock for
+    // the rest; a brand new database has nothing worth copying online.
+    const Migration* online = nullptr;
+    if (version > 0 && first != migrations.end() && first->isRebuild() && tableExists(first->rebuild.table)) {
+        if (!copyOnline(*first)) {
+            dropShadow(first->rebuild);
+            // Another process may have finished the migration meanwhile,
+            // dropping this shadow along with the old table.
+            return upToDate();
+        }
+        online = &*first;
+    }
+
+    if (!exec("BEGIN IMMEDIATE;")) {
+        if (online) {
+            dropShadow(online->rebuild);
+        }
+        return false;
+    }
+    // Other processes opening the same file may have migrated it while this
+    // one copied or waited for the lock.
+    int locked = currentVersion();
+    bool ok = locked >= 0;
+    if (ok && locked >= latest) {
+        if (online) {
+            dropShadow(online->rebuild);
+        }
+        result.toVersion = locked;
+        return exec("COMMIT;");
+    }
+    if (ok && adopted(locked) != version) {
+        version = adopted(locked);
+        first = pending(version);
+        if (online && (first == migrations.end() || &*first != online)) {
+            dropShadow(online->rebuild);
+            online = nullptr;
+        }
+    }
+    for (auto it = first; ok && it != migrations.end(); ++it) {
+        if (it->isRebuild()) {
+            ok = finishRebuild(*it, &*it != online);
+        } else {
+            ok = exec(it->sql);
+        }
+        if (ok) {
+            result.applied++;
+            long long rows = it->isRebuild() ? result.rowsCopied : 0;
+            notify(*it, rows, rows, true);
+        } else {
+            std::cerr << "Error applying migration " << it->version << " (" << it->description << ")" << std::endl;
+        }
+    }
+    ok = ok && exec("PRAGMA user_version = " + std::to_string(latest) + ";");
+    ok = ok && exec("COMMIT;");
+    if (!ok) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        if (online) {
+            dropShadow(online->rebuild);
+        }
+        return false;
+    }
+    result.toVersion = latest;
+    return true;
+}
+
+int SchemaMigrator::adopted(int version) {
+    if (version == 0 && !adoptTable.empty() && tableExists(adoptTable)) {
+        return adoptVersion;
+    }
+    return version;
+}
+
+std::vector<Migration>::const_iterator SchemaMigrator::pending(int version) const {
+    return std::find_if(migrations.begin(), migrations.end(),
+                        [&](const Migration& m) { return m.version > version; });
+}
+
+bool SchemaMigrator::upToDate() {
+    int version = currentVersion();
+    if (version < latestVersion()) {
+        return false;
+    }
+    result.toVersion = version;
+    return true;
+}
+
+bool SchemaMigrator::copyOnline(const Migration& migration) {
+    const TableRebuild& rebuild = migration.rebuild;
+    const std::string shadow = shadowName(rebuild);
+    const std::string columns = joinColumns(rebuild.columns, "");
+    const std::string newColumns = joinColumns(rebuild.columns, "NEW.");
+
+    // The shadow is named after this migrator, so the copies of other
+    // processes opening the same file run beside it untouched.
+    dropShadow(rebuild);
+
+    // Triggers keep the shadow in step with writes made while the copy runs.
+    // The batch copy below uses INSERT OR IGNORE, so a row a trigger already
+    // wrote is never overwritten with an older version.
+    if (!exec("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    bool ok = exec(substitute(rebuild.createSql, shadow)) &&
+        exec("CREATE TRIGGER " + shadow + "_ins AFTER INSERT ON " + rebuild.table + " BEGIN "
+             "INSERT OR REPLACE INTO " + shadow + " (" + columns + ") VALUES (" + newColumns + "); END;") &&
+        exec("CREATE TRIGGER " + shadow + "_upd AFTER UPDATE ON " + rebuild.table + " BEGIN "
+             "DELETE FROM " + shadow + " WHERE " + rebuild.key + " = OLD." + rebuild.key + "; "
+             "INSERT OR REPLACE INTO " + shadow + " (" + columns + ") VALUES (" + newColumns + "); END;") &&
+        exec("CREATE TRIGGER " + shadow + "_del AFTER DELETE ON " + rebuild.table + " BEGIN "
+             "DELETE FROM " + shadow + " WHERE " + rebuild.key + " = OLD." + rebuild.key + "; END;");
+    if (!ok || !exec("COMMIT;")) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    long long total = countRows(rebuild.table);
+    // Two variants of each statement: the first batch has no lower bound.
+    // Spelling the bound out (rather than "?1 IS NULL OR ...") keeps both on
+    // an index range scan.
+    sqlite3_stmt* bound[2] = {nullptr, nullptr};
+    sqlite3_stmt* copy[2] = {nullptr, nullptr};
+    for (int next = 0; next < 2 && ok; next++) {
+        std::string lower = next ? rebuild.key + " > ?1" : std::string();
+        std::string boundSql = "SELECT max(" + rebuild.key + "), count(*) FROM (SELECT " + rebuild.key +
+            " FROM " + rebuild.table + (next ? " WHERE " + lower : std::string()) +
+            " ORDER BY " + rebuild.key + " LIMIT ?2);";
+        std::string copySql = "INSERT OR IGNORE INTO " + shadow + " (" + columns + ") SELECT " + columns +
+            " FROM " + rebuild.table + " WHERE " + (next ? lower + " AND " : std::string()) +
+            rebuild.key + " <= ?2;";
+        ok = sqlite3_prepare_v2(db, boundSql.c_str(), -1, &bound[next], nullptr) == SQLITE_OK &&
+            sqlite3_prepare_v2(db, copySql.c_str(), -1, &copy[next], nullptr) == SQLITE_OK;
+    }
+    if (!ok) {
+        std::cerr << "Error preparing rebuild of " << rebuild.table << ": " << sqlite3_errmsg(db) << std::endl;
+        for (int i = 0; i < 2; i++) {
+            sqlite3_finalize(bound[i]);
+            sqlite3_finalize(copy[i]);
+        }
+        return false;
+    }
+
+    // Walk the key range in batches; each batch is a short write transaction
+    // sized so it holds the lock for about maxBatchMs.
+    int batchRows = kInitialBatchRows;
+    sqlite3_value* lastKey = nullptr;
+    notify(migration, 0, total, false);
+    while (ok) {
+        Clock::time_point started = Clock::now();
+        if (!exec("BEGIN IMMEDIATE;")) {
+            ok = false;
+            break;
+        }
+        sqlite3_stmt* boundStmt = bound[lastKey ? 1 : 0];
+        sqlite3_stmt* copyStmt = copy[lastKey ? 1 : 0];
+        sqlite3_reset(boundStmt);
+        sqlite3_reset(copyStmt);
+        if (lastKey) {
+            sqlite3_bind_value(boundStmt, 1, lastKey);
+            sqlite3_bind_value(copyStmt, 1, lastKey);
+        }
+        sqlite3_bind_int(boundStmt, 2, batchRows);
+        if (sqlite3_step(boundStmt) != SQLITE_ROW || sqlite3_column_type(boundStmt, 0) == SQLITE_NULL) {
+            sqlite3_reset(boundStmt);
+            exec("COMMIT;");
+            break;
+        }
+        sqlite3_value* upper = sqlite3_value_dup(sqlite3_column_value(boundStmt, 0));
+        long long rows = sqlite3_column_int64(boundStmt, 1);
+        sqlite3_reset(boundStmt);
+
+        sqlite3_bind_value(copyStmt, 2, upper);
+        ok = sqlite3_step(copyStmt) == SQLITE_DONE;
+        if (!ok) {
+            std::cerr << "Error copying " << rebuild.table << ": " << sqlite3_errmsg(db) << std::endl;
+        }
+        sqlite3_reset(copyStmt);
+        ok = ok && exec("COMMIT;");
+        if (!ok) {
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+        sqlite3_value_free(lastKey);
+        lastKey = upper;
+
+        double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+        result.copyBatches++;
+        result.maxBatchMs = std::max(result.maxBatchMs, elapsedMs);
+        result.rowsCopied += rows;
+        if (elapsedMs > maxBatchMs) {
+            batchRows = std::max(1, batchRows / 2);
+        } else if (elapsedMs < maxBatchMs / 2.0) {
+            batchRows = std::min(kMaxBatchRows, batchRows * 2);
+        }
+        notify(migration, std::min(result.rowsCopied, total), total, false);
+    }
+    sqlite3_value_free(lastKey);
+    for (int i = 0; i < 2; i++) {
+        sqlite3_finalize(bound[i]);
+        sqlite3_finalize(copy[i]);
+    }
+    return ok;
+}
+
+bool SchemaMigrator::finishRebuild(const Migration& migration, bool copyInline) {
+    const TableRebuild& rebuild = migration.rebuild;
+    const std::string shadow = shadowName(rebuild);
+    // With the write lock held the mirror triggers have nothing left to
+    // catch up on: a shadow that lost rows, or was dropped, is copied again.
+    if (!copyInline && (!tableExists(shadow) || countRows(shadow) != countRows(rebuild.table))) {
+        std::cerr << "Online copy of " << rebuild.table << " is incomplete; copying it again" << std::endl;
+        result.rowsCopied = 0;
+        copyInline = true;
+    }
+    if (copyInline) {
+        const std::string columns = joinColumns(rebuild.columns, "");
+        if (!exec("DROP TABLE IF EXISTS " + shadow + ";") ||
+            !exec(substitute(rebuild.createSql, shadow)) ||
+            !exec("INSERT INTO " + shadow + " (" + columns + ") SELECT " + columns + " FROM " + rebuild.table + ";")) {
+            return false;
+        }
+        result.rowsCopied += sqlite3_changes(db);
+    }
+    // Dropping the old table also drops the mirror triggers.
+    if (!exec("DROP TABLE " + rebuild.table + ";") ||
+        !exec("ALTER TABLE " + shadow + " RENAME TO " + rebuild.table + ";")) {
+        return false;
+    }
+    for (const std::string& sql : rebuild.afterSwapSql) {
+        if (!exec(substitute(sql, rebuild.table))) {
+            return false;
+        }
+    }
+    // Shadows of other migrators are useless now, and their triggers went
+    // with the old table; a live one notices when it takes the lock.
+    std::vector<std::string> stale;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master WHERE type = 'table';", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (isShadowOf(name, rebuild.table)) {
+            stale.push_back(name);
+        }
+    }
+    sqlite3_finalize(stmt);
+    for (const std::string& name : stale) {
+        if (!exec("DROP TABLE " + name + ";")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string SchemaMigrator::shadowName(const TableRebuild& rebuild) const {
+    return rebuild.table + "_rebuild_" + owner;
+}
+
+void SchemaMigrator::dropShadow(const TableRebuild& rebuild) {
+    const std::string shadow = shadowName(rebuild);
+    sqlite3_exec(db, ("DROP TRIGGER IF EXISTS " + shadow + "_ins;").c_str(), nullptr, nullptr, nullptr);
+    sqlite3_exec(db, ("DROP TRIGGER IF EXISTS " + shadow + "_upd;").c_str(), nullptr, nullptr, nullptr);
+    sqlite3_exec(db, ("DROP TRIGGER IF EXISTS " + shadow + "_del;").c_str(), nullptr, nullptr, nullptr);
+    sqlite3_exec(db, ("DROP TABLE IF EXISTS " + shadow + ";").c_str(), nullptr, nullptr, nullptr);
+}
+
+bool SchemaMigrator::exec(const std::string& sql) {
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Migration error: " << (errMsg ? errMsg : sqlite3_errstr(rc)) << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool SchemaMigrator::tableExists(const std::string& table) {
+    sqlite3_stmt* stmt = nullptr;
+    bool exists = false;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?;",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+long long SchemaMigrator::countRows(const std::string& table) {
+    sqlite3_stmt* stmt = nullptr;
+    long long rows = 0;
+    if (sqlite3_prepare_v2(db, ("SELECT count(*) FROM " + table + ";").c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        rows = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+void SchemaMigrator::notify(const Migration& migration, long long copied, long long total, bool finished) {
+    if (!progress) {
+        return;
+    }
+    MigrationProgress update;
+    update.version = migration.version;
+    update.description = &migration.description;
+    update.rowsCopied = copied;
+    update.rowsTotal = total;
+    update.finished = finished;
+    progress(update);
+}
@@ -0,0 +1,220 @@
+#include "Sha256.h"
+#include <algorithm>
+#include <cstring>
+
+const uint32_t kSha256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t kSha256InitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+namespace {
+    inline uint32_t rotr(uint32_t x, int n) {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    inline uint32_t loadBigEndian(const uint8_t* in) {
+        return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+               (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+    }
+
+    inline void storeBigEndian(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+}
+
+Sha256::Sha256() {
+    reset();
+}
+
+void Sha256::reset() {
+    std::memcpy(state, kSha256InitialState, sizeof(state));
+    buffered = 0;
+    totalBytes = 0;
+}
+
+void Sha256::compress(const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = loadBigEndian(block + 4 * i);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        uint32_t choose = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + choose + kSha256RoundConstants[i] + w[i];
+        uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void Sha256::update(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    totalBytes += length;
+    if (buffered > 0) {
+        size_t take = std::min(length, kBlockSize - buffered);
+        std::memcpy(buffer + buffered, bytes, take);
+        buffered += take;
+        bytes += take;
+        length -= take;
+        if (buffered < kBlockSize) {
+            return;
+        }
+        compress(buffer);
+        buffered = 0;
+    }
+    while (length >= kBlockSize) {
+        compress(bytes);
+        bytes += kBlockSize;
+        length -= kBlockSize;
+    }
+    std::memcpy(buffer, bytes, length);
+    buffered = length;
+}
+
+void Sha256::finish(uint8_t digest[kDigestSize]) {
+    uint64_t bits = totalBytes * 8;
+    uint8_t padding[kBlockSize * 2] = {0x80};
+    size_t padLength = (buffered < 56 ? 56 : 120) - buffered;
+    for (int i = 0; i < 8; i++) {
+        padding[padLength + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(padding, padLength + 8);
+    for (int i = 0; i < 8; i++) {
+        storeBigEndian(digest + 4 * i, state[i]);
+    }
+}
+
+void Sha256::digest(const void* data, size_t length, uint8_t out[kDigestSize]) {
+    Sha256 hash;
+    hash.update(data, length);
+    hash.finish(out);
+}
+
+void hmacSha256(const void* key, size_t keyLength, const void* data, size_t dataLength,
+                uint8_t out[Sha256::kDigestSize]) {
+    uint8_t block[Sha256::kBlockSize] = {0};
+    if (keyLength > Sha256::kBlockSize) {
+        Sha256::digest(key, keyLength, block);
+    } else {
+        std::memcpy(block, key, keyLength);
+    }
+
+    uint8_t pad[Sha256::kBlockSize];
+    for (size_t i = 0; i < Sha256::kBlockSize; i++) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    uint8_t inner[Sha256::kDigestSize];
+    Sha256 hash;
+    hash.update(pad, sizeof(pad));
+    hash.update(data, dataLength);
+    hash.finish(inner);
+
+    for (size_t i = 0; i < Sha256::kBlockSize; i++) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    hash.reset();
+    hash.update(pad, sizeof(pad));
+    hash.update(inner, sizeof(inner));
+    hash.finish(out);
+}
+
+void pbkdf2HmacSha256(const void* password, size_t passwordLength, const void* salt, size_t saltLength,
+                      uint32_t iterations, uint8_t* out, size_t outLength) {
+    // Key the inner and outer hashes once; every HMAC below starts from a
+    // copy of them instead of hashing the padded key again.
+    uint8_t block[Sha256::kBlockSize] = {0};
+    if (passwordLength > Sha256::kBlockSize) {
+        Sha256::digest(password, passwordLength, block);
+    } else {
+        std::memcpy(block, password, passwordLength);
+    }
+    uint8_t pad[Sha256::kBlockSize];
+    Sha256 inner;
+    for (size_t i = 0; i < Sha256::kBlockSize; i++) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    inner.update(pad, sizeof(pad));
+    Sha256 outer;
+    for (size_t i = 0; i < Sha256::kBlockSize; i++) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    outer.update(pad, sizeof(pad));
+
+    for (uint32_t blockIndex = 1; outLength > 0; blockIndex++) {
+        uint8_t counter[4];
+        storeBigEndian(counter, blockIndex);
+        uint8_t u[Sha256::kDigestSize];
+        uint8_t t[Sha256::kDigestSize];
+        Sha256 hash = inner;
+        hash.update(salt, saltLength);
+        hash.update(counter, sizeof(counter));
+        hash.finish(u);
+        hash = outer;
+        hash.update(u, sizeof(u));
+        hash.finish(u);
+        std::memcpy(t, u, sizeof(t));
+        for (uint32_t i = 1; i < iterations; i++) {
+            hash = inner;
+            hash.update(u, sizeof(u));
+            hash.finish(u);
+            hash = outer;
+            hash.update(u, sizeof(u));
+            hash.finish(u);
+            for (size_t k = 0; k < sizeof(t); k++) {
+                t[k] ^= u[k];
+            }
+        }
+        size_t take = std::min(outLength, sizeof(t));
+        std::memcpy(out, t, take);
+        out += take;
+        outLength -= take;
+    }
+}
+
+std::string toHex(const uint8_t* data, size_t length) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(length * 2);
+    for (size_t i = 0; i < length; i++) {
+        hex.push_back(kDigits[data[i] >> 4]);
+        hex.push_back(kDigits[data[i] & 0x0f]);
+    }
+    return hex;
+}
@@ -0,0 +1,431 @@
+#include "Sha256Batch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_BATCH_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+    inline uint32_t loadBigEndian(const uint8_t* in) {
+        return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16) |
+               (static_cast<uint32_t>(in[2]) << 8) | static_cast<uint32_t>(in[3]);
+    }
+
+    inline void storeBigEndian(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+
+    // Number of 64-byte blocks in the padded message.
+    inline size_t paddedBlocks(size_t length) {
+        return (length + 8) / Sha256::kBlockSize + 1;
+    }
+
+    // Returns block `index` of the padded message. Whole data blocks are read
+    // in place; the tail (data remainder, 0x80, zeros, bit length) is built in
+    // `scratch`.
+    const uint8_t* messageBlock(const Sha256Input& input, size_t index, uint8_t* scratch) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(input.data);
+        size_t offset = index * Sha256::kBlockSize;
+        if (offset + Sha256::kBlockSize <= input.length) {
+            return bytes + offset;
+        }
+        std::memset(scratch, 0, Sha256::kBlockSize);
+        if (input.length >= offset) {
+            size_t remaining = input.length - offset;
+            std::memcpy(scratch, bytes + offset, remaining);
+            scratch[remaining] = 0x80;
+        }
+        if (index + 1 == paddedBlocks(input.length)) {
+            uint64_t bits = static_cast<uint64_t>(input.length) * 8;
+            for (int i = 0; i < 8; i++) {
+                scratch[56 + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+            }
+        }
+        return scratch;
+    }
+
+    void hashScalar(const Sha256Input* inputs, size_t count, Sha256Digest* digests) {
+        for (size_t i = 0; i < count; i++) {
+            Sha256::digest(inputs[i].data, inputs[i].length, digests[i]);
+        }
+    }
+
+#ifdef SHA256_BATCH_X86
+    struct CpuFeatures {
+        bool avx2 = false;
+        bool avx512 = false;
+        bool shaNi = false;
+    };
+
+    CpuFeatures detectCpu() {
+        CpuFeatures features;
+        unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return features;
+        }
+        bool sse41 = (ecx & (1u << 19)) != 0;
+        bool osxsave = (ecx & (1u << 27)) != 0;
+        bool avx = (ecx & (1u << 28)) != 0;
+        // The OS must save the wide registers too (XCR0), not just the CPU
+        // have them.
+        uint64_t xcr0 = 0;
+        if (osxsave) {
+            uint32_t low = 0, high = 0;
+            __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+            xcr0 = (static_cast<uint64_t>(high) << 32) | low;
+        }
+        if (__get_cpuid_max(0, nullptr) < 7) {
+            return features;
+        }
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        features.avx2 = avx && (xcr0 & 0x06) == 0x06 && (ebx & (1u << 5)) != 0;
+        features.avx512 = features.avx2 && (xcr0 & 0xE6) == 0xE6 && (ebx & (1u << 16)) != 0;
+        features.shaNi = sse41 && (ebx & (1u << 29)) != 0;
+        return features;
+    }
+
+    const CpuFeatures& cpu() {
+        static const CpuFeatures features = detectCpu();
+        return features;
+    }
+
+    // ---- Multi-buffer kernels ----
+    //
+    // Each 32-bit lane of a GCC vector holds the working state of a different
+    // message. When a lane's message runs out of blocks its digest is stored
+    // and the next pending message takes the lane, so short and long messages
+    // can be mixed freely. hashLanes() is always inlined into the per-ISA
+    // wrappers below, so the vectors never cross a call boundary compiled
+    // without AVX.
+    typedef uint32_t Lanes8 __attribute__((vector_size(32)));
+    typedef uint32_t Lanes16 __attribute__((vector_size(64)));
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+    template <typename V, int L>
+    inline __attribute__((always_inline)) void hashLanes(const Sha256Input* inputs, size_t count,
+                                                         Sha256Digest* digests) {
+        const size_t kIdle = static_cast<size_t>(-1);
+        size_t message[L];
+        size_t block[L];
+        size_t next = 0;
+        int active = 0;
+        V state[8];
+        for (int k = 0; k < 8; k++) {
+            state[k] = V{} + kSha256InitialState[k];
+        }
+        for (int lane = 0; lane < L; lane++) {
+            block[lane] = 0;
+            message[lane] = next < count ? next++ : kIdle;
+            active += message[lane] != kIdle;
+        }
+
+        alignas(64) uint32_t words[16][L];
+        alignas(64) uint8_t scratch[L][Sha256::kBlockSize];
+        while (active > 0) {
+            for (int lane = 0; lane < L; lane++) {
+                if (message[lane] == kIdle) {
+                    for (int t = 0; t < 16; t++) {
+                        words[t][lane] = 0;
+                    }
+                    continue;
+                }
+                const uint8_t* bytes = messageBlock(inputs[message[lane]], block[lane], scratch[lane]);
+                for (int t = 0; t < 16; t++) {
+                    words[t][lane] = loadBigEndian(bytes + 4 * t);
+                }
+            }
+
+            V w[16];
+            for (int t = 0; t < 16; t++) {
+                std::memcpy(&w[t], words[t], sizeof(V));
+            }
+            V a = state[0], b = state[1], c = state[2], d = state[3];
+            V e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; i++) {
+                if (i >= 16) {
+                    V w15 = w[(i - 15) & 15];
+                    V w2 = w[(i - 2) & 15];
+                    V s0 = SHA256_ROTR(w15, 7) ^ SHA256_ROTR(w15, 18) ^ (w15 >> 3);
+                    V s1 = SHA256_ROTR(w2, 17) ^ SHA256_ROTR(w2, 19) ^ (w2 >> 10);
+                    w[i & 15] = w[i & 15] + s0 + w[(i - 7) & 15] + s1;
+                }
+                V s1 = SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25);
+                V choose = (e & f) ^ (~e & g);
+                V t1 = h + s1 + choose + kSha256RoundConstants[i] + w[i & 15];
+                V s0 = SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22);
+                V majority = (a & b) ^ (a & c) ^ (b & c);
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + s0 + majority;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+
+            for (int lane = 0; lane < L; lane++) {
+                if (message[lane] == kIdle ||
+                    ++block[lane] < paddedBlocks(inputs[message[lane]].length)) {
+                    continue;
+                }
+                for (int k = 0; k < 8; k++) {
+                    storeBigEndian(digests[message[lane]] + 4 * k, state[k][lane]);
+                    state[k][lane] = kSha256InitialState[k];
+                }
+                block[lane] = 0;
+                if (next < count) {
+                    message[lane] = next++;
+                } else {
+                    message[lane] = kIdle;
+                    active--;
+                }
+            }
+        }
+    }
+
+#undef SHA256_ROTR
+
+    __attribute__((target("avx2")))
+    void hashAvx2(const Sha256Input* inputs, size_t count, Sha256Digest* digests) {
+        hashLanes<Lanes8, 8>(inputs, count, digests);
+    }
+
+    __attribute__((target("avx512f")))
+    void hashAvx512(const Sha256Input* inputs, size_t count, Sha256Digest* digests) {
+        hashLanes<Lanes16, 16>(inputs, count, digests);
+    }
+
+    // ---- SHA extensions ----
+    //
+    // The hardware rounds keep the state as ABEF/CDGH and do two rounds per
+    // sha256rnds2; the message schedule is spread across the 16 quad-rounds
+    // with sha256msg1/msg2.
+    __attribute__((target("sha,sse4.1")))
+    void compressShaNi(__m128i& abef, __m128i& cdgh, const uint8_t* block) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i savedAbef = abef;
+        __m128i savedCdgh = cdgh;
+        __m128i m[4];
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                m[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i)), byteSwap);
+            }
+            __m128i message = _mm_add_epi32(m[i % 4],
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256RoundConstants[4 * i])));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+            if (i >= 3 && i < 15) {
+                __m128i carry = _mm_alignr_epi8(m[i % 4], m[(i + 3) % 4], 4);
+                m[(i + 1) % 4] = _mm_sha256msg2_epu32(_mm_add_epi32(m[(i + 1) % 4], carry), m[i % 4]);
+            }
+            message = _mm_shuffle_epi32(message, 0x0E);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, message);
+            if (i >= 1 && i < 13) {
+                m[(i + 3) % 4] = _mm_sha256msg1_epu32(m[(i + 3) % 4], m[i % 4]);
+            }
+        }
+        abef = _mm_add_epi32(abef, savedAbef);
+        cdgh = _mm_add_epi32(cdgh, savedCdgh);
+    }
+
+    __attribute__((target("sha,sse4.1")))
+    void hashShaNi(const Sha256Input* inputs, size_t count, Sha256Digest* digests) {
+        alignas(16) uint8_t scratch[Sha256::kBlockSize];
+        for (size_t n = 0; n < count; n++) {
+            __m128i abcd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256InitialState[0]));
+            __m128i efgh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256InitialState[4]));
+            __m128i cdab = _mm_shuffle_epi32(abcd, 0xB1);
+            efgh = _mm_shuffle_epi32(efgh, 0x1B);
+            __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+            __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+            size_t blocks = paddedBlocks(inputs[n].length);
+            for (size_t b = 0; b < blocks; b++) {
+                compressShaNi(abef, cdgh, messageBlock(inputs[n], b, scratch));
+            }
+
+            __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+            __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+            alignas(16) uint32_t state[8];
+            _mm_store_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(feba, dchg, 0xF0));
+            _mm_store_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));
+            for (int k = 0; k < 8; k++) {
+                storeBigEndian(digests[n] + 4 * k, state[k]);
+            }
+        }
+    }
+#endif
+}
+
+bool sha256KernelSupported(Sha256Kernel kernel) {
+    switch (kernel) {
+        case Sha256Kernel::Scalar:
+            return true;
+#ifdef SHA256_BATCH_X86
+        case Sha256Kernel::Avx2:
+            return cpu().avx2;
+        case Sha256Kernel::Avx512:
+            return cpu().avx512;
+        case Sha256Kernel::ShaNi:
+            return cpu().shaNi;
+#endif
+        default:
+            return false;
+    }
+}
+
+Sha256Kernel sha256BestKernel() {
+    // Which of SHA-NI and wide lanes wins depends on the microarchitecture,
+    // so the supported kernels race once on a small batch of short
+    // messages (the row-digest workload) and the fastest is kept.
+    static const Sha256Kernel best = [] {
+        const size_t kMessages = 256;
+        const size_t kLength = 64;
+        std::vector<uint8_t> data(kMessages * kLength, 0x5a);
+        std::vector<Sha256Input> inputs(kMessages);
+        for (size_t i = 0; i < kMessages; i++) {
+            inputs[i] = {data.data() + i * kLength, kLength};
+        }
+        std::vector<uint8_t> digestBytes(kMessages * Sha256::kDigestSize);
+        Sha256Digest* digests = reinterpret_cast<Sha256Digest*>(digestBytes.data());
+
+        Sha256Kernel fastest = Sha256Kernel::Scalar;
+        double fastestSeconds = 0;
+        for (Sha256Kernel kernel : {Sha256Kernel::Scalar, Sha256Kernel::Avx2, Sha256Kernel::Avx512,
+                                    Sha256Kernel::ShaNi}) {
+            if (!sha256KernelSupported(kernel)) {
+                continue;
+            }
+            double seconds = 0;
+            for (int round = 0; round < 3; round++) {
+                auto start = std::chrono::steady_clock::now();
+                sha256Batch(inputs.data(), kMessages, digests, kernel);
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                seconds = round == 0 ? elapsed : std::min(seconds, elapsed);
+            }
+            if (kernel == Sha256Kernel::Scalar || seconds < fastestSeconds) {
+                fastest = kernel;
+                fastestSeconds = seconds;
+            }
+        }
+        return fastest;
+    }();
+    return best;
+}
+
+namespace {
+    // Lane kernels pay for every lane even when few are filled, so tiny
+    // batches go to SHA-NI or the scalar code instead.
+    Sha256Kernel kernelFor(size_t count) {
+        Sha256Kernel kernel = sha256BestKernel();
+        if (count < 4 && (kernel == Sha256Kernel::Avx2 || kernel == Sha256Kernel::Avx512)) {
+            return sha256KernelSupported(Sha256Kernel::ShaNi) ? Sha256Kernel::ShaNi : Sha256Kernel::Scalar;
+        }
+        return kernel;
+    }
+}
+
+const char* sha256KernelName(Sha256Kernel kernel) {
+    switch (kernel) {
+        case Sha256Kernel::Scalar: return "scalar";
+        case Sha256Kernel::Avx2: return "avx2x8";
+        case Sha256Kernel::Avx512: return "avx512x16";
+        case Sha256Kernel::ShaNi: return "sha-ni";
+    }
+    return "?";
+}
+
+void sha256Batch(const Sha256Input* inputs, size_t count, Sha256Digest* digests) {
+    sha256Batch(inputs, count, digests, kernelFor(count));
+}
+
+void sha256Batch(const Sha256Input* inputs, size_t count, Sha256Digest* digests, Sha256Kernel kernel) {
+    if (!sha256KernelSupported(kernel)) {
+        kernel = Sha256Kernel::Scalar;
+    }
+    switch (kernel) {
+#ifdef SHA256_BATCH_X86
+        case Sha256Kernel::ShaNi:
+            hashShaNi(inputs, count, digests);
+            return;
+        case Sha256Kernel::Avx512:
+            hashAvx512(inputs, count, digests);
+            return;
+        case Sha256Kernel::Avx2:
+            hashAvx2(inputs, count, digests);
+            return;
+#endif
+        default:
+            hashScalar(inputs, count, digests);
+            return;
+    }
+}
+
+void hmacSha256Batch(const void* key, size_t keyLength, const Sha256Input* inputs, size_t count,
+                     Sha256Digest* digests) {
+    hmacSha256Batch(key, keyLength, inputs, count, digests, kernelFor(count));
+}
+
+void hmacSha256Batch(const void* key, size_t keyLength, const Sha256Input* inputs, size_t count,
+                     Sha256Digest* digests, Sha256Kernel kernel) {
+    uint8_t block[Sha256::kBlockSize] = {0};
+    if (keyLength > Sha256::kBlockSize) {
+        Sha256::digest(key, keyLength, block);
+    } else {
+        std::memcpy(block, key, keyLength);
+    }
+
+    // Inner pass: H(key ^ ipad || message), every message prefixed in one
+    // contiguous buffer so the kernels see plain inputs.
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += Sha256::kBlockSize + inputs[i].length;
+    }
+    std::vector<uint8_t> buffer(std::max(total, count * (Sha256::kBlockSize + Sha256::kDigestSize)));
+    std::vector<Sha256Input> prefixed(count);
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* out = buffer.data() + offset;
+        for (size_t k = 0; k < Sha256::kBlockSize; k++) {
+            out[k] = block[k] ^ 0x36;
+        }
+        if (inputs[i].length > 0) {
+            std::memcpy(out + Sha256::kBlockSize, inputs[i].data, inputs[i].length);
+        }
+        prefixed[i] = {out, Sha256::kBlockSize + inputs[i].length};
+        offset += prefixed[i].length;
+    }
+    std::vector<uint8_t> innerBytes(count * Sha256::kDigestSize);
+    Sha256Digest* inner = reinterpret_cast<Sha256Digest*>(innerBytes.data());
+    sha256Batch(prefixed.data(), count, inner, kernel);
+
+    // Outer pass: H(key ^ opad || inner digest).
+    const size_t outerLength = Sha256::kBlockSize + Sha256::kDigestSize;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* out = buffer.data() + i * outerLength;
+        for (size_t k = 0; k < Sha256::kBlockSize; k++) {
+            out[k] = block[k] ^ 0x5c;
+        }
+        std::memcpy(out + Sha256::kBlockSize, inner[i], Sha256::kDigestSize);
+        prefixed[i] = {out, outerLength};
+    }
+    sha256Batch(prefixed.data(), count, digests, kernel);
+}
@@ -0,0 +1,140 @@
+#include "ShardedDatabase.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+    // FNV-1a over the email with surrounding whitespace trimmed and ASCII
+    // letters lowercased, so "User@x " and "user@x" land on one shard. Part
+    // of the on-disk layout: changing it orphans every sharded account.
+    uint64_t routingKey(std::string_view email) {
+        const char* kSpace = " \t\r\n";
+        size_t first = email.find_first_not_of(kSpace);
+        if (first == std::string_view::npos) {
+            email = std::string_view();
+        } else {
+            email = email.substr(first, email.find_last_not_of(kSpace) - first + 1);
+        }
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : email) {
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<unsigned char>(c - 'A' + 'a');
+            }
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+ShardedDatabase::ShardedDatabase(const std::string& basePath, int shardCount, const DatabaseOptions& options) {
+    shardCount = std::max(shardCount, 1);
+    for (int i = 0; i < shardCount; i++) {
+        shards.push_back(std::make_unique<Database>(shardPath(basePath, i, shardCount), options));
+    }
+}
+
+bool ShardedDatabase::initialize() {
+    for (auto& shard : shards) {
+        if (!shard->initialize()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LoginOutcome ShardedDatabase::authenticate(std::string_view email, std::string_view password) {
+    return shardFor(email).authenticate(email, password);
+}
+
+LoginOutcome ShardedDatabase::authenticate(std::string_view email, std::string_view password,
+                                           Clock::time_point deadline) {
+    return shardFor(email).authenticate(email, password, deadline);
+}
+
+bool ShardedDatabase::addUser(const std::string& email, const std::string& password) {
+    return shardFor(email).addUser(email, password);
+}
+
+bool ShardedDatabase::addUsers(const std::vector<std::pair<std::string, std::string>>& users) {
+    if (shards.size() == 1) {
+        return shards[0]->addUsers(users);
+    }
+    std::vector<std::vector<std::pair<std::string, std::string>>> perShard(shards.size());
+    for (const auto& user : users) {
+        perShard[shardIndex(user.first, shardCount())].push_back(user);
+    }
+
+    // Each shard's connection is used by exactly one of these threads.
+    std::vector<char> ok(shards.size(), 1);
+    std::vector<std::thread> writers;
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (perShard[i].empty()) {
+            continue;
+        }
+        writers.emplace_back([this, i, &perShard, &ok]() {
+            ok[i] = shards[i]->addUsers(perShard[i]) ? 1 : 0;
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    return std::all_of(ok.begin(), ok.end(), [](char shardOk) { return shardOk != 0; });
+}
+
+bool ShardedDatabase::changePassword(const std::string& email, const std::string& newPassword) {
+    return shardFor(email).changePassword(email, newPassword);
+}
+
+void ShardedDatabase::setTraceRecorder(LoginTraceWriter* recorder) {
+    for (auto& shard : shards) {
+        shard->setTraceRecorder(recorder);
+    }
+}
+
+void ShardedDatabase::setActivityMonitor(ActivityMonitor* monitor) {
+    for (auto& shard : shards) {
+        shard->setActivityMonitor(monitor);
+    }
+}
+
+void ShardedDatabase::setStuffingDetector(StuffingDetector* detector, const std::string& source) {
+    for (auto& shard : shards) {
+        shard->setStuffingDetector(detector, source);
+    }
+}
+
+DatabaseStats ShardedDatabase::stats() const {
+    DatabaseStats total = {};
+    for (const auto& shard : shards) {
+        DatabaseStats stats = shard->stats();
+        total.queries += stats.queries;
+        total.timeouts += stats.timeouts;
+        total.storageErrors += stats.storageErrors;
+        total.busyRetries += stats.busyRetries;
+        total.busyWaitUs += stats.busyWaitUs;
+        total.rehashes += stats.rehashes;
+        total.cacheHits += stats.cacheHits;
+    }
+    return total;
+}
+
+int ShardedDatabase::shardIndex(std::string_view email, int shardCount) {
+    // Lamping & Veach, "A Fast, Minimal Memory, Consistent Hash Algorithm".
+    uint64_t key = routingKey(email);
+    int64_t bucket = -1;
+    int64_t next = 0;
+    while (next < shardCount) {
+        bucket = next;
+        key = key * 2862933555777941757ull + 1;
+        next = static_cast<int64_t>((bucket + 1) * (static_cast<double>(1ll << 31) /
+                                                    static_cast<double>((key >> 33) + 1)));
+    }
+    return static_cast<int>(std::max<int64_t>(bucket, 0));
+}
+
+std::string ShardedDatabase::shardPath(const std::string& basePath, int index, int shardCount) {
+    if (shardCount <= 1) {
+        return basePath;
+    }
+    return basePath + "." + std::to_string(index) + "-of-" + std::to_string(shardCount);
+}
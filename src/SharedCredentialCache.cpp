@@ -0,0 +1,417 @@
+#include "SharedCredentialCache.h"
+#include "LoginTrace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const uint64_t kMagic = 0x4155544843414348ull;  // "AUTHCACH"
+    const uint32_t kLayoutVersion = 2;
+    const size_t kStripes = 4096;
+    // Slots examined per key; a full neighbourhood evicts one of them.
+    const size_t kProbe = 4;
+    const size_t kWords = (SharedCredentialCache::kMaxKeyLength + SharedCredentialCache::kMaxValueLength) / 8;
+    // Reader retries before treating a busy entry as a miss.
+    const int kReadAttempts = 4;
+    // A fill holds its entry for well under a microsecond; one held longer
+    // than this belongs to a writer that is gone, even if its pid was reused.
+    const uint32_t kAbandonedAfterMs = 1000;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock-free");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock-free");
+
+    size_t roundUpPowerOfTwo(size_t value) {
+        size_t power = kProbe;
+        while (power < value) {
+            power *= 2;
+        }
+        return power;
+    }
+
+    // steady_clock is CLOCK_MONOTONIC on Linux, the same in every process.
+    // Wraps every 49 days; only differences are used.
+    uint32_t nowMs() {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+#ifndef _WIN32
+    uint64_t processId() {
+        return static_cast<uint64_t>(getpid());
+    }
+
+    bool processGone(uint64_t pid) {
+        return kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH;
+    }
+#else
+    uint64_t processId() {
+        return 0;
+    }
+
+    bool processGone(uint64_t) {
+        return false;
+    }
+#endif
+}
+
+// Every field lives in the shared mapping, so all of them are lock-free
+// atomics; the segment starts zero-filled, which is a valid empty state.
+struct SharedCredentialCache::Segment {
+    std::atomic<uint64_t> magic;
+    uint32_t version;
+    uint32_t capacity;
+    std::atomic<uint32_t> globalGeneration;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> fills;
+    std::atomic<uint64_t> invalidations;
+    std::atomic<uint64_t> takeovers;
+    std::atomic<uint32_t> stripes[kStripes];
+};
+
+struct SharedCredentialCache::Entry {
+    // Low half: the seqlock count. High half: while the count is odd, the pid
+    // of the writer, claimed in the same compare-and-swap.
+    std::atomic<uint64_t> sequence;
+    // The count a writer claimed | when it claimed it (nowMs) << 32. Stamped
+    // just after the claim, so a count that does not match is not stamped yet.
+    std::atomic<uint64_t> claimedAt;
+    // 0 while empty; otherwise keyLength | valueLength << 16.
+    std::atomic<uint32_t> lengths;
+    std::atomic<uint64_t> hash;
+    std::atomic<uint64_t> ticket;
+    // Key bytes followed by value bytes.
+    std::atomic<uint64_t> words[kWords];
+};
+
+SharedCredentialCache::SharedCredentialCache()
+    : segment(nullptr), entries(nullptr), mappedBytes(0), mask(0) {}
+
+SharedCredentialCache::~SharedCredentialCache() {
+    detach();
+}
+
+std::string SharedCredentialCache::segmentName(const std::string& prefix, const std::string& dbPath) {
+    // The same file under any relative path, symlink or working directory.
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::weakly_canonical(std::filesystem::absolute(dbPath, ec), ec);
+    std::string canonical = ec ? dbPath : path.string();
+    char suffix[18];
+    std::snprintf(suffix, sizeof(suffix), "-%016llx", static_cast<unsigned long long>(hashAccountKey(canonical)));
+    return prefix + suffix;
+}
+
+#ifndef _WIN32
+
+bool SharedCredentialCache::attach(const std::string& name, size_t capacity) {
+    detach();
+    capacity = roundUpPowerOfTwo(capacity);
+    size_t entriesOffset = (sizeof(Segment) + 63) / 64 * 64;
+    size_t bytes = entriesOffset + capacity * sizeof(Entry);
+
+    bool creator = true;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        creator = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        std::cerr << "Error abriendo cache compartida " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (creator && ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        std::cerr << "Error dimensionando cache compartida: " << std::strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // Another process may have created the segment and not sized it yet.
+    auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    struct stat info;
+    while (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) != bytes &&
+           std::chrono::steady_clock::now() < giveUp) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (static_cast<size_t>(info.st_size) != bytes) {
+        std::cerr << "Cache compartida " << name << " con otro tamano" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error mapeando cache compartida: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    Segment* shared = static_cast<Segment*>(mapping);
+    if (creator) {
+        shared->version = kLayoutVersion;
+        shared->capacity = static_cast<uint32_t>(capacity);
+        shared->magic.store(kMagic, std::memory_order_release);
+    } else {
+        while (shared->magic.load(std::memory_order_acquire) != kMagic &&
+               std::chrono::steady_clock::now() < giveUp) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (shared->magic.load(std::memory_order_acquire) != kMagic ||
+            shared->version != kLayoutVersion || shared->capacity != capacity) {
+            std::cerr << "Cache compartida " << name << " incompatible" << std::endl;
+            munmap(mapping, bytes);
+            return false;
+        }
+    }
+
+    segment = shared;
+    entries = reinterpret_cast<Entry*>(static_cast<char*>(mapping) + entriesOffset);
+    mappedBytes = bytes;
+    mask = capacity - 1;
+    return true;
+}
+
+void SharedCredentialCache::detach() {
+    if (segment) {
+        munmap(segment, mappedBytes);
+    }
+    segment = nullptr;
+    entries = nullptr;
+    mappedBytes = 0;
+    mask = 0;
+}
+
+bool SharedCredentialCache::unlink(const std::string& name) {
+    return shm_unlink(name.c_str()) == 0;
+}
+
+#else
+
+bool SharedCredentialCache::attach(const std::string& name, size_t) {
+    std::cerr << "Cache compartida " << name << " no disponible en esta plataforma" << std::endl;
+    return false;
+}
+
+void SharedCredentialCache::detach() {}
+
+bool SharedCredentialCache::unlink(const std::string&) {
+    return false;
+}
+
+#endif
+
+size_t SharedCredentialCache::capacity() const {
+    return segment ? mask + 1 : 0;
+}
+
+uint64_t SharedCredentialCache::currentTicket(uint64_t hash) const {
+    uint64_t global = segment->globalGeneration.load(std::memory_order_acquire);
+    uint64_t stripe = segment->stripes[hash % kStripes].load(std::memory_order_acquire);
+    return (global << 32) | stripe;
+}
+
+uint64_t SharedCredentialCache::fillTicket(std::string_view key) const {
+    return segment ? currentTicket(hashAccountKey(key)) : 0;
+}
+
+bool SharedCredentialCache::readEntry(const Entry& entry, uint64_t& hash, uint64_t& ticket, char* bytes,
+                                      size_t& keyLength, size_t& valueLength) const {
+    for (int attempt = 0; attempt < kReadAttempts; attempt++) {
+        uint64_t before = entry.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        uint32_t lengths = entry.lengths.load(std::memory_order_relaxed);
+        hash = entry.hash.load(std::memory_order_relaxed);
+        ticket = entry.ticket.load(std::memory_order_relaxed);
+        keyLength = lengths & 0xffff;
+        valueLength = lengths >> 16;
+        uint64_t words[kWords];
+        if (bytes) {
+            size_t used = (keyLength + valueLength + 7) / 8;
+            for (size_t i = 0; i < used && i < kWords; i++) {
+                words[i] = entry.words[i].load(std::memory_order_relaxed);
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry.sequence.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        if (lengths == 0 || keyLength > kMaxKeyLength || valueLength > kMaxValueLength) {
+            return false;
+        }
+        if (bytes) {
+            std::memcpy(bytes, words, keyLength + valueLength);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool SharedCredentialCache::lookup(std::string_view key, std::string& value) {
+    char buffer[kMaxValueLength];
+    size_t length = 0;
+    bool hit = lookup(key, buffer, length);
+    value.assign(buffer, length);
+    return hit;
+}
+
+bool SharedCredentialCache::lookup(std::string_view key, char* value, size_t& valueLength) {
+    valueLength = 0;
+    if (!segment) {
+        return false;
+    }
+    uint64_t hash = hashAccountKey(key);
+    uint64_t valid = currentTicket(hash);
+    for (size_t probe = 0; probe < kProbe; probe++) {
+        const Entry& entry = entries[(hash + probe) & mask];
+        uint64_t entryHash;
+        uint64_t entryTicket;
+        size_t keyLength;
+        size_t length;
+        char bytes[kWords * 8];
+        // Cheap check first: most probes are for other keys.
+        if (entry.hash.load(std::memory_order_relaxed) != hash) {
+            continue;
+        }
+        if (readEntry(entry, entryHash, entryTicket, bytes, keyLength, length) && entryHash == hash &&
+            entryTicket == valid && std::string_view(bytes, keyLength) == key) {
+            std::memcpy(value, bytes + keyLength, length);
+            valueLength = length;
+            segment->hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    segment->misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void SharedCredentialCache::fill(std::string_view key, std::string_view value, uint64_t ticket) {
+    if (!segment || key.empty() || key.size() > kMaxKeyLength || value.size() > kMaxValueLength) {
+        return;
+    }
+    uint64_t hash = hashAccountKey(key);
+    if (currentTicket(hash) != ticket) {
+        return;
+    }
+
+    // Reuse this key's entry, else an empty or stale one, else evict a
+    // neighbour picked by the hash so hot keys do not keep evicting each other.
+    Entry* target = nullptr;
+    Entry* reusable = nullptr;
+    for (size_t probe = 0; probe < kProbe && !target; probe++) {
+        Entry& entry = entries[(hash + probe) & mask];
+        uint64_t entryHash;
+        uint64_t entryTicket;
+        size_t keyLength;
+        size_t valueLength;
+        char bytes[kWords * 8];
+        if (!readEntry(entry, entryHash, entryTicket, bytes, keyLength, valueLength)) {
+            uint64_t sequence = entry.sequence.load(std::memory_order_relaxed);
+            if (!reusable && (!(sequence & 1) || abandoned(entry, sequence))) {
+                reusable = &entry;
+            }
+        } else if (entryHash == hash && std::string_view(bytes, keyLength) == key) {
+            target = &entry;
+        } else if (!reusable && entryTicket != currentTicket(entryHash)) {
+            reusable = &entry;
+        }
+    }
+    if (!target) {
+        target = reusable ? reusable : &entries[(hash + ((hash >> 32) % kProbe)) & mask];
+    }
+
+    uint64_t sequence = claim(*target);
+    if (sequence == 0) {
+        return;
+    }
+
+    uint64_t words[kWords] = {};
+    std::memcpy(words, key.data(), key.size());
+    std::memcpy(reinterpret_cast<char*>(words) + key.size(), value.data(), value.size());
+    size_t used = (key.size() + value.size() + 7) / 8;
+    for (size_t i = 0; i < used; i++) {
+        target->words[i].store(words[i], std::memory_order_relaxed);
+    }
+    target->hash.store(hash, std::memory_order_relaxed);
+    target->ticket.store(ticket, std::memory_order_relaxed);
+    target->lengths.store(static_cast<uint32_t>(key.size() | (value.size() << 16)), std::memory_order_relaxed);
+    // A writer that stalled past kAbandonedAfterMs has lost the entry to
+    // another one, and must not publish over it.
+    uint64_t done = static_cast<uint32_t>(sequence + 1);
+    if (target->sequence.compare_exchange_strong(sequence, done, std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+        segment->fills.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool SharedCredentialCache::abandoned(const Entry& entry, uint64_t sequence) const {
+    uint64_t claimedAt = entry.claimedAt.load(std::memory_order_relaxed);
+    if (static_cast<uint32_t>(claimedAt) == static_cast<uint32_t>(sequence) &&
+        nowMs() - static_cast<uint32_t>(claimedAt >> 32) > kAbandonedAfterMs) {
+        return true;
+    }
+    return processGone(sequence >> 32);
+}
+
+uint64_t SharedCredentialCache::claim(Entry& entry) {
+    uint64_t sequence = entry.sequence.load(std::memory_order_acquire);
+    // Odd: a writer holds it. Take over only if that writer died between
+    // its claim and its release, or has held it for far too long.
+    if ((sequence & 1) && !abandoned(entry, sequence)) {
+        return 0;
+    }
+    uint64_t count = static_cast<uint32_t>(sequence);
+    uint64_t claimed = ((count + ((count & 1) ? 2 : 1)) & 0xffffffffull) | (processId() << 32);
+    if (!entry.sequence.compare_exchange_strong(sequence, claimed, std::memory_order_acquire)) {
+        return 0;
+    }
+    if (sequence & 1) {
+        segment->takeovers.fetch_add(1, std::memory_order_relaxed);
+    }
+    entry.claimedAt.store(static_cast<uint32_t>(claimed) | (static_cast<uint64_t>(nowMs()) << 32),
+                          std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return claimed;
+}
+
+void SharedCredentialCache::invalidate(std::string_view key) {
+    if (!segment) {
+        return;
+    }
+    segment->stripes[hashAccountKey(key) % kStripes].fetch_add(1, std::memory_order_acq_rel);
+    segment->invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SharedCredentialCache::invalidateAll() {
+    if (!segment) {
+        return;
+    }
+    segment->globalGeneration.fetch_add(1, std::memory_order_acq_rel);
+    segment->invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+SharedCacheStats SharedCredentialCache::stats() const {
+    SharedCacheStats result = {};
+    if (segment) {
+        result.hits = segment->hits.load(std::memory_order_relaxed);
+        result.misses = segment->misses.load(std::memory_order_relaxed);
+        result.fills = segment->fills.load(std::memory_order_relaxed);
+        result.invalidations = segment->invalidations.load(std::memory_order_relaxed);
+        result.takeovers = segment->takeovers.load(std::memory_order_relaxed);
+    }
+    return result;
+}
@@ -0,0 +1,372 @@
+#include "Snapshot.h"
+#include "Checksum.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    const char kMagic[4] = {'A', 'S', 'N', 'P'};
+    const uint8_t kVersion = 1;
+    const size_t kBlockSize = 256 * 1024;
+    // Block header: raw length, stored length (top bit set if uncompressed), CRC-32.
+    const size_t kBlockHeaderSize = 12;
+    const uint32_t kStoredRaw = 0x80000000u;
+
+    const size_t kMinMatch = 4;
+    const size_t kMaxOffset = 65535;
+    const int kHashBits = 14;
+
+    void putU32(unsigned char* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    void putU64(unsigned char* out, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    uint32_t getU32(const unsigned char* in) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t getU64(const unsigned char* in) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    bool syncFile(FILE* file) {
+        if (std::fflush(file) != 0) {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // Closes `file` (written to `tmpPath`) durably and renames it to `path`;
+    // on any failure the temporary file is removed.
+    bool commitFile(FILE* file, const std::string& tmpPath, const std::string& path) {
+        bool ok = syncFile(file);
+        ok = std::fclose(file) == 0 && ok;
+        std::error_code ec;
+        if (ok) {
+            std::filesystem::rename(tmpPath, path, ec);
+            ok = !ec;
+        }
+        if (!ok) {
+            std::cerr << "Error escribiendo " << path << std::endl;
+            std::filesystem::remove(tmpPath, ec);
+        }
+        return ok;
+    }
+
+    void abandonFile(FILE* file, const std::string& tmpPath) {
+        std::fclose(file);
+        std::error_code ec;
+        std::filesystem::remove(tmpPath, ec);
+    }
+
+    uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint64_t read64(const uint8_t* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    void putLength(uint8_t*& op, size_t remaining) {
+        while (remaining >= 255) {
+            *op++ = 255;
+            remaining -= 255;
+        }
+        *op++ = static_cast<uint8_t>(remaining);
+    }
+
+    bool getLength(const uint8_t* in, size_t length, size_t& ip, size_t& value) {
+        uint8_t byte;
+        do {
+            if (ip >= length) {
+                return false;
+            }
+            byte = in[ip++];
+            value += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // One sequence: token (literal and match length nibbles), literal
+    // length overflow, literals, then, unless this is the final sequence,
+    // the offset and match length overflow.
+    void emitSequence(uint8_t*& op, const uint8_t* literals, size_t literalLength, size_t offset,
+                      size_t matchLength) {
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+        if (literalLength >= 15) {
+            putLength(op, literalLength - 15);
+        }
+        std::memcpy(op, literals, literalLength);
+        op += literalLength;
+        if (matchLength == 0) {
+            return;
+        }
+        *op++ = static_cast<uint8_t>(offset);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        size_t extra = matchLength - kMinMatch;
+        *token |= static_cast<uint8_t>(extra < 15 ? extra : 15);
+        if (extra >= 15) {
+            putLength(op, extra - 15);
+        }
+    }
+}
+
+size_t lzCompressBound(size_t length) {
+    return length + length / 255 + 16;
+}
+
+size_t lzCompress(const uint8_t* in, size_t length, uint8_t* out) {
+    std::vector<uint32_t> table(size_t(1) << kHashBits, 0);
+    uint8_t* op = out;
+    size_t ip = 0;
+    size_t anchor = 0;
+    while (ip + kMinMatch <= length) {
+        uint32_t sequence = read32(in + ip);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - kHashBits);
+        size_t candidate = table[slot];
+        table[slot] = static_cast<uint32_t>(ip);
+        if (candidate >= ip || ip - candidate > kMaxOffset || read32(in + candidate) != sequence) {
+            // Step faster through data that keeps failing to match.
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+        size_t matchLength = kMinMatch;
+        bool mismatch = false;
+        while (!mismatch && ip + matchLength + 8 <= length) {
+            uint64_t diff = read64(in + candidate + matchLength) ^ read64(in + ip + matchLength);
+            if (diff) {
+                matchLength += __builtin_ctzll(diff) / 8;
+                mismatch = true;
+            } else {
+                matchLength += 8;
+            }
+        }
+        while (!mismatch && ip + matchLength < length && in[candidate + matchLength] == in[ip + matchLength]) {
+            matchLength++;
+        }
+        emitSequence(op, in + anchor, ip - anchor, ip - candidate, matchLength);
+        ip += matchLength;
+        anchor = ip;
+    }
+    emitSequence(op, in + anchor, length - anchor, 0, 0);
+    return static_cast<size_t>(op - out);
+}
+
+bool lzDecompress(const uint8_t* in, size_t length, uint8_t* out, size_t outLength) {
+    size_t ip = 0;
+    size_t op = 0;
+    while (ip < length) {
+        uint8_t token = in[ip++];
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !getLength(in, length, ip, literalLength)) {
+            return false;
+        }
+        if (literalLength > length - ip || literalLength > outLength - op) {
+            return false;
+        }
+        std::memcpy(out + op, in + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+        if (ip == length) {
+            return op == outLength;
+        }
+
+        if (length - ip < 2) {
+            return false;
+        }
+        size_t offset = in[ip] | (static_cast<size_t>(in[ip + 1]) << 8);
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !getLength(in, length, ip, matchLength)) {
+            return false;
+        }
+        matchLength += kMinMatch;
+        if (offset == 0 || offset > op || matchLength > outLength - op) {
+            return false;
+        }
+        if (offset >= matchLength) {
+            std::memcpy(out + op, out + op - offset, matchLength);
+        } else {
+            // Overlapping match: repeats the last `offset` bytes.
+            for (size_t i = 0; i < matchLength; i++) {
+                out[op + i] = out[op + i - offset];
+            }
+        }
+        op += matchLength;
+    }
+    return false;
+}
+
+bool writeSnapshot(const std::string& sourcePath, const std::string& snapshotPath, SnapshotInfo* info) {
+    FILE* source = std::fopen(sourcePath.c_str(), "rb");
+    if (!source) {
+        std::cerr << "Error abriendo " << sourcePath << std::endl;
+        return false;
+    }
+    std::string tmpPath = snapshotPath + ".tmp";
+    FILE* out = std::fopen(tmpPath.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error creando " << tmpPath << std::endl;
+        std::fclose(source);
+        return false;
+    }
+
+    unsigned char header[5];
+    std::memcpy(header, kMagic, 4);
+    header[4] = kVersion;
+    bool ok = std::fwrite(header, 1, sizeof(header), out) == sizeof(header);
+    uint64_t rawBytes = 0;
+    uint64_t storedBytes = sizeof(header);
+    uint32_t fileCrc = 0;
+    std::vector<uint8_t> raw(kBlockSize);
+    std::vector<uint8_t> packed(kBlockHeaderSize + lzCompressBound(kBlockSize));
+    size_t read;
+    while (ok && (read = std::fread(raw.data(), 1, raw.size(), source)) > 0) {
+        uint32_t crc = crc32(raw.data(), read);
+        size_t compressed = lzCompress(raw.data(), read, packed.data() + kBlockHeaderSize);
+        uint32_t stored = static_cast<uint32_t>(compressed);
+        if (compressed >= read) {
+            std::memcpy(packed.data() + kBlockHeaderSize, raw.data(), read);
+            stored = static_cast<uint32_t>(read) | kStoredRaw;
+            compressed = read;
+        }
+        putU32(packed.data(), static_cast<uint32_t>(read));
+        putU32(packed.data() + 4, stored);
+        putU32(packed.data() + 8, crc);
+        fileCrc = crc32(packed.data() + 8, 4, fileCrc);
+        size_t total = kBlockHeaderSize + compressed;
+        ok = std::fwrite(packed.data(), 1, total, out) == total;
+        rawBytes += read;
+        storedBytes += total;
+    }
+    ok = ok && !std::ferror(source);
+    std::fclose(source);
+
+    // Trailer: an empty block, then the file size and a CRC-32 over the
+    // block CRCs, which catches dropped or reordered blocks.
+    unsigned char trailer[kBlockHeaderSize + 12] = {};
+    putU64(trailer + kBlockHeaderSize, rawBytes);
+    putU32(trailer + kBlockHeaderSize + 8, fileCrc);
+    ok = ok && std::fwrite(trailer, 1, sizeof(trailer), out) == sizeof(trailer);
+    storedBytes += sizeof(trailer);
+    if (!ok) {
+        std::cerr << "Error comprimiendo " << sourcePath << std::endl;
+        abandonFile(out, tmpPath);
+        return false;
+    }
+    if (!commitFile(out, tmpPath, snapshotPath)) {
+        return false;
+    }
+    if (info) {
+        info->rawBytes = rawBytes;
+        info->storedBytes = storedBytes;
+    }
+    return true;
+}
+
+bool readSnapshot(const std::string& snapshotPath, const std::string& outputPath, SnapshotInfo* info) {
+    FILE* in = std::fopen(snapshotPath.c_str(), "rb");
+    if (!in) {
+        std::cerr << "Error abriendo " << snapshotPath << std::endl;
+        return false;
+    }
+    unsigned char header[5];
+    if (std::fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        std::memcmp(header, kMagic, 4) != 0 || header[4] != kVersion) {
+        std::cerr << snapshotPath << " no es una copia de seguridad valida" << std::endl;
+        std::fclose(in);
+        return false;
+    }
+    std::string tmpPath = outputPath + ".tmp";
+    FILE* out = std::fopen(tmpPath.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error creando " << tmpPath << std::endl;
+        std::fclose(in);
+        return false;
+    }
+
+    bool ok = false;
+    uint64_t rawBytes = 0;
+    uint64_t storedBytes = sizeof(header);
+    uint32_t fileCrc = 0;
+    std::vector<uint8_t> raw(kBlockSize);
+    std::vector<uint8_t> packed(lzCompressBound(kBlockSize));
+    unsigned char blockHeader[kBlockHeaderSize];
+    while (std::fread(blockHeader, 1, sizeof(blockHeader), in) == sizeof(blockHeader)) {
+        uint32_t rawLength = getU32(blockHeader);
+        uint32_t stored = getU32(blockHeader + 4);
+        uint32_t crc = getU32(blockHeader + 8);
+        storedBytes += sizeof(blockHeader);
+        if (rawLength == 0) {
+            unsigned char trailer[12];
+            ok = std::fread(trailer, 1, sizeof(trailer), in) == sizeof(trailer) &&
+                 getU64(trailer) == rawBytes && getU32(trailer + 8) == fileCrc;
+            storedBytes += sizeof(trailer);
+            break;
+        }
+        bool isRaw = (stored & kStoredRaw) != 0;
+        size_t storedLength = stored & ~kStoredRaw;
+        if (rawLength > kBlockSize || storedLength > packed.size() || (isRaw && storedLength != rawLength) ||
+            std::fread(packed.data(), 1, storedLength, in) != storedLength) {
+            break;
+        }
+        if (isRaw) {
+            std::memcpy(raw.data(), packed.data(), rawLength);
+        } else if (!lzDecompress(packed.data(), storedLength, raw.data(), rawLength)) {
+            break;
+        }
+        if (crc32(raw.data(), rawLength) != crc ||
+            std::fwrite(raw.data(), 1, rawLength, out) != rawLength) {
+            break;
+        }
+        fileCrc = crc32(blockHeader + 8, 4, fileCrc);
+        rawBytes += rawLength;
+        storedBytes += storedLength;
+    }
+    std::fclose(in);
+    if (!ok) {
+        std::cerr << snapshotPath << " esta danada o incompleta" << std::endl;
+        abandonFile(out, tmpPath);
+        return false;
+    }
+    if (!commitFile(out, tmpPath, outputPath)) {
+        return false;
+    }
+    if (info) {
+        info->rawBytes = rawBytes;
+        info->storedBytes = storedBytes;
+    }
+    return true;
+}
@@ -0,0 +1,336 @@
+#include "StuffingDetector.h"
+#include "LoginTrace.h"
+#include "Sha256Batch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    const uint32_t kEmpty = 0xffffffffu;
+    const size_t kMinSketchWidth = 64;
+    const int kMaxDepth = 16;
+    // Forward-decay weights are renormalized before they reach this, which
+    // keeps counters far from overflow and precise to well below one event.
+    const double kRescaleWeight = 1099511627776.0;  // 2^40
+
+    // splitmix64 finalizer: spreads FNV output over all bits.
+    inline uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    size_t floorPowerOfTwo(size_t value) {
+        size_t power = 1;
+        while (power * 2 <= value) {
+            power *= 2;
+        }
+        return power;
+    }
+}
+
+const char* stuffingKeyName(StuffingKey kind) {
+    switch (kind) {
+        case StuffingKey::Account: return "cuenta";
+        case StuffingKey::Source: return "origen";
+        case StuffingKey::PasswordPrefix: return "clave";
+    }
+    return "?";
+}
+
+StuffingDetector::StuffingDetector(const StuffingDetectorOptions& options)
+    : options(options),
+      landmark(Clock::now()),
+      eventCount(0) {
+    this->options.depth = std::min(std::max(1, options.depth), kMaxDepth);
+    this->options.trackedKeys = std::max<size_t>(1, options.trackedKeys);
+    if (this->options.halfLife.count() <= 0) {
+        this->options.halfLife = std::chrono::milliseconds(1);
+    }
+    size_t tracked = this->options.trackedKeys;
+    size_t indexSize = floorPowerOfTwo(tracked * 4 - 1);
+    indexMask = indexSize - 1;
+
+    // Each key kind gets a third of the budget: first its heavy-hitter
+    // table, the rest for the sketch rounded down to a power-of-two width.
+    size_t heavyBytes = tracked * (sizeof(Slot) + sizeof(uint32_t)) + indexSize * sizeof(uint32_t);
+    size_t perKind = this->options.memoryBytes / kStuffingKeyCount;
+    size_t sketchBytes = perKind > heavyBytes ? perKind - heavyBytes : 0;
+    width = std::max(kMinSketchWidth, floorPowerOfTwo(sketchBytes / (this->options.depth * sizeof(double))));
+
+    for (int kind = 0; kind < kStuffingKeyCount; kind++) {
+        sketches[kind].assign(width * this->options.depth, 0.0);
+        heavy[kind].slots.resize(tracked);
+        heavy[kind].heap.reserve(tracked);
+        heavy[kind].index.assign(indexSize, kEmpty);
+    }
+}
+
+void StuffingDetector::recordFailure(const std::string& account, const std::string& source,
+                                     const std::string& password, Clock::time_point now) {
+    // The sketch rows are random reads into megabytes of counters; start
+    // fetching them before hashing the password so the two overlap.
+    uint64_t accountHash = hashAccountKey(account);
+    uint64_t sourceHash = hashAccountKey(source);
+    prefetch(static_cast<int>(StuffingKey::Account), accountHash);
+    prefetch(static_cast<int>(StuffingKey::Source), sourceHash);
+    std::string prefix = passwordKey(password, options.passwordPrefixBytes);
+    uint64_t prefixHash = hashAccountKey(prefix);
+    prefetch(static_cast<int>(StuffingKey::PasswordPrefix), prefixHash);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    double weight = weightAt(now);
+    if (weight > kRescaleWeight) {
+        rescale(now);
+        weight = weightAt(now);
+    }
+    eventCount++;
+    add(static_cast<int>(StuffingKey::Account), accountHash, account, weight);
+    add(static_cast<int>(StuffingKey::Source), sourceHash, source, weight);
+    add(static_cast<int>(StuffingKey::PasswordPrefix), prefixHash, prefix, weight);
+}
+
+void StuffingDetector::record(StuffingKey kind, const std::string& key, Clock::time_point now) {
+    uint64_t hash = hashAccountKey(key);
+    std::lock_guard<std::mutex> lock(mutex);
+    double weight = weightAt(now);
+    if (weight > kRescaleWeight) {
+        rescale(now);
+        weight = weightAt(now);
+    }
+    eventCount++;
+    add(static_cast<int>(kind), hash, key, weight);
+}
+
+double StuffingDetector::estimate(StuffingKey kind, const std::string& key, Clock::time_point now) const {
+    uint64_t hash = hashAccountKey(key);
+    uint64_t h1 = mix(hash);
+    uint64_t h2 = mix(hash ^ 0x9e3779b97f4a7c15ull) | 1;
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::vector<double>& sketch = sketches[static_cast<int>(kind)];
+    double lowest = sketch[h1 & (width - 1)];
+    for (int row = 1; row < options.depth; row++) {
+        lowest = std::min(lowest, sketch[row * width + ((h1 + row * h2) & (width - 1))]);
+    }
+    return lowest * decayAt(now);
+}
+
+std::vector<StuffingOffender> StuffingDetector::topOffenders(StuffingKey kind, size_t count,
+                                                             Clock::time_point now) const {
+    std::vector<StuffingOffender> offenders;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const HeavyHitters& table = heavy[static_cast<int>(kind)];
+        double decay = decayAt(now);
+        offenders.reserve(table.used);
+        for (size_t i = 0; i < table.used; i++) {
+            const Slot& slot = table.slots[i];
+            offenders.push_back({std::string(slot.key, slot.keyLength), slot.count * decay, slot.error * decay});
+        }
+    }
+    std::sort(offenders.begin(), offenders.end(), [](const StuffingOffender& a, const StuffingOffender& b) {
+        return a.failures > b.failures;
+    });
+    if (offenders.size() > count) {
+        offenders.resize(count);
+    }
+    return offenders;
+}
+
+uint64_t StuffingDetector::events() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return eventCount;
+}
+
+size_t StuffingDetector::memoryBytes() const {
+    size_t bytes = 0;
+    for (int kind = 0; kind < kStuffingKeyCount; kind++) {
+        bytes += sketches[kind].capacity() * sizeof(double);
+        bytes += heavy[kind].slots.capacity() * sizeof(Slot);
+        bytes += heavy[kind].heap.capacity() * sizeof(uint32_t);
+        bytes += heavy[kind].index.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+std::string StuffingDetector::passwordKey(const std::string& password, size_t prefixBytes) {
+    Sha256Input input = {password.data(), password.size()};
+    Sha256Digest digest;
+    sha256Batch(&input, 1, &digest);
+    return toHex(digest, std::min(prefixBytes, sizeof(digest)));
+}
+
+void StuffingDetector::prefetch(int kind, uint64_t hash) const {
+#if defined(__GNUC__)
+    uint64_t h1 = mix(hash);
+    uint64_t h2 = mix(hash ^ 0x9e3779b97f4a7c15ull) | 1;
+    const double* sketch = sketches[kind].data();
+    for (int row = 0; row < options.depth; row++) {
+        __builtin_prefetch(&sketch[row * width + ((h1 + row * h2) & (width - 1))], 1);
+    }
+#else
+    (void)kind;
+    (void)hash;
+#endif
+}
+
+void StuffingDetector::add(int kind, uint64_t hash, const std::string& key, double weight) {
+    uint64_t h1 = mix(hash);
+    uint64_t h2 = mix(hash ^ 0x9e3779b97f4a7c15ull) | 1;
+
+    // Conservative update: raise only the counters that are below the new
+    // estimate, which tightens the overestimate for light keys.
+    std::vector<double>& sketch = sketches[kind];
+    double* cells[kMaxDepth];
+    double lowest = 0;
+    for (int row = 0; row < options.depth; row++) {
+        cells[row] = &sketch[row * width + ((h1 + row * h2) & (width - 1))];
+        lowest = row == 0 ? *cells[row] : std::min(lowest, *cells[row]);
+    }
+    double raised = lowest + weight;
+    for (int row = 0; row < options.depth; row++) {
+        if (*cells[row] < raised) {
+            *cells[row] = raised;
+        }
+    }
+
+    addHeavyHitter(heavy[kind], hash, key, weight, raised);
+}
+
+double StuffingDetector::weightAt(Clock::time_point now) const {
+    double halfLives = std::chrono::duration<double, std::milli>(now - landmark).count() / options.halfLife.count();
+    return std::exp2(halfLives);
+}
+
+double StuffingDetector::decayAt(Clock::time_point now) const {
+    return 1.0 / weightAt(now);
+}
+
+void StuffingDetector::rescale(Clock::time_point now) {
+    // Moves the landmark to `now`: every stored count is divided by the
+    // current weight, so relative order and decayed values are unchanged.
+    double factor = decayAt(now);
+    for (int kind = 0; kind < kStuffingKeyCount; kind++) {
+        for (double& cell : sketches[kind]) {
+            cell *= factor;
+        }
+        for (size_t i = 0; i < heavy[kind].used; i++) {
+            heavy[kind].slots[i].count *= factor;
+            heavy[kind].slots[i].error *= factor;
+        }
+    }
+    landmark = now;
+}
+
+void StuffingDetector::addHeavyHitter(HeavyHitters& table, uint64_t hash, const std::string& key, double weight,
+                                      double estimate) {
+    uint32_t* entry = findIndex(table, hash);
+    if (*entry != kEmpty) {
+        Slot& slot = table.slots[*entry];
+        slot.count += weight;
+        siftDown(table, slot.heapIndex);
+        return;
+    }
+
+    uint32_t slotIndex;
+    if (table.used < table.slots.size()) {
+        slotIndex = static_cast<uint32_t>(table.used++);
+        Slot& slot = table.slots[slotIndex];
+        slot.count = weight;
+        slot.error = 0;
+        slot.heapIndex = static_cast<uint32_t>(table.heap.size());
+        table.heap.push_back(slotIndex);
+    } else {
+        // Space-Saving: the new key takes over the smallest counter and
+        // inherits its count as possible overestimate. Every untracked key
+        // has at most that count, and the sketch bounds it from above too:
+        // when the sketch is already below the smallest counter the swap
+        // cannot change the top entries, so the long tail of one-off keys
+        // skips it.
+        slotIndex = table.heap[0];
+        Slot& slot = table.slots[slotIndex];
+        if (estimate <= slot.count) {
+            return;
+        }
+        eraseIndex(table, slot.hash);
+        entry = findIndex(table, hash);
+        double count = std::min(slot.count + weight, estimate);
+        slot.error = count - weight;
+        slot.count = count;
+    }
+    Slot& slot = table.slots[slotIndex];
+    slot.hash = hash;
+    slot.keyLength = static_cast<uint8_t>(std::min(key.size(), kMaxKeyLength));
+    std::memcpy(slot.key, key.data(), slot.keyLength);
+    *entry = slotIndex;
+    siftUp(table, slot.heapIndex);
+    siftDown(table, slot.heapIndex);
+}
+
+uint32_t* StuffingDetector::findIndex(HeavyHitters& table, uint64_t hash) {
+    size_t position = mix(hash) & indexMask;
+    while (table.index[position] != kEmpty && table.slots[table.index[position]].hash != hash) {
+        position = (position + 1) & indexMask;
+    }
+    return &table.index[position];
+}
+
+void StuffingDetector::eraseIndex(HeavyHitters& table, uint64_t hash) {
+    // Linear probing with backward-shift deletion: later entries of the same
+    // probe run move up so lookups never need tombstones.
+    size_t hole = findIndex(table, hash) - table.index.data();
+    size_t next = hole;
+    while (true) {
+        next = (next + 1) & indexMask;
+        if (table.index[next] == kEmpty) {
+            break;
+        }
+        size_t home = mix(table.slots[table.index[next]].hash) & indexMask;
+        bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (movable) {
+            table.index[hole] = table.index[next];
+            hole = next;
+        }
+    }
+    table.index[hole] = kEmpty;
+}
+
+void StuffingDetector::swapHeap(HeavyHitters& table, size_t a, size_t b) {
+    std::swap(table.heap[a], table.heap[b]);
+    table.slots[table.heap[a]].heapIndex = static_cast<uint32_t>(a);
+    table.slots[table.heap[b]].heapIndex = static_cast<uint32_t>(b);
+}
+
+void StuffingDetector::siftUp(HeavyHitters& table, size_t position) {
+    while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (table.slots[table.heap[parent]].count <= table.slots[table.heap[position]].count) {
+            break;
+        }
+        swapHeap(table, parent, position);
+        position = parent;
+    }
+}
+
+void StuffingDetector::siftDown(HeavyHitters& table, size_t position) {
+    size_t size = table.heap.size();
+    while (true) {
+        size_t smallest = position;
+        size_t left = 2 * position + 1;
+        size_t right = left + 1;
+        if (left < size && table.slots[table.heap[left]].count < table.slots[table.heap[smallest]].count) {
+            smallest = left;
+        }
+        if (right < size && table.slots[table.heap[right]].count < table.slots[table.heap[smallest]].count) {
+            smallest = right;
+        }
+        if (smallest == position) {
+            return;
+        }
+        swapHeap(table, position, smallest);
+        position = smallest;
+    }
+}
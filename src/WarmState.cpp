@@ -0,0 +1,504 @@
+#include "WarmState.h"
+#include "Checksum.h"
+#include "LoginTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char kMagic[4] = {'A', 'W', 'R', 'M'};
+    const uint32_t kVersion = 1;
+    // magic, version, database size, mtime and change counter, page size,
+    // accounts, bitmap bytes, CRC-32 of everything after the header.
+    const size_t kHeaderSize = 64;
+    // count, length, key.
+    const size_t kRecordSize = 8 + WarmState::kMaxKeyLength;
+
+    void putU32(unsigned char* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    void putU64(unsigned char* out, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    uint32_t getU32(const unsigned char* in) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t getU64(const unsigned char* in) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    // What the page hints were taken against; any write to auth.db changes it.
+    struct Fingerprint {
+        uint64_t bytes = 0;
+        uint64_t mtimeNs = 0;
+        uint32_t changeCounter = 0;
+
+        bool operator==(const Fingerprint& other) const {
+            return bytes == other.bytes && mtimeNs == other.mtimeNs && changeCounter == other.changeCounter;
+        }
+    };
+
+    bool fingerprint(const std::string& path, Fingerprint& out) {
+        std::error_code ec;
+        out.bytes = std::filesystem::file_size(path, ec);
+        if (ec) {
+            return false;
+        }
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            return false;
+        }
+        out.mtimeNs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count());
+        // SQLite's file change counter: big-endian, at offset 24 of the header.
+        unsigned char header[28];
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        bool ok = std::fread(header, 1, sizeof(header), file) == sizeof(header);
+        std::fclose(file);
+        out.changeCounter = ok ? (static_cast<uint32_t>(header[24]) << 24 | static_cast<uint32_t>(header[25]) << 16 |
+                                  static_cast<uint32_t>(header[26]) << 8 | header[27])
+                               : 0;
+        return ok;
+    }
+
+    uint32_t osPageSize() {
+#ifdef _WIN32
+        return 4096;
+#else
+        return static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    // One bit per OS page of `path`, set if the page is in the page cache.
+    // Empty where mincore() is not available.
+    std::vector<unsigned char> residentPages(const std::string& path, uint64_t bytes, uint32_t pageSize) {
+        std::vector<unsigned char> bitmap;
+#ifndef _WIN32
+        if (bytes == 0) {
+            return bitmap;
+        }
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return bitmap;
+        }
+        void* address = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            return bitmap;
+        }
+        size_t pages = static_cast<size_t>((bytes + pageSize - 1) / pageSize);
+        std::vector<unsigned char> resident(pages);
+        if (mincore(address, bytes, resident.data()) == 0) {
+            bitmap.assign((pages + 7) / 8, 0);
+            for (size_t i = 0; i < pages; i++) {
+                if (resident[i] & 1) {
+                    bitmap[i / 8] |= static_cast<unsigned char>(1u << (i % 8));
+                }
+            }
+        }
+        munmap(address, bytes);
+#else
+        (void)path;
+        (void)bytes;
+        (void)pageSize;
+#endif
+        return bitmap;
+    }
+
+    // Asks the OS to read the marked pages ahead, in runs; returns how many.
+    uint64_t prefetchPages(const std::string& path, const unsigned char* bitmap, size_t bitmapBytes,
+                           uint32_t pageSize, uint64_t maxBytes) {
+        uint64_t prefetched = 0;
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return 0;
+        }
+        uint64_t budget = maxBytes / pageSize;
+        size_t pages = bitmapBytes * 8;
+        for (size_t i = 0; i < pages && prefetched < budget;) {
+            if (!(bitmap[i / 8] & (1u << (i % 8)))) {
+                i++;
+                continue;
+            }
+            size_t run = i;
+            while (run < pages && (bitmap[run / 8] & (1u << (run % 8))) && prefetched + (run - i) < budget) {
+                run++;
+            }
+            posix_fadvise(fd, static_cast<off_t>(i) * pageSize, static_cast<off_t>(run - i) * pageSize,
+                          POSIX_FADV_WILLNEED);
+            prefetched += run - i;
+            i = run;
+        }
+        close(fd);
+#else
+        (void)path;
+        (void)bitmap;
+        (void)bitmapBytes;
+        (void)pageSize;
+        (void)maxBytes;
+#endif
+        return prefetched;
+    }
+
+    // The whole file, mapped read-only where possible.
+    class MappedFile {
+    public:
+        MappedFile() : address(nullptr), length(0) {}
+        ~MappedFile() {
+#ifndef _WIN32
+            if (address) {
+                munmap(address, length);
+            }
+#endif
+        }
+
+        bool open(const std::string& path) {
+#ifdef _WIN32
+            FILE* file = std::fopen(path.c_str(), "rb");
+            if (!file) {
+                return false;
+            }
+            unsigned char chunk[64 * 1024];
+            size_t read;
+            while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+                buffer.insert(buffer.end(), chunk, chunk + read);
+            }
+            std::fclose(file);
+            length = buffer.size();
+            return true;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            bool ok = fstat(fd, &info) == 0 && info.st_size > 0;
+            if (ok) {
+                length = static_cast<size_t>(info.st_size);
+                address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED) {
+                    address = nullptr;
+                    ok = false;
+                }
+            }
+            close(fd);
+            return ok;
+#endif
+        }
+
+        const unsigned char* data() const {
+#ifdef _WIN32
+            return buffer.data();
+#else
+            return static_cast<const unsigned char*>(address);
+#endif
+        }
+        size_t size() const { return length; }
+
+    private:
+        void* address;
+        size_t length;
+#ifdef _WIN32
+        std::vector<unsigned char> buffer;
+#endif
+    };
+
+    bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes) {
+        std::string tmpPath = path + ".tmp";
+        FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Error writing warm state: " << tmpPath << std::endl;
+            return false;
+        }
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && std::fflush(file) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(file)) == 0;
+#else
+        ok = ok && fsync(fileno(file)) == 0;
+#endif
+        ok = std::fclose(file) == 0 && ok;
+        std::error_code ec;
+        if (ok) {
+            std::filesystem::rename(tmpPath, path, ec);
+            ok = !ec;
+        }
+        if (!ok) {
+            std::cerr << "Error writing warm state: " << path << std::endl;
+            std::filesystem::remove(tmpPath, ec);
+        }
+        return ok;
+    }
+}
+
+WarmState::WarmState(const std::string& dbPath, const std::string& statePath, const WarmStateOptions& options,
+                     const DatabaseOptions& databaseOptions)
+    : dbPath(dbPath), statePath(statePath), options(options), databaseOptions(databaseOptions),
+      slots(std::max<size_t>(1, options.maxAccounts * 2)), lastRestore(), warm(false), running(false),
+      stopRequested(false) {
+    for (Slot& slot : slots) {
+        slot.hash = 0;
+        slot.count = 0;
+        slot.length = 0;
+    }
+}
+
+WarmState::~WarmState() {
+    stop();
+}
+
+bool WarmState::start() {
+    if (running) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = false;
+        warm = false;
+    }
+    running = true;
+    worker = std::thread(&WarmState::loop, this);
+    return true;
+}
+
+void WarmState::stop() {
+    if (!running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    save();
+    running = false;
+}
+
+bool WarmState::isWarm() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return warm;
+}
+
+void WarmState::touch(std::string_view email) {
+    add(email, 1);
+}
+
+void WarmState::add(std::string_view email, uint32_t times) {
+    if (email.empty() || email.size() > kMaxKeyLength || times == 0) {
+        return;
+    }
+    uint64_t hash = hashAccountKey(email);
+    std::lock_guard<std::mutex> lock(mutex);
+    Slot& slot = slots[hash % slots.size()];
+    if (slot.count > 0 && slot.hash == hash && slot.length == email.size()) {
+        slot.count = static_cast<uint32_t>(std::min<uint64_t>(UINT32_MAX, uint64_t(slot.count) + times));
+        return;
+    }
+    if (slot.count > times) {
+        slot.count -= times;
+        return;
+    }
+    uint32_t left = times - slot.count;
+    slot.hash = hash;
+    slot.count = std::max<uint32_t>(1, left);
+    slot.length = static_cast<uint32_t>(email.size());
+    std::memcpy(slot.key, email.data(), email.size());
+}
+
+std::vector<std::string> WarmState::hotAccounts() const {
+    std::vector<std::pair<uint32_t, std::string>> counted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Slot& slot : slots) {
+            if (slot.count > 0) {
+                counted.emplace_back(slot.count, std::string(slot.key, slot.length));
+            }
+        }
+    }
+    std::sort(counted.begin(), counted.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::vector<std::string> result;
+    for (size_t i = 0; i < counted.size() && i < options.maxAccounts; i++) {
+        result.push_back(std::move(counted[i].second));
+    }
+    return result;
+}
+
+bool WarmState::save() {
+    std::vector<std::pair<uint32_t, const Slot*>> hot;
+    std::vector<Slot> copy;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        copy = slots;
+        // Halved on every save, so accounts that went quiet give way.
+        for (Slot& slot : slots) {
+            slot.count /= 2;
+        }
+    }
+    for (const Slot& slot : copy) {
+        if (slot.count > 0) {
+            hot.emplace_back(slot.count, &slot);
+        }
+    }
+    std::sort(hot.begin(), hot.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    hot.resize(std::min(hot.size(), options.maxAccounts));
+
+    Fingerprint database;
+    if (!fingerprint(dbPath, database)) {
+        std::cerr << "Error reading database for warm state: " << dbPath << std::endl;
+        return false;
+    }
+    uint32_t pageSize = osPageSize();
+    std::vector<unsigned char> bitmap = residentPages(dbPath, database.bytes, pageSize);
+
+    std::vector<unsigned char> bytes(kHeaderSize + hot.size() * kRecordSize + bitmap.size(), 0);
+    unsigned char* record = bytes.data() + kHeaderSize;
+    for (const auto& entry : hot) {
+        putU32(record, entry.first);
+        putU32(record + 4, entry.second->length);
+        std::memcpy(record + 8, entry.second->key, entry.second->length);
+        record += kRecordSize;
+    }
+    if (!bitmap.empty()) {
+        std::memcpy(record, bitmap.data(), bitmap.size());
+    }
+
+    unsigned char* header = bytes.data();
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    putU32(header + 4, kVersion);
+    putU64(header + 8, database.bytes);
+    putU64(header + 16, database.mtimeNs);
+    putU32(header + 24, database.changeCounter);
+    putU32(header + 28, pageSize);
+    putU32(header + 32, static_cast<uint32_t>(hot.size()));
+    putU32(header + 36, static_cast<uint32_t>(bitmap.size()));
+    putU32(header + 40, crc32(bytes.data() + kHeaderSize, bytes.size() - kHeaderSize));
+    return writeFile(statePath, bytes);
+}
+
+WarmStateReport WarmState::restore() {
+    auto started = std::chrono::steady_clock::now();
+    WarmStateReport result = {};
+    MappedFile file;
+    // No file is a normal first start.
+    if (file.open(statePath)) {
+        const unsigned char* header = file.data();
+        bool valid = file.size() >= kHeaderSize && std::memcmp(header, kMagic, sizeof(kMagic)) == 0 &&
+                     getU32(header + 4) == kVersion;
+        uint64_t accounts = valid ? getU32(header + 32) : 0;
+        uint64_t bitmapBytes = valid ? getU32(header + 36) : 0;
+        valid = valid && file.size() == kHeaderSize + accounts * kRecordSize + bitmapBytes &&
+                crc32(header + kHeaderSize, file.size() - kHeaderSize) == getU32(header + 40);
+        if (!valid) {
+            std::cerr << "Ignoring damaged warm state: " << statePath << std::endl;
+        } else {
+            result.loaded = true;
+            result.accounts = accounts;
+            const unsigned char* records = header + kHeaderSize;
+
+            Fingerprint saved;
+            saved.bytes = getU64(header + 8);
+            saved.mtimeNs = getU64(header + 16);
+            saved.changeCounter = getU32(header + 24);
+            Fingerprint current;
+            result.pagesMatched = fingerprint(dbPath, current) && current == saved &&
+                                  getU32(header + 28) == osPageSize();
+            if (result.pagesMatched) {
+                result.pagesPrefetched = prefetchPages(dbPath, records + accounts * kRecordSize,
+                                                       static_cast<size_t>(bitmapBytes), osPageSize(),
+                                                       options.maxPrefetchBytes);
+            }
+
+            Database db(dbPath, databaseOptions);
+            if (db.initialize()) {
+                FetchedCredential fetched;
+                for (uint64_t i = 0; i < accounts && !stopping(); i++) {
+                    const unsigned char* record = records + i * kRecordSize;
+                    uint32_t length = std::min<uint32_t>(getU32(record + 4), kMaxKeyLength);
+                    std::string_view email(reinterpret_cast<const char*>(record + 8), length);
+                    if (db.fetchCredential(email, fetched) == LoginOutcome::Success && fetched.found) {
+                        result.accountsWarmed++;
+                        // Aged like a save, so they stay hot until traffic says otherwise.
+                        add(email, std::max<uint32_t>(1, getU32(record) / 2));
+                    }
+                }
+            }
+        }
+    }
+    result.restoreMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    lastRestore = result;
+    return result;
+}
+
+WarmStateReport WarmState::report() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastRestore;
+}
+
+bool WarmState::stopping() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stopRequested;
+}
+
+void WarmState::loop() {
+    restore();
+    std::unique_lock<std::mutex> lock(mutex);
+    warm = true;
+    while (!stopRequested) {
+        if (options.saveIntervalMs > 0) {
+            wake.wait_for(lock, std::chrono::milliseconds(options.saveIntervalMs));
+        } else {
+            wake.wait(lock);
+        }
+        if (stopRequested) {
+            break;
+        }
+        lock.unlock();
+        save();
+        lock.lock();
+    }
+}
+
+// ============================================
+// WarmStateStage
+// ============================================
+
+void WarmStateStage::observe(const LoginContext& context) {
+    // Only accounts that exist are worth warming.
+    if (context.outcome == LoginOutcome::Success || context.outcome == LoginOutcome::WrongPassword) {
+        state.touch(context.request.email);
+    }
+}
@@ -0,0 +1,69 @@
+#include "ZipfGenerator.h"
+#include <cmath>
+
+namespace {
+    // log1p(x) / x, stable around 0.
+    double helper1(double x) {
+        if (std::fabs(x) > 1e-8) {
+            return std::log1p(x) / x;
+        }
+        return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // expm1(x) / x, stable around 0.
+    double helper2(double x) {
+        if (std::fabs(x) > 1e-8) {
+            return std::expm1(x) / x;
+        }
+        return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+}
+
+ZipfGenerator::ZipfGenerator(uint64_t n, double exponent)
+    : n(n == 0 ? 1 : n),
+      exponent(exponent < 0 ? 0 : exponent),
+      hIntegralX1(0),
+      hIntegralN(0),
+      squeeze(0) {
+    hIntegralX1 = hIntegral(1.5) - 1.0;
+    hIntegralN = hIntegral(static_cast<double>(this->n) + 0.5);
+    squeeze = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+}
+
+double ZipfGenerator::h(double x) const {
+    return std::exp(-exponent * std::log(x));
+}
+
+double ZipfGenerator::hIntegral(double x) const {
+    double logX = std::log(x);
+    return helper2((1.0 - exponent) * logX) * logX;
+}
+
+double ZipfGenerator::hIntegralInverse(double x) const {
+    double t = x * (1.0 - exponent);
+    if (t < -1.0) {
+        t = -1.0;
+    }
+    return std::exp(helper1(t) * x);
+}
+
+uint64_t ZipfGenerator::next(std::mt19937_64& rng) {
+    if (exponent == 0) {
+        return std::uniform_int_distribution<uint64_t>(0, n - 1)(rng);
+    }
+
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    while (true) {
+        double u = hIntegralN + uniform(rng) * (hIntegralX1 - hIntegralN);
+        double x = hIntegralInverse(u);
+        double k = std::floor(x + 0.5);
+        if (k < 1) {
+            k = 1;
+        } else if (k > static_cast<double>(n)) {
+            k = static_cast<double>(n);
+        }
+        if (k - x <= squeeze || u >= hIntegral(k + 0.5) - h(k)) {
+            return static_cast<uint64_t>(k) - 1;
+        }
+    }
+}
@@ -1,7 +1,25 @@
 #include "AuthScreen.h"
+#include "Profiler.h"
+#include <string>
 
-int main() {
-    AuthScreen authScreen;
+int main(int argc, char* argv[]) {
+    std::string tracePath;
+    // --profile FILE samples the CPU at 100 Hz and writes a pprof profile
+    // to FILE on SIGUSR2 and at exit.
+    ProfilerOptions profilerOptions;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--trace") {
+            tracePath = argv[i + 1];
+        } else if (std::string(argv[i]) == "--profile") {
+            profilerOptions.outputPath = argv[i + 1];
+        }
+    }
+    CpuProfiler profiler(profilerOptions);
+    if (!profilerOptions.outputPath.empty()) {
+        profiler.start();
+    }
+    
+    AuthScreen authScreen(tracePath);
     authScreen.run();
     return 0;
 }
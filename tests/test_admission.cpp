@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "AdmissionController.h"
+#include "AuthPipeline.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// ============================================
+// PRUEBAS UNITARIAS - Control de admisión
+// ============================================
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Stands in for storage: every login that gets this far succeeds.
+    class AcceptStage : public AuthStage {
+    public:
+        const char* name() const override { return "accept"; }
+        int cost() const override { return 100; }
+        bool decide(LoginContext& context) override {
+            context.outcome = LoginOutcome::Success;
+            return true;
+        }
+    };
+
+    AdmissionOptions options(size_t maxInFlight, std::chrono::milliseconds target,
+                             std::chrono::milliseconds interval) {
+        AdmissionOptions result;
+        result.maxInFlight = maxInFlight;
+        result.target = target;
+        result.interval = interval;
+        return result;
+    }
+}
+
+// Test de límite: como mucho maxInFlight a la vez; el resto espera su turno
+TEST(AdmissionTest, AdmitsUpToMaxInFlight) {
+    AdmissionController controller(options(2, std::chrono::milliseconds(5), std::chrono::seconds(1)));
+    EXPECT_TRUE(controller.acquire(false));
+    EXPECT_TRUE(controller.acquire(false));
+    EXPECT_FALSE(controller.acquire(false, Clock::now() + std::chrono::milliseconds(10)));
+
+    std::thread waiter([&]() {
+        EXPECT_TRUE(controller.acquire(false));
+        controller.release();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    controller.release();
+    waiter.join();
+    controller.release();
+
+    AdmissionStats stats = controller.stats();
+    EXPECT_EQ(stats.admitted, 3u);
+    EXPECT_EQ(stats.shed, 1u);
+    EXPECT_GE(stats.queueDelay.max(), 10u * 1000 * 1000);
+    EXPECT_FALSE(controller.overloaded());
+}
+
+// Test de descarte: con la cola parada un intervalo, un login nuevo no espera más de 2*target
+TEST(AdmissionTest, StandingQueueShedsFreshLogins) {
+    AdmissionController controller(options(1, std::chrono::milliseconds(1), std::chrono::milliseconds(100)));
+    ASSERT_TRUE(controller.acquire(false));
+
+    // The first interval saw an admission without wait; in the second
+    // nobody waits less than target, so the queue is standing.
+    EXPECT_FALSE(controller.acquire(false));
+    EXPECT_FALSE(controller.acquire(false));
+    EXPECT_TRUE(controller.overloaded());
+
+    auto started = Clock::now();
+    EXPECT_FALSE(controller.acquire(false));
+    EXPECT_LT(Clock::now() - started, std::chrono::milliseconds(50));
+
+    // A login with a session still waits for the slot.
+    std::thread session([&]() {
+        EXPECT_TRUE(controller.acquire(true));
+        controller.release();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    controller.release();
+    session.join();
+
+    AdmissionStats stats = controller.stats();
+    EXPECT_EQ(stats.shed, 3u);
+    EXPECT_EQ(stats.sessionShed, 0u);
+    EXPECT_EQ(stats.sessionAdmitted, 1u);
+}
+
+// Test de prioridad: un login con sesión pasa antes que uno nuevo que ya esperaba
+TEST(AdmissionTest, SessionGoesAheadOfFreshLogins) {
+    AdmissionController controller(options(1, std::chrono::milliseconds(5), std::chrono::seconds(2)));
+    ASSERT_TRUE(controller.acquire(false));
+
+    std::atomic<int> order(0);
+    int freshTurn = 0;
+    int sessionTurn = 0;
+    std::thread fresh([&]() {
+        if (controller.acquire(false)) {
+            freshTurn = ++order;
+            controller.release();
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::thread session([&]() {
+        if (controller.acquire(true)) {
+            sessionTurn = ++order;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            controller.release();
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    controller.release();
+    fresh.join();
+    session.join();
+
+    EXPECT_EQ(sessionTurn, 1);
+    EXPECT_EQ(freshTurn, 2);
+}
+
+// Test de etapa: un login descartado termina en Overloaded y libera su hueco
+TEST(AdmissionTest, StageShedsAsOverloadedAndReleasesTheSlot) {
+    AdmissionController controller(options(1, std::chrono::milliseconds(5), std::chrono::seconds(1)));
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    pipeline.add(std::make_unique<AdmissionStage>(controller));
+    pipeline.add(std::make_unique<AcceptStage>());
+
+    LoginRequest request;
+    request.email = "user@example.com";
+    request.password = "Pass@123";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+
+    ASSERT_TRUE(controller.acquire(false));
+    request.deadline = Clock::now() + std::chrono::milliseconds(10);
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::Overloaded);
+    controller.release();
+
+    AdmissionStats stats = controller.stats();
+    EXPECT_EQ(stats.admitted, 3u);
+    EXPECT_EQ(stats.shed, 1u);
+}
@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+#include "Arena.h"
+#include "Database.h"
+#include "HashingPool.h"
+#include "PasswordValidator.h"
+#include "SharedCredentialCache.h"
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// ============================================
+// PRUEBAS UNITARIAS - Asignaciones de memoria en el login
+// ============================================
+
+namespace {
+    // Every operator new in the process, on any thread, and every SQLite
+    // malloc/realloc.
+    std::atomic<uint64_t> heapAllocations{0};
+    std::atomic<uint64_t> sqliteAllocations{0};
+    sqlite3_mem_methods sqliteMemory;
+
+    void* countingSqliteMalloc(int bytes) {
+        sqliteAllocations.fetch_add(1, std::memory_order_relaxed);
+        return sqliteMemory.xMalloc(bytes);
+    }
+
+    void* countingSqliteRealloc(void* memory, int bytes) {
+        sqliteAllocations.fetch_add(1, std::memory_order_relaxed);
+        return sqliteMemory.xRealloc(memory, bytes);
+    }
+
+    // Runs before main(), ahead of the first sqlite3_open(); if SQLite was
+    // already initialized only operator new is counted.
+    bool countSqliteAllocations() {
+        if (sqlite3_config(SQLITE_CONFIG_GETMALLOC, &sqliteMemory) != SQLITE_OK) {
+            return false;
+        }
+        sqlite3_mem_methods counting = sqliteMemory;
+        counting.xMalloc = countingSqliteMalloc;
+        counting.xRealloc = countingSqliteRealloc;
+        return sqlite3_config(SQLITE_CONFIG_MALLOC, &counting) == SQLITE_OK;
+    }
+
+    const bool sqliteCounted = countSqliteAllocations();
+
+    struct Allocations {
+        uint64_t heap;
+        uint64_t sqlite;
+    };
+
+    Allocations allocationsNow() {
+        return Allocations{heapAllocations.load(), sqliteAllocations.load()};
+    }
+}
+
+// Counting global allocator. operator new[] and the nothrow forms end up
+// here as well.
+void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+class AllocationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "allocation_test.db";
+        std::filesystem::remove(testDbPath);
+        dbOptions.hashCost = HashCost{4, 8, 1};
+        dbOptions.hashingPool = &pool;
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(testDbPath);
+    }
+
+    // Runs a mix of logins and returns the allocations they made.
+    Allocations loginAllocations(Database& db, int rounds) {
+        Allocations before = allocationsNow();
+        for (int i = 0; i < rounds; i++) {
+            bool ok = db.authenticate("user@example.com", "Pass@123") == LoginOutcome::Success &&
+                      db.authenticate("user@example.com", "Wrong@123") == LoginOutcome::WrongPassword &&
+                      db.authenticate("nadie@example.com", "Pass@123") == LoginOutcome::UnknownUser;
+            if (!ok) {
+                ADD_FAILURE() << "unexpected login outcome in round " << i;
+                break;
+            }
+        }
+        Allocations after = allocationsNow();
+        return Allocations{after.heap - before.heap, after.sqlite - before.sqlite};
+    }
+
+    std::string testDbPath;
+    HashingPool pool{1};
+    DatabaseOptions dbOptions;
+};
+
+// Test de arena: tras un reset reutiliza su bloque sin volver al heap
+TEST_F(AllocationTest, ArenaReusesItsBlockAfterReset) {
+    Arena arena(256);
+    for (int i = 0; i < 100; i++) {
+        arena.allocate(100);
+    }
+    arena.copy("user@example.com");
+    arena.reset();
+    size_t capacity = arena.capacity();
+    EXPECT_GE(capacity, 100u * 100u);
+
+    uint64_t before = heapAllocations.load();
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 100; i++) {
+            void* memory = arena.allocate(100);
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(memory) % alignof(std::max_align_t), 0u);
+        }
+        EXPECT_EQ(arena.copy("user@example.com"), "user@example.com");
+        arena.reset();
+    }
+    EXPECT_EQ(heapAllocations.load() - before, 0u);
+    EXPECT_EQ(arena.capacity(), capacity);
+
+    // A much smaller request gives the surplus back.
+    arena.allocate(10);
+    arena.reset();
+    EXPECT_LT(arena.capacity(), capacity);
+}
+
+// Test de login en régimen estable: ni el login ni el pool de hashing asignan memoria
+TEST_F(AllocationTest, SteadyStateLoginMakesNoHeapAllocations) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+    // Warm up: statement, arenas, pool slots and scrypt scratch.
+    loginAllocations(db, 3);
+
+    Allocations made = loginAllocations(db, 20);
+    EXPECT_EQ(made.heap, 0u);
+    // Builds without lookaside (SQLITE_OMIT_LOOKASIDE, as some distributions
+    // ship) malloc each statement's cursor on every step.
+    std::cout << "Asignaciones de SQLite por login: " << made.sqlite / 60.0 << std::endl;
+    if (sqliteCounted && !sqlite3_compileoption_used("OMIT_LOOKASIDE")) {
+        EXPECT_EQ(made.sqlite, 0u);
+    }
+}
+
+#ifndef _WIN32
+// Test de login con cache compartida: los aciertos de cache tampoco asignan memoria
+TEST_F(AllocationTest, SharedCacheHitsMakeNoHeapAllocations) {
+    std::string cacheName = "/authscreen-alloc-" + std::to_string(getpid());
+    SharedCredentialCache::unlink(cacheName);
+    SharedCredentialCache cache;
+    ASSERT_TRUE(cache.attach(cacheName, 1024));
+    dbOptions.sharedCache = &cache;
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+    loginAllocations(db, 3);
+
+    Allocations made = loginAllocations(db, 20);
+    EXPECT_EQ(made.heap, 0u);
+    EXPECT_GT(db.stats().cacheHits, 0u);
+    SharedCredentialCache::unlink(cacheName);
+}
+#endif
+
+// Test de validación: la política de contraseñas no copia la entrada
+TEST_F(AllocationTest, PasswordValidationMakesNoHeapAllocations) {
+    const char* candidates[] = {"Pass@123", "corta", "SinEspecial1", "Larguisima@1234"};
+    uint64_t before = heapAllocations.load();
+    int valid = 0;
+    for (const char* candidate : candidates) {
+        valid += PasswordValidator::validate(candidate) ? 1 : 0;
+    }
+    EXPECT_EQ(heapAllocations.load() - before, 0u);
+    EXPECT_EQ(valid, 1);
+}
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include "AuditLog.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Log de auditoría
+// ============================================
+
+class AuditLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        options.directory = "audit_test_dir";
+        std::filesystem::remove_all(options.directory);
+    }
+    
+    void TearDown() override {
+        std::filesystem::remove_all(options.directory);
+    }
+    
+    std::vector<AuditRecord> readAll() {
+        std::vector<AuditRecord> records;
+        AuditLogReader reader(options.directory);
+        AuditRecord record;
+        while (reader.next(record)) {
+            records.push_back(record);
+        }
+        return records;
+    }
+    
+    AuditLogOptions options;
+};
+
+// Test de ida y vuelta: los registros se leen en orden
+TEST_F(AuditLogTest, AppendAndReadBack) {
+    {
+        AuditLog log(options);
+        ASSERT_TRUE(log.start());
+        EXPECT_TRUE(log.append("user@example.com", LoginOutcome::Success, 1));
+        EXPECT_TRUE(log.append("user@example.com", LoginOutcome::WrongPassword, 2));
+        EXPECT_TRUE(log.append("user@example.com", LoginOutcome::WrongPassword, 5, AuditEvent::Lockout));
+    }
+    
+    auto records = readAll();
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].account, "user@example.com");
+    EXPECT_EQ(records[0].outcome, LoginOutcome::Success);
+    EXPECT_EQ(records[1].attempt, 2u);
+    EXPECT_EQ(records[2].event, AuditEvent::Lockout);
+    EXPECT_LE(records[0].timestampNs, records[2].timestampNs);
+}
+
+// Test de durabilidad: flush espera a que los registros estén en disco
+TEST_F(AuditLogTest, FlushMakesRecordsDurable) {
+    AuditLog log(options);
+    ASSERT_TRUE(log.start());
+    for (int i = 0; i < 100; i++) {
+        log.append("user" + std::to_string(i), LoginOutcome::UnknownUser);
+    }
+    log.flush();
+    
+    AuditLogStats stats = log.stats();
+    EXPECT_EQ(stats.written, 100u);
+    EXPECT_GE(stats.groupCommits, 1u);
+    EXPECT_EQ(readAll().size(), 100u);
+}
+
+// Test de group commit: muchos registros comparten un fsync
+TEST_F(AuditLogTest, GroupCommitBatchesRecords) {
+    options.idleWaitMs = 20;
+    AuditLog log(options);
+    ASSERT_TRUE(log.start());
+    for (int i = 0; i < 5000; i++) {
+        log.append("user@example.com", LoginOutcome::Success);
+    }
+    log.flush();
+    
+    AuditLogStats stats = log.stats();
+    EXPECT_EQ(stats.written, 5000u);
+    EXPECT_LT(stats.groupCommits, 100u);
+}
+
+// Test de rotación de segmentos
+TEST_F(AuditLogTest, RotatesSegments) {
+    options.maxSegmentBytes = 4096;
+    options.maxGroupRecords = 16;
+    {
+        AuditLog log(options);
+        ASSERT_TRUE(log.start());
+        for (int i = 0; i < 1000; i++) {
+            log.append("rotation" + std::to_string(i) + "@example.com", LoginOutcome::Success);
+        }
+    }
+    
+    AuditLogReader reader(options.directory);
+    EXPECT_GT(reader.segmentCount(), 5u);
+    for (const auto& entry : std::filesystem::directory_iterator(options.directory)) {
+        EXPECT_LE(entry.file_size(), 4096u + 16 * 128);
+    }
+    EXPECT_EQ(readAll().size(), 1000u);
+}
+
+// Test de reinicio: un nuevo log continúa en un segmento nuevo sin sobrescribir
+TEST_F(AuditLogTest, RestartAppendsNewSegment) {
+    for (int run = 0; run < 2; run++) {
+        AuditLog log(options);
+        ASSERT_TRUE(log.start());
+        log.append("run" + std::to_string(run), LoginOutcome::Success);
+    }
+    
+    auto records = readAll();
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].account, "run0");
+    EXPECT_EQ(records[1].account, "run1");
+}
+
+// Test de concurrencia: varios productores sin perder registros
+TEST_F(AuditLogTest, ConcurrentProducers) {
+    AuditLog log(options);
+    ASSERT_TRUE(log.start());
+    
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; t++) {
+        producers.emplace_back([&log, t]() {
+            for (int i = 0; i < 2000; i++) {
+                log.append("t" + std::to_string(t) + "-" + std::to_string(i), LoginOutcome::Success);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    log.stop();
+    
+    AuditLogStats stats = log.stats();
+    EXPECT_EQ(stats.appended + stats.dropped, 8000u);
+    auto records = readAll();
+    EXPECT_EQ(records.size(), stats.appended);
+    std::set<std::string> unique;
+    for (const auto& record : records) {
+        unique.insert(record.account);
+    }
+    EXPECT_EQ(unique.size(), records.size());
+}
+
+// Test de saturación: con el ring lleno se descarta en vez de bloquear
+TEST_F(AuditLogTest, FullRingDropsInsteadOfBlocking) {
+    options.ringCapacity = 8;
+    options.idleWaitMs = 200;
+    AuditLog log(options);
+    ASSERT_TRUE(log.start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    
+    int accepted = 0;
+    for (int i = 0; i < 100; i++) {
+        if (log.append("burst", LoginOutcome::Success)) {
+            accepted++;
+        }
+    }
+    EXPECT_EQ(accepted, 8);
+    EXPECT_EQ(log.stats().dropped, 92u);
+}
+
+// Test de recuperación: un registro final truncado se ignora
+TEST_F(AuditLogTest, TornTailIsSkipped) {
+    {
+        AuditLog log(options);
+        ASSERT_TRUE(log.start());
+        log.append("complete", LoginOutcome::Success);
+    }
+    std::string segmentPath;
+    for (const auto& entry : std::filesystem::directory_iterator(options.directory)) {
+        segmentPath = entry.path().string();
+    }
+    {
+        std::ofstream out(segmentPath, std::ios::binary | std::ios::app);
+        out.write("\x20\x00\x00\x00garbage", 11);
+    }
+    
+    AuditLogReader reader(options.directory);
+    AuditRecord record;
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.account, "complete");
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_EQ(reader.corruptRecords(), 1u);
+}
+
+#ifndef _WIN32
+
+// Test de disco lleno: un grupo que no llega al disco no se cuenta como escrito y flush() lo informa
+TEST_F(AuditLogTest, FailedWriteIsNotReportedDurable) {
+    if (!std::filesystem::exists("/dev/full")) {
+        GTEST_SKIP() << "/dev/full no disponible";
+    }
+    // The first segment is a disk that is always full.
+    std::filesystem::create_directories(options.directory);
+    std::filesystem::create_symlink("/dev/full", std::filesystem::path(options.directory) / "audit-000001.seg");
+    AuditLog log(options);
+    ASSERT_TRUE(log.start());
+
+    log.append("lost@example.com", LoginOutcome::Success);
+    EXPECT_FALSE(log.flush());
+    AuditLogStats stats = log.stats();
+    EXPECT_EQ(stats.written, 0u);
+    EXPECT_EQ(stats.failed, 1u);
+
+    // The next group goes to a new segment; the earlier loss still shows.
+    log.append("kept@example.com", LoginOutcome::Success);
+    EXPECT_FALSE(log.flush());
+    EXPECT_EQ(log.stats().written, 1u);
+    log.stop();
+
+    auto records = readAll();
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].account, "kept@example.com");
+}
+
+#endif
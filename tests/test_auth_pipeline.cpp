@@ -0,0 +1,261 @@
+#include <gtest/gtest.h>
+#include "AuditLog.h"
+#include "AuthPipeline.h"
+#include "Database.h"
+#include "LoginTrace.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+// ============================================
+// PRUEBAS UNITARIAS - Pipeline de login
+// ============================================
+
+namespace {
+    LoginRequest loginRequest(std::string_view email, std::string_view password) {
+        LoginRequest request;
+        request.email = email;
+        request.password = password;
+        return request;
+    }
+
+    // Counts the logins that reach storage.
+    class CountingStorageStage : public StorageStage {
+    public:
+        explicit CountingStorageStage(Database& db) : StorageStage(db), calls(0) {}
+
+        bool decide(LoginContext& context) override {
+            calls++;
+            return StorageStage::decide(context);
+        }
+
+        int calls;
+    };
+}
+
+class AuthPipelineTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "pipeline_test.db";
+        std::filesystem::remove(testDbPath);
+        DatabaseOptions options;
+        options.hashCost = HashCost{4, 8, 1};
+        db = std::make_unique<Database>(testDbPath, options);
+        ASSERT_TRUE(db->initialize());
+        ASSERT_TRUE(db->addUser("user@example.com", "Pass@123"));
+    }
+
+    void TearDown() override {
+        db.reset();
+        std::filesystem::remove(testDbPath);
+    }
+
+    // Adds a counting storage stage and returns it.
+    CountingStorageStage* addStorage(AuthPipeline& pipeline) {
+        auto stage = std::make_unique<CountingStorageStage>(*db);
+        CountingStorageStage* storage = stage.get();
+        pipeline.add(std::move(stage));
+        return storage;
+    }
+
+    const AuthStageStats* findStats(const std::vector<AuthStageStats>& stats, const std::string& name) {
+        for (const AuthStageStats& stage : stats) {
+            if (name == stage.name) {
+                return &stage;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string testDbPath;
+    std::unique_ptr<Database> db;
+};
+
+// Test de orden: las etapas baratas van primero aunque se añadan después
+TEST_F(AuthPipelineTest, CheaperStagesRunFirstAndShortCircuit) {
+    AuthPipeline pipeline;
+    CountingStorageStage* storage = addStorage(pipeline);
+    pipeline.add(std::make_unique<PolicyStage>());
+    pipeline.add(std::make_unique<NormalizeStage>());
+
+    std::vector<AuthStageStats> stats = pipeline.stats();
+    ASSERT_EQ(stats.size(), 3u);
+    EXPECT_STREQ(stats[0].name, "normalize");
+    EXPECT_STREQ(stats[1].name, "policy");
+    EXPECT_STREQ(stats[2].name, "storage");
+
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "debil")), LoginOutcome::PolicyRejected);
+    EXPECT_EQ(pipeline.authenticate(loginRequest("   ", "Pass@123")), LoginOutcome::UnknownUser);
+    EXPECT_EQ(storage->calls, 0);
+
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::Success);
+    EXPECT_EQ(storage->calls, 1);
+}
+
+// Test de normalización: los espacios alrededor del email no impiden el login
+TEST_F(AuthPipelineTest, NormalizeTrimsEmail) {
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    addStorage(pipeline);
+
+    EXPECT_EQ(pipeline.authenticate(loginRequest("  user@example.com\t\n", "Pass@123")), LoginOutcome::Success);
+    std::string overlong(NormalizeStage::kMaxEmailLength + 1, 'a');
+    EXPECT_EQ(pipeline.authenticate(loginRequest(overlong, "Pass@123")), LoginOutcome::UnknownUser);
+}
+
+// Test de cache negativa: un usuario desconocido repetido no vuelve a la base
+TEST_F(AuthPipelineTest, NegativeCacheAnswersRepeatedUnknownUser) {
+    AuthPipeline pipeline;
+    auto cache = std::make_unique<NegativeCacheStage>();
+    NegativeCacheStage* negative = cache.get();
+    pipeline.add(std::move(cache));
+    CountingStorageStage* storage = addStorage(pipeline);
+
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(pipeline.authenticate(loginRequest("nadie@example.com", "Pass@123")), LoginOutcome::UnknownUser);
+    }
+    EXPECT_EQ(storage->calls, 1);
+
+    // An account created meanwhile is seen once its entry is forgotten.
+    ASSERT_TRUE(db->addUser("nadie@example.com", "Pass@123"));
+    negative->forget("nadie@example.com");
+    EXPECT_EQ(pipeline.authenticate(loginRequest("nadie@example.com", "Pass@123")), LoginOutcome::Success);
+    EXPECT_EQ(storage->calls, 2);
+}
+
+// Test de cache positiva: repetir un login correcto no recalcula el hash
+TEST_F(AuthPipelineTest, PositiveCacheSkipsStorageOnRepeatedSuccess) {
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<PositiveCacheStage>());
+    CountingStorageStage* storage = addStorage(pipeline);
+
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::Success);
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::Success);
+    EXPECT_EQ(storage->calls, 1);
+
+    // Another password never matches the cached entry; its failure drops it.
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Otra@123")), LoginOutcome::WrongPassword);
+    EXPECT_EQ(storage->calls, 2);
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::Success);
+    EXPECT_EQ(storage->calls, 3);
+}
+
+// Test de límite: tras N fallos la cuenta se rechaza sin consultar la base
+TEST_F(AuthPipelineTest, RateLimitTurnsAwayAfterFailures) {
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<RateLimitStage>(3, std::chrono::minutes(1)));
+    CountingStorageStage* storage = addStorage(pipeline);
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Mala@123")), LoginOutcome::WrongPassword);
+    }
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::RateLimited);
+    EXPECT_EQ(storage->calls, 3);
+    EXPECT_STREQ(loginOutcomeName(LoginOutcome::RateLimited), "rate-limited");
+
+    // Other accounts are not affected.
+    ASSERT_TRUE(db->addUser("otro@example.com", "Pass@123"));
+    EXPECT_EQ(pipeline.authenticate(loginRequest("otro@example.com", "Pass@123")), LoginOutcome::Success);
+}
+
+// Test de ventana: al caducar la ventana la cuenta vuelve a intentarlo
+TEST_F(AuthPipelineTest, RateLimitWindowExpires) {
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<RateLimitStage>(1, std::chrono::milliseconds(50)));
+    addStorage(pipeline);
+
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Mala@123")), LoginOutcome::WrongPassword);
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::RateLimited);
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::Success);
+}
+
+// Test de observadores: auditoría y traza ven cada resultado, decida quien decida
+TEST_F(AuthPipelineTest, ObserversSeeEveryOutcome) {
+    AuditLogOptions auditOptions;
+    auditOptions.directory = "pipeline_audit_dir";
+    std::filesystem::remove_all(auditOptions.directory);
+    std::string tracePath = "pipeline_test.trace";
+    {
+        AuditLog audit(auditOptions);
+        ASSERT_TRUE(audit.start());
+        LoginTraceWriter trace;
+        ASSERT_TRUE(trace.open(tracePath));
+        db->setTraceRecorder(&trace);
+
+        AuthPipeline pipeline;
+        pipeline.add(std::make_unique<PolicyStage>());
+        addStorage(pipeline);
+        pipeline.add(std::make_unique<AuditStage>(audit));
+        pipeline.add(std::make_unique<TraceStage>(trace));
+
+        LoginRequest request = loginRequest("user@example.com", "debil");
+        request.attempt = 1;
+        EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::PolicyRejected);
+        request = loginRequest("user@example.com", "Pass@123");
+        request.attempt = 2;
+        EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+
+        // One record each: storage traced the second login itself.
+        EXPECT_EQ(trace.recordCount(), 2u);
+        db->setTraceRecorder(nullptr);
+    }
+
+    AuditLogReader reader(auditOptions.directory);
+    AuditRecord record;
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.outcome, LoginOutcome::PolicyRejected);
+    EXPECT_EQ(record.attempt, 1u);
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.outcome, LoginOutcome::Success);
+    EXPECT_EQ(record.attempt, 2u);
+    EXPECT_FALSE(reader.next(record));
+
+    std::filesystem::remove_all(auditOptions.directory);
+    std::filesystem::remove(tracePath);
+}
+
+// Test de estadísticas: tasa de acierto y latencia por etapa
+TEST_F(AuthPipelineTest, StatsReportHitRatioAndLatencyPerStage) {
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<PolicyStage>());
+    pipeline.add(std::make_unique<PositiveCacheStage>());
+    addStorage(pipeline);
+
+    pipeline.authenticate(loginRequest("user@example.com", "debil"));
+    for (int i = 0; i < 3; i++) {
+        pipeline.authenticate(loginRequest("user@example.com", "Pass@123"));
+    }
+
+    std::vector<AuthStageStats> stats = pipeline.stats();
+    const AuthStageStats* policy = findStats(stats, "policy");
+    const AuthStageStats* cache = findStats(stats, "positive-cache");
+    const AuthStageStats* storage = findStats(stats, "storage");
+    ASSERT_TRUE(policy && cache && storage);
+    EXPECT_EQ(policy->evaluated, 4u);
+    EXPECT_DOUBLE_EQ(policy->hitRatio(), 0.25);
+    EXPECT_EQ(cache->evaluated, 3u);
+    EXPECT_EQ(cache->decided, 2u);
+    EXPECT_EQ(storage->evaluated, 1u);
+    EXPECT_DOUBLE_EQ(storage->hitRatio(), 1.0);
+    // decide() is timed when asked, observe() on every login.
+    EXPECT_EQ(cache->latency.count(), 3u);
+    EXPECT_EQ(storage->latency.count(), 1u);
+    EXPECT_EQ(storage->observeLatency.count(), 4u);
+    EXPECT_GT(storage->latency.max(), cache->latency.percentile(50));
+
+    pipeline.resetStats();
+    for (const AuthStageStats& stage : pipeline.stats()) {
+        EXPECT_EQ(stage.evaluated, 0u);
+        EXPECT_EQ(stage.latency.count(), 0u);
+        EXPECT_EQ(stage.observeLatency.count(), 0u);
+    }
+}
+
+// Test sin almacenamiento: si ninguna etapa decide el resultado es un error
+TEST_F(AuthPipelineTest, UndecidedLoginIsStorageError) {
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    EXPECT_EQ(pipeline.authenticate(loginRequest("user@example.com", "Pass@123")), LoginOutcome::StorageError);
+}
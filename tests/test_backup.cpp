@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "Snapshot.h"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Copia de seguridad y restauración
+// ============================================
+
+class BackupTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "backup_test.db";
+        snapshotPath = "backup_test.snap";
+        removeFiles();
+        // Backups copy pages, not hashes
+        dbOptions.hashCost = HashCost{4, 1, 1};
+    }
+
+    void TearDown() override {
+        removeFiles();
+    }
+
+    void removeFiles() {
+        for (const char* suffix : {"", "-wal", "-shm", ".restore"}) {
+            std::filesystem::remove(testDbPath + suffix);
+        }
+        std::filesystem::remove(snapshotPath);
+    }
+
+    std::vector<std::pair<std::string, std::string>> makeUsers(int first, int count) {
+        std::vector<std::pair<std::string, std::string>> users;
+        for (int i = first; i < first + count; i++) {
+            users.emplace_back("user" + std::to_string(i) + "@example.com", "Pass@" + std::to_string(i));
+        }
+        return users;
+    }
+
+    std::string testDbPath;
+    std::string snapshotPath;
+    DatabaseOptions dbOptions;
+};
+
+// Test de ida y vuelta: restaurar devuelve la base al momento de la copia
+TEST_F(BackupTest, RestoreReturnsToBackedUpState) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUsers(makeUsers(0, 2000)));
+
+    BackupOptions options;
+    options.pagesPerStep = 16;
+    options.pauseMs = 0;
+    BackupReport report = {};
+    ASSERT_TRUE(db.backup(snapshotPath, options, &report));
+    EXPECT_GT(report.steps, 1u);
+    EXPECT_EQ(report.restarts, 0u);
+    EXPECT_GT(report.databaseBytes, 0u);
+    EXPECT_GT(report.snapshotBytes, 0u);
+    EXPECT_LT(report.snapshotBytes, report.databaseBytes);
+    EXPECT_GT(report.megabytesPerSecond, 0.0);
+    EXPECT_FALSE(std::filesystem::exists(snapshotPath + ".copy"));
+
+    ASSERT_TRUE(db.addUser("late@example.com", "Late@1"));
+    ASSERT_TRUE(db.restore(snapshotPath));
+    EXPECT_TRUE(db.validateUser("user0@example.com", "Pass@0"));
+    EXPECT_TRUE(db.validateUser("user1999@example.com", "Pass@1999"));
+    EXPECT_FALSE(db.validateUser("late@example.com", "Late@1"));
+    EXPECT_FALSE(std::filesystem::exists(testDbPath + ".restore"));
+}
+
+// Test de copia en caliente: en WAL la copia es consistente mientras otro escribe
+TEST_F(BackupTest, WalBackupIsConsistentUnderConcurrentWrites) {
+    dbOptions.walMode = true;
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUsers(makeUsers(0, 3000)));
+
+    std::atomic<bool> done(false);
+    std::atomic<int> written(0);
+    std::thread writer([&]() {
+        Database other(testDbPath, dbOptions);
+        if (!other.initialize()) {
+            return;
+        }
+        for (int batch = 0; !done.load(); batch++) {
+            if (other.addUsers(makeUsers(100000 + batch * 10, 10))) {
+                written += 10;
+            }
+        }
+    });
+
+    BackupOptions options;
+    options.pagesPerStep = 8;
+    BackupReport report = {};
+    bool ok = db.backup(snapshotPath, options, &report);
+    done.store(true);
+    writer.join();
+    ASSERT_TRUE(ok);
+    EXPECT_GT(written.load(), 0);
+    // A pinned snapshot never restarts, whatever the writer does.
+    EXPECT_EQ(report.restarts, 0u);
+
+    ASSERT_TRUE(db.restore(snapshotPath));
+    EXPECT_TRUE(db.validateUser("user0@example.com", "Pass@0"));
+    EXPECT_TRUE(db.validateUser("user2999@example.com", "Pass@2999"));
+}
+
+// Test de integridad: una copia dañada no reemplaza la base actual
+TEST_F(BackupTest, CorruptSnapshotLeavesDatabaseUntouched) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUsers(makeUsers(0, 500)));
+    ASSERT_TRUE(db.backup(snapshotPath));
+    ASSERT_TRUE(db.addUser("late@example.com", "Late@1"));
+
+    // Flip one byte in the middle of the snapshot.
+    FILE* file = std::fopen(snapshotPath.c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    std::fseek(file, static_cast<long>(std::filesystem::file_size(snapshotPath) / 2), SEEK_SET);
+    int byte = std::fgetc(file);
+    std::fseek(file, -1, SEEK_CUR);
+    std::fputc(byte ^ 0x5a, file);
+    std::fclose(file);
+
+    EXPECT_FALSE(db.restore(snapshotPath));
+    EXPECT_FALSE(db.restore("no_existe.snap"));
+    EXPECT_TRUE(db.validateUser("late@example.com", "Late@1"));
+    EXPECT_FALSE(std::filesystem::exists(testDbPath + ".restore"));
+}
+
+// Test del compresor: ida y vuelta exacta y rechazo de entradas malformadas
+TEST_F(BackupTest, BlockCodecRoundTrips) {
+    std::mt19937 rng(7);
+    std::vector<std::vector<uint8_t>> inputs;
+    inputs.push_back({});
+    inputs.push_back({'a', 'b', 'c'});
+    inputs.push_back(std::vector<uint8_t>(100000, 0));
+    std::vector<uint8_t> random(70000);
+    for (auto& b : random) {
+        b = static_cast<uint8_t>(rng());
+    }
+    inputs.push_back(random);
+    std::vector<uint8_t> text;
+    while (text.size() < 200000) {
+        std::string row = "user" + std::to_string(rng() % 5000) + "@example.com|$scrypt$ln=14,r=8,p=1$";
+        text.insert(text.end(), row.begin(), row.end());
+    }
+    inputs.push_back(text);
+
+    for (const auto& input : inputs) {
+        std::vector<uint8_t> packed(lzCompressBound(input.size()));
+        size_t packedLength = lzCompress(input.data(), input.size(), packed.data());
+        ASSERT_LE(packedLength, packed.size());
+        std::vector<uint8_t> output(input.size());
+        ASSERT_TRUE(lzDecompress(packed.data(), packedLength, output.data(), output.size()));
+        EXPECT_EQ(output, input);
+        if (!input.empty()) {
+            // Truncated input or a wrong expected size is rejected.
+            EXPECT_FALSE(lzDecompress(packed.data(), packedLength - 1, output.data(), output.size()));
+            EXPECT_FALSE(lzDecompress(packed.data(), packedLength, output.data(), output.size() - 1));
+        }
+    }
+    std::vector<uint8_t> packed(lzCompressBound(100000));
+    EXPECT_LT(lzCompress(inputs[2].data(), inputs[2].size(), packed.data()), 1000u);
+}
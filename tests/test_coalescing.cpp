@@ -0,0 +1,274 @@
+#include <gtest/gtest.h>
+#include "AuthPipeline.h"
+#include "LookupCoalescer.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Coalescencia de consultas
+// ============================================
+
+class CoalescingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "coalescing_test.db";
+        std::filesystem::remove(testDbPath);
+        options.hashCost = HashCost{4, 1, 1};
+        Database db(testDbPath, options);
+        ASSERT_TRUE(db.initialize());
+        ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+        ASSERT_TRUE(db.addUser("otro@example.com", "Pass@123"));
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(testDbPath);
+    }
+
+    // Another connection takes the write lock, so lookups wait in the busy
+    // handler until release().
+    void lock() {
+        ASSERT_EQ(sqlite3_open(testDbPath.c_str(), &writer), SQLITE_OK);
+        ASSERT_EQ(sqlite3_exec(writer, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr), SQLITE_OK);
+    }
+
+    void release() {
+        sqlite3_exec(writer, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_close(writer);
+    }
+
+    template <typename Predicate>
+    bool waitFor(Predicate predicate) {
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!predicate()) {
+            if (std::chrono::steady_clock::now() >= until) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    std::string testDbPath;
+    DatabaseOptions options;
+    sqlite3* writer = nullptr;
+};
+
+// Test de coalescencia: consultas simultáneas de la misma cuenta hacen una sola consulta
+TEST_F(CoalescingTest, ConcurrentLookupsShareOneQuery) {
+    LookupCoalescer coalescer(256, std::chrono::seconds(5));
+    const int followers = 4;
+    std::vector<std::unique_ptr<Database>> connections;
+    for (int i = 0; i <= followers; i++) {
+        connections.push_back(std::make_unique<Database>(testDbPath, options));
+        ASSERT_TRUE(connections.back()->initialize());
+    }
+    std::vector<LoginOutcome> outcomes(followers + 1, LoginOutcome::StorageError);
+    std::vector<FetchedCredential> fetched(followers + 1);
+    auto lookup = [&](int i) {
+        outcomes[i] = coalescer.fetch("user@example.com", *connections[i], fetched[i],
+                                      LookupCoalescer::Clock::time_point::max());
+    };
+
+    lock();
+    std::vector<std::thread> threads;
+    threads.emplace_back(lookup, 0);
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().leaders == 1; }));
+    for (int i = 1; i <= followers; i++) {
+        threads.emplace_back(lookup, i);
+    }
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().coalesced == static_cast<uint64_t>(followers); }));
+    release();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 0; i <= followers; i++) {
+        EXPECT_EQ(outcomes[i], LoginOutcome::Success);
+        EXPECT_TRUE(fetched[i].found);
+        EXPECT_EQ(fetched[i].clave, fetched[0].clave);
+        EXPECT_EQ(connections[i]->stats().queries, i == 0 ? 1u : 0u);
+    }
+    CoalescerStats stats = coalescer.stats();
+    EXPECT_EQ(stats.lookups, 5u);
+    EXPECT_DOUBLE_EQ(stats.coalescingRatio(), 0.8);
+}
+
+// Test de deadline: quien espera a otra consulta no espera más que su propio límite
+TEST_F(CoalescingTest, WaiterGivesUpAtItsDeadline) {
+    LookupCoalescer coalescer(256, std::chrono::seconds(5));
+    Database leaderDb(testDbPath, options);
+    Database waiterDb(testDbPath, options);
+    ASSERT_TRUE(leaderDb.initialize());
+    ASSERT_TRUE(waiterDb.initialize());
+
+    lock();
+    FetchedCredential leaderFetched;
+    std::thread leader([&]() {
+        coalescer.fetch("user@example.com", leaderDb, leaderFetched, LookupCoalescer::Clock::time_point::max());
+    });
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().leaders == 1; }));
+    FetchedCredential fetched;
+    auto started = LookupCoalescer::Clock::now();
+    EXPECT_EQ(coalescer.fetch("user@example.com", waiterDb, fetched, started + std::chrono::milliseconds(30)),
+              LoginOutcome::TimedOut);
+    EXPECT_LT(LookupCoalescer::Clock::now() - started, std::chrono::milliseconds(500));
+    release();
+    leader.join();
+}
+
+// Test de deadline ajeno: si la consulta compartida agota el límite de quien la lanzó,
+// quien aún tiene tiempo consulta por su cuenta en vez de heredar el TimedOut
+TEST_F(CoalescingTest, LeaderTimeoutIsNotHandedOn) {
+    LookupCoalescer coalescer(256, std::chrono::seconds(5));
+    Database leaderDb(testDbPath, options);
+    Database waiterDb(testDbPath, options);
+    ASSERT_TRUE(leaderDb.initialize());
+    ASSERT_TRUE(waiterDb.initialize());
+
+    lock();
+    LoginOutcome leaderOutcome = LoginOutcome::Success;
+    std::thread leader([&]() {
+        FetchedCredential leaderFetched;
+        leaderOutcome = coalescer.fetch("user@example.com", leaderDb, leaderFetched,
+                                        LookupCoalescer::Clock::now() + std::chrono::milliseconds(100));
+    });
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().leaders == 1; }));
+    LoginOutcome outcome = LoginOutcome::StorageError;
+    FetchedCredential fetched;
+    std::thread waiter([&]() {
+        outcome = coalescer.fetch("user@example.com", waiterDb, fetched,
+                                  LookupCoalescer::Clock::now() + std::chrono::seconds(5));
+    });
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().coalesced == 1; }));
+    leader.join();
+    EXPECT_EQ(leaderOutcome, LoginOutcome::TimedOut);
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().retried == 1; }));
+    release();
+    waiter.join();
+
+    EXPECT_EQ(outcome, LoginOutcome::Success);
+    EXPECT_TRUE(fetched.found);
+    EXPECT_EQ(waiterDb.stats().queries, 1u);
+}
+
+// Test de antigüedad: una consulta que lleva mucho esperando al escritor se sigue compartiendo
+TEST_F(CoalescingTest, SlowQueryIsStillJoined) {
+    LookupCoalescer coalescer(256, std::chrono::seconds(5));
+    Database leaderDb(testDbPath, options);
+    Database lateDb(testDbPath, options);
+    ASSERT_TRUE(leaderDb.initialize());
+    ASSERT_TRUE(lateDb.initialize());
+
+    lock();
+    FetchedCredential leaderFetched;
+    std::thread leader([&]() {
+        coalescer.fetch("user@example.com", leaderDb, leaderFetched, LookupCoalescer::Clock::time_point::max());
+    });
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().leaders == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    FetchedCredential fetched;
+    LoginOutcome outcome = LoginOutcome::StorageError;
+    std::thread late([&]() {
+        outcome = coalescer.fetch("user@example.com", lateDb, fetched, LookupCoalescer::Clock::time_point::max());
+    });
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().coalesced == 1; }));
+    release();
+    leader.join();
+    late.join();
+    EXPECT_EQ(outcome, LoginOutcome::Success);
+    EXPECT_TRUE(fetched.found);
+    EXPECT_EQ(coalescer.stats().bypassed, 0u);
+    EXPECT_EQ(lateDb.stats().queries, 0u);
+}
+
+// Test de consulta de respaldo: una consulta vieja recibe una segunda, y la primera que acaba responde a todos
+TEST_F(CoalescingTest, OldQueryIsHedgedOnce) {
+    LookupCoalescer coalescer(256, std::chrono::milliseconds(10));
+    std::vector<std::unique_ptr<Database>> connections;
+    for (int i = 0; i < 4; i++) {
+        connections.push_back(std::make_unique<Database>(testDbPath, options));
+        ASSERT_TRUE(connections.back()->initialize());
+    }
+    std::vector<LoginOutcome> outcomes(4, LoginOutcome::StorageError);
+    std::vector<FetchedCredential> fetched(4);
+    auto lookup = [&](int i) {
+        outcomes[i] = coalescer.fetch("user@example.com", *connections[i], fetched[i],
+                                      LookupCoalescer::Clock::time_point::max());
+    };
+
+    lock();
+    std::vector<std::thread> threads;
+    threads.emplace_back(lookup, 0);
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().leaders == 1; }));
+    threads.emplace_back(lookup, 1);
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().coalesced == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    threads.emplace_back(lookup, 2);
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().hedged == 1; }));
+    threads.emplace_back(lookup, 3);
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().coalesced == 2; }));
+    release();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    uint64_t queries = 0;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(outcomes[i], LoginOutcome::Success);
+        EXPECT_TRUE(fetched[i].found);
+        queries += connections[i]->stats().queries;
+    }
+    EXPECT_EQ(queries, 2u);
+    EXPECT_EQ(connections[1]->stats().queries, 0u);
+    EXPECT_EQ(connections[3]->stats().queries, 0u);
+    EXPECT_EQ(coalescer.stats().bypassed, 0u);
+}
+
+// Test de colisión: otra cuenta en el mismo hueco hace su propia consulta
+TEST_F(CoalescingTest, OtherAccountInTheSameSlotRunsItsOwnQuery) {
+    LookupCoalescer coalescer(1);
+    Database leaderDb(testDbPath, options);
+    Database otherDb(testDbPath, options);
+    ASSERT_TRUE(leaderDb.initialize());
+    ASSERT_TRUE(otherDb.initialize());
+
+    lock();
+    FetchedCredential leaderFetched;
+    std::thread leader([&]() {
+        coalescer.fetch("user@example.com", leaderDb, leaderFetched, LookupCoalescer::Clock::time_point::max());
+    });
+    ASSERT_TRUE(waitFor([&]() { return coalescer.stats().leaders == 1; }));
+    release();
+    FetchedCredential fetched;
+    EXPECT_EQ(coalescer.fetch("otro@example.com", otherDb, fetched, LookupCoalescer::Clock::time_point::max()),
+              LoginOutcome::Success);
+    EXPECT_TRUE(fetched.found);
+    leader.join();
+    EXPECT_EQ(otherDb.stats().queries, 1u);
+}
+
+// Test de pipeline: mismos resultados que StorageStage, cada login con su clave
+TEST_F(CoalescingTest, StageAnswersLikeStorage) {
+    LookupCoalescer coalescer;
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    pipeline.add(std::make_unique<CoalescedStorageStage>(coalescer, db));
+
+    auto login = [&](const char* email, const char* password) {
+        LoginRequest request;
+        request.email = email;
+        request.password = password;
+        return pipeline.authenticate(request);
+    };
+    EXPECT_EQ(login("user@example.com", "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(login("user@example.com", "Mala@123"), LoginOutcome::WrongPassword);
+    EXPECT_EQ(login("nadie@example.com", "Pass@123"), LoginOutcome::UnknownUser);
+    EXPECT_EQ(coalescer.stats().lookups, 3u);
+    EXPECT_EQ(coalescer.stats().leaders, 3u);
+}
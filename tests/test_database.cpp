@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "Database.h"
+#include <chrono>
 #include <filesystem>
+#include <thread>
 
 // ============================================
 // PRUEBAS UNITARIAS - Database Class
@@ -96,6 +98,123 @@ TEST_F(DatabaseTest, ValidateUserWithEmptyCredentials) {
     EXPECT_FALSE(db.validateUser("", ""));
 }
 
+// Test de alta de usuario y validación posterior
+TEST_F(DatabaseTest, AddUserThenValidate) {
+    Database db(testDbPath);
+    db.initialize();
+    
+    EXPECT_TRUE(db.addUser("user@example.com", "Pass@123"));
+    EXPECT_TRUE(db.validateUser("user@example.com", "Pass@123"));
+    EXPECT_FALSE(db.validateUser("user@example.com", "Wrong@123"));
+}
+
+// Test de alta duplicada
+TEST_F(DatabaseTest, AddUserRejectsDuplicate) {
+    Database db(testDbPath);
+    db.initialize();
+    
+    EXPECT_TRUE(db.addUser("user@example.com", "Pass@123"));
+    EXPECT_FALSE(db.addUser("user@example.com", "Other@123"));
+    EXPECT_TRUE(db.validateUser("user@example.com", "Pass@123"));
+}
+
+// Test de alta masiva en una transacción
+TEST_F(DatabaseTest, AddUsersBulkInsert) {
+    DatabaseOptions options;
+    options.hashCost = HashCost{4, 1, 1};
+    Database db(testDbPath, options);
+    db.initialize();
+    
+    std::vector<std::pair<std::string, std::string>> users;
+    for (int i = 0; i < 1000; i++) {
+        users.emplace_back("bulk" + std::to_string(i) + "@example.com", "Bulk@" + std::to_string(i));
+    }
+    EXPECT_TRUE(db.addUsers(users));
+    EXPECT_TRUE(db.validateUser("bulk0@example.com", "Bulk@0"));
+    EXPECT_TRUE(db.validateUser("bulk999@example.com", "Bulk@999"));
+}
+
+// ============================================
+// PRUEBAS UNITARIAS - Deadlines y bloqueos
+// ============================================
+
+// Test de resultado: se distingue usuario inexistente de contraseña errónea
+TEST_F(DatabaseTest, AuthenticateDistinguishesOutcomes) {
+    Database db(testDbPath);
+    db.initialize();
+    db.addUser("user@example.com", "Pass@123");
+    
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(db.authenticate("user@example.com", "Wrong@123"), LoginOutcome::WrongPassword);
+    EXPECT_EQ(db.authenticate("ghost@example.com", "Pass@123"), LoginOutcome::UnknownUser);
+}
+
+// Test de deadline vencido: no se consulta y se reporta timeout
+TEST_F(DatabaseTest, ExpiredDeadlineReportsTimeout) {
+    Database db(testDbPath);
+    db.initialize();
+    db.addUser("user@example.com", "Pass@123");
+    
+    auto past = Database::Clock::now() - std::chrono::milliseconds(1);
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123", past), LoginOutcome::TimedOut);
+    EXPECT_EQ(db.stats().timeouts, 1u);
+}
+
+// Test de bloqueo: otro escritor con lock exclusivo produce timeout, no "credenciales inválidas"
+TEST_F(DatabaseTest, LockedDatabaseReportsTimeoutNotInvalidCredentials) {
+    DatabaseOptions options;
+    options.queryTimeoutMs = 100;
+    Database db(testDbPath, options);
+    db.initialize();
+    db.addUser("user@example.com", "Pass@123");
+    
+    sqlite3* writer = nullptr;
+    ASSERT_EQ(sqlite3_open(testDbPath.c_str(), &writer), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(writer, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr), SQLITE_OK);
+    
+    auto start = std::chrono::steady_clock::now();
+    LoginOutcome outcome = db.authenticate("user@example.com", "Pass@123");
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    EXPECT_EQ(outcome, LoginOutcome::TimedOut);
+    EXPECT_GE(elapsed, 90);
+    EXPECT_LT(elapsed, 300);
+    EXPECT_GT(db.stats().busyRetries, 0u);
+    
+    sqlite3_exec(writer, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(writer);
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::Success);
+}
+
+// Test de bloqueo breve: el busy handler espera y la consulta termina bien
+TEST_F(DatabaseTest, ShortLockIsWaitedOut) {
+    DatabaseOptions options;
+    options.queryTimeoutMs = 1000;
+    Database db(testDbPath, options);
+    db.initialize();
+    db.addUser("user@example.com", "Pass@123");
+    
+    sqlite3* writer = nullptr;
+    ASSERT_EQ(sqlite3_open(testDbPath.c_str(), &writer), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(writer, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr), SQLITE_OK);
+    std::thread releaser([writer]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        sqlite3_exec(writer, "COMMIT;", nullptr, nullptr, nullptr);
+    });
+    
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::Success);
+    releaser.join();
+    sqlite3_close(writer);
+}
+
+// Test de error de almacenamiento: base sin inicializar
+TEST_F(DatabaseTest, UninitializedDatabaseReportsStorageError) {
+    Database db(testDbPath);
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::StorageError);
+    EXPECT_FALSE(db.validateUser("user@example.com", "Pass@123"));
+}
+
 // ============================================
 // PRUEBAS DE SEGURIDAD - SQL Injection
 // ============================================
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include "AuthPipeline.h"
+#include "FairScheduler.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Reparto justo entre aplicaciones
+// ============================================
+
+class FairSchedulerTest : public ::testing::Test {
+protected:
+    // Holds the only slot while logins queue up, in the order given, then
+    // lets them through; returns the tenants in the order they were served.
+    std::vector<std::string> serveInOrder(FairScheduler& scheduler,
+                                          const std::vector<std::pair<std::string, AuthPriority>>& logins) {
+        FairScheduler::Ticket holder;
+        EXPECT_TRUE(scheduler.acquire("holder", AuthPriority::Interactive, FairScheduler::Clock::time_point(),
+                                      holder));
+        std::vector<std::string> served;
+        std::mutex servedMutex;
+        std::vector<std::thread> threads;
+        for (const auto& login : logins) {
+            threads.emplace_back([&, login]() {
+                FairScheduler::Ticket ticket;
+                if (scheduler.acquire(login.first, login.second, FairScheduler::Clock::time_point(), ticket)) {
+                    {
+                        std::lock_guard<std::mutex> lock(servedMutex);
+                        served.push_back(login.first);
+                    }
+                    scheduler.release(ticket);
+                }
+            });
+            // Let it join its queue before the next one.
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        scheduler.release(holder);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return served;
+    }
+
+    const TenantStats* find(const std::vector<TenantStats>& stats, const std::string& name) {
+        for (const TenantStats& tenant : stats) {
+            if (tenant.name == name) {
+                return &tenant;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Test de turnos: una aplicación con muchos logins en cola no pasa por delante de otra
+TEST_F(FairSchedulerTest, TenantsTakeTurns) {
+    FairScheduler scheduler(1);
+    auto served = serveInOrder(scheduler, {{"noisy", AuthPriority::Interactive},
+                                           {"noisy", AuthPriority::Interactive},
+                                           {"noisy", AuthPriority::Interactive},
+                                           {"quiet", AuthPriority::Interactive}});
+    std::vector<std::string> expected = {"noisy", "quiet", "noisy", "noisy"};
+    EXPECT_EQ(served, expected);
+}
+
+// Test de pesos: una aplicación de peso 2 pasa dos logins por turno
+TEST_F(FairSchedulerTest, WeightSetsLoginsPerTurn) {
+    FairScheduler scheduler(1);
+    scheduler.setWeight("big", 2);
+    auto served = serveInOrder(scheduler, {{"big", AuthPriority::Interactive},
+                                           {"big", AuthPriority::Interactive},
+                                           {"big", AuthPriority::Interactive},
+                                           {"big", AuthPriority::Interactive},
+                                           {"small", AuthPriority::Interactive},
+                                           {"small", AuthPriority::Interactive}});
+    std::vector<std::string> expected = {"big", "big", "small", "big", "big", "small"};
+    EXPECT_EQ(served, expected);
+}
+
+// Test de prioridad: los logins interactivos pasan antes que la revalidación por lotes
+TEST_F(FairSchedulerTest, InteractiveBeforeBatch) {
+    FairScheduler scheduler(1);
+    auto served = serveInOrder(scheduler, {{"batch", AuthPriority::Batch},
+                                           {"batch", AuthPriority::Batch},
+                                           {"screen", AuthPriority::Interactive}});
+    std::vector<std::string> expected = {"screen", "batch", "batch"};
+    EXPECT_EQ(served, expected);
+}
+
+// Test de deadline: quien se cansa de esperar sale de la cola sin quedarse con un hueco
+TEST_F(FairSchedulerTest, WaiterLeavesAtDeadline) {
+    FairScheduler scheduler(1);
+    FairScheduler::Ticket holder;
+    ASSERT_TRUE(scheduler.acquire("a", AuthPriority::Interactive, FairScheduler::Clock::time_point(), holder));
+    FairScheduler::Ticket late;
+    EXPECT_FALSE(scheduler.acquire("b", AuthPriority::Interactive,
+                                   FairScheduler::Clock::now() + std::chrono::milliseconds(10), late));
+    scheduler.release(holder);
+
+    FairScheduler::Ticket ticket;
+    EXPECT_TRUE(scheduler.acquire("b", AuthPriority::Interactive,
+                                  FairScheduler::Clock::now() + std::chrono::milliseconds(10), ticket));
+    scheduler.release(ticket);
+
+    auto stats = scheduler.stats();
+    ASSERT_NE(find(stats, "b"), nullptr);
+    EXPECT_EQ(find(stats, "b")->timedOut, 1u);
+    EXPECT_EQ(find(stats, "b")->granted, 1u);
+    EXPECT_EQ(find(stats, "a")->latency.count(), 1u);
+}
+
+// Test de etapa: el pipeline reparte por LoginRequest::tenant y lleva estadísticas por aplicación
+TEST_F(FairSchedulerTest, StageSchedulesByTenant) {
+    class AcceptStage : public AuthStage {
+    public:
+        const char* name() const override { return "accept"; }
+        int cost() const override { return 100; }
+        bool decide(LoginContext& context) override {
+            context.outcome = LoginOutcome::Success;
+            return true;
+        }
+    };
+    FairScheduler scheduler(1);
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<FairStage>(scheduler));
+    pipeline.add(std::make_unique<AcceptStage>());
+
+    LoginRequest request;
+    request.email = "user@example.com";
+    request.password = "Pass@123";
+    request.tenant = "tienda";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+    request.tenant = "foro";
+    request.priority = AuthPriority::Batch;
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+
+    FairScheduler::Ticket holder;
+    ASSERT_TRUE(scheduler.acquire("tienda", AuthPriority::Interactive, FairScheduler::Clock::time_point(), holder));
+    request.deadline = FairScheduler::Clock::now() + std::chrono::milliseconds(10);
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::TimedOut);
+    scheduler.release(holder);
+
+    auto stats = scheduler.stats();
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(find(stats, "tienda")->granted, 2u);
+    EXPECT_EQ(find(stats, "foro")->granted, 1u);
+    EXPECT_EQ(find(stats, "foro")->timedOut, 1u);
+}
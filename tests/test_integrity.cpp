@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include "ActivityMonitor.h"
+#include "Database.h"
+#include "IntegrityVerifier.h"
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Verificación de integridad incremental
+// ============================================
+
+class IntegrityTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "integrity_test.db";
+        removeFiles();
+        // Verification reads rows; hashing cost is irrelevant here.
+        dbOptions.hashCost = HashCost{4, 1, 1};
+    }
+
+    void TearDown() override {
+        removeFiles();
+    }
+
+    void removeFiles() {
+        for (const char* suffix : {"", "-wal", "-shm", "-journal", ".quarantine", ".snap"}) {
+            std::filesystem::remove(testDbPath + suffix);
+        }
+    }
+
+    void populate(int count) {
+        Database db(testDbPath, dbOptions);
+        ASSERT_TRUE(db.initialize());
+        std::vector<std::pair<std::string, std::string>> users;
+        for (int i = 0; i < count; i++) {
+            users.emplace_back("user" + std::to_string(i) + "@example.com", "Pass@" + std::to_string(i));
+        }
+        ASSERT_TRUE(db.addUsers(users));
+    }
+
+    // Overwrites the start of the page at `fraction` of the file with garbage.
+    void corruptPage(double fraction) {
+        const long pageSize = 4096;
+        long pages = static_cast<long>(std::filesystem::file_size(testDbPath)) / pageSize;
+        FILE* file = std::fopen(testDbPath.c_str(), "r+b");
+        ASSERT_NE(file, nullptr);
+        std::fseek(file, static_cast<long>(pages * fraction) * pageSize, SEEK_SET);
+        std::vector<unsigned char> garbage(64, 0xff);
+        std::fwrite(garbage.data(), 1, garbage.size(), file);
+        std::fclose(file);
+    }
+
+    std::string testDbPath;
+    DatabaseOptions dbOptions;
+    IntegrityOptions options;
+};
+
+// Test de base sana: una pasada completa recorre todas las filas sin hallazgos
+TEST_F(IntegrityTest, CleanDatabasePassesWithoutFindings) {
+    populate(5000);
+    IntegrityVerifier verifier(testDbPath, options);
+    ASSERT_TRUE(verifier.runPass());
+
+    IntegrityProgress progress = verifier.progress();
+    EXPECT_EQ(progress.passesCompleted, 1u);
+    EXPECT_GE(progress.entriesChecked, 5000u);
+    EXPECT_FALSE(progress.quarantined);
+    EXPECT_TRUE(verifier.findings().empty());
+    EXPECT_FALSE(IntegrityVerifier::isQuarantined(testDbPath));
+
+    // The second pass knows how far along it is.
+    options.stepBudgetMs = 1;
+    IntegrityVerifier sliced(testDbPath, options);
+    ASSERT_TRUE(sliced.runPass());
+    ASSERT_TRUE(sliced.runStep());
+    progress = sliced.progress();
+    EXPECT_GT(progress.passFraction, 0.0);
+    EXPECT_LT(progress.passFraction, 1.0);
+}
+
+// Test de presupuesto: pasos cortos reanudan donde quedaron sin saltar ni repetir filas
+TEST_F(IntegrityTest, SmallStepsResumeWithoutGapsOrRepeats) {
+    populate(20000);
+    IntegrityVerifier whole(testDbPath, options);
+    ASSERT_TRUE(whole.runPass());
+    uint64_t entries = whole.progress().entriesChecked;
+
+    options.stepBudgetMs = 1;
+    IntegrityVerifier sliced(testDbPath, options);
+    ASSERT_TRUE(sliced.runPass());
+    IntegrityProgress progress = sliced.progress();
+    EXPECT_EQ(progress.entriesChecked, entries);
+    EXPECT_GT(progress.steps, 2u);
+    // 1ms budget plus scheduling slack
+    EXPECT_LT(progress.maxStepMs, 25.0);
+}
+
+// Test de cortesía: no verifica mientras hay logins en curso
+TEST_F(IntegrityTest, YieldsToLoginsInFlight) {
+    populate(100);
+    ActivityMonitor activity;
+    IntegrityVerifier verifier(testDbPath, options, &activity);
+    activity.begin();
+    EXPECT_FALSE(verifier.runStep());
+    EXPECT_EQ(verifier.progress().entriesChecked, 0u);
+    activity.end();
+    EXPECT_TRUE(verifier.runStep());
+}
+
+// Test de corrupción: se detecta la página dañada y la base queda en cuarentena de solo lectura
+TEST_F(IntegrityTest, CorruptPageIsReportedAndQuarantined) {
+    populate(3000);
+    {
+        Database db(testDbPath, dbOptions);
+        ASSERT_TRUE(db.initialize());
+        ASSERT_TRUE(db.backup(testDbPath + ".snap"));
+    }
+    corruptPage(0.5);
+
+    IntegrityVerifier verifier(testDbPath, options);
+    std::vector<IntegrityFinding> notified;
+    verifier.setFindingCallback([&](const IntegrityFinding& finding) { notified.push_back(finding); });
+    ASSERT_TRUE(verifier.runPass());
+
+    std::vector<IntegrityFinding> findings = verifier.findings();
+    ASSERT_EQ(findings.size(), 1u);
+    EXPECT_EQ(findings[0].btree, "usuarios");
+    EXPECT_EQ(findings[0].code & 0xff, SQLITE_CORRUPT);
+    EXPECT_EQ(notified.size(), 1u);
+    EXPECT_TRUE(verifier.progress().quarantined);
+    EXPECT_TRUE(IntegrityVerifier::isQuarantined(testDbPath));
+
+    // Quarantined: reads still work, writes are refused.
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_TRUE(db.isQuarantined());
+    EXPECT_TRUE(db.validateUser("user0@example.com", "Pass@0"));
+    EXPECT_FALSE(db.addUser("new@example.com", "New@1"));
+
+    // Restoring a good snapshot lifts the quarantine.
+    ASSERT_TRUE(db.restore(testDbPath + ".snap"));
+    EXPECT_FALSE(db.isQuarantined());
+    EXPECT_FALSE(IntegrityVerifier::isQuarantined(testDbPath));
+    EXPECT_TRUE(db.addUser("new@example.com", "New@1"));
+}
+
+// Test de hilo: el verificador en segundo plano completa pasadas por sí solo
+TEST_F(IntegrityTest, BackgroundThreadCompletesPasses) {
+    populate(1000);
+    options.cpuShare = 0.5;
+    IntegrityVerifier verifier(testDbPath, options);
+    ASSERT_TRUE(verifier.start());
+    for (int i = 0; i < 200 && verifier.progress().passesCompleted == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    verifier.stop();
+    EXPECT_EQ(verifier.progress().passesCompleted, 1u);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "LatencyHistogram.h"
+#include "ZipfGenerator.h"
+#include <filesystem>
+#include <random>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Generación de carga
+// ============================================
+
+// Test de histograma: percentiles dentro del error relativo de los buckets
+TEST(LoadGenerationTest, HistogramPercentilesWithinBucketError) {
+    LatencyHistogram histogram;
+    for (uint64_t i = 1; i <= 100000; i++) {
+        histogram.record(i * 1000);
+    }
+    
+    EXPECT_EQ(histogram.count(), 100000u);
+    EXPECT_NEAR(histogram.percentile(50), 50000000.0, 50000000.0 * 0.04);
+    EXPECT_NEAR(histogram.percentile(99), 99000000.0, 99000000.0 * 0.04);
+    EXPECT_NEAR(histogram.percentile(99.9), 99900000.0, 99900000.0 * 0.04);
+    EXPECT_EQ(histogram.max(), 100000000u);
+    EXPECT_EQ(histogram.min(), 1000u);
+}
+
+// Test de histograma: valores pequeños se registran exactos
+TEST(LoadGenerationTest, HistogramSmallValuesExact) {
+    LatencyHistogram histogram;
+    histogram.record(7);
+    histogram.record(7);
+    histogram.record(42);
+    
+    EXPECT_EQ(histogram.percentile(50), 7u);
+    EXPECT_EQ(histogram.percentile(100), 42u);
+}
+
+// Test de histograma: merge equivale a registrar todo en uno
+TEST(LoadGenerationTest, HistogramMergeCombinesCounts) {
+    LatencyHistogram a;
+    LatencyHistogram b;
+    for (int i = 0; i < 100; i++) {
+        a.record(1000);
+        b.record(1000000);
+    }
+    a.merge(b);
+    
+    EXPECT_EQ(a.count(), 200u);
+    EXPECT_EQ(a.max(), 1000000u);
+    EXPECT_LT(a.percentile(25), 2000u);
+    EXPECT_GT(a.percentile(75), 900000u);
+}
+
+// Test de histograma: guardar y cargar conserva la distribución
+TEST(LoadGenerationTest, HistogramSaveAndLoadRoundTrip) {
+    std::string path = "loadgen_histogram.txt";
+    LatencyHistogram original;
+    for (uint64_t i = 0; i < 1000; i++) {
+        original.record(5000 + i * 37);
+    }
+    ASSERT_TRUE(original.saveToFile(path));
+    
+    LatencyHistogram loaded;
+    ASSERT_TRUE(loaded.loadFromFile(path));
+    EXPECT_EQ(loaded.count(), original.count());
+    EXPECT_NEAR(loaded.percentile(99), original.percentile(99), original.percentile(99) * 0.04);
+    
+    std::filesystem::remove(path);
+}
+
+// Test de Zipf: todos los valores dentro del rango
+TEST(LoadGenerationTest, ZipfStaysInRange) {
+    std::mt19937_64 rng(1);
+    ZipfGenerator zipf(1000, 1.1);
+    for (int i = 0; i < 100000; i++) {
+        EXPECT_LT(zipf.next(rng), 1000u);
+    }
+}
+
+// Test de Zipf: las cuentas calientes dominan el tráfico
+TEST(LoadGenerationTest, ZipfSkewsTowardHotAccounts) {
+    std::mt19937_64 rng(2);
+    ZipfGenerator zipf(10000000, 0.99);
+    std::vector<int> low(10, 0);
+    int samples = 200000;
+    int hot = 0;
+    for (int i = 0; i < samples; i++) {
+        uint64_t k = zipf.next(rng);
+        if (k < 10) {
+            low[k]++;
+        }
+        if (k < 1000) {
+            hot++;
+        }
+    }
+    
+    // Rank 0 is roughly twice as popular as rank 1
+    EXPECT_NEAR(static_cast<double>(low[0]) / low[1], 2.0, 0.3);
+    // The hottest 0.01% of accounts take a large share of requests
+    EXPECT_GT(hot, samples / 3);
+}
+
+// Test de Zipf: exponente 0 es uniforme
+TEST(LoadGenerationTest, ZipfZeroExponentIsUniform) {
+    std::mt19937_64 rng(3);
+    ZipfGenerator zipf(10, 0.0);
+    std::vector<int> counts(10, 0);
+    for (int i = 0; i < 100000; i++) {
+        counts[zipf.next(rng)]++;
+    }
+    for (int count : counts) {
+        EXPECT_NEAR(count, 10000, 800);
+    }
+}
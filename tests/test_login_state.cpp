@@ -0,0 +1,338 @@
+#include <gtest/gtest.h>
+#include "AuthPipeline.h"
+#include "Database.h"
+#include "LoginStateStore.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+// ============================================
+// PRUEBAS UNITARIAS - Bloqueo persistente y último acceso
+// ============================================
+
+class LoginStateTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "login_state_test.db";
+        std::filesystem::remove(testDbPath);
+        databaseOptions.hashCost = HashCost{4, 1, 1};
+        db = std::make_unique<Database>(testDbPath, databaseOptions);
+        ASSERT_TRUE(db->initialize());
+        for (int i = 0; i < 10; i++) {
+            ASSERT_TRUE(db->addUser(email(i), "Pass@123"));
+        }
+    }
+
+    void TearDown() override {
+        db.reset();
+        std::filesystem::remove(testDbPath);
+    }
+
+    static std::string email(int i) {
+        return "user" + std::to_string(i) + "@example.com";
+    }
+
+    // What another process would read from the file right now.
+    LoginState stored(const std::string& account) {
+        LoginState state;
+        EXPECT_TRUE(db->loadLoginState(account, state));
+        return state;
+    }
+
+    LoginStateOptions options(int flushIntervalMs) {
+        LoginStateOptions result;
+        result.flushIntervalMs = flushIntervalMs;
+        return result;
+    }
+
+    std::string testDbPath;
+    DatabaseOptions databaseOptions;
+    std::unique_ptr<Database> db;
+};
+
+// Test de bloqueo: el quinto fallo bloquea la cuenta, y el bloqueo sobrevive al cierre
+TEST_F(LoginStateTest, LockoutSurvivesRestart) {
+    {
+        LoginStateStore store(testDbPath, options(20), databaseOptions);
+        ASSERT_TRUE(store.start());
+        for (int i = 0; i < 4; i++) {
+            EXPECT_EQ(store.recordFailure(email(0)).lockedUntil, 0);
+        }
+        EXPECT_FALSE(store.isLocked(email(0)));
+        EXPECT_GT(store.recordFailure(email(0)).lockedUntil, 0);
+        EXPECT_TRUE(store.isLocked(email(0)));
+    }
+
+    LoginStateStore reopened(testDbPath, options(20), databaseOptions);
+    ASSERT_TRUE(reopened.start());
+    EXPECT_TRUE(reopened.isLocked(email(0)));
+    EXPECT_EQ(reopened.state(email(0)).failures, 5u);
+    EXPECT_FALSE(reopened.isLocked(email(1)));
+}
+
+// Test de último acceso: un login correcto borra los fallos y guarda la hora
+TEST_F(LoginStateTest, SuccessClearsFailuresAndSetsLastLogin) {
+    LoginStateStore store(testDbPath, options(20), databaseOptions);
+    ASSERT_TRUE(store.start());
+    store.recordFailure(email(0));
+    store.recordFailure(email(0));
+    LoginState before = store.recordSuccess(email(0));
+    EXPECT_EQ(before.failures, 2u);
+    EXPECT_EQ(before.lastLogin, 0);
+
+    ASSERT_TRUE(store.flush());
+    LoginState after = stored(email(0));
+    EXPECT_EQ(after.failures, 0u);
+    EXPECT_GT(after.lastLogin, 0);
+    EXPECT_EQ(store.recordSuccess(email(0)).lastLogin, after.lastLogin);
+}
+
+// Test de escritura diferida: cambios repetidos de una cuenta se escriben una vez, en un lote
+TEST_F(LoginStateTest, ChangesAreCoalescedIntoOneBatch) {
+    LoginStateOptions lazy = options(60 * 1000);
+    lazy.maxFailures = 1000;
+    LoginStateStore store(testDbPath, lazy, databaseOptions);
+    ASSERT_TRUE(store.start());
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 10; i++) {
+            store.recordFailure(email(i));
+        }
+    }
+    // Nothing has reached the file yet.
+    EXPECT_EQ(stored(email(3)).failures, 0u);
+
+    ASSERT_TRUE(store.flush());
+    EXPECT_EQ(stored(email(3)).failures, 10u);
+    LoginStateStats stats = store.stats();
+    EXPECT_EQ(stats.updates, 100u);
+    EXPECT_EQ(stats.coalesced, 90u);
+    EXPECT_EQ(stats.flushes, 1u);
+    EXPECT_EQ(stats.rowsWritten, 10u);
+}
+
+// Test de ventana de pérdida: sin llamar a flush() los cambios llegan al fichero en el intervalo
+TEST_F(LoginStateTest, WriterFlushesWithinTheInterval) {
+    LoginStateStore store(testDbPath, options(20), databaseOptions);
+    ASSERT_TRUE(store.start());
+    store.recordFailure(email(0));
+
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (stored(email(0)).failures == 0 && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(stored(email(0)).failures, 1u);
+    EXPECT_EQ(store.stats().flushFailures, 0u);
+}
+
+// Test de escritura inmediata: con intervalo 0 cada cambio se escribe antes de volver
+TEST_F(LoginStateTest, ZeroIntervalWritesThrough) {
+    LoginStateStore store(testDbPath, options(0), databaseOptions);
+    ASSERT_TRUE(store.start());
+    store.recordFailure(email(0));
+    EXPECT_EQ(stored(email(0)).failures, 1u);
+    store.recordFailure(email(0));
+    EXPECT_EQ(stored(email(0)).failures, 2u);
+    EXPECT_EQ(store.stats().flushes, 2u);
+}
+
+// Test de caducidad: pasado el bloqueo, la cuenta vuelve a empezar la cuenta de fallos
+TEST_F(LoginStateTest, LockoutRunsOut) {
+    LoginStateOptions brief = options(20);
+    brief.maxFailures = 1;
+    brief.lockoutSeconds = 1;
+    LoginStateStore store(testDbPath, brief, databaseOptions);
+    ASSERT_TRUE(store.start());
+    store.recordFailure(email(0));
+    EXPECT_TRUE(store.isLocked(email(0)));
+
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (store.isLocked(email(0)) && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_FALSE(store.isLocked(email(0)));
+    EXPECT_EQ(store.recordFailure(email(0)).failures, 1u);
+}
+
+// Test de etapa: tras cinco claves erróneas ni la correcta entra; cuentas inexistentes no dejan filas
+TEST_F(LoginStateTest, StageLocksAfterFiveWrongPasswords) {
+    LoginStateStore store(testDbPath, options(20), databaseOptions);
+    ASSERT_TRUE(store.start());
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    pipeline.add(std::make_unique<LockoutStage>(store));
+    pipeline.add(std::make_unique<StorageStage>(*db));
+
+    std::string account = email(0);
+    LoginRequest request;
+    request.email = account;
+    request.password = "Mala@123";
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::WrongPassword);
+    }
+    request.password = "Pass@123";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::RateLimited);
+    // Turned away without a check, so it is not another failure.
+    EXPECT_EQ(store.state(account).failures, 5u);
+
+    request.email = "nadie@example.com";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::UnknownUser);
+    ASSERT_TRUE(store.flush());
+    EXPECT_EQ(stored("nadie@example.com").failures, 0u);
+    EXPECT_EQ(stored(account).failures, 5u);
+}
+
+// Test de memoria: emails inventados no crecen la memoria ni se leen dos veces
+TEST_F(LoginStateTest, UnknownEmailsAreRememberedWithoutEntries) {
+    LoginStateStore store(testDbPath, options(20), databaseOptions);
+    ASSERT_TRUE(store.start());
+    const int flood = 2000;
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < flood; i++) {
+            EXPECT_FALSE(store.isLocked("inventado" + std::to_string(i) + "@example.com"));
+        }
+    }
+    LoginStateStats stats = store.stats();
+    EXPECT_EQ(stats.entries, 0u);
+    EXPECT_EQ(stats.loads, static_cast<uint64_t>(flood));
+    EXPECT_EQ(stats.absentHits, static_cast<uint64_t>(flood));
+
+    // An account without stored state still keeps what happens to it.
+    EXPECT_EQ(store.state(email(0)).failures, 0u);
+    EXPECT_EQ(store.recordFailure(email(0)).failures, 1u);
+    EXPECT_EQ(store.state(email(0)).failures, 1u);
+}
+
+// Test de límite: maxEntries se respeta al añadir cuentas, no solo tras escribir
+TEST_F(LoginStateTest, EntriesStayWithinMaxEntries) {
+    for (int i = 0; i < 10; i++) {
+        LoginState state;
+        state.email = email(i);
+        state.lastLogin = 1000 + i;
+        ASSERT_TRUE(db->storeLoginStates({state}));
+    }
+    LoginStateOptions limited = options(20);
+    limited.maxEntries = 4;
+    LoginStateStore store(testDbPath, limited, databaseOptions);
+    ASSERT_TRUE(store.start());
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(store.state(email(i)).lastLogin, 1000 + i);
+        EXPECT_LE(store.stats().entries, 4u);
+    }
+    // Dropped ones are read again.
+    EXPECT_EQ(store.state(email(0)).lastLogin, 1000);
+}
+
+// Test de memoria: se descarta la cuenta sin cambios usada hace más tiempo,
+// y nunca una con cambios por escribir
+TEST_F(LoginStateTest, LeastRecentlyUsedEntryIsDropped) {
+    for (int i = 0; i < 4; i++) {
+        LoginState state;
+        state.email = email(i);
+        state.lastLogin = 1000 + i;
+        ASSERT_TRUE(db->storeLoginStates({state}));
+    }
+    LoginStateOptions limited = options(60000);
+    limited.maxEntries = 3;
+    LoginStateStore store(testDbPath, limited, databaseOptions);
+    ASSERT_TRUE(store.start());
+    store.recordFailure(email(0));
+    store.state(email(1));
+    store.state(email(2));
+    store.state(email(1));
+    EXPECT_EQ(store.stats().loads, 3u);
+
+    // email(2) goes: email(0) has a change to write, email(1) was used since.
+    store.state(email(3));
+    EXPECT_EQ(store.stats().entries, 3u);
+    EXPECT_EQ(store.state(email(0)).failures, 1u);
+    store.state(email(1));
+    EXPECT_EQ(store.stats().loads, 4u);
+    EXPECT_EQ(store.state(email(2)).lastLogin, 1002);
+    EXPECT_EQ(store.stats().loads, 5u);
+}
+
+// Test de enumeración: un email sin cuenta se bloquea igual que uno con cuenta
+TEST_F(LoginStateTest, UnknownEmailLocksLikeAnAccount) {
+    LoginStateStore store(testDbPath, options(20), databaseOptions);
+    ASSERT_TRUE(store.start());
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    auto stage = std::make_unique<LockoutStage>(store);
+    LockoutStage* lockout = stage.get();
+    pipeline.add(std::move(stage));
+    pipeline.add(std::make_unique<StorageStage>(*db));
+
+    for (const std::string& account : {email(2), std::string("nadie@example.com")}) {
+        LoginRequest request;
+        request.email = account;
+        request.password = "Mala@123";
+        LoginOutcome failure = account == email(2) ? LoginOutcome::WrongPassword : LoginOutcome::UnknownUser;
+        for (uint32_t i = 1; i <= 5; i++) {
+            EXPECT_EQ(pipeline.authenticate(request), failure) << account;
+            EXPECT_EQ(lockout->last().failures, i) << account;
+            EXPECT_EQ(lockout->last().lockedUntil > 0, i == store.maxFailures()) << account;
+        }
+        EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::RateLimited) << account;
+        EXPECT_TRUE(store.isLocked(account));
+    }
+    // Nothing stored for the email without an account.
+    ASSERT_TRUE(store.flush());
+    EXPECT_EQ(stored("nadie@example.com").failures, 0u);
+    EXPECT_EQ(store.stats().entries, 1u);
+}
+
+namespace {
+    // Keeps the attempt number each login reached the end of the pipeline with.
+    class AttemptProbe : public AuthStage {
+    public:
+        const char* name() const override { return "attempt-probe"; }
+        int cost() const override { return 1000; }
+        void observe(const LoginContext& context) override { attempt = context.request.attempt; }
+        uint32_t attempt = 0;
+    };
+}
+
+// Test de estado: la etapa deja a quien llama los fallos, el bloqueo y el último acceso de la cuenta
+TEST_F(LoginStateTest, StageReportsTheAccountState) {
+    LoginStateStore store(testDbPath, options(20), databaseOptions);
+    ASSERT_TRUE(store.start());
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    auto stage = std::make_unique<LockoutStage>(store);
+    LockoutStage* lockout = stage.get();
+    pipeline.add(std::move(stage));
+    pipeline.add(std::make_unique<StorageStage>(*db));
+    auto probe = std::make_unique<AttemptProbe>();
+    AttemptProbe* attempts = probe.get();
+    pipeline.add(std::move(probe));
+
+    std::string padded = "  " + email(1) + " ";
+    LoginRequest request;
+    request.email = padded;
+    request.password = "Pass@123";
+    ASSERT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+    EXPECT_EQ(lockout->last().email, email(1));
+    EXPECT_EQ(lockout->last().lastLogin, 0);
+    ASSERT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+    EXPECT_GT(lockout->last().lastLogin, 0);
+
+    request.password = "Mala@123";
+    for (uint32_t i = 1; i <= 5; i++) {
+        EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::WrongPassword);
+        EXPECT_EQ(attempts->attempt, i);
+        EXPECT_EQ(lockout->last().failures, i);
+        EXPECT_EQ(lockout->last().lockedUntil > 0, i == store.maxFailures());
+    }
+    int64_t lockedUntil = lockout->last().lockedUntil;
+    request.password = "Pass@123";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::RateLimited);
+    EXPECT_EQ(lockout->last().lockedUntil, lockedUntil);
+
+    // Settled by NormalizeStage: nothing about the previous account is left.
+    request.email = "";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::UnknownUser);
+    EXPECT_TRUE(lockout->last().email.empty());
+    EXPECT_EQ(lockout->last().failures, 0u);
+}
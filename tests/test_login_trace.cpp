@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "LoginTrace.h"
+#include <filesystem>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Grabación de trazas
+// ============================================
+
+class LoginTraceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "trace_test.db";
+        tracePath = "trace_test.trace";
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove(tracePath);
+    }
+    
+    void TearDown() override {
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove(tracePath);
+    }
+    
+    std::vector<LoginTraceRecord> readAll() {
+        std::vector<LoginTraceRecord> records;
+        LoginTraceReader reader;
+        EXPECT_TRUE(reader.open(tracePath));
+        LoginTraceRecord record;
+        while (reader.next(record)) {
+            records.push_back(record);
+        }
+        return records;
+    }
+    
+    std::string testDbPath;
+    std::string tracePath;
+};
+
+// Test de ida y vuelta: escribir y leer registros
+TEST_F(LoginTraceTest, WriteAndReadRoundTrip) {
+    {
+        LoginTraceWriter writer;
+        ASSERT_TRUE(writer.open(tracePath));
+        writer.record(1, LoginOutcome::Success);
+        writer.record(2, LoginOutcome::WrongPassword);
+        writer.record(0xffffffffffffffffull, LoginOutcome::PolicyRejected);
+        EXPECT_EQ(writer.recordCount(), 3u);
+    }
+    
+    auto records = readAll();
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].accountKey, 1u);
+    EXPECT_EQ(records[0].outcome, LoginOutcome::Success);
+    EXPECT_EQ(records[1].outcome, LoginOutcome::WrongPassword);
+    EXPECT_EQ(records[2].accountKey, 0xffffffffffffffffull);
+    EXPECT_EQ(records[2].outcome, LoginOutcome::PolicyRejected);
+    EXPECT_LE(records[0].timestampNs, records[1].timestampNs);
+    EXPECT_LE(records[1].timestampNs, records[2].timestampNs);
+}
+
+// Test de tamaño: los registros son compactos
+TEST_F(LoginTraceTest, RecordsAreCompact) {
+    {
+        LoginTraceWriter writer;
+        ASSERT_TRUE(writer.open(tracePath));
+        for (int i = 0; i < 1000; i++) {
+            writer.record(hashAccountKey("user" + std::to_string(i)), LoginOutcome::Success);
+        }
+    }
+    EXPECT_LT(std::filesystem::file_size(tracePath), 1000u * 16);
+}
+
+// Test de privacidad: el email nunca se escribe en la traza
+TEST_F(LoginTraceTest, EmailIsHashed) {
+    EXPECT_EQ(hashAccountKey("user@example.com"), hashAccountKey("user@example.com"));
+    EXPECT_NE(hashAccountKey("user@example.com"), hashAccountKey("User@example.com"));
+}
+
+// Test de lectura: archivo que no es una traza
+TEST_F(LoginTraceTest, RejectsInvalidFile) {
+    {
+        FILE* f = std::fopen(tracePath.c_str(), "wb");
+        std::fputs("not a trace", f);
+        std::fclose(f);
+    }
+    LoginTraceReader reader;
+    EXPECT_FALSE(reader.open(tracePath));
+}
+
+// Test de integración: Database graba cada clase de resultado
+TEST_F(LoginTraceTest, DatabaseRecordsOutcomeClasses) {
+    LoginTraceWriter writer;
+    ASSERT_TRUE(writer.open(tracePath));
+    {
+        Database db(testDbPath);
+        db.initialize();
+        db.addUser("user@example.com", "Pass@123");
+        db.setTraceRecorder(&writer);
+        
+        EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::Success);
+        EXPECT_EQ(db.authenticate("user@example.com", "Wrong@123"), LoginOutcome::WrongPassword);
+        EXPECT_EQ(db.authenticate("ghost@example.com", "Pass@123"), LoginOutcome::UnknownUser);
+    }
+    writer.close();
+    
+    auto records = readAll();
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].outcome, LoginOutcome::Success);
+    EXPECT_EQ(records[1].outcome, LoginOutcome::WrongPassword);
+    EXPECT_EQ(records[2].outcome, LoginOutcome::UnknownUser);
+    EXPECT_EQ(records[0].accountKey, hashAccountKey("user@example.com"));
+    EXPECT_EQ(records[2].accountKey, hashAccountKey("ghost@example.com"));
+}
+
+// Test de grabación opcional: sin grabador no se escribe nada
+TEST_F(LoginTraceTest, RecordingIsOptional) {
+    Database db(testDbPath);
+    db.initialize();
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::UnknownUser);
+    EXPECT_FALSE(std::filesystem::exists(tracePath));
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "ActivityMonitor.h"
+#include "Database.h"
+#include "MaintenanceScheduler.h"
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Mantenimiento en segundo plano
+// ============================================
+
+class MaintenanceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "maintenance_test.db";
+        removeFiles();
+        options.idleThresholdMs = 0;
+        options.pollIntervalMs = 10;
+        // These tests churn thousands of rows; hashing cost is irrelevant here.
+        dbOptions.hashCost = HashCost{4, 1, 1};
+    }
+    
+    void TearDown() override {
+        removeFiles();
+    }
+    
+    void removeFiles() {
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove(testDbPath + "-wal");
+        std::filesystem::remove(testDbPath + "-shm");
+        std::filesystem::remove(testDbPath + "-journal");
+    }
+    
+    // Inserts and then deletes `count` users, leaving their pages on the freelist.
+    void churn(Database& db, int count) {
+        std::vector<std::pair<std::string, std::string>> users;
+        for (int i = 0; i < count; i++) {
+            users.emplace_back("churn" + std::to_string(i) + "@example.com", "Churn@" + std::to_string(i));
+        }
+        ASSERT_TRUE(db.addUsers(users));
+        
+        sqlite3* conn = nullptr;
+        ASSERT_EQ(sqlite3_open(testDbPath.c_str(), &conn), SQLITE_OK);
+        ASSERT_EQ(sqlite3_exec(conn, "DELETE FROM usuarios WHERE usuario LIKE 'churn%';", nullptr, nullptr, nullptr), SQLITE_OK);
+        sqlite3_close(conn);
+    }
+    
+    int runUntilIdle(MaintenanceScheduler& scheduler) {
+        int steps = 0;
+        while (scheduler.runStep() && steps < 10000) {
+            steps++;
+        }
+        return steps;
+    }
+    
+    std::string testDbPath;
+    MaintenanceOptions options;
+    DatabaseOptions dbOptions;
+    ActivityMonitor activity;
+};
+
+// Test de vacuum incremental: se recuperan las páginas libres
+TEST_F(MaintenanceTest, IncrementalVacuumReclaimsSpace) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    churn(db, 5000);
+    auto sizeBefore = std::filesystem::file_size(testDbPath);
+    
+    MaintenanceScheduler scheduler(testDbPath, activity, options);
+    EXPECT_GT(runUntilIdle(scheduler), 0);
+    
+    MaintenanceReport report = scheduler.report();
+    EXPECT_EQ(report.optimizeRuns, 1u);
+    EXPECT_GT(report.vacuumSteps, 0u);
+    EXPECT_GT(report.pagesReclaimed, 10u);
+    EXPECT_EQ(report.bytesReclaimed, report.pagesReclaimed * 4096);
+    EXPECT_LT(std::filesystem::file_size(testDbPath), sizeBefore);
+}
+
+// Test de checkpoint: el WAL se copia y se trunca cuando no hay tráfico
+TEST_F(MaintenanceTest, CheckpointTruncatesWal) {
+    dbOptions.walMode = true;
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    std::vector<std::pair<std::string, std::string>> users;
+    for (int i = 0; i < 2000; i++) {
+        users.emplace_back("wal" + std::to_string(i) + "@example.com", "Wal@" + std::to_string(i));
+    }
+    ASSERT_TRUE(db.addUsers(users));
+    ASSERT_GT(std::filesystem::file_size(testDbPath + "-wal"), 0u);
+    
+    MaintenanceScheduler scheduler(testDbPath, activity, options);
+    runUntilIdle(scheduler);
+    
+    MaintenanceReport report = scheduler.report();
+    EXPECT_GT(report.checkpoints, 0u);
+    EXPECT_GT(report.truncatingCheckpoints, 0u);
+    EXPECT_GT(report.framesCheckpointed, 0u);
+    EXPECT_EQ(std::filesystem::file_size(testDbPath + "-wal"), 0u);
+    EXPECT_TRUE(db.validateUser("wal1999@example.com", "Wal@1999"));
+}
+
+// Test de inactividad: no se ejecuta con logins en curso
+TEST_F(MaintenanceTest, SkipsWhileLoginsInFlight) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    churn(db, 1000);
+    
+    MaintenanceScheduler scheduler(testDbPath, activity, options);
+    activity.begin();
+    EXPECT_FALSE(scheduler.runStep());
+    EXPECT_EQ(scheduler.report().steps, 0u);
+    activity.end();
+    EXPECT_TRUE(scheduler.runStep());
+}
+
+// Test de inactividad: espera a que el tráfico lleve un tiempo en silencio
+TEST_F(MaintenanceTest, WaitsForQuietPeriod) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    db.setActivityMonitor(&activity);
+    options.idleThresholdMs = 100;
+    
+    MaintenanceScheduler scheduler(testDbPath, activity, options);
+    db.validateUser("user@example.com", "Pass@123");
+    EXPECT_FALSE(scheduler.runStep());
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    EXPECT_TRUE(scheduler.runStep());
+}
+
+// Test de presupuesto: ningún paso supera el presupuesto configurado
+TEST_F(MaintenanceTest, StepsStayWithinBudget) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    churn(db, 20000);
+    options.stepBudgetMs = 5;
+    options.vacuumPagesPerStep = 4096;
+    
+    MaintenanceScheduler scheduler(testDbPath, activity, options);
+    runUntilIdle(scheduler);
+    
+    MaintenanceReport report = scheduler.report();
+    EXPECT_GT(report.pagesReclaimed, 0u);
+    // Budget plus scheduling/fsync slack on slow CI disks
+    EXPECT_LT(report.maxStepMs, 5.0 + 50.0);
+}
+
+// Test de hilo en segundo plano: el trabajo se hace solo
+TEST_F(MaintenanceTest, BackgroundThreadDoesWork) {
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    churn(db, 2000);
+    
+    MaintenanceScheduler scheduler(testDbPath, activity, options);
+    ASSERT_TRUE(scheduler.start());
+    for (int i = 0; i < 100 && scheduler.report().pagesReclaimed == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    scheduler.stop();
+    
+    EXPECT_GT(scheduler.report().pagesReclaimed, 0u);
+}
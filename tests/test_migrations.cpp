@@ -0,0 +1,304 @@
+#include <gtest/gtest.h>
+#include "AuthSchema.h"
+#include "Database.h"
+#include "SchemaMigrator.h"
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Migraciones de esquema
+// ============================================
+
+class MigrationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "migration_test.db";
+        removeFiles();
+    }
+
+    void TearDown() override {
+        removeFiles();
+    }
+
+    void removeFiles() {
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove(testDbPath + "-wal");
+        std::filesystem::remove(testDbPath + "-shm");
+        std::filesystem::remove(testDbPath + "-journal");
+    }
+
+    sqlite3* openRaw() {
+        sqlite3* conn = nullptr;
+        EXPECT_EQ(sqlite3_open(testDbPath.c_str(), &conn), SQLITE_OK);
+        return conn;
+    }
+
+    // Writes a file the way releases before versioning did: the v1 table
+    // and user_version left at 0.
+    void createLegacyDatabase(int users) {
+        sqlite3* conn = openRaw();
+        ASSERT_EQ(sqlite3_exec(conn,
+            "CREATE TABLE usuarios ("
+            "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "usuario TEXT NOT NULL UNIQUE,"
+            "clave TEXT NOT NULL);", nullptr, nullptr, nullptr), SQLITE_OK);
+        sqlite3_exec(conn, "BEGIN;", nullptr, nullptr, nullptr);
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(conn, "INSERT INTO usuarios (usuario, clave) VALUES (?, ?);", -1, &stmt, nullptr);
+        for (int i = 0; i < users; i++) {
+            std::string email = "legacy" + std::to_string(i) + "@example.com";
+            std::string password = "Legacy@" + std::to_string(i);
+            sqlite3_bind_text(stmt, 1, email.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, password.c_str(), -1, SQLITE_TRANSIENT);
+            ASSERT_EQ(sqlite3_step(stmt), SQLITE_DONE);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_close(conn);
+    }
+
+    std::string scalarText(sqlite3* conn, const std::string& sql) {
+        sqlite3_stmt* stmt = nullptr;
+        std::string value;
+        if (sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+            value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        return value;
+    }
+
+    int userVersion() {
+        sqlite3* conn = openRaw();
+        int version = std::stoi(scalarText(conn, "PRAGMA user_version;"));
+        sqlite3_close(conn);
+        return version;
+    }
+
+    static int countStatements(unsigned, void* context, void*, void*) {
+        (*static_cast<int*>(context))++;
+        return 0;
+    }
+
+    std::string testDbPath;
+};
+
+// Test de base nueva: queda en la última versión con usuarios WITHOUT ROWID
+TEST_F(MigrationTest, NewDatabaseGetsLatestSchema) {
+    Database db(testDbPath);
+    ASSERT_TRUE(db.initialize());
+
+    int latest = authSchemaMigrations().back().version;
+    EXPECT_EQ(userVersion(), latest);
+    EXPECT_EQ(db.schemaReport().fromVersion, 0);
+    EXPECT_EQ(db.schemaReport().applied, latest);
+
+    sqlite3* conn = openRaw();
+    std::string ddl = scalarText(conn, "SELECT sql FROM sqlite_master WHERE name = 'usuarios';");
+    EXPECT_NE(ddl.find("WITHOUT ROWID"), std::string::npos) << ddl;
+    EXPECT_EQ(scalarText(conn, "PRAGMA auto_vacuum;"), "2");
+    sqlite3_close(conn);
+
+    EXPECT_TRUE(db.addUser("nuevo@example.com", "Nuevo@123"));
+    EXPECT_TRUE(db.validateUser("nuevo@example.com", "Nuevo@123"));
+}
+
+// Test de arranque sin cambios: solo se lee PRAGMA user_version
+TEST_F(MigrationTest, CurrentSchemaStartupIsSinglePragmaRead) {
+    {
+        Database db(testDbPath);
+        ASSERT_TRUE(db.initialize());
+    }
+
+    sqlite3* conn = openRaw();
+    int statements = 0;
+    sqlite3_trace_v2(conn, SQLITE_TRACE_STMT, &MigrationTest::countStatements, &statements);
+    SchemaMigrator migrator(conn, authSchemaMigrations());
+    migrator.adoptUnversioned("usuarios", kAuthSchemaUnversioned);
+    EXPECT_TRUE(migrator.migrate());
+    sqlite3_close(conn);
+
+    EXPECT_EQ(statements, 1);
+    EXPECT_EQ(migrator.report().applied, 0);
+}
+
+// Test de actualización: una base sin versión conserva sus usuarios
+TEST_F(MigrationTest, LegacyDatabaseIsUpgradedInPlace) {
+    createLegacyDatabase(50);
+
+    Database db(testDbPath);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_EQ(db.schemaReport().fromVersion, kAuthSchemaUnversioned);
+    EXPECT_EQ(db.schemaReport().rowsCopied, 50);
+
+    EXPECT_TRUE(db.validateUser("legacy0@example.com", "Legacy@0"));
+    EXPECT_TRUE(db.validateUser("legacy49@example.com", "Legacy@49"));
+    EXPECT_FALSE(db.validateUser("legacy49@example.com", "Legacy@0"));
+
+    sqlite3* conn = openRaw();
+    EXPECT_EQ(scalarText(conn, "SELECT count(*) FROM usuarios;"), "50");
+    EXPECT_EQ(scalarText(conn, "SELECT actualizado_en FROM usuarios WHERE usuario = 'legacy10@example.com';"), "0");
+    EXPECT_EQ(scalarText(conn, "SELECT count(*) FROM sqlite_master WHERE name LIKE 'usuarios_rebuild%';"), "0");
+    sqlite3_close(conn);
+}
+
+// Test de reconstrucción en línea: lotes acotados y progreso informado
+TEST_F(MigrationTest, OnlineRebuildCopiesInBoundedBatches) {
+    createLegacyDatabase(20000);
+
+    std::vector<MigrationProgress> updates;
+    DatabaseOptions options;
+    options.migrationBatchMs = 5;
+    options.migrationProgress = [&](const MigrationProgress& progress) {
+        updates.push_back(progress);
+    };
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+
+    const MigrationReport& report = db.schemaReport();
+    EXPECT_GT(report.copyBatches, 5);
+    EXPECT_EQ(report.rowsCopied, 20000);
+    // Generous bound: a batch that overruns is halved for the next one.
+    EXPECT_LT(report.maxBatchMs, 250.0);
+
+    ASSERT_FALSE(updates.empty());
+    long long previous = -1;
+    for (const MigrationProgress& update : updates) {
+        if (update.version == 2 && !update.finished) {
+            EXPECT_GE(update.rowsCopied, previous);
+            EXPECT_EQ(update.rowsTotal, 20000);
+            previous = update.rowsCopied;
+        }
+    }
+    EXPECT_EQ(previous, 20000);
+    EXPECT_TRUE(updates.back().finished);
+    EXPECT_TRUE(db.validateUser("legacy19999@example.com", "Legacy@19999"));
+}
+
+// Test de escrituras concurrentes: los cambios hechos durante la copia no se pierden
+TEST_F(MigrationTest, WritesDuringOnlineRebuildAreKept) {
+    createLegacyDatabase(5000);
+
+    sqlite3* writer = openRaw();
+    bool wrote = false;
+    sqlite3* conn = openRaw();
+    SchemaMigrator migrator(conn, authSchemaMigrations());
+    migrator.adoptUnversioned("usuarios", kAuthSchemaUnversioned);
+    migrator.setProgressCallback([&](const MigrationProgress& progress) {
+        // After the first batch: touch rows on both sides of the copy cursor.
+        if (!wrote && progress.version == 2 && progress.rowsCopied > 0 && !progress.finished) {
+            wrote = true;
+            ASSERT_EQ(sqlite3_exec(writer,
+                "INSERT INTO usuarios (usuario, clave) VALUES ('nuevo@example.com', 'Nuevo@1');"
+                "UPDATE usuarios SET clave = 'Cambiada@1' WHERE usuario = 'legacy0@example.com';"
+                "UPDATE usuarios SET clave = 'Cambiada@2' WHERE usuario = 'legacy999@example.com';"
+                "DELETE FROM usuarios WHERE usuario = 'legacy1@example.com';"
+                "DELETE FROM usuarios WHERE usuario = 'legacy998@example.com';",
+                nullptr, nullptr, nullptr), SQLITE_OK);
+        }
+    });
+    ASSERT_TRUE(migrator.migrate());
+    EXPECT_TRUE(wrote);
+    sqlite3_close(conn);
+    sqlite3_close(writer);
+
+    Database db(testDbPath);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_TRUE(db.validateUser("nuevo@example.com", "Nuevo@1"));
+    EXPECT_TRUE(db.validateUser("legacy0@example.com", "Cambiada@1"));
+    EXPECT_TRUE(db.validateUser("legacy999@example.com", "Cambiada@2"));
+    EXPECT_EQ(db.authenticate("legacy1@example.com", "Legacy@1"), LoginOutcome::UnknownUser);
+    EXPECT_EQ(db.authenticate("legacy998@example.com", "Legacy@998"), LoginOutcome::UnknownUser);
+    EXPECT_TRUE(db.validateUser("legacy4999@example.com", "Legacy@4999"));
+}
+
+// Test de concurrencia: varias conexiones abren a la vez una base nueva y todas arrancan
+TEST_F(MigrationTest, ConcurrentOpenersOfNewDatabaseAllSucceed) {
+    const int kConnections = 4;
+    for (int round = 0; round < 10; round++) {
+        removeFiles();
+        std::vector<char> ok(kConnections, 0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kConnections; i++) {
+            threads.emplace_back([&, i]() {
+                Database db(testDbPath);
+                ok[i] = db.initialize();
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (int i = 0; i < kConnections; i++) {
+            EXPECT_TRUE(ok[i]) << "round " << round << ", connection " << i;
+        }
+        EXPECT_EQ(userVersion(), authSchemaMigrations().back().version);
+    }
+}
+
+// Test de concurrencia: varias copias en línea de la misma tabla no se pisan
+TEST_F(MigrationTest, ConcurrentOnlineRebuildsKeepEveryRow) {
+    createLegacyDatabase(20000);
+
+    const int kConnections = 3;
+    std::vector<char> ok(kConnections, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kConnections; i++) {
+        threads.emplace_back([&, i]() {
+            DatabaseOptions options;
+            options.migrationBatchMs = 2;
+            Database db(testDbPath, options);
+            ok[i] = db.initialize();
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (int i = 0; i < kConnections; i++) {
+        EXPECT_TRUE(ok[i]) << "connection " << i;
+    }
+
+    sqlite3* conn = openRaw();
+    EXPECT_EQ(scalarText(conn, "SELECT count(*) FROM usuarios;"), "20000");
+    EXPECT_EQ(scalarText(conn, "SELECT count(*) FROM sqlite_master WHERE name LIKE 'usuarios_rebuild%';"), "0");
+    sqlite3_close(conn);
+    Database db(testDbPath);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_TRUE(db.validateUser("legacy0@example.com", "Legacy@0"));
+    EXPECT_TRUE(db.validateUser("legacy19999@example.com", "Legacy@19999"));
+}
+
+// Test de fallo: una migración errónea no deja cambios a medias
+TEST_F(MigrationTest, FailedMigrationRollsBack) {
+    {
+        Database db(testDbPath);
+        ASSERT_TRUE(db.initialize());
+        ASSERT_TRUE(db.addUser("usuario@example.com", "Clave@123"));
+    }
+    int before = userVersion();
+
+    std::vector<Migration> migrations = authSchemaMigrations();
+    Migration good;
+    good.version = before + 1;
+    good.description = "columna nueva";
+    good.sql = "ALTER TABLE usuarios ADD COLUMN extra INTEGER;";
+    Migration bad;
+    bad.version = before + 2;
+    bad.description = "sql roto";
+    bad.sql = "ALTER TABLE no_existe ADD COLUMN x INTEGER;";
+    migrations.push_back(good);
+    migrations.push_back(bad);
+
+    sqlite3* conn = openRaw();
+    SchemaMigrator migrator(conn, migrations);
+    EXPECT_FALSE(migrator.migrate());
+    EXPECT_EQ(scalarText(conn, "SELECT count(*) FROM pragma_table_info('usuarios') WHERE name = 'extra';"), "0");
+    sqlite3_close(conn);
+
+    EXPECT_EQ(userVersion(), before);
+    Database db(testDbPath);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_TRUE(db.validateUser("usuario@example.com", "Clave@123"));
+}
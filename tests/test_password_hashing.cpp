@@ -0,0 +1,302 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "HashingPool.h"
+#include "PasswordHasher.h"
+#include "Sha256.h"
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+// ============================================
+// PRUEBAS UNITARIAS - Hashing de contraseñas
+// ============================================
+
+namespace {
+    const HashCost kCheapCost = HashCost{4, 1, 1};
+
+    std::string readClave(const std::string& dbPath, const std::string& email) {
+        sqlite3* conn = nullptr;
+        sqlite3_open(dbPath.c_str(), &conn);
+        sqlite3_stmt* stmt = nullptr;
+        std::string value;
+        sqlite3_prepare_v2(conn, "SELECT clave FROM usuarios WHERE usuario = ?;", -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, email.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_close(conn);
+        return value;
+    }
+}
+
+class PasswordHashingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "hashing_test.db";
+        std::filesystem::remove(testDbPath);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(testDbPath);
+    }
+
+    std::string testDbPath;
+};
+
+// Test de SHA-256: vectores conocidos, también por partes
+TEST_F(PasswordHashingTest, Sha256KnownAnswers) {
+    uint8_t digest[Sha256::kDigestSize];
+    Sha256::digest("abc", 3, digest);
+    EXPECT_EQ(toHex(digest, sizeof(digest)), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    std::string thousand(1000, 'a');
+    Sha256 hash;
+    for (size_t i = 0; i < thousand.size(); i += 7) {
+        hash.update(thousand.data() + i, std::min<size_t>(7, thousand.size() - i));
+    }
+    hash.finish(digest);
+    EXPECT_EQ(toHex(digest, sizeof(digest)), "41edece42d63e8d9bf515a9ba6932e1c20cbc9f5a5d134645adb5db1b9737ea3");
+}
+
+// Test de HMAC y PBKDF2: vectores conocidos
+TEST_F(PasswordHashingTest, HmacAndPbkdf2KnownAnswers) {
+    uint8_t mac[Sha256::kDigestSize];
+    std::string message = "The quick brown fox jumps over the lazy dog";
+    hmacSha256("key", 3, message.data(), message.size(), mac);
+    EXPECT_EQ(toHex(mac, sizeof(mac)), "f7bc83f430538424b13298e6aa6fb143ef4d59a14946175997479dbc2d1a3cd8");
+
+    uint8_t key[32];
+    pbkdf2HmacSha256("password", 8, "salt", 4, 4096, key, sizeof(key));
+    EXPECT_EQ(toHex(key, sizeof(key)), "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a");
+}
+
+// Test de scrypt: vectores del RFC 7914
+TEST_F(PasswordHashingTest, ScryptRfc7914Vectors) {
+    uint8_t key[64];
+    scrypt("", 0, "", 0, HashCost{4, 1, 1}, key, sizeof(key));
+    EXPECT_EQ(toHex(key, sizeof(key)),
+              "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+              "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906");
+
+    scrypt("password", 8, "NaCl", 4, HashCost{10, 8, 16}, key, sizeof(key));
+    EXPECT_EQ(toHex(key, sizeof(key)),
+              "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+              "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640");
+}
+
+// Test de formato: hash con sal aleatoria y verificación
+TEST_F(PasswordHashingTest, HashVerifiesOnlyTheRightPassword) {
+    PasswordHasher hasher(HashCost{6, 8, 1});
+    std::string first = hasher.hash("Pass@123");
+    std::string second = hasher.hash("Pass@123");
+
+    EXPECT_EQ(first.rfind("$scrypt$ln=6,r=8,p=1$", 0), 0u) << first;
+    EXPECT_NE(first, second);
+    EXPECT_EQ(first.find("Pass@123"), std::string::npos);
+
+    PasswordCheck ok = hasher.verify("Pass@123", first);
+    EXPECT_TRUE(ok.match);
+    EXPECT_FALSE(ok.needsRehash);
+    EXPECT_FALSE(hasher.verify("Pass@124", first).match);
+    EXPECT_FALSE(hasher.verify("", first).match);
+}
+
+// Test de rehash: un cambio de coste marca los hashes antiguos
+TEST_F(PasswordHashingTest, CostChangeRequestsRehash) {
+    std::string stored = PasswordHasher(HashCost{5, 8, 1}).hash("Pass@123");
+    PasswordCheck check = PasswordHasher(HashCost{6, 8, 1}).verify("Pass@123", stored);
+    EXPECT_TRUE(check.match);
+    EXPECT_TRUE(check.needsRehash);
+}
+
+// Test de rehash: un hash más caro que el coste actual se deja como está, así
+// dos procesos calibrados distinto no se reescriben los hashes en cada login
+TEST_F(PasswordHashingTest, StrongerStoredCostIsKept) {
+    std::string stored = PasswordHasher(HashCost{6, 8, 1}).hash("Pass@123");
+    PasswordCheck check = PasswordHasher(HashCost{5, 8, 1}).verify("Pass@123", stored);
+    EXPECT_TRUE(check.match);
+    EXPECT_FALSE(check.needsRehash);
+
+    // Same work in another shape is not weaker either.
+    stored = PasswordHasher(HashCost{4, 2, 1}).hash("Pass@123");
+    EXPECT_FALSE(PasswordHasher(HashCost{5, 1, 1}).verify("Pass@123", stored).needsRehash);
+    EXPECT_TRUE(PasswordHasher(HashCost{5, 2, 1}).verify("Pass@123", stored).needsRehash);
+}
+
+// Test de compatibilidad: claves en texto plano de versiones anteriores
+TEST_F(PasswordHashingTest, LegacyPlaintextVerifiesAndRequestsRehash) {
+    PasswordHasher hasher(kCheapCost);
+    PasswordCheck check = hasher.verify("Pass@123", "Pass@123");
+    EXPECT_TRUE(check.match);
+    EXPECT_TRUE(check.needsRehash);
+    EXPECT_FALSE(hasher.verify("Pass@12", "Pass@123").match);
+
+    HashCost cost;
+    std::string salt;
+    std::string key;
+    EXPECT_FALSE(PasswordHasher::parse("$scrypt$ln=99,r=8,p=1$AAAA$AAAA", cost, salt, key));
+    EXPECT_FALSE(PasswordHasher::parse("$scrypt$ln=4,r=1,p=1$AA!A$AAAA", cost, salt, key));
+    EXPECT_FALSE(PasswordHasher::parse("$scrypt$ln=4,r=1,p=1$AAAA", cost, salt, key));
+}
+
+// Test de hash corrupto: un valor con prefijo $scrypt$ que no se puede leer nunca coincide
+TEST_F(PasswordHashingTest, MalformedHashNeverMatches) {
+    PasswordHasher hasher(kCheapCost);
+    std::string stored = hasher.hash("Pass@123");
+    const std::string malformed[] = {
+        stored.substr(0, stored.size() / 2),
+        "$scrypt$ln=99,r=8,p=1$AAAA$AAAA",
+        "$scrypt$ln=4,r=1,p=1$AA!A$AAAA",
+        "$scrypt$",
+    };
+    for (const std::string& value : malformed) {
+        PasswordCheck check = hasher.verify(value, value);
+        EXPECT_FALSE(check.match) << value;
+        EXPECT_FALSE(check.needsRehash) << value;
+        EXPECT_TRUE(check.malformed) << value;
+    }
+    EXPECT_FALSE(hasher.verify("Pass@123", stored).malformed);
+    EXPECT_FALSE(hasher.verify("Pass@123", "Pass@123").malformed);
+
+    PasswordCheck dummy = hasher.verify("Pass@123", hasher.dummy());
+    EXPECT_FALSE(dummy.match);
+    EXPECT_FALSE(dummy.malformed);
+    EXPECT_FALSE(dummy.needsRehash);
+
+    DatabaseOptions options;
+    options.hashCost = kCheapCost;
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+    sqlite3* conn = nullptr;
+    sqlite3_open(testDbPath.c_str(), &conn);
+    std::string sql = "INSERT INTO usuarios (usuario, clave) VALUES ('corrupt@example.com', '" + malformed[0] + "');";
+    ASSERT_EQ(sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr), SQLITE_OK);
+    sqlite3_close(conn);
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(db.authenticate("corrupt@example.com", malformed[0]), LoginOutcome::StorageError);
+    EXPECT_EQ(testing::internal::GetCapturedStderr().find("corrupt@example.com"), std::string::npos);
+    EXPECT_EQ(readClave(testDbPath, "corrupt@example.com"), malformed[0]);
+}
+
+// Test de cuentas inexistentes: pagan el mismo hash que una contraseña incorrecta
+TEST_F(PasswordHashingTest, UnknownAccountPaysForOneHash) {
+    HashingPool pool(1, 4);
+    DatabaseOptions options;
+    options.hashCost = kCheapCost;
+    options.hashingPool = &pool;
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+    uint64_t before = pool.stats().completed;
+
+    EXPECT_EQ(db.authenticate("nadie@example.com", "Pass@123"), LoginOutcome::UnknownUser);
+    EXPECT_EQ(pool.stats().completed, before + 1);
+    EXPECT_EQ(db.authenticate("user@example.com", "Wrong@123"), LoginOutcome::WrongPassword);
+    EXPECT_EQ(pool.stats().completed, before + 2);
+
+    FetchedCredential fetched;
+    ASSERT_EQ(db.fetchCredential("nadie@example.com", fetched), LoginOutcome::Success);
+    ASSERT_FALSE(fetched.found);
+    EXPECT_EQ(db.authenticateFetched("nadie@example.com", "Pass@123", fetched), LoginOutcome::UnknownUser);
+    EXPECT_EQ(pool.stats().completed, before + 3);
+
+    EXPECT_EQ(db.authenticate("nadie@example.com", "Pass@123", Database::Clock::now() - std::chrono::seconds(1)),
+              LoginOutcome::TimedOut);
+}
+
+// Test de calibración: elige el mayor coste que cabe en el objetivo
+TEST_F(PasswordHashingTest, CalibrationFitsTarget) {
+    HashCost cost = PasswordHasher::calibrate(20.0);
+    EXPECT_GE(cost.logN, PasswordHasher::kMinCalibratedLogN);
+    EXPECT_EQ(cost.r, 8);
+
+    auto start = std::chrono::steady_clock::now();
+    PasswordHasher(cost).hash("Pass@123");
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "calibrado ln=" << cost.logN << " -> " << elapsedMs << "ms" << std::endl;
+    if (cost.logN > PasswordHasher::kMinCalibratedLogN) {
+        // Generous: the machine may be busier now than during calibration.
+        EXPECT_LT(elapsedMs, 20.0 * 4);
+    }
+    EXPECT_EQ(PasswordHasher::calibrated(20.0), PasswordHasher::calibrated(20.0));
+}
+
+// Test del pool: resultados, deadline y cola acotada
+TEST_F(PasswordHashingTest, PoolHonoursDeadlinesAndBoundsQueue) {
+    HashingPool pool(1, 1);
+    auto now = [] { return HashingPool::Clock::now(); };
+
+    int value = 0;
+    EXPECT_TRUE(pool.run([] { return 42; }, now() + std::chrono::seconds(5), value));
+    EXPECT_EQ(value, 42);
+
+    // Occupy the worker, fill the single queue slot, then overflow.
+    auto busy = [] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return 1;
+    };
+    std::thread blocker([&] {
+        int ignored = 0;
+        pool.run(busy, HashingPool::Clock::time_point::max(), ignored);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(pool.submit([](bool) {}, now() + std::chrono::milliseconds(10)));
+    EXPECT_FALSE(pool.submit([](bool) {}, now() + std::chrono::milliseconds(10)));
+    EXPECT_FALSE(pool.run(busy, now() + std::chrono::milliseconds(10), value));
+    blocker.join();
+
+    HashingPoolStats stats = pool.stats();
+    EXPECT_GE(stats.rejected, 2u);
+    EXPECT_EQ(stats.maxQueueDepth, 1u);
+}
+
+// Test de base de datos: se guarda el hash, nunca la contraseña
+TEST_F(PasswordHashingTest, DatabaseStoresHashes) {
+    DatabaseOptions options;
+    options.hashCost = kCheapCost;
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+
+    std::string stored = readClave(testDbPath, "user@example.com");
+    EXPECT_EQ(stored.rfind("$scrypt$ln=4,r=1,p=1$", 0), 0u) << stored;
+    EXPECT_TRUE(db.validateUser("user@example.com", "Pass@123"));
+    EXPECT_EQ(db.authenticate("user@example.com", "Wrong@123"), LoginOutcome::WrongPassword);
+    EXPECT_EQ(db.stats().rehashes, 0u);
+}
+
+// Test de rehash perezoso: texto plano y coste antiguo se actualizan al entrar
+TEST_F(PasswordHashingTest, SuccessfulLoginRehashesLazily) {
+    {
+        Database db(testDbPath, DatabaseOptions());
+        ASSERT_TRUE(db.initialize());
+    }
+    sqlite3* conn = nullptr;
+    sqlite3_open(testDbPath.c_str(), &conn);
+    ASSERT_EQ(sqlite3_exec(conn, "INSERT INTO usuarios (usuario, clave) VALUES ('legacy@example.com', 'Pass@123');",
+                           nullptr, nullptr, nullptr), SQLITE_OK);
+    sqlite3_close(conn);
+
+    DatabaseOptions options;
+    options.hashCost = HashCost{5, 1, 1};
+    {
+        Database db(testDbPath, options);
+        ASSERT_TRUE(db.initialize());
+        EXPECT_EQ(db.authenticate("legacy@example.com", "Wrong@123"), LoginOutcome::WrongPassword);
+        EXPECT_EQ(readClave(testDbPath, "legacy@example.com"), "Pass@123");
+        EXPECT_TRUE(db.validateUser("legacy@example.com", "Pass@123"));
+        EXPECT_EQ(db.stats().rehashes, 1u);
+    }
+    std::string upgraded = readClave(testDbPath, "legacy@example.com");
+    EXPECT_EQ(upgraded.rfind("$scrypt$ln=5,r=1,p=1$", 0), 0u) << upgraded;
+
+    options.hashCost = HashCost{6, 1, 1};
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_TRUE(db.validateUser("legacy@example.com", "Pass@123"));
+    EXPECT_TRUE(db.validateUser("legacy@example.com", "Pass@123"));
+    EXPECT_EQ(db.stats().rehashes, 1u);
+    EXPECT_EQ(readClave(testDbPath, "legacy@example.com").rfind("$scrypt$ln=6,r=1,p=1$", 0), 0u);
+}
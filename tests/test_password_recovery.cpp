@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "PasswordRecovery.h"
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Recuperación de clave
+// ============================================
+
+class PasswordRecoveryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "recovery_test.db";
+        spoolDir = "recovery_spool_test";
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove_all(spoolDir);
+        dbOptions.hashCost = HashCost{4, 1, 1};
+        Database db(testDbPath, dbOptions);
+        ASSERT_TRUE(db.initialize());
+        ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+        ASSERT_TRUE(db.addUser("otro@example.com", "Pass@123"));
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove_all(spoolDir);
+    }
+
+    // The token is whatever follows the reset URL in the body.
+    std::string tokenIn(const OutboundMessage& message) {
+        size_t at = message.body.find(options.resetUrl);
+        if (at == std::string::npos) {
+            return "";
+        }
+        at += options.resetUrl.size();
+        return message.body.substr(at, message.body.find('\n', at) - at);
+    }
+
+    std::string testDbPath;
+    std::string spoolDir;
+    DatabaseOptions dbOptions;
+    RecoveryOptions options;
+    MemoryTransport transport;
+};
+
+// Test de recuperación: el token llega por mensaje y sirve una sola vez
+TEST_F(PasswordRecoveryTest, TokenIsDeliveredAndSingleUse) {
+    PasswordRecovery recovery(testDbPath, transport, options, dbOptions);
+    ASSERT_TRUE(recovery.start());
+    EXPECT_TRUE(recovery.request("user@example.com"));
+    recovery.flush();
+
+    std::vector<OutboundMessage> messages = transport.messages();
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0].to, "user@example.com");
+    EXPECT_EQ(messages[0].subject, options.subject);
+    std::string token = tokenIn(messages[0]);
+    EXPECT_EQ(token.size(), 64u);
+
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_TRUE(db.redeemResetToken(token, "Nueva@123"));
+    EXPECT_EQ(db.authenticate("user@example.com", "Nueva@123"), LoginOutcome::Success);
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::WrongPassword);
+    EXPECT_FALSE(db.redeemResetToken(token, "Otra@123"));
+    EXPECT_FALSE(db.redeemResetToken("no-es-un-token", "Otra@123"));
+
+    RecoveryStats stats = recovery.stats();
+    EXPECT_EQ(stats.issued, 1u);
+    EXPECT_EQ(stats.delivered, 1u);
+}
+
+// Test de cuenta inexistente: misma respuesta, ningún mensaje
+TEST_F(PasswordRecoveryTest, UnknownAccountGetsNoMessage) {
+    PasswordRecovery recovery(testDbPath, transport, options, dbOptions);
+    ASSERT_TRUE(recovery.start());
+    EXPECT_TRUE(recovery.request("nadie@example.com"));
+    recovery.flush();
+
+    EXPECT_TRUE(transport.messages().empty());
+    EXPECT_EQ(recovery.stats().unknownAccounts, 1u);
+    EXPECT_EQ(recovery.stats().issued, 0u);
+}
+
+// Test de límite: una cuenta no recibe más de maxPerAccount mensajes por ventana
+TEST_F(PasswordRecoveryTest, RequestsAreRateLimitedPerAccount) {
+    options.maxPerAccount = 2;
+    PasswordRecovery recovery(testDbPath, transport, options, dbOptions);
+    ASSERT_TRUE(recovery.start());
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(recovery.request("user@example.com"));
+    }
+    EXPECT_TRUE(recovery.request("otro@example.com"));
+    recovery.flush();
+
+    EXPECT_EQ(transport.messages().size(), 3u);
+    EXPECT_EQ(recovery.stats().rateLimited, 3u);
+}
+
+// Test de tokens: usar uno invalida los demás de la cuenta; uno caducado no sirve
+TEST_F(PasswordRecoveryTest, RedeemingUsesUpOtherTokensAndExpiredOnesFail) {
+    PasswordRecovery recovery(testDbPath, transport, options, dbOptions);
+    ASSERT_TRUE(recovery.start());
+    recovery.request("user@example.com");
+    recovery.request("user@example.com");
+    recovery.flush();
+    std::vector<OutboundMessage> messages = transport.messages();
+    ASSERT_EQ(messages.size(), 2u);
+
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    EXPECT_TRUE(db.redeemResetToken(tokenIn(messages[1]), "Nueva@123"));
+    EXPECT_FALSE(db.redeemResetToken(tokenIn(messages[0]), "Otra@123"));
+
+    std::vector<bool> issued;
+    int64_t past = static_cast<int64_t>(std::time(nullptr)) - 1;
+    ASSERT_TRUE(db.storeResetTokens({{"otro@example.com", Database::hashResetToken("caducado"), past},
+                                     {"nadie@example.com", Database::hashResetToken("huerfano"), past + 3600}},
+                                    issued));
+    EXPECT_TRUE(issued[0]);
+    EXPECT_FALSE(issued[1]);
+    EXPECT_FALSE(db.redeemResetToken("caducado", "Nueva@123"));
+    // Two used by user@example.com plus the expired one.
+    EXPECT_EQ(db.purgeResetTokens(), 3);
+}
+
+// Test de reintentos: un transporte caído no pierde los mensajes si se recupera
+TEST_F(PasswordRecoveryTest, RefusedBatchIsRetried) {
+    options.retryBackoffMs = 20;
+    transport.setFailing(true);
+    PasswordRecovery recovery(testDbPath, transport, options, dbOptions);
+    ASSERT_TRUE(recovery.start());
+    recovery.request("user@example.com");
+    std::thread repair([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        transport.setFailing(false);
+    });
+    recovery.flush();
+    repair.join();
+
+    EXPECT_EQ(transport.messages().size(), 1u);
+    EXPECT_EQ(recovery.stats().deliveryFailures, 0u);
+}
+
+// Test de envío por lotes: muchas peticiones salen en pocos lotes
+TEST_F(PasswordRecoveryTest, DeliveriesAreBatched) {
+    options.maxPerAccount = 1000;
+    PasswordRecovery recovery(testDbPath, transport, options, dbOptions);
+    // Queued before the sender starts draining, so they form full batches.
+    ASSERT_TRUE(recovery.start());
+    for (int i = 0; i < 300; i++) {
+        recovery.request(i % 2 ? "user@example.com" : "otro@example.com");
+    }
+    recovery.flush();
+    EXPECT_EQ(transport.messages().size(), 300u);
+    EXPECT_LT(transport.batchCount(), 300u);
+    EXPECT_EQ(recovery.stats().batches, transport.batchCount());
+}
+
+// Test de parada: sin arrancar no se aceptan peticiones
+TEST_F(PasswordRecoveryTest, RequestsAreDroppedWhenStopped) {
+    PasswordRecovery recovery(testDbPath, transport, options, dbOptions);
+    EXPECT_FALSE(recovery.request("user@example.com"));
+    EXPECT_EQ(recovery.stats().dropped, 1u);
+}
+
+// Test de spool: cada lote es un fichero completo, nunca uno a medias
+TEST_F(PasswordRecoveryTest, SpoolTransportWritesWholeBatchFiles) {
+    SpoolTransport spool(spoolDir);
+    std::vector<OutboundMessage> batch = {
+        {"a@example.com", "Asunto", "cuerpo uno\n"},
+        {"b@example.com", "Asunto", "cuerpo dos\n"},
+    };
+    ASSERT_TRUE(spool.deliver(batch));
+    ASSERT_TRUE(spool.deliver(batch));
+
+    int files = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(spoolDir)) {
+        EXPECT_EQ(entry.path().extension(), ".txt");
+        std::ifstream in(entry.path());
+        std::stringstream content;
+        content << in.rdbuf();
+        EXPECT_EQ(content.str(),
+                  "To: a@example.com\nSubject: Asunto\nContent-Length: 11\n\ncuerpo uno\n"
+                  "To: b@example.com\nSubject: Asunto\nContent-Length: 11\n\ncuerpo dos\n");
+        files++;
+    }
+    EXPECT_EQ(files, 2);
+}
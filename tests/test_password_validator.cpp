@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "PasswordValidator.h"
+#include <string>
 
 // ============================================
 // PRUEBAS DE CAJA NEGRA - Password Validator
@@ -117,3 +118,60 @@ TEST(PasswordValidatorTest, EdgeCases) {
     // Múltiples caracteres especiales
     EXPECT_TRUE(PasswordValidator::validate("A@#$%b"));
 }
+
+// ============================================
+// PRUEBAS UNITARIAS - Validación incremental
+// ============================================
+
+// Test de equivalencia: el estado incremental coincide con validate() tras cada tecla y borrado
+TEST(PasswordPolicyStateTest, MatchesValidateKeystrokeByKeystroke) {
+    const std::string keys = "aZ@1bY#2cX$3 ";
+    unsigned seed = 12345;
+    for (int round = 0; round < 200; round++) {
+        PasswordPolicyState state;
+        std::string typed;
+        for (int step = 0; step < 30; step++) {
+            seed = seed * 1103515245 + 12345;
+            if (!typed.empty() && (seed >> 16) % 4 == 0) {
+                state.pop(typed.back());
+                typed.pop_back();
+            } else {
+                char c = keys[(seed >> 16) % keys.size()];
+                typed += c;
+                state.push(c);
+            }
+            ASSERT_EQ(state.length(), typed.size());
+            ASSERT_EQ(state.hasMinLength(), PasswordValidator::hasMinLength(typed));
+            ASSERT_EQ(state.hasMaxLength(), PasswordValidator::hasMaxLength(typed));
+            ASSERT_EQ(state.hasUpperCase(), PasswordValidator::hasUpperCase(typed));
+            ASSERT_EQ(state.hasSpecialChar(), PasswordValidator::hasSpecialChar(typed));
+            ASSERT_EQ(state.valid(), PasswordValidator::validate(typed)) << typed;
+        }
+    }
+}
+
+// Test de indicador de fuerza: crece con la variedad y la longitud
+TEST(PasswordPolicyStateTest, StrengthGrowsWithVarietyAndLength) {
+    auto strengthOf = [](const std::string& password) {
+        PasswordPolicyState state;
+        for (char c : password) {
+            state.push(c);
+        }
+        return state.strength();
+    };
+    EXPECT_EQ(strengthOf(""), 0);
+    EXPECT_EQ(strengthOf("A@b"), 1);  // too short to rate higher
+    EXPECT_EQ(strengthOf("abcde"), 1);
+    EXPECT_EQ(strengthOf("Abcde"), 1);
+    EXPECT_EQ(strengthOf("A@bcd"), 2);
+    EXPECT_EQ(strengthOf("A@bc1"), 3);
+    EXPECT_EQ(strengthOf("A@bcd1234"), 4);
+
+    PasswordPolicyState state;
+    state.push('A');
+    state.clear();
+    EXPECT_EQ(state.length(), 0u);
+    EXPECT_FALSE(state.hasUpperCase());
+    state.pop('A');  // nothing to remove
+    EXPECT_EQ(state.length(), 0u);
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include "AuthPipeline.h"
+#include "CredentialPrefetcher.h"
+#include "Database.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+// ============================================
+// PRUEBAS UNITARIAS - Precarga de credenciales
+// ============================================
+
+class PrefetchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "prefetch_test.db";
+        std::filesystem::remove(testDbPath);
+        options.hashCost = HashCost{4, 1, 1};
+        db = std::make_unique<Database>(testDbPath, options);
+        ASSERT_TRUE(db->initialize());
+        ASSERT_TRUE(db->addUser("user@example.com", "Pass@123"));
+    }
+
+    void TearDown() override {
+        db.reset();
+        std::filesystem::remove(testDbPath);
+    }
+
+    void buildPipeline(CredentialPrefetcher& prefetcher) {
+        pipeline.add(std::make_unique<NormalizeStage>());
+        pipeline.add(std::make_unique<PrefetchStage>(prefetcher, *db));
+        pipeline.add(std::make_unique<StorageStage>(*db));
+    }
+
+    // Waits until the prefetch thread has finished `count` lookups.
+    bool waitForLookups(CredentialPrefetcher& prefetcher, uint64_t count) {
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < until) {
+            PrefetchStats stats = prefetcher.stats();
+            if (stats.fetched + stats.dropped >= count) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+    LoginOutcome login(const char* email, const char* password) {
+        LoginRequest request;
+        request.email = email;
+        request.password = password;
+        return pipeline.authenticate(request);
+    }
+
+    const AuthStageStats& stageStats(const char* name) {
+        lastStats = pipeline.stats();
+        for (const AuthStageStats& stats : lastStats) {
+            if (std::string(stats.name) == name) {
+                return stats;
+            }
+        }
+        return lastStats.front();
+    }
+
+    std::string testDbPath;
+    DatabaseOptions options;
+    std::unique_ptr<Database> db;
+    AuthPipeline pipeline;
+    std::vector<AuthStageStats> lastStats;
+};
+
+// Test de precarga: con el registro ya leído el login no consulta la base
+TEST_F(PrefetchTest, PrefetchedLoginSkipsTheQuery) {
+    CredentialPrefetcher prefetcher(testDbPath, options);
+    ASSERT_TRUE(prefetcher.start());
+    buildPipeline(prefetcher);
+
+    prefetcher.prefetch("  user@example.com ");
+    ASSERT_TRUE(waitForLookups(prefetcher, 1));
+    EXPECT_EQ(login("user@example.com", "Pass@123"), LoginOutcome::Success);
+
+    EXPECT_EQ(stageStats("prefetch").decided, 1u);
+    EXPECT_EQ(stageStats("storage").evaluated, 0u);
+    EXPECT_EQ(db->stats().queries, 0u);
+    EXPECT_EQ(prefetcher.stats().used, 1u);
+}
+
+// Test de resultados: clave incorrecta y cuenta inexistente también desde la precarga
+TEST_F(PrefetchTest, PrefetchAnswersFailuresToo) {
+    CredentialPrefetcher prefetcher(testDbPath, options);
+    ASSERT_TRUE(prefetcher.start());
+    buildPipeline(prefetcher);
+
+    prefetcher.prefetch("user@example.com");
+    prefetcher.prefetch("nadie@example.com");
+    ASSERT_TRUE(waitForLookups(prefetcher, 2));
+    EXPECT_EQ(login("user@example.com", "Mala@123"), LoginOutcome::WrongPassword);
+    EXPECT_EQ(login("nadie@example.com", "Pass@123"), LoginOutcome::UnknownUser);
+    EXPECT_EQ(stageStats("prefetch").decided, 2u);
+    EXPECT_EQ(stageStats("storage").evaluated, 0u);
+}
+
+// Test de uso único: el segundo login vuelve a leer la base
+TEST_F(PrefetchTest, RecordIsUsedOnce) {
+    CredentialPrefetcher prefetcher(testDbPath, options);
+    ASSERT_TRUE(prefetcher.start());
+    buildPipeline(prefetcher);
+
+    prefetcher.prefetch("user@example.com");
+    ASSERT_TRUE(waitForLookups(prefetcher, 1));
+    EXPECT_EQ(login("user@example.com", "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(login("user@example.com", "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(stageStats("prefetch").decided, 1u);
+    EXPECT_EQ(stageStats("storage").decided, 1u);
+}
+
+// Test de caducidad: un registro viejo no decide, y un cambio de clave se ve
+TEST_F(PrefetchTest, ExpiredRecordFallsThroughToStorage) {
+    PrefetchOptions prefetchOptions;
+    prefetchOptions.ttl = std::chrono::milliseconds(20);
+    CredentialPrefetcher prefetcher(testDbPath, options, prefetchOptions);
+    ASSERT_TRUE(prefetcher.start());
+    buildPipeline(prefetcher);
+
+    prefetcher.prefetch("user@example.com");
+    ASSERT_TRUE(waitForLookups(prefetcher, 1));
+    ASSERT_TRUE(db->changePassword("user@example.com", "Nueva@123"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+    EXPECT_EQ(login("user@example.com", "Nueva@123"), LoginOutcome::Success);
+    EXPECT_EQ(stageStats("prefetch").decided, 0u);
+    EXPECT_EQ(prefetcher.stats().expired, 1u);
+}
+
+// Test de otra cuenta: la precarga de un email no sirve para otro
+TEST_F(PrefetchTest, OnlyTheSameEmailMatches) {
+    CredentialPrefetcher prefetcher(testDbPath, options);
+    ASSERT_TRUE(prefetcher.start());
+    buildPipeline(prefetcher);
+
+    prefetcher.prefetch("otro@example.com");
+    ASSERT_TRUE(waitForLookups(prefetcher, 1));
+    EXPECT_EQ(login("user@example.com", "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(stageStats("prefetch").decided, 0u);
+    EXPECT_EQ(stageStats("storage").decided, 1u);
+}
+
+// Test de Database: la lectura anticipada más la comprobación equivalen a authenticate
+TEST_F(PrefetchTest, FetchedCredentialMatchesAuthenticate) {
+    FetchedCredential fetched;
+    EXPECT_EQ(db->fetchCredential("user@example.com", fetched), LoginOutcome::Success);
+    EXPECT_TRUE(fetched.found);
+    EXPECT_FALSE(fetched.clave.empty());
+    EXPECT_EQ(db->authenticateFetched("user@example.com", "Pass@123", fetched), LoginOutcome::Success);
+    EXPECT_EQ(db->authenticateFetched("user@example.com", "Mala@123", fetched), LoginOutcome::WrongPassword);
+
+    EXPECT_EQ(db->fetchCredential("nadie@example.com", fetched), LoginOutcome::Success);
+    EXPECT_FALSE(fetched.found);
+    EXPECT_EQ(db->authenticateFetched("nadie@example.com", "Pass@123", fetched), LoginOutcome::UnknownUser);
+}
@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include "Profiler.h"
+#include "Sha256.h"
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+
+// ============================================
+// PRUEBAS UNITARIAS - Perfilador de CPU
+// ============================================
+
+namespace {
+    struct ParsedProfile {
+        bool valid = false;
+        uintptr_t periodUs = 0;
+        uint64_t samples = 0;
+        std::vector<std::vector<uintptr_t>> stacks;
+        std::string maps;
+    };
+
+    ParsedProfile readProfile(const std::string& path) {
+        ParsedProfile profile;
+        std::ifstream file(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const uintptr_t* words = reinterpret_cast<const uintptr_t*>(bytes.data());
+        size_t count = bytes.size() / sizeof(uintptr_t);
+        if (count < 8 || words[0] != 0 || words[1] != 3 || words[2] != 0 || words[4] != 0) {
+            return profile;
+        }
+        profile.periodUs = words[3];
+        size_t i = 5;
+        while (i + 2 < count) {
+            if (words[i] == 0 && words[i + 1] == 1 && words[i + 2] == 0) {
+                profile.maps = bytes.substr((i + 3) * sizeof(uintptr_t));
+                profile.valid = true;
+                return profile;
+            }
+            uintptr_t depth = words[i + 1];
+            if (i + 2 + depth > count) {
+                return profile;
+            }
+            profile.samples += words[i];
+            profile.stacks.emplace_back(words + i + 2, words + i + 2 + depth);
+            i += 2 + depth;
+        }
+        return profile;
+    }
+
+    // Burns `ms` of CPU time in this thread.
+    void burnCpu(int ms) {
+        std::clock_t until = std::clock() + ms * CLOCKS_PER_SEC / 1000;
+        std::string block(4096, 'x');
+        uint8_t digest[Sha256::kDigestSize];
+        while (std::clock() < until) {
+            Sha256::digest(block.data(), block.size(), digest);
+            block[0] = static_cast<char>(digest[0]);
+        }
+    }
+
+#if defined(__linux__) && defined(__x86_64__)
+    // Spins with the stack pointer at `stackTop` and a frame pointer that
+    // code without frame pointers could have left: a frame whose return
+    // address lies past the end of the mapping.
+    void spinWithBadFramePointer(uintptr_t stackTop, uintptr_t framePointer, uint64_t iterations) {
+        asm volatile(
+            "mov %%rsp, %%r12\n\t"
+            "mov %%rbp, %%r13\n\t"
+            "mov %[top], %%rsp\n\t"
+            "mov %[fp], %%rbp\n\t"
+            "1: dec %[n]\n\t"
+            "jnz 1b\n\t"
+            "mov %%r12, %%rsp\n\t"
+            "mov %%r13, %%rbp\n\t"
+            : [n] "+r"(iterations)
+            : [top] "r"(stackTop), [fp] "r"(framePointer)
+            : "r12", "r13", "memory", "cc");
+    }
+#endif
+}
+
+class ProfilerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        profilePath = "profiler_test.prof";
+        std::filesystem::remove(profilePath);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(profilePath);
+    }
+
+    std::string profilePath;
+};
+
+// Test de muestreo: el tiempo de CPU se muestrea a la frecuencia pedida y el perfil es legible
+TEST_F(ProfilerTest, SamplesCpuTimeAndWritesProfile) {
+    ProfilerOptions options;
+    options.frequencyHz = 250;
+    CpuProfiler profiler(options);
+    ASSERT_TRUE(profiler.start());
+    burnCpu(400);
+    profiler.stop();
+
+    ProfilerStats stats = profiler.stats();
+    // 100 expected; the timer only fires on the kernel's tick.
+    EXPECT_GT(stats.samples, 40u);
+    EXPECT_LT(stats.samples, 160u);
+    EXPECT_EQ(stats.dropped, 0u);
+
+    ASSERT_TRUE(profiler.writeProfile(profilePath));
+    ParsedProfile profile = readProfile(profilePath);
+    ASSERT_TRUE(profile.valid);
+    EXPECT_EQ(profile.periodUs, 4000u);
+    EXPECT_EQ(profile.samples, stats.samples);
+    EXPECT_EQ(profile.stacks.size(), stats.stacks);
+    EXPECT_NE(profile.maps.find("r-xp"), std::string::npos);
+}
+
+// Test de pilas: cada dirección cae en una región ejecutable del proceso, así que pprof la puede simbolizar
+TEST_F(ProfilerTest, FramesLieInExecutableMappings) {
+    CpuProfiler profiler;
+    ASSERT_TRUE(profiler.start());
+    burnCpu(300);
+    profiler.stop();
+    ASSERT_TRUE(profiler.writeProfile(profilePath));
+    ParsedProfile profile = readProfile(profilePath);
+    ASSERT_TRUE(profile.valid);
+    ASSERT_FALSE(profile.stacks.empty());
+
+    std::vector<std::pair<uintptr_t, uintptr_t>> executable;
+    std::istringstream maps(profile.maps);
+    std::string line;
+    while (std::getline(maps, line)) {
+        unsigned long long low = 0;
+        unsigned long long high = 0;
+        char permissions[5] = {};
+        if (std::sscanf(line.c_str(), "%llx-%llx %4s", &low, &high, permissions) == 3 && permissions[2] == 'x') {
+            executable.emplace_back(static_cast<uintptr_t>(low), static_cast<uintptr_t>(high));
+        }
+    }
+    size_t deep = 0;
+    for (const auto& stack : profile.stacks) {
+        deep += stack.size() > 2 ? 1 : 0;
+        for (uintptr_t pc : stack) {
+            bool found = false;
+            for (const auto& range : executable) {
+                found = found || (pc >= range.first && pc < range.second);
+            }
+            EXPECT_TRUE(found) << std::hex << pc;
+        }
+    }
+    // burnCpu, the test body and gtest are below every leaf.
+    EXPECT_GT(deep, 0u);
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+// Test de robustez: un puntero de marco basura, registrado el hilo o no, corta la pila en vez de leer memoria sin mapear
+TEST_F(ProfilerTest, GarbageFramePointerEndsTheStack) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t size = 64 * 1024;
+    char* region = static_cast<char*>(mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(region, MAP_FAILED);
+    ASSERT_EQ(munmap(region + size, page), 0);
+    uintptr_t end = reinterpret_cast<uintptr_t>(region + size);
+
+    ProfilerOptions options;
+    options.frequencyHz = 1000;
+    CpuProfiler profiler(options);
+    ASSERT_TRUE(profiler.start());
+    for (bool registered : {false, true}) {
+        std::thread spinner([&]() {
+            if (registered) {
+                CpuProfiler::registerThread();
+            }
+            spinWithBadFramePointer(end - 256, end - sizeof(uintptr_t), 300000000);
+        });
+        spinner.join();
+    }
+    profiler.stop();
+    munmap(region, size);
+    EXPECT_GT(profiler.stats().samples, 20u);
+}
+#endif
+
+// Test de reposo: un proceso dormido no gasta CPU y no se muestrea
+TEST_F(ProfilerTest, IdleProcessIsNotSampled) {
+    CpuProfiler profiler;
+    ASSERT_TRUE(profiler.start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    profiler.stop();
+    EXPECT_LE(profiler.stats().samples, 2u);
+}
+
+// Test de señal: SIGUSR2 escribe el perfil sin parar el muestreo, y stop() lo escribe de nuevo
+TEST_F(ProfilerTest, SignalWritesProfile) {
+    ProfilerOptions options;
+    options.outputPath = profilePath;
+    options.drainIntervalMs = 10;
+    CpuProfiler profiler(options);
+    ASSERT_TRUE(profiler.start());
+    burnCpu(100);
+    ASSERT_EQ(raise(SIGUSR2), 0);
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (profiler.stats().profilesWritten == 0 && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(profiler.stats().profilesWritten, 1u);
+    EXPECT_TRUE(readProfile(profilePath).valid);
+    EXPECT_TRUE(profiler.isRunning());
+
+    profiler.stop();
+    EXPECT_EQ(profiler.stats().profilesWritten, 2u);
+}
+
+// Test de exclusividad: solo un perfilador por proceso
+TEST_F(ProfilerTest, OnlyOneProfilerRuns) {
+    CpuProfiler first;
+    CpuProfiler second;
+    ASSERT_TRUE(first.start());
+    EXPECT_FALSE(second.start());
+    first.stop();
+    EXPECT_TRUE(second.start());
+    second.stop();
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "Replication.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Réplicas de lectura
+// ============================================
+
+class ReplicationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        primaryPath = "replication_test.db";
+        replicaPath = "replication_test_replica.db";
+        logDirectory = "replication_test_log";
+        snapshotPath = "replication_test.snap";
+        removeFiles();
+        databaseOptions.hashCost = HashCost{4, 1, 1};
+        primary = std::make_unique<Database>(primaryPath, databaseOptions);
+        ASSERT_TRUE(primary->initialize());
+        std::vector<std::pair<std::string, std::string>> accounts;
+        for (int i = 0; i < 20; i++) {
+            accounts.emplace_back(email(i), "Pass@123");
+        }
+        ASSERT_TRUE(primary->addUsers(accounts));
+    }
+
+    void TearDown() override {
+        primary.reset();
+        removeFiles();
+    }
+
+    void removeFiles() {
+        for (const std::string& path : {primaryPath, replicaPath}) {
+            std::filesystem::remove(path);
+            std::filesystem::remove(path + "-wal");
+            std::filesystem::remove(path + "-shm");
+        }
+        std::filesystem::remove(snapshotPath);
+        std::filesystem::remove_all(logDirectory);
+    }
+
+    static std::string email(int i) {
+        return "user" + std::to_string(i) + "@example.com";
+    }
+
+    LoginOutcome replicaLogin(const std::string& user, const std::string& password) {
+        Database replica(replicaPath, databaseOptions);
+        EXPECT_TRUE(replica.initialize());
+        return replica.authenticate(user, password);
+    }
+
+    std::string primaryPath;
+    std::string replicaPath;
+    std::string logDirectory;
+    std::string snapshotPath;
+    DatabaseOptions databaseOptions;
+    std::unique_ptr<Database> primary;
+};
+
+// Test de réplica: las cuentas existentes y los cambios posteriores llegan a la réplica
+TEST_F(ReplicationTest, ReplicaFollowsThePrimary) {
+    ChangeShipper shipper(primaryPath, logDirectory);
+    ReplicaFollower follower(replicaPath, logDirectory);
+    EXPECT_EQ(shipper.shipOnce(), 20);
+    EXPECT_EQ(follower.applyOnce(), 20);
+    EXPECT_EQ(replicaLogin(email(3), "Pass@123"), LoginOutcome::Success);
+
+    ASSERT_TRUE(primary->changePassword(email(3), "Nueva@123"));
+    ASSERT_TRUE(primary->addUser("nuevo@example.com", "Pass@123"));
+    EXPECT_EQ(shipper.shipOnce(), 2);
+    EXPECT_EQ(shipper.shipOnce(), 0);
+    EXPECT_EQ(follower.applyOnce(), 2);
+    EXPECT_EQ(follower.applyOnce(), 0);
+
+    EXPECT_EQ(replicaLogin(email(3), "Pass@123"), LoginOutcome::WrongPassword);
+    EXPECT_EQ(replicaLogin(email(3), "Nueva@123"), LoginOutcome::Success);
+    EXPECT_EQ(replicaLogin("nuevo@example.com", "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(follower.status().position, shipper.stats().position);
+    EXPECT_EQ(follower.status().lag.count(), 22u);
+}
+
+// Test de solo lectura: una réplica no acepta escrituras salvo las del seguidor
+TEST_F(ReplicationTest, ReplicaIsReadOnly) {
+    ReplicaFollower follower(replicaPath, logDirectory);
+    EXPECT_EQ(follower.applyOnce(), 0);
+
+    Database replica(replicaPath, databaseOptions);
+    ASSERT_TRUE(replica.initialize());
+    EXPECT_TRUE(replica.isReplica());
+    EXPECT_FALSE(replica.addUser("nuevo@example.com", "Pass@123"));
+    EXPECT_FALSE(primary->isReplica());
+}
+
+// Test de borrado: una fila borrada en el primario desaparece de la réplica
+TEST_F(ReplicationTest, DeletesAreReplicated) {
+    ChangeShipper shipper(primaryPath, logDirectory);
+    ReplicaFollower follower(replicaPath, logDirectory);
+    ASSERT_EQ(shipper.shipOnce(), 20);
+    ASSERT_EQ(follower.applyOnce(), 20);
+
+    sqlite3* raw = nullptr;
+    ASSERT_EQ(sqlite3_open(primaryPath.c_str(), &raw), SQLITE_OK);
+    std::string sql = "DELETE FROM usuarios WHERE usuario = '" + email(5) + "';";
+    EXPECT_EQ(sqlite3_exec(raw, sql.c_str(), nullptr, nullptr, nullptr), SQLITE_OK);
+    sqlite3_close(raw);
+
+    EXPECT_EQ(shipper.shipOnce(), 1);
+    EXPECT_EQ(follower.applyOnce(), 1);
+    EXPECT_EQ(replicaLogin(email(5), "Pass@123"), LoginOutcome::UnknownUser);
+    EXPECT_EQ(replicaLogin(email(6), "Pass@123"), LoginOutcome::Success);
+}
+
+// Test de hueco: si los segmentos necesarios ya se borraron, la réplica se siembra desde una copia
+TEST_F(ReplicationTest, GapIsFixedBySeeding) {
+    ShipperOptions small;
+    small.maxRecords = 5;
+    small.maxSegments = 2;
+    ChangeShipper shipper(primaryPath, logDirectory, small);
+    while (shipper.shipOnce() > 0) {
+    }
+    ASSERT_EQ(shipper.stats().segments, 4u);
+
+    ReplicaFollower follower(replicaPath, logDirectory);
+    EXPECT_EQ(follower.applyOnce(), -1);
+    EXPECT_TRUE(follower.status().gap);
+
+    ASSERT_TRUE(primary->backup(snapshotPath));
+    ASSERT_TRUE(primary->changePassword(email(1), "Nueva@123"));
+    ASSERT_TRUE(follower.seed(snapshotPath));
+    EXPECT_FALSE(follower.status().gap);
+    EXPECT_EQ(follower.status().position, 20u);
+
+    EXPECT_EQ(shipper.shipOnce(), 1);
+    EXPECT_EQ(follower.applyOnce(), 1);
+    EXPECT_EQ(replicaLogin(email(1), "Nueva@123"), LoginOutcome::Success);
+    EXPECT_EQ(replicaLogin(email(19), "Pass@123"), LoginOutcome::Success);
+
+    Database replica(replicaPath, databaseOptions);
+    ASSERT_TRUE(replica.initialize());
+    EXPECT_TRUE(replica.isReplica());
+}
+
+// Test de reinicio: la posición se guarda en la réplica y no se aplica nada dos veces
+TEST_F(ReplicationTest, PositionSurvivesRestart) {
+    ChangeShipper shipper(primaryPath, logDirectory);
+    ASSERT_EQ(shipper.shipOnce(), 20);
+    {
+        ReplicaFollower follower(replicaPath, logDirectory);
+        ASSERT_EQ(follower.applyOnce(), 20);
+    }
+    ASSERT_TRUE(primary->changePassword(email(2), "Nueva@123"));
+    ASSERT_EQ(shipper.shipOnce(), 1);
+
+    ReplicaFollower restarted(replicaPath, logDirectory);
+    EXPECT_EQ(restarted.applyOnce(), 1);
+    EXPECT_EQ(restarted.status().position, 21u);
+    EXPECT_EQ(replicaLogin(email(2), "Nueva@123"), LoginOutcome::Success);
+}
+
+// Test de segundo plano: con los dos hilos en marcha la réplica se pone al día sola
+TEST_F(ReplicationTest, BackgroundThreadsCatchUp) {
+    ShipperOptions shipperOptions;
+    shipperOptions.intervalMs = 5;
+    FollowerOptions followerOptions;
+    followerOptions.pollIntervalMs = 5;
+    ChangeShipper shipper(primaryPath, logDirectory, shipperOptions);
+    ReplicaFollower follower(replicaPath, logDirectory, followerOptions);
+    ASSERT_TRUE(shipper.start());
+    ASSERT_TRUE(follower.start());
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(primary->changePassword(email(i), "Nueva@123"));
+    }
+
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (follower.status().position < 30 && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    follower.stop();
+    shipper.stop();
+    EXPECT_EQ(follower.status().position, 30u);
+    EXPECT_EQ(follower.status().lag.count(), 30u);
+    EXPECT_EQ(replicaLogin(email(9), "Nueva@123"), LoginOutcome::Success);
+}
+
+// Test de roles: no se envían cambios desde una réplica ni se sigue a un primario
+TEST_F(ReplicationTest, RolesAreChecked) {
+    ChangeShipper shipper(primaryPath, logDirectory);
+    ASSERT_EQ(shipper.shipOnce(), 20);
+    ReplicaFollower follower(replicaPath, logDirectory);
+    ASSERT_EQ(follower.applyOnce(), 20);
+
+    ChangeShipper fromReplica(replicaPath, logDirectory);
+    EXPECT_FALSE(fromReplica.start());
+    ReplicaFollower ofPrimary(primaryPath, logDirectory);
+    EXPECT_FALSE(ofPrimary.start());
+    EXPECT_EQ(ofPrimary.applyOnce(), -1);
+}
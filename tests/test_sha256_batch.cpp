@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "Sha256.h"
+#include "Sha256Batch.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - SHA-256 por lotes
+// ============================================
+
+namespace {
+    const Sha256Kernel kAllKernels[] = {
+        Sha256Kernel::Scalar, Sha256Kernel::Avx2, Sha256Kernel::Avx512, Sha256Kernel::ShaNi
+    };
+
+    // Deterministic, non-repeating bytes so every block differs.
+    std::string message(size_t length, int seed) {
+        std::string text(length, '\0');
+        uint32_t x = 2166136261u ^ static_cast<uint32_t>(seed);
+        for (size_t i = 0; i < length; i++) {
+            x = x * 16777619u + 0x9e3779b9u;
+            text[i] = static_cast<char>(x >> 24);
+        }
+        return text;
+    }
+
+    std::vector<Sha256Input> asInputs(const std::vector<std::string>& messages) {
+        std::vector<Sha256Input> inputs;
+        for (const std::string& text : messages) {
+            inputs.push_back({text.data(), text.size()});
+        }
+        return inputs;
+    }
+
+    std::vector<std::string> batchHex(const std::vector<std::string>& messages, Sha256Kernel kernel,
+                                      const std::string* key = nullptr) {
+        std::vector<Sha256Input> inputs = asInputs(messages);
+        std::vector<uint8_t> bytes(messages.size() * Sha256::kDigestSize);
+        Sha256Digest* digests = reinterpret_cast<Sha256Digest*>(bytes.data());
+        if (key) {
+            hmacSha256Batch(key->data(), key->size(), inputs.data(), inputs.size(), digests, kernel);
+        } else {
+            sha256Batch(inputs.data(), inputs.size(), digests, kernel);
+        }
+        std::vector<std::string> hex;
+        for (size_t i = 0; i < messages.size(); i++) {
+            hex.push_back(toHex(digests[i], Sha256::kDigestSize));
+        }
+        return hex;
+    }
+
+    std::string scalarHex(const std::string& text) {
+        uint8_t digest[Sha256::kDigestSize];
+        Sha256::digest(text.data(), text.size(), digest);
+        return toHex(digest, sizeof(digest));
+    }
+}
+
+class Sha256BatchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "sha256_batch_test.db";
+        std::filesystem::remove(testDbPath);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(testDbPath);
+    }
+
+    std::string testDbPath;
+};
+
+// Test de vectores conocidos: cada kernel disponible coincide con FIPS 180-4
+TEST_F(Sha256BatchTest, KnownAnswersOnEveryKernel) {
+    std::vector<std::string> messages = {
+        "", "abc", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+    };
+    for (Sha256Kernel kernel : kAllKernels) {
+        if (!sha256KernelSupported(kernel)) {
+            continue;
+        }
+        SCOPED_TRACE(sha256KernelName(kernel));
+        std::vector<std::string> hex = batchHex(messages, kernel);
+        EXPECT_EQ(hex[0], "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        EXPECT_EQ(hex[1], "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        EXPECT_EQ(hex[2], "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    }
+}
+
+// Test de longitudes: todos los límites de relleno y lotes que no llenan los carriles
+TEST_F(Sha256BatchTest, EveryKernelMatchesScalarAcrossLengths) {
+    std::vector<std::string> messages;
+    for (size_t length = 0; length <= 200; length++) {
+        messages.push_back(message(length, static_cast<int>(length)));
+    }
+    std::vector<std::string> expected;
+    for (const std::string& text : messages) {
+        expected.push_back(scalarHex(text));
+    }
+
+    for (Sha256Kernel kernel : kAllKernels) {
+        if (!sha256KernelSupported(kernel)) {
+            continue;
+        }
+        SCOPED_TRACE(sha256KernelName(kernel));
+        EXPECT_EQ(batchHex(messages, kernel), expected);
+        // Fewer messages than lanes: idle lanes must not leak into results.
+        std::vector<std::string> few(messages.begin() + 60, messages.begin() + 63);
+        std::vector<std::string> fewExpected(expected.begin() + 60, expected.begin() + 63);
+        EXPECT_EQ(batchHex(few, kernel), fewExpected);
+    }
+}
+
+// Test de mezcla: mensajes largos y cortos comparten carriles que se recargan
+TEST_F(Sha256BatchTest, MixedLengthsRefillLanes) {
+    std::vector<std::string> messages;
+    for (int i = 0; i < 100; i++) {
+        size_t length = (i % 7 == 0) ? 4096 + i : static_cast<size_t>(i % 13) * 11;
+        messages.push_back(message(length, i));
+    }
+    std::vector<std::string> expected;
+    for (const std::string& text : messages) {
+        expected.push_back(scalarHex(text));
+    }
+    for (Sha256Kernel kernel : kAllKernels) {
+        if (!sha256KernelSupported(kernel)) {
+            continue;
+        }
+        SCOPED_TRACE(sha256KernelName(kernel));
+        EXPECT_EQ(batchHex(messages, kernel), expected);
+    }
+}
+
+// Test de HMAC por lotes: igual que hmacSha256 con claves cortas y largas
+TEST_F(Sha256BatchTest, HmacBatchMatchesSingleHmac) {
+    std::vector<std::string> messages;
+    for (int i = 0; i < 40; i++) {
+        messages.push_back(message(static_cast<size_t>(i) * 9, i));
+    }
+    for (const std::string& key : {std::string("clave-corta"), message(100, 7)}) {
+        std::vector<std::string> expected;
+        for (const std::string& text : messages) {
+            uint8_t digest[Sha256::kDigestSize];
+            hmacSha256(key.data(), key.size(), text.data(), text.size(), digest);
+            expected.push_back(toHex(digest, sizeof(digest)));
+        }
+        for (Sha256Kernel kernel : kAllKernels) {
+            if (!sha256KernelSupported(kernel)) {
+                continue;
+            }
+            SCOPED_TRACE(sha256KernelName(kernel));
+            EXPECT_EQ(batchHex(messages, kernel, &key), expected);
+        }
+    }
+}
+
+// Test de kernel no disponible: se usa el escalar y el resultado no cambia
+TEST_F(Sha256BatchTest, UnsupportedKernelFallsBackToScalar) {
+    EXPECT_TRUE(sha256KernelSupported(Sha256Kernel::Scalar));
+    EXPECT_TRUE(sha256KernelSupported(sha256BestKernel()));
+    std::vector<std::string> messages = {message(77, 1)};
+    for (Sha256Kernel kernel : kAllKernels) {
+        EXPECT_EQ(batchHex(messages, kernel)[0], scalarHex(messages[0]));
+    }
+}
+
+// Test de integridad de filas: digest estable que cambia si cambia la fila
+TEST_F(Sha256BatchTest, DigestRowsDetectsChangedRows) {
+    DatabaseOptions options;
+    options.hashCost = HashCost{4, 1, 1};
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+    std::vector<std::pair<std::string, std::string>> users;
+    for (int i = 0; i < 2500; i++) {
+        users.push_back({"user" + std::to_string(i) + "@example.com", "Pass@" + std::to_string(i)});
+    }
+    ASSERT_TRUE(db.addUsers(users));
+
+    std::vector<RowDigest> first;
+    std::vector<RowDigest> second;
+    ASSERT_TRUE(db.digestRows(first));
+    ASSERT_TRUE(db.digestRows(second));
+    ASSERT_EQ(first.size(), users.size());
+    for (size_t i = 0; i < first.size(); i++) {
+        EXPECT_EQ(first[i].usuario, second[i].usuario);
+        EXPECT_EQ(first[i].digest, second[i].digest);
+        EXPECT_EQ(first[i].digest.size(), 2 * Sha256::kDigestSize);
+    }
+
+    std::vector<RowDigest> keyed;
+    ASSERT_TRUE(db.digestRows(keyed, "clave-de-integridad"));
+    EXPECT_NE(keyed[0].digest, first[0].digest);
+
+    sqlite3* conn = nullptr;
+    sqlite3_open(testDbPath.c_str(), &conn);
+    sqlite3_exec(conn, "UPDATE usuarios SET actualizado_en = actualizado_en + 1 WHERE usuario = 'user7@example.com';",
+                 nullptr, nullptr, nullptr);
+    sqlite3_close(conn);
+
+    std::vector<RowDigest> after;
+    ASSERT_TRUE(db.digestRows(after));
+    ASSERT_EQ(after.size(), first.size());
+    int changed = 0;
+    for (size_t i = 0; i < after.size(); i++) {
+        if (after[i].digest != first[i].digest) {
+            changed++;
+            EXPECT_EQ(after[i].usuario, "user7@example.com");
+        }
+    }
+    EXPECT_EQ(changed, 1);
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include "ShardedDatabase.h"
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Almacén de credenciales por shards
+// ============================================
+
+class ShardingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        basePath = "sharding_test.db";
+        removeShards();
+        options.hashCost = HashCost{4, 1, 1};
+    }
+
+    void TearDown() override {
+        removeShards();
+    }
+
+    void removeShards() {
+        for (int count = 1; count <= 4; count++) {
+            for (int i = 0; i < count; i++) {
+                std::filesystem::remove(ShardedDatabase::shardPath(basePath, i, count));
+                std::filesystem::remove(ShardedDatabase::shardPath(basePath, i, count) + "-journal");
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> makeUsers(int count) {
+        std::vector<std::pair<std::string, std::string>> users;
+        for (int i = 0; i < count; i++) {
+            users.emplace_back("user" + std::to_string(i) + "@example.com", "Pass@123");
+        }
+        return users;
+    }
+
+    std::string basePath;
+    DatabaseOptions options;
+};
+
+// Test de reparto: el shard depende solo del email normalizado y es uniforme
+TEST_F(ShardingTest, ShardIndexIsStableAndNormalized) {
+    EXPECT_EQ(ShardedDatabase::shardIndex("  User@Example.COM\n", 4), ShardedDatabase::shardIndex("user@example.com", 4));
+    EXPECT_EQ(ShardedDatabase::shardIndex("user@example.com", 1), 0);
+
+    std::vector<int> perShard(4, 0);
+    for (int i = 0; i < 8000; i++) {
+        int shard = ShardedDatabase::shardIndex("user" + std::to_string(i) + "@example.com", 4);
+        ASSERT_GE(shard, 0);
+        ASSERT_LT(shard, 4);
+        perShard[shard]++;
+    }
+    for (int count : perShard) {
+        EXPECT_GT(count, 1700);
+        EXPECT_LT(count, 2300);
+    }
+}
+
+// Test de crecimiento: pasar de 4 a 5 shards mueve solo las cuentas del nuevo
+TEST_F(ShardingTest, GrowingByOneShardMovesFewAccounts) {
+    int moved = 0;
+    const int accounts = 10000;
+    for (int i = 0; i < accounts; i++) {
+        std::string email = "user" + std::to_string(i) + "@example.com";
+        int before = ShardedDatabase::shardIndex(email, 4);
+        int after = ShardedDatabase::shardIndex(email, 5);
+        if (before != after) {
+            EXPECT_EQ(after, 4);
+            moved++;
+        }
+    }
+    EXPECT_GT(moved, accounts / 5 - accounts / 25);
+    EXPECT_LT(moved, accounts / 5 + accounts / 25);
+}
+
+// Test de rutas: un solo shard es el propio fichero base
+TEST_F(ShardingTest, ShardPathNaming) {
+    EXPECT_EQ(ShardedDatabase::shardPath("auth.db", 0, 1), "auth.db");
+    EXPECT_EQ(ShardedDatabase::shardPath("auth.db", 2, 4), "auth.db.2-of-4");
+}
+
+// Test de almacenamiento: cada cuenta vive solo en su shard y se autentica
+TEST_F(ShardingTest, UsersLandOnTheirShardAndAuthenticate) {
+    ShardedDatabase db(basePath, 4, options);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUsers(makeUsers(200)));
+
+    int total = 0;
+    for (int i = 0; i < db.shardCount(); i++) {
+        EXPECT_TRUE(std::filesystem::exists(ShardedDatabase::shardPath(basePath, i, 4)));
+        ASSERT_TRUE(db.shard(i).exportUsers([&](const StoredUser& user) {
+            EXPECT_EQ(ShardedDatabase::shardIndex(user.usuario, 4), i);
+            total++;
+            return true;
+        }));
+    }
+    EXPECT_EQ(total, 200);
+
+    for (int i = 0; i < 200; i += 7) {
+        EXPECT_EQ(db.authenticate("user" + std::to_string(i) + "@example.com", "Pass@123"), LoginOutcome::Success);
+    }
+    EXPECT_EQ(db.authenticate("nadie@example.com", "Pass@123"), LoginOutcome::UnknownUser);
+    EXPECT_GT(db.stats().queries, 0u);
+}
+
+// Test de cambio de clave: la nueva clave funciona y la anterior no
+TEST_F(ShardingTest, ChangePasswordReplacesTheHash) {
+    ShardedDatabase db(basePath, 2, options);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+
+    EXPECT_TRUE(db.changePassword("user@example.com", "Nueva@123"));
+    EXPECT_EQ(db.authenticate("user@example.com", "Pass@123"), LoginOutcome::WrongPassword);
+    EXPECT_EQ(db.authenticate("user@example.com", "Nueva@123"), LoginOutcome::Success);
+    EXPECT_FALSE(db.changePassword("nadie@example.com", "Nueva@123"));
+}
+
+// Test de concurrencia: un lock de escritura en un shard no frena a los demás
+TEST_F(ShardingTest, WriteLockOnOneShardLeavesOthersWritable) {
+    options.queryTimeoutMs = 100;
+    ShardedDatabase db(basePath, 2, options);
+    ASSERT_TRUE(db.initialize());
+    std::string onShard[2];
+    for (int i = 0; onShard[0].empty() || onShard[1].empty(); i++) {
+        std::string email = "user" + std::to_string(i) + "@example.com";
+        onShard[ShardedDatabase::shardIndex(email, 2)] = email;
+    }
+    ASSERT_TRUE(db.addUser(onShard[0], "Pass@123"));
+    ASSERT_TRUE(db.addUser(onShard[1], "Pass@123"));
+
+    // Another writer holds shard 0's lock.
+    sqlite3* writer = nullptr;
+    ASSERT_EQ(sqlite3_open(ShardedDatabase::shardPath(basePath, 0, 2).c_str(), &writer), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(writer, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr), SQLITE_OK);
+
+    auto started = std::chrono::steady_clock::now();
+    EXPECT_TRUE(db.changePassword(onShard[1], "Nueva@123"));
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(100));
+    EXPECT_FALSE(db.changePassword(onShard[0], "Nueva@123"));
+
+    sqlite3_exec(writer, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(writer);
+    EXPECT_TRUE(db.changePassword(onShard[0], "Nueva@123"));
+}
+
+// Test de copia: exportar e importar conserva el hash sin recalcularlo
+TEST_F(ShardingTest, ExportImportCopiesStoredHashes) {
+    ShardedDatabase source(basePath, 1, options);
+    ASSERT_TRUE(source.initialize());
+    ASSERT_TRUE(source.addUsers(makeUsers(50)));
+
+    std::vector<StoredUser> rows;
+    ASSERT_TRUE(source.shard(0).exportUsers([&](const StoredUser& user) {
+        rows.push_back(user);
+        return true;
+    }));
+    ASSERT_EQ(rows.size(), 50u);
+
+    // Grouped by the 3-shard layout, as AuthReshard does.
+    ShardedDatabase target(basePath, 3, options);
+    ASSERT_TRUE(target.initialize());
+    std::vector<std::vector<StoredUser>> perShard(3);
+    for (const StoredUser& user : rows) {
+        perShard[ShardedDatabase::shardIndex(user.usuario, 3)].push_back(user);
+    }
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(target.shard(i).importUsers(perShard[i]));
+    }
+
+    for (const StoredUser& user : rows) {
+        std::string clave;
+        target.shardFor(user.usuario).exportUsers([&](const StoredUser& copied) {
+            if (copied.usuario == user.usuario) {
+                clave = copied.clave;
+                EXPECT_EQ(copied.actualizadoEn, user.actualizadoEn);
+            }
+            return true;
+        });
+        EXPECT_EQ(clave, user.clave);
+    }
+    EXPECT_EQ(target.authenticate("user7@example.com", "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(target.stats().rehashes, 0u);
+
+    // Stopping early is reported.
+    EXPECT_FALSE(source.shard(0).exportUsers([](const StoredUser&) { return false; }));
+}
@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "HashingPool.h"
+#include "SharedCredentialCache.h"
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// ============================================
+// PRUEBAS UNITARIAS - Cache de credenciales compartida
+// ============================================
+
+#ifndef _WIN32
+
+class SharedCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "shared_cache_test.db";
+        cacheName = "/authscreen-test-" + std::to_string(getpid());
+        std::filesystem::remove(testDbPath);
+        SharedCredentialCache::unlink(cacheName);
+        dbOptions.hashCost = HashCost{4, 1, 1};
+    }
+
+    void TearDown() override {
+        SharedCredentialCache::unlink(cacheName);
+        std::filesystem::remove(testDbPath);
+    }
+
+    // Runs `body` in a child process and returns its exit code. The child
+    // gets no threads from the parent, so it must not touch the shared
+    // hashing pool: pass it a pool of its own.
+    template <typename Body>
+    int inChild(Body body) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(body());
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    std::string testDbPath;
+    std::string cacheName;
+    DatabaseOptions dbOptions;
+};
+
+// Test de relleno y consulta: el valor vuelve tal cual
+TEST_F(SharedCacheTest, FillThenLookupHits) {
+    SharedCredentialCache cache;
+    ASSERT_TRUE(cache.attach(cacheName, 1024));
+    EXPECT_EQ(cache.capacity(), 1024u);
+
+    std::string value;
+    EXPECT_FALSE(cache.lookup("user@example.com", value));
+    cache.fill("user@example.com", "$scrypt$ln=4,r=1,p=1$c2FsdA$a2V5", cache.fillTicket("user@example.com"));
+    ASSERT_TRUE(cache.lookup("user@example.com", value));
+    EXPECT_EQ(value, "$scrypt$ln=4,r=1,p=1$c2FsdA$a2V5");
+
+    // Too long to cache: silently skipped.
+    std::string longKey(SharedCredentialCache::kMaxKeyLength + 1, 'k');
+    cache.fill(longKey, "v", cache.fillTicket(longKey));
+    EXPECT_FALSE(cache.lookup(longKey, value));
+
+    SharedCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.fills, 1u);
+}
+
+// Test de invalidación: una escritura anula la entrada y los rellenos en curso
+TEST_F(SharedCacheTest, InvalidationVoidsEntriesAndPendingFills) {
+    SharedCredentialCache cache;
+    ASSERT_TRUE(cache.attach(cacheName, 1024));
+    std::string value;
+
+    uint64_t ticket = cache.fillTicket("a@example.com");
+    cache.invalidate("a@example.com");
+    cache.fill("a@example.com", "viejo", ticket);
+    EXPECT_FALSE(cache.lookup("a@example.com", value));
+
+    cache.fill("a@example.com", "nuevo", cache.fillTicket("a@example.com"));
+    cache.fill("b@example.com", "otro", cache.fillTicket("b@example.com"));
+    cache.invalidate("a@example.com");
+    EXPECT_FALSE(cache.lookup("a@example.com", value));
+    EXPECT_TRUE(cache.lookup("b@example.com", value));
+
+    cache.invalidateAll();
+    EXPECT_FALSE(cache.lookup("b@example.com", value));
+}
+
+// Test de segmento: otra instancia ve las mismas entradas y exige la misma capacidad
+TEST_F(SharedCacheTest, AttachSharesSegmentAndChecksCapacity) {
+    SharedCredentialCache first;
+    ASSERT_TRUE(first.attach(cacheName, 1024));
+    first.fill("user@example.com", "clave", first.fillTicket("user@example.com"));
+
+    SharedCredentialCache second;
+    ASSERT_TRUE(second.attach(cacheName, 1024));
+    std::string value;
+    EXPECT_TRUE(second.lookup("user@example.com", value));
+    EXPECT_EQ(value, "clave");
+
+    SharedCredentialCache mismatched;
+    EXPECT_FALSE(mismatched.attach(cacheName, 4096));
+    EXPECT_FALSE(mismatched.isAttached());
+    EXPECT_FALSE(mismatched.lookup("user@example.com", value));
+}
+
+// Test de aislamiento: cada base tiene su segmento, sea cual sea la ruta usada
+TEST_F(SharedCacheTest, SegmentNameFollowsTheDatabaseFile) {
+    const std::string name = SharedCredentialCache::segmentName(cacheName, testDbPath);
+    EXPECT_EQ(name.compare(0, cacheName.size(), cacheName), 0);
+    EXPECT_EQ(SharedCredentialCache::segmentName(cacheName, "./" + testDbPath), name);
+    EXPECT_EQ(SharedCredentialCache::segmentName(cacheName, std::filesystem::absolute(testDbPath).string()), name);
+    EXPECT_NE(SharedCredentialCache::segmentName(cacheName, "replica_" + testDbPath), name);
+
+    SharedCredentialCache primary;
+    ASSERT_TRUE(primary.attach(name, 1024));
+    primary.fill("user@example.com", "clave", primary.fillTicket("user@example.com"));
+    const std::string otherName = SharedCredentialCache::segmentName(cacheName, "replica_" + testDbPath);
+    SharedCredentialCache other;
+    ASSERT_TRUE(other.attach(otherName, 1024));
+    std::string value;
+    EXPECT_FALSE(other.lookup("user@example.com", value));
+    SharedCredentialCache::unlink(name);
+    SharedCredentialCache::unlink(otherName);
+}
+
+// Test multiproceso: otro proceso acierta en la cache que calentó el primero,
+// y su escritura la invalida para todos
+TEST_F(SharedCacheTest, ProcessesShareWarmCacheAndInvalidations) {
+    SharedCredentialCache cache;
+    ASSERT_TRUE(cache.attach(cacheName));
+    DatabaseOptions options = dbOptions;
+    options.sharedCache = &cache;
+    Database db(testDbPath, options);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+    ASSERT_TRUE(db.validateUser("user@example.com", "Pass@123"));
+    EXPECT_EQ(db.stats().cacheHits, 0u);
+    EXPECT_EQ(cache.stats().fills, 1u);
+
+    int childResult = inChild([&]() {
+        SharedCredentialCache childCache;
+        if (!childCache.attach(cacheName)) {
+            return 10;
+        }
+        HashingPool pool(1);
+        DatabaseOptions childOptions;
+        childOptions.hashingPool = &pool;
+        childOptions.sharedCache = &childCache;
+        // A higher cost: the successful login rehashes, which is a write.
+        childOptions.hashCost = HashCost{5, 1, 1};
+        Database childDb(testDbPath, childOptions);
+        if (!childDb.initialize()) {
+            return 11;
+        }
+        if (!childDb.validateUser("user@example.com", "Pass@123")) {
+            return 12;
+        }
+        if (childDb.stats().cacheHits != 1 || childDb.stats().rehashes != 1) {
+            return 13;
+        }
+        return 0;
+    });
+    ASSERT_EQ(childResult, 0);
+
+    SharedCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_GE(stats.invalidations, 2u);  // addUser, then the child's rehash
+
+    // The parent's entry is stale now: it reads the child's row again and,
+    // the stored cost being higher than its own, keeps it.
+    ASSERT_TRUE(db.validateUser("user@example.com", "Pass@123"));
+    EXPECT_EQ(db.stats().cacheHits, 0u);
+    EXPECT_EQ(db.stats().rehashes, 0u);
+    ASSERT_TRUE(db.validateUser("user@example.com", "Pass@123"));
+    EXPECT_EQ(db.stats().cacheHits, 1u);
+}
+
+// Test de recuperación: una entrada que un proceso dejó a medio escribir al
+// morir la recupera el siguiente escritor
+TEST_F(SharedCacheTest, EntryLeftBusyByDeadWriterIsRecovered) {
+    // Four entries: every key probes all of them.
+    SharedCredentialCache cache;
+    ASSERT_TRUE(cache.attach(cacheName, 4));
+    std::vector<std::string> keys;
+    for (int i = 0; i < 8; i++) {
+        keys.push_back("user" + std::to_string(i) + "@example.com");
+    }
+
+    // Kill writers that fill nonstop until one dies holding an entry.
+    for (int attempt = 0; attempt < 200 && cache.stats().takeovers == 0; attempt++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            SharedCredentialCache childCache;
+            if (!childCache.attach(cacheName, 4)) {
+                _exit(10);
+            }
+            std::string value(SharedCredentialCache::kMaxValueLength, 'v');
+            for (size_t i = 0;; i++) {
+                const std::string& key = keys[i % keys.size()];
+                childCache.fill(key, value, childCache.fillTicket(key));
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500 + 37 * attempt));
+        kill(pid, SIGKILL);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFSIGNALED(status));
+        for (const std::string& key : keys) {
+            cache.fill(key, "recuperada", cache.fillTicket(key));
+        }
+    }
+    ASSERT_GT(cache.stats().takeovers, 0u);
+
+    // No entry is left busy: every fill lands and reads back.
+    std::string value;
+    for (const std::string& key : keys) {
+        cache.fill(key, "clave", cache.fillTicket(key));
+        ASSERT_TRUE(cache.lookup(key, value)) << key;
+        EXPECT_EQ(value, "clave");
+    }
+}
+
+// Test de concurrencia: varios procesos rellenan, leen e invalidan a la vez
+// sin ver nunca una entrada a medio escribir
+TEST_F(SharedCacheTest, ConcurrentProcessesNeverSeeTornEntries) {
+    SharedCredentialCache cache;
+    ASSERT_TRUE(cache.attach(cacheName, 64));
+
+    // Values are derived from the key, so any mix of two writes shows.
+    auto valueFor = [](const std::string& key, int round) {
+        std::string value = key + "#" + std::to_string(round % 3) + ":";
+        while (value.size() < 120) {
+            value += key;
+        }
+        return value.substr(0, 120);
+    };
+
+    std::vector<pid_t> children;
+    for (int c = 0; c < 3; c++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            SharedCredentialCache childCache;
+            if (!childCache.attach(cacheName, 64)) {
+                _exit(10);
+            }
+            std::string value;
+            for (int i = 0; i < 30000; i++) {
+                std::string key = "user" + std::to_string((i * 7 + c) % 200) + "@example.com";
+                if (childCache.lookup(key, value)) {
+                    bool known = false;
+                    for (int round = 0; round < 3; round++) {
+                        known = known || value == valueFor(key, round);
+                    }
+                    if (!known) {
+                        _exit(1);
+                    }
+                } else {
+                    childCache.fill(key, valueFor(key, i), childCache.fillTicket(key));
+                }
+            }
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    for (int i = 0; i < 2000; i++) {
+        cache.invalidate("user" + std::to_string(i % 200) + "@example.com");
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+    EXPECT_GT(cache.stats().hits, 0u);
+}
+
+#endif
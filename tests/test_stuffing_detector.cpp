@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include "Database.h"
+#include "StuffingDetector.h"
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// ============================================
+// PRUEBAS UNITARIAS - Detección de relleno de credenciales
+// ============================================
+
+class StuffingDetectorTest : public ::testing::Test {
+protected:
+    using Clock = StuffingDetector::Clock;
+
+    void SetUp() override {
+        testDbPath = "stuffing_test.db";
+        std::filesystem::remove(testDbPath);
+        start = Clock::now();
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(testDbPath);
+    }
+
+    std::string testDbPath;
+    Clock::time_point start;
+};
+
+// Test de heavy hitters: un atacante repartido entre muchas cuentas aparece primero
+TEST_F(StuffingDetectorTest, SprayingSourceIsTopOffender) {
+    StuffingDetectorOptions options;
+    options.trackedKeys = 32;
+    StuffingDetector detector(options);
+
+    // 20,000 accounts tried once each from one source with one password,
+    // mixed with ordinary typos from 2,000 other sources.
+    for (int i = 0; i < 20000; i++) {
+        detector.recordFailure("victim" + std::to_string(i) + "@example.com", "203.0.113.7", "Verano2024!", start);
+        if (i % 10 == 0) {
+            detector.recordFailure("user" + std::to_string(i) + "@example.com",
+                                   "198.51.100." + std::to_string(i % 2000), "Typo" + std::to_string(i), start);
+        }
+    }
+
+    std::vector<StuffingOffender> sources = detector.topOffenders(StuffingKey::Source, 3, start);
+    ASSERT_FALSE(sources.empty());
+    EXPECT_EQ(sources[0].key, "203.0.113.7");
+    EXPECT_GE(sources[0].failures, 19999.99);
+    EXPECT_LE(sources[0].failures - sources[0].error, 20000.01);
+
+    std::vector<StuffingOffender> passwords = detector.topOffenders(StuffingKey::PasswordPrefix, 1, start);
+    ASSERT_EQ(passwords.size(), 1u);
+    EXPECT_EQ(passwords[0].key, StuffingDetector::passwordKey("Verano2024!", options.passwordPrefixBytes));
+
+    // No single account stands out: each victim failed only once.
+    std::vector<StuffingOffender> accounts = detector.topOffenders(StuffingKey::Account, 1, start);
+    ASSERT_EQ(accounts.size(), 1u);
+    EXPECT_LT(accounts[0].failures - accounts[0].error, 2.0);
+    EXPECT_EQ(detector.events(), 22000u);
+}
+
+// Test de estimación: count-min nunca subestima y se acerca al valor real
+TEST_F(StuffingDetectorTest, SketchNeverUnderestimates) {
+    StuffingDetector detector;
+    for (int key = 0; key < 5000; key++) {
+        for (int n = 0; n <= key % 7; n++) {
+            detector.record(StuffingKey::Account, "cuenta" + std::to_string(key), start);
+        }
+    }
+    int exact = 0;
+    for (int key = 0; key < 5000; key++) {
+        double truth = key % 7 + 1;
+        double estimate = detector.estimate(StuffingKey::Account, "cuenta" + std::to_string(key), start);
+        EXPECT_GE(estimate, truth - 1e-3);
+        if (estimate < truth + 0.5) {
+            exact++;
+        }
+    }
+    // Conservative update keeps most light keys exact at this load.
+    EXPECT_GT(exact, 4500);
+    EXPECT_EQ(detector.estimate(StuffingKey::Account, "nunca-visto", start), 0.0);
+}
+
+// Test de decaimiento: los fallos pierden la mitad de su peso cada vida media
+TEST_F(StuffingDetectorTest, CountsDecayWithHalfLife) {
+    StuffingDetectorOptions options;
+    options.halfLife = std::chrono::seconds(10);
+    StuffingDetector detector(options);
+    for (int i = 0; i < 100; i++) {
+        detector.record(StuffingKey::Source, "10.0.0.1", start);
+    }
+    EXPECT_NEAR(detector.estimate(StuffingKey::Source, "10.0.0.1", start), 100.0, 0.01);
+    EXPECT_NEAR(detector.estimate(StuffingKey::Source, "10.0.0.1", start + std::chrono::seconds(10)), 50.0, 0.01);
+    EXPECT_NEAR(detector.estimate(StuffingKey::Source, "10.0.0.1", start + std::chrono::seconds(30)), 12.5, 0.01);
+
+    // A fresh burst outranks an older, larger one once it has decayed.
+    Clock::time_point later = start + std::chrono::seconds(60);
+    for (int i = 0; i < 10; i++) {
+        detector.record(StuffingKey::Source, "10.0.0.2", later);
+    }
+    std::vector<StuffingOffender> top = detector.topOffenders(StuffingKey::Source, 2, later);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].key, "10.0.0.2");
+    EXPECT_NEAR(top[1].failures, 100.0 / 64, 0.01);
+}
+
+// Test de reescalado: semanas de eventos no desbordan los contadores
+TEST_F(StuffingDetectorTest, LongRunsRescaleWithoutOverflow) {
+    StuffingDetectorOptions options;
+    options.halfLife = std::chrono::milliseconds(100);
+    StuffingDetector detector(options);
+    Clock::time_point now = start;
+    for (int i = 0; i < 1000; i++) {
+        now += std::chrono::seconds(10);  // 100 half-lives per step
+        detector.record(StuffingKey::Account, "cuenta@example.com", now);
+    }
+    double estimate = detector.estimate(StuffingKey::Account, "cuenta@example.com", now);
+    EXPECT_NEAR(estimate, 1.0, 1e-3);
+    std::vector<StuffingOffender> top = detector.topOffenders(StuffingKey::Account, 1, now);
+    ASSERT_EQ(top.size(), 1u);
+    EXPECT_NEAR(top[0].failures, 1.0, 1e-3);
+}
+
+// Test de memoria: el presupuesto fija el tamaño sin importar la cardinalidad
+TEST_F(StuffingDetectorTest, MemoryStaysWithinBudget) {
+    StuffingDetectorOptions options;
+    options.memoryBytes = 1u << 20;
+    StuffingDetector detector(options);
+    size_t before = detector.memoryBytes();
+    EXPECT_LE(before, options.memoryBytes);
+    EXPECT_GT(before, options.memoryBytes / 2);
+    for (int i = 0; i < 200000; i++) {
+        detector.recordFailure("a" + std::to_string(i), "s" + std::to_string(i), "p" + std::to_string(i), start);
+    }
+    EXPECT_EQ(detector.memoryBytes(), before);
+    EXPECT_EQ(detector.topOffenders(StuffingKey::Account, 1000, start).size(), options.trackedKeys);
+}
+
+// Test de integración: solo los logins fallidos llegan al detector
+TEST_F(StuffingDetectorTest, DatabaseReportsOnlyFailures) {
+    DatabaseOptions dbOptions;
+    dbOptions.hashCost = HashCost{4, 1, 1};
+    Database db(testDbPath, dbOptions);
+    ASSERT_TRUE(db.initialize());
+    ASSERT_TRUE(db.addUser("user@example.com", "Pass@123"));
+
+    StuffingDetector detector;
+    db.setStuffingDetector(&detector, "terminal-1");
+    EXPECT_TRUE(db.validateUser("user@example.com", "Pass@123"));
+    EXPECT_FALSE(db.validateUser("user@example.com", "Wrong@1"));
+    EXPECT_FALSE(db.validateUser("ghost@example.com", "Wrong@1"));
+    EXPECT_EQ(detector.events(), 2u);
+
+    std::vector<StuffingOffender> sources = detector.topOffenders(StuffingKey::Source, 1);
+    ASSERT_EQ(sources.size(), 1u);
+    EXPECT_EQ(sources[0].key, "terminal-1");
+    EXPECT_NEAR(sources[0].failures, 2.0, 0.01);
+    EXPECT_NEAR(detector.estimate(StuffingKey::PasswordPrefix,
+                                  StuffingDetector::passwordKey("Wrong@1", StuffingDetectorOptions().passwordPrefixBytes)),
+                2.0, 0.01);
+}
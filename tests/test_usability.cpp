@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include "PasswordValidator.h"
+#include <chrono>
+#include <string>
 
 // ============================================
 // PRUEBAS DE USABILIDAD
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include "AuthPipeline.h"
+#include "Database.h"
+#include "SharedCredentialCache.h"
+#include "WarmState.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// ============================================
+// PRUEBAS UNITARIAS - Arranque en caliente
+// ============================================
+
+class WarmStateTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDbPath = "warm_state_test.db";
+        statePath = "warm_state_test.warm";
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove(statePath);
+        databaseOptions.hashCost = HashCost{4, 1, 1};
+        db = std::make_unique<Database>(testDbPath, databaseOptions);
+        ASSERT_TRUE(db->initialize());
+        std::vector<std::pair<std::string, std::string>> accounts;
+        for (int i = 0; i < 100; i++) {
+            accounts.emplace_back(email(i), "Pass@123");
+        }
+        ASSERT_TRUE(db->addUsers(accounts));
+    }
+
+    void TearDown() override {
+        db.reset();
+        std::filesystem::remove(testDbPath);
+        std::filesystem::remove(statePath);
+    }
+
+    static std::string email(int i) {
+        return "user" + std::to_string(i) + "@example.com";
+    }
+
+    std::string testDbPath;
+    std::string statePath;
+    DatabaseOptions databaseOptions;
+    std::unique_ptr<Database> db;
+};
+
+// Test de guardado: las cuentas más usadas vuelven en orden, y solo las que existen se leen
+TEST_F(WarmStateTest, HotAccountsSurviveRestart) {
+    {
+        WarmState state(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+        for (int i = 0; i < 30; i++) {
+            state.touch(email(7));
+        }
+        for (int i = 0; i < 20; i++) {
+            state.touch(email(3));
+        }
+        for (int i = 0; i < 10; i++) {
+            state.touch("nadie@example.com");
+        }
+        ASSERT_TRUE(state.save());
+    }
+
+    WarmState restarted(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+    WarmStateReport report = restarted.restore();
+    EXPECT_TRUE(report.loaded);
+    EXPECT_EQ(report.accounts, 3u);
+    EXPECT_EQ(report.accountsWarmed, 2u);
+    std::vector<std::string> expected = {email(7), email(3)};
+    EXPECT_EQ(restarted.hotAccounts(), expected);
+}
+
+// Test de frecuencia: una cuenta muy usada no pierde su hueco por muchas de paso
+TEST_F(WarmStateTest, FrequentAccountKeepsItsSlot) {
+    WarmStateOptions small;
+    small.maxAccounts = 1;
+    WarmState state(testDbPath, statePath, small, databaseOptions);
+    for (int i = 0; i < 100; i++) {
+        state.touch(email(0));
+    }
+    for (int i = 1; i < 50; i++) {
+        state.touch(email(i));
+    }
+    ASSERT_EQ(state.hotAccounts().size(), 1u);
+    EXPECT_EQ(state.hotAccounts()[0], email(0));
+}
+
+// Test de versión: las pistas de páginas solo se usan si la base no ha cambiado desde el guardado
+TEST_F(WarmStateTest, PageHintsNeedAnUnchangedDatabase) {
+    WarmState state(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+    state.touch(email(1));
+    ASSERT_TRUE(state.save());
+
+    WarmStateReport unchanged = state.restore();
+    EXPECT_TRUE(unchanged.pagesMatched);
+#ifndef _WIN32
+    // Just written, so cached.
+    EXPECT_GT(unchanged.pagesPrefetched, 0u);
+#endif
+
+    // Let the modification time tick over on coarse filesystems.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(db->addUser("nuevo@example.com", "Pass@123"));
+    WarmStateReport changed = state.restore();
+    EXPECT_TRUE(changed.loaded);
+    EXPECT_FALSE(changed.pagesMatched);
+    EXPECT_EQ(changed.pagesPrefetched, 0u);
+    // Accounts are read from the database either way.
+    EXPECT_EQ(changed.accountsWarmed, 1u);
+}
+
+// Test de integridad: un fichero dañado o ausente se ignora
+TEST_F(WarmStateTest, DamagedFileIsIgnored) {
+    WarmState state(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+    EXPECT_FALSE(state.restore().loaded);
+
+    state.touch(email(1));
+    ASSERT_TRUE(state.save());
+    {
+        std::fstream file(statePath, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(70);
+        file.put('X');
+    }
+    WarmStateReport report = state.restore();
+    EXPECT_FALSE(report.loaded);
+    EXPECT_EQ(report.accountsWarmed, 0u);
+}
+
+// Test de ciclo de vida: start() restaura en segundo plano y stop() guarda
+TEST_F(WarmStateTest, StopSavesForTheNextStart) {
+    {
+        WarmState state(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+        ASSERT_TRUE(state.start());
+        state.touch(email(5));
+        state.stop();
+    }
+    EXPECT_TRUE(std::filesystem::exists(statePath));
+
+    WarmState restarted(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+    ASSERT_TRUE(restarted.start());
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!restarted.isWarm() && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(restarted.isWarm());
+    EXPECT_EQ(restarted.report().accountsWarmed, 1u);
+}
+
+// Test de etapa: se cuentan los logins de cuentas que existen
+TEST_F(WarmStateTest, StageCountsExistingAccounts) {
+    WarmState state(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+    AuthPipeline pipeline;
+    pipeline.add(std::make_unique<NormalizeStage>());
+    pipeline.add(std::make_unique<StorageStage>(*db));
+    pipeline.add(std::make_unique<WarmStateStage>(state));
+
+    LoginRequest request;
+    std::string right = email(1);
+    std::string wrong = email(2);
+    request.email = right;
+    request.password = "Pass@123";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::Success);
+    request.email = wrong;
+    request.password = "Mala@123";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::WrongPassword);
+    request.email = "nadie@example.com";
+    EXPECT_EQ(pipeline.authenticate(request), LoginOutcome::UnknownUser);
+
+    std::vector<std::string> hot = state.hotAccounts();
+    ASSERT_EQ(hot.size(), 2u);
+    EXPECT_NE(std::find(hot.begin(), hot.end(), right), hot.end());
+    EXPECT_NE(std::find(hot.begin(), hot.end(), wrong), hot.end());
+}
+
+#ifndef _WIN32
+
+// Test de cache compartida: tras restaurar, el primer login de una cuenta caliente no consulta la base
+TEST_F(WarmStateTest, RestoreFillsSharedCache) {
+    std::string cacheName = "/authscreen-warm-test-" + std::to_string(getpid());
+    SharedCredentialCache::unlink(cacheName);
+    {
+        WarmState state(testDbPath, statePath, WarmStateOptions(), databaseOptions);
+        state.touch(email(4));
+        ASSERT_TRUE(state.save());
+    }
+
+    // A new segment, as after a reboot.
+    SharedCredentialCache cache;
+    ASSERT_TRUE(cache.attach(cacheName));
+    DatabaseOptions cached = databaseOptions;
+    cached.sharedCache = &cache;
+    WarmState state(testDbPath, statePath, WarmStateOptions(), cached);
+    EXPECT_EQ(state.restore().accountsWarmed, 1u);
+
+    Database screen(testDbPath, cached);
+    ASSERT_TRUE(screen.initialize());
+    EXPECT_EQ(screen.authenticate(email(4), "Pass@123"), LoginOutcome::Success);
+    EXPECT_EQ(screen.stats().cacheHits, 1u);
+    cache.detach();
+    SharedCredentialCache::unlink(cacheName);
+}
+
+#endif
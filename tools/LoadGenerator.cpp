@@ -0,0 +1,1021 @@
+#include "ActivityMonitor.h"
+#include "AdmissionController.h"
+#include "AuditLog.h"
+#include "AuthPipeline.h"
+#include "CredentialPrefetcher.h"
+#include "Database.h"
+#include "FairScheduler.h"
+#include "HashingPool.h"
+#include "LatencyHistogram.h"
+#include "LoginStateStore.h"
+#include "LookupCoalescer.h"
+#include "LoginTrace.h"
+#include "MaintenanceScheduler.h"
+#include "PasswordHasher.h"
+#include "Profiler.h"
+#include "Replication.h"
+#include "ShardedDatabase.h"
+#include "SharedCredentialCache.h"
+#include "StuffingDetector.h"
+#include "WarmState.h"
+#include "ZipfGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ============================================
+// Generador de carga de logins (open-loop)
+// ============================================
+//
+// Drives an AuthPipeline from N threads the same way AuthScreen does on
+// Enter. Every thread owns its own pipeline and Database connection (one
+// per shard with --shards). The change-password kind rewrites the
+// account's hash with the same password, so later logins still succeed. With --rate > 0 requests follow an open-loop schedule and
+// latency is measured from the *intended* send time, so a stalled request
+// also charges the requests queued behind it (coordinated omission
+// correction). With --rate 0 the threads run closed-loop as fast as possible.
+// With --prefetch-ms each login's email is handed to a CredentialPrefetcher
+// that long before the login is submitted, as AuthScreen does when the
+// email field is left; latency is still measured from the submit.
+// With --admission every login queues for one of N database slots in an
+// AdmissionController shared by the threads, which sheds fresh logins
+// (overloaded) once the queue stands; "a tiempo" counts the logins
+// answered within --timeout-ms of their intended send time.
+// With --fair N the logins share N database slots through a FairScheduler;
+// --tenants K spreads the threads over K applications (thread i is app
+// i % K) and reports latency per application.
+// With --lockout failures, lockouts and last logins are kept in the
+// database through a LoginStateStore shared by the threads, written behind
+// every --lockout-flush-ms (0 writes each change in its own transaction).
+// With --warm-state FILE the hot accounts and cached pages saved by the
+// previous run are reloaded before the clock starts, and saved again at the
+// end; with --cold this shows what a warm restart is worth.
+// With --replicas N the database ships its changes to <db>.log and N
+// followers apply them to <db>.replica<i>/auth.db; every replica is caught
+// up before the clock starts, so the lag reported is that of the run's
+// writes (use a change-password share in --mix).
+// With --profile FILE the process samples its own CPU use (--profile-hz,
+// default 100) and writes a pprof profile to FILE at the end and on
+// SIGUSR2: pprof -top ./AuthLoadGen FILE
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    enum RequestKind { Hit, Miss, WrongPassword, PolicyFail, ChangePassword, KindCount };
+    const char* kKindNames[KindCount] = {"hit", "miss", "wrong-password", "policy-fail", "change-password"};
+
+    struct Config {
+        std::string dbPath = "loadgen.db";
+        bool provision = false;
+        uint64_t users = 100000;
+        unsigned threads = 4;
+        double rate = 1000.0;
+        bool poisson = true;
+        double durationSeconds = 10.0;
+        double zipfExponent = 0.99;
+        double mix[KindCount] = {70, 10, 15, 5, 0};
+        uint64_t seed = 42;
+        std::string histogramOut;
+        std::string tracePath;
+        std::string auditDir;
+        int timeoutMs = DatabaseOptions().queryTimeoutMs;
+        int writerHoldMs = 0;
+        int writerPeriodMs = 100;
+        bool walMode = false;
+        int maintenanceBudgetMs = 0;
+        // Cheap by default so provisioning large databases stays fast; use
+        // e.g. 14,8,1 or "calibrate" to benchmark realistic costs.
+        HashCost hashCost = HashCost{4, 1, 1};
+        double hashTargetMs = 50;
+        int hashThreads = 0;
+        HashingPool* hashingPool = nullptr;
+        StuffingDetector* stuffing = nullptr;
+        bool detectStuffing = false;
+        std::string sharedCacheName;
+        SharedCredentialCache* sharedCache = nullptr;
+        std::string backupPath;
+        // Adds AuthScreen's rate-limit and cache stages in front of storage.
+        bool fastPaths = false;
+        int shards = 1;
+        // Time between leaving the email field and submitting; 0 disables
+        // the prefetch.
+        int prefetchMs = 0;
+        // Drops the database files from the OS page cache before the run.
+        bool cold = false;
+        // Shared by all workers: concurrent lookups of one account run once.
+        bool coalesce = false;
+        LookupCoalescer* coalescer = nullptr;
+        // Database slots; 0 admits everything at once.
+        size_t admissionSlots = 0;
+        int admissionTargetUs = 5000;
+        AdmissionController* admission = nullptr;
+        // Share of logins, in percent, that carry a session.
+        double sessionShare = 0;
+        size_t fairSlots = 0;
+        unsigned tenants = 1;
+        // Share of logins, in percent, sent as batch re-validation.
+        double batchShare = 0;
+        FairScheduler* scheduler = nullptr;
+        // Flush interval of the persistent lockout state; -1 leaves it out.
+        int lockoutFlushMs = -1;
+        LoginStateStore* loginState = nullptr;
+        std::string warmStatePath;
+        WarmState* warmState = nullptr;
+        unsigned replicas = 0;
+        std::string profilePath;
+        int profileHz = 100;
+    };
+
+    struct WorkerResult {
+        LatencyHistogram corrected;
+        LatencyHistogram service;
+        uint64_t perKind[KindCount] = {};
+        uint64_t perOutcome[kLoginOutcomeCount] = {};
+        uint64_t accepted = 0;
+        uint64_t onTime = 0;
+        uint64_t unexpected = 0;
+        uint64_t failedChanges = 0;
+        std::vector<AuthStageStats> stages;
+        PrefetchStats prefetch = {};
+    };
+
+    std::string accountEmail(uint64_t index) {
+        return "user" + std::to_string(index) + "@loadgen.test";
+    }
+
+    // Prefix plus 7 zero-padded digits: always 10 characters, so every
+    // generated password passes the 5-10 character policy.
+    std::string paddedPassword(const char* prefix, uint64_t index) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%s%07llu", prefix,
+                      static_cast<unsigned long long>(index % 10000000));
+        return buffer;
+    }
+
+    std::string accountPassword(uint64_t index) {
+        return paddedPassword("Lg@", index);
+    }
+
+    void printUsage() {
+        std::cout <<
+            "Uso: AuthLoadGen [opciones]\n"
+            "  --db PATH            base de datos (default loadgen.db)\n"
+            "  --provision          recrea la base con --users cuentas\n"
+            "  --users N            cuentas provisionadas (default 100000)\n"
+            "  --threads N          hilos generadores (default 4)\n"
+            "  --rate R             peticiones/s totales; 0 = closed-loop (default 1000)\n"
+            "  --arrival poisson|constant   proceso de llegadas (default poisson)\n"
+            "  --duration S         segundos de carga (default 10)\n"
+            "  --zipf S             exponente Zipf de cuentas calientes; 0 = uniforme (default 0.99)\n"
+            "  --mix H,M,W,P[,C]    pesos hit,miss,wrong-password,policy-fail,change-password\n"
+            "                       (default 70,10,15,5,0)\n"
+            "  --seed N             semilla (default 42)\n"
+            "  --histogram FILE     guarda el histograma corregido para comparar\n"
+            "  --trace FILE         graba cada peticion en una traza para AuthReplay\n"
+            "  --audit DIR          registra cada resultado en el log de auditoria\n"
+            "  --timeout-ms N       deadline por consulta; 0 = sin limite (default 2000)\n"
+            "  --writer-hold-ms N   otro proceso toma el lock exclusivo N ms...\n"
+            "  --writer-period-ms N ...cada N ms (default 100)\n"
+            "  --wal                abre la base en modo WAL\n"
+            "  --maintenance-ms N   mantenimiento en segundo plano con pasos de N ms\n"
+            "  --hash-cost LN,R,P|calibrate  coste scrypt de las claves (default 4,1,1)\n"
+            "  --hash-target-ms X   objetivo de la calibracion (default 50)\n"
+            "  --hash-threads N     hilos del pool de hashing; 0 = uno por nucleo\n"
+            "  --stuffing           detecta relleno de credenciales y muestra los mayores infractores\n"
+            "  --shared-cache NAME  usa la cache de credenciales compartida NAME (p.ej. /authscreen-cache), una por base\n"
+            "  --backup FILE        copia en caliente a FILE en mitad de la carga\n"
+            "  --fast-paths         limite de fallos y caches de login delante de la base\n"
+            "  --shards N           reparte las cuentas en N ficheros (default 1); el lock,\n"
+            "                       la copia y el mantenimiento usan el shard 0\n"
+            "  --prefetch-ms N      precarga la cuenta N ms antes de enviar el login\n"
+            "  --cold               saca la base de la cache de paginas del sistema antes de empezar\n"
+            "  --coalesce           los hilos comparten la consulta de una misma cuenta\n"
+            "  --admission N        como mucho N logins en la base a la vez; descarta si la cola se estanca\n"
+            "  --admission-target-us N  espera en cola tolerada (default 5000)\n"
+            "  --sessions P         % de logins con sesion, que pasan delante (default 0)\n"
+            "  --fair N             N logins en la base a la vez, por turnos entre aplicaciones\n"
+            "  --tenants K          reparte los hilos entre K aplicaciones (default 1)\n"
+            "  --batch P            % de logins de revalidacion por lotes, tras los interactivos (default 0)\n"
+            "  --lockout            guarda fallos, bloqueos y ultimo acceso en la base (solo con --shards 1)\n"
+            "  --lockout-flush-ms N escribe ese estado cada N ms (default 100; 0 en cada login)\n"
+            "  --warm-state FILE    recarga las cuentas calientes guardadas en FILE y las guarda al final\n"
+            "                       (solo con --shards 1)\n"
+            "  --replicas N         replica los cambios en N bases de solo lectura (solo con --shards 1)\n"
+            "  --profile FILE       perfil de CPU en formato pprof a FILE (al final y con SIGUSR2)\n"
+            "  --profile-hz N       muestras por segundo de CPU (default 100)\n";
+    }
+
+    bool parseMix(const std::string& text, double* mix) {
+        std::stringstream stream(text);
+        std::string item;
+        int i = 0;
+        mix[ChangePassword] = 0;
+        while (std::getline(stream, item, ',')) {
+            if (i >= KindCount) {
+                return false;
+            }
+            mix[i++] = std::atof(item.c_str());
+        }
+        return i == KindCount || i == ChangePassword;
+    }
+
+    bool parseHashCost(const std::string& text, HashCost& cost) {
+        if (text == "calibrate") {
+            cost.logN = 0;
+            return true;
+        }
+        return std::sscanf(text.c_str(), "%d,%d,%d", &cost.logN, &cost.r, &cost.p) == 3 &&
+            cost.logN > 0 && cost.r > 0 && cost.p > 0;
+    }
+
+    DatabaseOptions databaseOptions(const Config& config) {
+        DatabaseOptions options;
+        options.queryTimeoutMs = config.timeoutMs;
+        options.walMode = config.walMode;
+        options.hashCost = config.hashCost;
+        options.hashTargetMs = config.hashTargetMs;
+        options.hashingPool = config.hashingPool;
+        options.sharedCache = config.sharedCache;
+        return options;
+    }
+
+    // The lock holder, backup and maintenance act on this one file.
+    std::string firstShardPath(const Config& config) {
+        return ShardedDatabase::shardPath(config.dbPath, 0, config.shards);
+    }
+
+    bool parseArgs(int argc, char** argv, Config& config) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+            const char* v = nullptr;
+            if (arg == "--provision") {
+                config.provision = true;
+            } else if (arg == "--stuffing") {
+                config.detectStuffing = true;
+            } else if (arg == "--fast-paths") {
+                config.fastPaths = true;
+            } else if (arg == "--coalesce") {
+                config.coalesce = true;
+            } else if (arg == "--cold") {
+                config.cold = true;
+            } else if (arg == "--lockout") {
+                config.lockoutFlushMs = std::max(config.lockoutFlushMs, 100);
+            } else if (arg == "--wal") {
+                config.walMode = true;
+            } else if (arg == "--help" || arg == "-h") {
+                return false;
+            } else if ((v = value()) == nullptr) {
+                std::cerr << "Falta valor para " << arg << std::endl;
+                return false;
+            } else if (arg == "--db") {
+                config.dbPath = v;
+            } else if (arg == "--users") {
+                config.users = std::strtoull(v, nullptr, 10);
+            } else if (arg == "--threads") {
+                config.threads = static_cast<unsigned>(std::atoi(v));
+            } else if (arg == "--rate") {
+                config.rate = std::atof(v);
+            } else if (arg == "--arrival") {
+                config.poisson = std::strcmp(v, "constant") != 0;
+            } else if (arg == "--duration") {
+                config.durationSeconds = std::atof(v);
+            } else if (arg == "--zipf") {
+                config.zipfExponent = std::atof(v);
+            } else if (arg == "--mix") {
+                if (!parseMix(v, config.mix)) {
+                    std::cerr << "--mix espera 4 o 5 pesos" << std::endl;
+                    return false;
+                }
+            } else if (arg == "--seed") {
+                config.seed = std::strtoull(v, nullptr, 10);
+            } else if (arg == "--histogram") {
+                config.histogramOut = v;
+            } else if (arg == "--trace") {
+                config.tracePath = v;
+            } else if (arg == "--audit") {
+                config.auditDir = v;
+            } else if (arg == "--timeout-ms") {
+                config.timeoutMs = std::atoi(v);
+            } else if (arg == "--writer-hold-ms") {
+                config.writerHoldMs = std::atoi(v);
+            } else if (arg == "--writer-period-ms") {
+                config.writerPeriodMs = std::atoi(v);
+            } else if (arg == "--maintenance-ms") {
+                config.maintenanceBudgetMs = std::atoi(v);
+            } else if (arg == "--hash-cost") {
+                if (!parseHashCost(v, config.hashCost)) {
+                    std::cerr << "--hash-cost espera LN,R,P o calibrate" << std::endl;
+                    return false;
+                }
+            } else if (arg == "--hash-target-ms") {
+                config.hashTargetMs = std::atof(v);
+            } else if (arg == "--backup") {
+                config.backupPath = v;
+            } else if (arg == "--shared-cache") {
+                config.sharedCacheName = v;
+            } else if (arg == "--shards") {
+                config.shards = std::atoi(v);
+            } else if (arg == "--prefetch-ms") {
+                config.prefetchMs = std::atoi(v);
+            } else if (arg == "--admission") {
+                config.admissionSlots = std::strtoull(v, nullptr, 10);
+            } else if (arg == "--admission-target-us") {
+                config.admissionTargetUs = std::atoi(v);
+            } else if (arg == "--sessions") {
+                config.sessionShare = std::atof(v);
+            } else if (arg == "--fair") {
+                config.fairSlots = std::strtoull(v, nullptr, 10);
+            } else if (arg == "--tenants") {
+                config.tenants = static_cast<unsigned>(std::atoi(v));
+            } else if (arg == "--batch") {
+                config.batchShare = std::atof(v);
+            } else if (arg == "--lockout-flush-ms") {
+                config.lockoutFlushMs = std::max(0, std::atoi(v));
+            } else if (arg == "--warm-state") {
+                config.warmStatePath = v;
+            } else if (arg == "--replicas") {
+                config.replicas = static_cast<unsigned>(std::atoi(v));
+            } else if (arg == "--profile") {
+                config.profilePath = v;
+            } else if (arg == "--profile-hz") {
+                config.profileHz = std::max(1, std::atoi(v));
+            } else if (arg == "--hash-threads") {
+                config.hashThreads = std::atoi(v);
+            } else {
+                std::cerr << "Opcion desconocida: " << arg << std::endl;
+                return false;
+            }
+        }
+        bool oneFile = config.lockoutFlushMs >= 0 || !config.warmStatePath.empty() || config.replicas > 0;
+        return config.threads > 0 && config.users > 0 && config.durationSeconds > 0 && config.shards > 0 &&
+            config.tenants > 0 && (!oneFile || config.shards == 1);
+    }
+
+    bool provisionDatabase(const Config& config) {
+        for (int i = 0; i < config.shards; i++) {
+            std::filesystem::remove(ShardedDatabase::shardPath(config.dbPath, i, config.shards));
+        }
+        ShardedDatabase db(config.dbPath, config.shards, databaseOptions(config));
+        if (!db.initialize()) {
+            return false;
+        }
+
+        const uint64_t chunkSize = 10000;
+        std::vector<std::pair<std::string, std::string>> chunk;
+        chunk.reserve(chunkSize);
+        for (uint64_t i = 0; i < config.users; i++) {
+            chunk.emplace_back(accountEmail(i), accountPassword(i));
+            if (chunk.size() == chunkSize || i + 1 == config.users) {
+                if (!db.addUsers(chunk)) {
+                    return false;
+                }
+                chunk.clear();
+            }
+        }
+        return true;
+    }
+
+    // Best effort; only clean pages are dropped, which is all of them once
+    // the provisioning has been synced.
+    void evictFromPageCache(const std::string& path) {
+#ifdef _WIN32
+        (void)path;
+        std::cerr << "--cold no esta disponible en Windows" << std::endl;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+#endif
+    }
+
+    void runWorker(const Config& config, unsigned index, Clock::time_point start,
+                   LoginTraceWriter* trace, AuditLog* audit, ActivityMonitor* activity,
+                   WorkerResult& result) {
+        CpuProfiler::registerThread();
+        ShardedDatabase db(config.dbPath, config.shards, databaseOptions(config));
+        if (!db.initialize()) {
+            return;
+        }
+        db.setTraceRecorder(trace);
+        db.setActivityMonitor(activity);
+        if (config.stuffing) {
+            db.setStuffingDetector(config.stuffing, "worker" + std::to_string(index));
+        }
+
+        AuthPipeline pipeline;
+        pipeline.add(std::make_unique<NormalizeStage>());
+        pipeline.add(std::make_unique<PolicyStage>());
+        if (config.fastPaths) {
+            pipeline.add(std::make_unique<RateLimitStage>());
+            pipeline.add(std::make_unique<NegativeCacheStage>());
+            pipeline.add(std::make_unique<PositiveCacheStage>());
+        }
+        if (config.loginState) {
+            pipeline.add(std::make_unique<LockoutStage>(*config.loginState));
+        }
+        std::unique_ptr<CredentialPrefetcher> prefetcher;
+        if (config.prefetchMs > 0) {
+            PrefetchOptions prefetchOptions;
+            prefetchOptions.shards = config.shards;
+            prefetcher = std::make_unique<CredentialPrefetcher>(config.dbPath, databaseOptions(config),
+                                                                prefetchOptions);
+            if (!prefetcher->start()) {
+                return;
+            }
+            pipeline.add(std::make_unique<PrefetchStage>(*prefetcher, db));
+        }
+        if (config.admission) {
+            pipeline.add(std::make_unique<AdmissionStage>(*config.admission));
+        }
+        if (config.scheduler) {
+            pipeline.add(std::make_unique<FairStage>(*config.scheduler));
+        }
+        if (config.coalescer) {
+            pipeline.add(std::make_unique<CoalescedStorageStage>(*config.coalescer, db));
+        } else {
+            pipeline.add(std::make_unique<StorageStage>(db));
+        }
+        if (audit) {
+            pipeline.add(std::make_unique<AuditStage>(*audit));
+        }
+        if (trace) {
+            pipeline.add(std::make_unique<TraceStage>(*trace));
+        }
+        if (config.warmState) {
+            pipeline.add(std::make_unique<WarmStateStage>(*config.warmState));
+        }
+
+        std::mt19937_64 rng(config.seed + index * 7919);
+        ZipfGenerator accounts(config.users, config.zipfExponent);
+        std::discrete_distribution<int> kinds(config.mix, config.mix + KindCount);
+        std::bernoulli_distribution withSession(config.sessionShare / 100.0);
+        std::bernoulli_distribution asBatch(config.batchShare / 100.0);
+        const std::string tenant = "app" + std::to_string(index % config.tenants);
+
+        const bool openLoop = config.rate > 0;
+        const double perThreadRate = config.rate / config.threads;
+        std::exponential_distribution<double> poissonGap(openLoop ? perThreadRate : 1.0);
+        const auto end = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(config.durationSeconds));
+        const auto typing = std::chrono::milliseconds(config.prefetchMs);
+
+        Clock::time_point intended = start;
+        while (true) {
+            if (openLoop) {
+                double gap = config.poisson ? poissonGap(rng) : 1.0 / perThreadRate;
+                intended += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap));
+                if (intended >= end) {
+                    break;
+                }
+            } else if (Clock::now() >= end) {
+                break;
+            }
+
+            int kind = kinds(rng);
+            uint64_t account = accounts.next(rng);
+            std::string email;
+            std::string password;
+            switch (kind) {
+                case Hit:
+                    email = accountEmail(account);
+                    password = accountPassword(account);
+                    break;
+                case Miss:
+                    email = "ghost" + std::to_string(account) + "@loadgen.test";
+                    password = accountPassword(account);
+                    break;
+                case WrongPassword:
+                    email = accountEmail(account);
+                    password = paddedPassword("Wr@", account);
+                    break;
+                case ChangePassword:
+                    email = accountEmail(account);
+                    password = accountPassword(account);
+                    break;
+                default:
+                    email = accountEmail(account);
+                    password = "weak";
+                    break;
+            }
+
+            if (prefetcher && kind != ChangePassword) {
+                // The email is known `typing` before the login is submitted;
+                // in open loop the schedule is of submits.
+                Clock::time_point submit = openLoop ? intended : Clock::now() + typing;
+                std::this_thread::sleep_until(submit - typing);
+                prefetcher->prefetch(email);
+                std::this_thread::sleep_until(submit);
+            } else if (openLoop) {
+                std::this_thread::sleep_until(intended);
+            }
+
+            Clock::time_point sent = Clock::now();
+            if (!openLoop) {
+                intended = sent;
+            }
+            if (kind == ChangePassword) {
+                bool changed = db.changePassword(email, password);
+                Clock::time_point done = Clock::now();
+                result.corrected.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+                result.service.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent).count());
+                result.perKind[kind]++;
+                if (!changed) {
+                    result.failedChanges++;
+                }
+                continue;
+            }
+            LoginRequest request;
+            request.email = email;
+            request.password = password;
+            request.hasSession = withSession(rng);
+            request.received = intended;
+            request.tenant = tenant;
+            request.priority = asBatch(rng) ? AuthPriority::Batch : AuthPriority::Interactive;
+            LoginOutcome outcome = pipeline.authenticate(request);
+            bool accepted = outcome == LoginOutcome::Success;
+            Clock::time_point done = Clock::now();
+
+            result.corrected.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+            result.service.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent).count());
+            result.perKind[kind]++;
+            result.perOutcome[static_cast<int>(outcome)]++;
+            if (accepted) {
+                result.accepted++;
+            }
+            bool unanswered = outcome == LoginOutcome::TimedOut || outcome == LoginOutcome::StorageError ||
+                              outcome == LoginOutcome::RateLimited || outcome == LoginOutcome::Overloaded;
+            if (!unanswered &&
+                (config.timeoutMs <= 0 || done - intended <= std::chrono::milliseconds(config.timeoutMs))) {
+                result.onTime++;
+            }
+            if (!unanswered && accepted != (kind == Hit)) {
+                result.unexpected++;
+            }
+        }
+        result.stages = pipeline.stats();
+        if (prefetcher) {
+            result.prefetch = prefetcher->stats();
+        }
+    }
+
+    // Simulates another process writing to the same file: repeatedly holds
+    // an exclusive lock for writerHoldMs every writerPeriodMs.
+    void runLockHolder(const Config& config, Clock::time_point start, Clock::time_point end) {
+        sqlite3* writer = nullptr;
+        if (sqlite3_open(firstShardPath(config).c_str(), &writer) != SQLITE_OK) {
+            sqlite3_close(writer);
+            return;
+        }
+        sqlite3_busy_timeout(writer, 1000);
+        std::this_thread::sleep_until(start);
+        while (Clock::now() < end) {
+            if (sqlite3_exec(writer, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr) == SQLITE_OK) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(config.writerHoldMs));
+                sqlite3_exec(writer, "COMMIT;", nullptr, nullptr, nullptr);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(
+                std::max(1, config.writerPeriodMs - config.writerHoldMs)));
+        }
+        sqlite3_close(writer);
+    }
+
+    // Starts an online backup a quarter of the way into the run, so the
+    // latency figures show what it costs the foreground traffic.
+    void runBackup(const Config& config, Clock::time_point start, bool& ok, BackupReport& report) {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(config.durationSeconds / 4)));
+        Database db(firstShardPath(config), databaseOptions(config));
+        ok = db.initialize() && db.backup(config.backupPath, BackupOptions(), &report);
+    }
+
+    void printLatency(const char* label, const LatencyHistogram& histogram) {
+        std::printf("%-22s p50=%9.1fus p99=%9.1fus p999=%9.1fus max=%9.1fus\n",
+                    label,
+                    histogram.percentile(50) / 1000.0,
+                    histogram.percentile(99) / 1000.0,
+                    histogram.percentile(99.9) / 1000.0,
+                    histogram.max() / 1000.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parseArgs(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+    HashingPool hashingPool(config.hashThreads);
+    config.hashingPool = &hashingPool;
+    LookupCoalescer coalescer;
+    if (config.coalesce) {
+        config.coalescer = &coalescer;
+    }
+    AdmissionOptions admissionOptions;
+    admissionOptions.maxInFlight = std::max<size_t>(1, config.admissionSlots);
+    admissionOptions.target = std::chrono::microseconds(config.admissionTargetUs);
+    AdmissionController admission(admissionOptions);
+    if (config.admissionSlots > 0) {
+        config.admission = &admission;
+    }
+    FairScheduler scheduler(std::max<size_t>(1, config.fairSlots));
+    if (config.fairSlots > 0) {
+        config.scheduler = &scheduler;
+    }
+    LoginStateOptions loginStateOptions;
+    loginStateOptions.flushIntervalMs = std::max(0, config.lockoutFlushMs);
+    LoginStateStore loginState(config.dbPath, loginStateOptions, databaseOptions(config));
+    StuffingDetector stuffing;
+    if (config.detectStuffing) {
+        config.stuffing = &stuffing;
+    }
+    SharedCredentialCache sharedCache;
+    if (!config.sharedCacheName.empty()) {
+        if (!sharedCache.attach(SharedCredentialCache::segmentName(config.sharedCacheName, config.dbPath))) {
+            return 1;
+        }
+        config.sharedCache = &sharedCache;
+    }
+    HashCost hashCost = PasswordHasher::resolve(config.hashCost, config.hashTargetMs);
+    std::printf("Hashing: scrypt ln=%d r=%d p=%d, %d hilos\n", hashCost.logN, hashCost.r, hashCost.p,
+                hashingPool.threadCount());
+
+    if (config.provision) {
+        std::cout << "Provisionando " << config.users << " cuentas en " << config.dbPath << "..." << std::endl;
+        if (!provisionDatabase(config)) {
+            std::cerr << "Error provisionando la base de datos" << std::endl;
+            return 1;
+        }
+    }
+    if (config.cold) {
+        for (int i = 0; i < config.shards; i++) {
+            evictFromPageCache(ShardedDatabase::shardPath(config.dbPath, i, config.shards));
+        }
+    }
+    if (config.lockoutFlushMs >= 0) {
+        if (!loginState.start()) {
+            return 1;
+        }
+        config.loginState = &loginState;
+    }
+    WarmState warmState(config.dbPath, config.warmStatePath, WarmStateOptions(), databaseOptions(config));
+    WarmStateReport warmReport = {};
+    if (!config.warmStatePath.empty()) {
+        warmReport = warmState.restore();
+        config.warmState = &warmState;
+    }
+
+    std::string logDirectory = config.dbPath + ".log";
+    ChangeShipper shipper(config.dbPath, logDirectory);
+    std::vector<std::unique_ptr<ReplicaFollower>> followers;
+    for (unsigned i = 0; i < config.replicas; i++) {
+        std::string replicaPath = config.dbPath + ".replica" + std::to_string(i) + "/auth.db";
+        std::filesystem::create_directories(std::filesystem::path(replicaPath).parent_path());
+        if (i == 0) {
+            while (shipper.shipOnce() > 0) {
+            }
+        }
+        if (ReplicaFollower(replicaPath, logDirectory).applyOnce() < 0) {
+            std::cerr << "No se pudo poner al dia la replica " << replicaPath << std::endl;
+            return 1;
+        }
+        followers.push_back(std::make_unique<ReplicaFollower>(replicaPath, logDirectory));
+    }
+    if (config.replicas > 0 && !shipper.start()) {
+        return 1;
+    }
+    for (auto& follower : followers) {
+        if (!follower->start()) {
+            return 1;
+        }
+    }
+
+    LoginTraceWriter trace;
+    if (!config.tracePath.empty() && !trace.open(config.tracePath)) {
+        std::cerr << "No se pudo abrir la traza " << config.tracePath << std::endl;
+        return 1;
+    }
+    LoginTraceWriter* tracePtr = trace.isOpen() ? &trace : nullptr;
+
+    AuditLogOptions auditOptions;
+    auditOptions.directory = config.auditDir;
+    AuditLog audit(auditOptions);
+    if (!config.auditDir.empty() && !audit.start()) {
+        return 1;
+    }
+    AuditLog* auditPtr = audit.isRunning() ? &audit : nullptr;
+
+    ActivityMonitor activity;
+    MaintenanceOptions maintenanceOptions;
+    maintenanceOptions.stepBudgetMs = std::max(1, config.maintenanceBudgetMs);
+    maintenanceOptions.idleThresholdMs = 20;
+    maintenanceOptions.pollIntervalMs = 20;
+    MaintenanceScheduler maintenance(firstShardPath(config), activity, maintenanceOptions);
+    if (config.maintenanceBudgetMs > 0 && !maintenance.start()) {
+        return 1;
+    }
+
+    ProfilerOptions profilerOptions;
+    profilerOptions.frequencyHz = config.profileHz;
+    profilerOptions.outputPath = config.profilePath;
+    CpuProfiler profiler(profilerOptions);
+    if (!config.profilePath.empty() && !profiler.start()) {
+        return 1;
+    }
+
+    std::vector<WorkerResult> results(config.threads);
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(50);
+    for (unsigned i = 0; i < config.threads; i++) {
+        workers.emplace_back(runWorker, std::cref(config), i, start, tracePtr, auditPtr, &activity,
+                             std::ref(results[i]));
+    }
+    if (config.writerHoldMs > 0) {
+        auto end = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(config.durationSeconds));
+        workers.emplace_back(runLockHolder, std::cref(config), start, end);
+    }
+    bool backupOk = false;
+    BackupReport backupReport = {};
+    if (!config.backupPath.empty()) {
+        workers.emplace_back(runBackup, std::cref(config), start, std::ref(backupOk), std::ref(backupReport));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    profiler.stop();
+    // Writes what is still pending, so the stats count every change.
+    loginState.stop();
+    shipper.stop();
+    auto caughtUp = Clock::now() + std::chrono::seconds(5);
+    for (auto& follower : followers) {
+        while (follower->status().position < shipper.stats().position && Clock::now() < caughtUp) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        follower->stop();
+    }
+
+    WorkerResult total;
+    for (const auto& result : results) {
+        total.corrected.merge(result.corrected);
+        total.service.merge(result.service);
+        for (int k = 0; k < KindCount; k++) {
+            total.perKind[k] += result.perKind[k];
+        }
+        for (int o = 0; o < kLoginOutcomeCount; o++) {
+            total.perOutcome[o] += result.perOutcome[o];
+        }
+        total.accepted += result.accepted;
+        total.onTime += result.onTime;
+        total.unexpected += result.unexpected;
+        total.failedChanges += result.failedChanges;
+        total.prefetch.requested += result.prefetch.requested;
+        total.prefetch.fetched += result.prefetch.fetched;
+        total.prefetch.dropped += result.prefetch.dropped;
+        total.prefetch.used += result.prefetch.used;
+        total.prefetch.expired += result.prefetch.expired;
+        // Every worker builds the same pipeline, so stages line up by position.
+        if (total.stages.empty()) {
+            total.stages = result.stages;
+        } else {
+            for (size_t i = 0; i < total.stages.size() && i < result.stages.size(); i++) {
+                total.stages[i].evaluated += result.stages[i].evaluated;
+                total.stages[i].decided += result.stages[i].decided;
+                total.stages[i].latency.merge(result.stages[i].latency);
+                total.stages[i].observeLatency.merge(result.stages[i].observeLatency);
+            }
+        }
+    }
+
+    std::printf("Peticiones: %llu en %.2fs -> %.1f logins/s",
+                static_cast<unsigned long long>(total.corrected.count()), elapsed,
+                total.corrected.count() / elapsed);
+    if (config.rate > 0) {
+        std::printf(" (objetivo %.0f/s, %s)\n", config.rate, config.poisson ? "poisson" : "constante");
+    } else {
+        std::printf(" (closed-loop)\n");
+    }
+    for (int k = 0; k < KindCount; k++) {
+        std::printf("  %-16s %llu\n", kKindNames[k], static_cast<unsigned long long>(total.perKind[k]));
+    }
+    std::printf("Resultados:");
+    for (int o = 0; o < kLoginOutcomeCount; o++) {
+        std::printf(" %s=%llu", loginOutcomeName(static_cast<LoginOutcome>(o)),
+                    static_cast<unsigned long long>(total.perOutcome[o]));
+    }
+    std::printf("\n");
+    std::printf("Aceptadas: %llu  Resultados inesperados: %llu\n",
+                static_cast<unsigned long long>(total.accepted),
+                static_cast<unsigned long long>(total.unexpected));
+    std::printf("A tiempo: %llu (%.1f/s)\n", static_cast<unsigned long long>(total.onTime),
+                total.onTime / elapsed);
+    if (total.perKind[ChangePassword] > 0) {
+        std::printf("Cambios de clave: %llu (%llu fallidos) en %d shard(s)\n",
+                    static_cast<unsigned long long>(total.perKind[ChangePassword]),
+                    static_cast<unsigned long long>(total.failedChanges), config.shards);
+    }
+    printLatency("Latencia (corregida)", total.corrected);
+    printLatency("Tiempo de servicio", total.service);
+    std::printf("Etapas:\n");
+    for (const AuthStageStats& stage : total.stages) {
+        std::printf("  %-16s %10llu evaluadas, %5.1f%% decididas, decide p50 %.1fus p99 %.1fus, "
+                    "observe p99 %.1fus\n", stage.name,
+                    static_cast<unsigned long long>(stage.evaluated), stage.hitRatio() * 100.0,
+                    stage.latency.percentile(50) / 1000.0, stage.latency.percentile(99) / 1000.0,
+                    stage.observeLatency.percentile(99) / 1000.0);
+    }
+
+    if (config.prefetchMs > 0) {
+        std::printf("Precarga (%d ms antes): %llu pedidas, %llu leidas, %llu usadas, %llu caducadas, "
+                    "%llu descartadas\n", config.prefetchMs,
+                    static_cast<unsigned long long>(total.prefetch.requested),
+                    static_cast<unsigned long long>(total.prefetch.fetched),
+                    static_cast<unsigned long long>(total.prefetch.used),
+                    static_cast<unsigned long long>(total.prefetch.expired),
+                    static_cast<unsigned long long>(total.prefetch.dropped));
+    }
+
+    if (config.coalescer) {
+        CoalescerStats coalescing = coalescer.stats();
+        std::printf("Coalescencia: %llu consultas, %llu compartidas (%.1f%%), %llu con hueco ocupado, "
+                    "%llu de respaldo, %llu repetidas\n",
+                    static_cast<unsigned long long>(coalescing.lookups),
+                    static_cast<unsigned long long>(coalescing.coalesced), coalescing.coalescingRatio() * 100.0,
+                    static_cast<unsigned long long>(coalescing.bypassed),
+                    static_cast<unsigned long long>(coalescing.hedged),
+                    static_cast<unsigned long long>(coalescing.retried));
+    }
+
+    if (config.admission) {
+        AdmissionStats admitted = admission.stats();
+        std::printf("Admision (%zu huecos): %llu admitidas, %llu descartadas (%.1f%%), con sesion %llu/%llu; "
+                    "espera p50 %.1fus p99 %.1fus\n", admissionOptions.maxInFlight,
+                    static_cast<unsigned long long>(admitted.admitted),
+                    static_cast<unsigned long long>(admitted.shed), admitted.shedRatio() * 100.0,
+                    static_cast<unsigned long long>(admitted.sessionAdmitted),
+                    static_cast<unsigned long long>(admitted.sessionAdmitted + admitted.sessionShed),
+                    admitted.queueDelay.percentile(50) / 1000.0, admitted.queueDelay.percentile(99) / 1000.0);
+    }
+
+    if (config.scheduler) {
+        std::printf("Reparto (%zu huecos):\n", config.fairSlots);
+        for (const TenantStats& tenant : scheduler.stats()) {
+            std::printf("  %-8s peso %u: %llu logins, %llu sin turno; espera p99 %.1fus, total p50 %.1fus "
+                        "p99 %.1fus\n", tenant.name.c_str(), tenant.weight,
+                        static_cast<unsigned long long>(tenant.granted),
+                        static_cast<unsigned long long>(tenant.timedOut),
+                        tenant.queueDelay.percentile(99) / 1000.0, tenant.latency.percentile(50) / 1000.0,
+                        tenant.latency.percentile(99) / 1000.0);
+        }
+    }
+
+    if (config.warmState) {
+        size_t hot = warmState.hotAccounts().size();
+        bool saved = warmState.save();
+        std::printf("Estado caliente: %s; %llu/%llu cuentas leidas, %llu paginas precargadas (base %s), "
+                    "restaurado en %.1fms; %s %zu cuentas en %s\n",
+                    warmReport.loaded ? "cargado" : "sin fichero valido",
+                    static_cast<unsigned long long>(warmReport.accountsWarmed),
+                    static_cast<unsigned long long>(warmReport.accounts),
+                    static_cast<unsigned long long>(warmReport.pagesPrefetched),
+                    warmReport.pagesMatched ? "sin cambios" : "cambiada", warmReport.restoreMs,
+                    saved ? "guardadas" : "error guardando", hot,
+                    config.warmStatePath.c_str());
+    }
+
+    if (config.replicas > 0) {
+        ShipperStats shipped = shipper.stats();
+        std::printf("Replicas (%u): %llu cambios en %llu segmentos (max %.1fms, %llu fallidos) a %s\n",
+                    config.replicas, static_cast<unsigned long long>(shipped.changes),
+                    static_cast<unsigned long long>(shipped.segments), shipped.maxShipMs,
+                    static_cast<unsigned long long>(shipped.failures), logDirectory.c_str());
+        for (size_t i = 0; i < followers.size(); i++) {
+            ReplicaStatus replica = followers[i]->status();
+            std::printf("  replica %zu: posicion %llu/%llu, %llu aplicados, retraso p50 %.1fms p99 %.1fms "
+                        "max %.1fms%s\n", i, static_cast<unsigned long long>(replica.position),
+                        static_cast<unsigned long long>(shipped.position),
+                        static_cast<unsigned long long>(replica.applied),
+                        replica.lag.percentile(50) / 1e6, replica.lag.percentile(99) / 1e6,
+                        replica.lag.max() / 1e6, replica.gap ? " (hueco: sembrar de nuevo)" : "");
+        }
+    }
+
+    if (config.loginState) {
+        LoginStateStats state = loginState.stats();
+        std::printf("Estado de login (cada %d ms): %llu cambios, %llu agrupados, %llu filas en %llu transacciones "
+                    "(max %.2fms), %llu fallidas, %llu cuentas leidas\n", loginStateOptions.flushIntervalMs,
+                    static_cast<unsigned long long>(state.updates),
+                    static_cast<unsigned long long>(state.coalesced),
+                    static_cast<unsigned long long>(state.rowsWritten),
+                    static_cast<unsigned long long>(state.flushes), state.maxFlushMs,
+                    static_cast<unsigned long long>(state.flushFailures),
+                    static_cast<unsigned long long>(state.loads));
+    }
+
+    if (!config.profilePath.empty()) {
+        ProfilerStats profile = profiler.stats();
+        double captureUs = profile.samples ? profile.captureNs / 1000.0 / profile.samples : 0;
+        std::printf("Perfil de CPU (%d Hz): %llu muestras (%.1fus cada una, %.2f%% de CPU), %llu perdidas, "
+                    "%llu pilas distintas, %s en %s\n",
+                    config.profileHz, static_cast<unsigned long long>(profile.samples), captureUs,
+                    captureUs * config.profileHz / 10000.0, static_cast<unsigned long long>(profile.dropped),
+                    static_cast<unsigned long long>(profile.stacks),
+                    profile.profilesWritten > 0 ? "escrito" : "error escribiendo", config.profilePath.c_str());
+    }
+
+    HashingPoolStats hashStats = hashingPool.stats();
+    std::printf("Pool de hashing: %llu hashes, %llu caducados en cola, %llu rechazados, cola max %zu\n",
+                static_cast<unsigned long long>(hashStats.completed),
+                static_cast<unsigned long long>(hashStats.expired),
+                static_cast<unsigned long long>(hashStats.rejected), hashStats.maxQueueDepth);
+
+    if (!config.backupPath.empty()) {
+        if (backupOk) {
+            std::printf("Copia en caliente: %.1f MB -> %.1f MB en %.2fs (copia %.2fs) = %.1f MB/s, "
+                        "%llu pasos (max %.2fms), %llu reinicios\n",
+                        backupReport.databaseBytes / 1048576.0, backupReport.snapshotBytes / 1048576.0,
+                        backupReport.totalSeconds, backupReport.copySeconds, backupReport.megabytesPerSecond,
+                        static_cast<unsigned long long>(backupReport.steps), backupReport.maxStepMs,
+                        static_cast<unsigned long long>(backupReport.restarts));
+        } else {
+            std::printf("Copia en caliente: fallida\n");
+        }
+    }
+
+    if (config.sharedCache) {
+        SharedCacheStats cacheStats = sharedCache.stats();
+        std::printf("Cache compartida: %llu aciertos, %llu fallos, %llu rellenos, %llu invalidaciones, "
+                    "%llu recuperadas (todos los procesos)\n",
+                    static_cast<unsigned long long>(cacheStats.hits),
+                    static_cast<unsigned long long>(cacheStats.misses),
+                    static_cast<unsigned long long>(cacheStats.fills),
+                    static_cast<unsigned long long>(cacheStats.invalidations),
+                    static_cast<unsigned long long>(cacheStats.takeovers));
+    }
+
+    if (config.stuffing) {
+        std::printf("Relleno de credenciales: %llu fallos, %zu KB de contadores\n",
+                    static_cast<unsigned long long>(stuffing.events()), stuffing.memoryBytes() / 1024);
+        for (int k = 0; k < kStuffingKeyCount; k++) {
+            StuffingKey kind = static_cast<StuffingKey>(k);
+            std::printf("  %-7s", stuffingKeyName(kind));
+            for (const StuffingOffender& offender : stuffing.topOffenders(kind, 3)) {
+                std::printf(" %s=%.0f", offender.key.c_str(), offender.failures);
+            }
+            std::printf("\n");
+        }
+    }
+
+    if (config.maintenanceBudgetMs > 0) {
+        maintenance.stop();
+        MaintenanceReport report = maintenance.report();
+        std::printf("Mantenimiento: %llu pasos (%llu interrumpidos, max %.2fms), optimize=%llu, "
+                    "vacuum=%llu (%llu KB liberados), checkpoints=%llu (%llu frames)\n",
+                    static_cast<unsigned long long>(report.steps),
+                    static_cast<unsigned long long>(report.interruptedSteps), report.maxStepMs,
+                    static_cast<unsigned long long>(report.optimizeRuns),
+                    static_cast<unsigned long long>(report.vacuumSteps),
+                    static_cast<unsigned long long>(report.bytesReclaimed / 1024),
+                    static_cast<unsigned long long>(report.checkpoints),
+                    static_cast<unsigned long long>(report.framesCheckpointed));
+    }
+
+    if (auditPtr) {
+        audit.stop();
+        AuditLogStats stats = audit.stats();
+        std::printf("Auditoria: %llu registros, %llu descartados, %llu fallidos, %llu grupos (fsync), "
+                    "%llu segmentos\n",
+                    static_cast<unsigned long long>(stats.written),
+                    static_cast<unsigned long long>(stats.dropped),
+                    static_cast<unsigned long long>(stats.failed),
+                    static_cast<unsigned long long>(stats.groupCommits),
+                    static_cast<unsigned long long>(stats.segments));
+    }
+
+    if (!config.histogramOut.empty() && !total.corrected.saveToFile(config.histogramOut)) {
+        std::cerr << "No se pudo escribir " << config.histogramOut << std::endl;
+    }
+    return total.unexpected == 0 ? 0 : 2;
+}
@@ -0,0 +1,214 @@
+#include "Database.h"
+#include "ShardedDatabase.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ============================================
+// Redistribución de cuentas entre shards
+// ============================================
+//
+// Copies every account of an N-shard store into a new M-shard store (see
+// ShardedDatabase) and then swaps the files. Stored hashes are copied as
+// they are, so no password is rehashed. The new shards are written beside
+// the final paths and only renamed into place once every row is accounted
+// for; a failed run leaves the old store untouched. Offline: nothing may
+// write to the store while it runs.
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct ReshardConfig {
+        std::string dbPath = "auth.db";
+        int from = 0;
+        int to = 0;
+        bool keep = false;
+        size_t batchRows = 10000;
+    };
+
+    void printUsage() {
+        std::cout <<
+            "Uso: AuthReshard --db auth.db --from N --to M [opciones]\n"
+            "  --db PATH       ruta base del almacen (default auth.db)\n"
+            "  --from N        shards actuales\n"
+            "  --to M          shards nuevos\n"
+            "  --keep          conserva los ficheros antiguos\n"
+            "  --batch N       filas por transaccion (default 10000)\n"
+            "Detén la aplicacion antes: ningun proceso puede escribir durante la copia.\n";
+    }
+
+    bool parseArgs(int argc, char** argv, ReshardConfig& config) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--keep") {
+                config.keep = true;
+                continue;
+            }
+            if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+                return false;
+            }
+            const char* v = argv[++i];
+            if (arg == "--db") {
+                config.dbPath = v;
+            } else if (arg == "--from") {
+                config.from = std::atoi(v);
+            } else if (arg == "--to") {
+                config.to = std::atoi(v);
+            } else if (arg == "--batch") {
+                config.batchRows = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+            } else {
+                std::cerr << "Opcion desconocida: " << arg << std::endl;
+                return false;
+            }
+        }
+        return config.from > 0 && config.to > 0 && config.from != config.to && config.batchRows > 0;
+    }
+
+    std::string stagingPath(const std::string& path) {
+        return path + ".reshard";
+    }
+
+    void removeFiles(const std::string& path) {
+        std::error_code ec;
+        for (const char* suffix : {"", "-wal", "-shm", "-journal"}) {
+            std::filesystem::remove(path + suffix, ec);
+        }
+    }
+
+    uint64_t countUsers(Database& db) {
+        uint64_t rows = 0;
+        db.exportUsers([&rows](const StoredUser&) {
+            rows++;
+            return true;
+        });
+        return rows;
+    }
+}
+
+int main(int argc, char** argv) {
+    ReshardConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::string> sources;
+    for (int i = 0; i < config.from; i++) {
+        sources.push_back(ShardedDatabase::shardPath(config.dbPath, i, config.from));
+        if (!std::filesystem::exists(sources.back())) {
+            std::cerr << "No existe el shard " << sources.back() << std::endl;
+            return 1;
+        }
+    }
+    std::vector<std::string> targets;
+    for (int i = 0; i < config.to; i++) {
+        targets.push_back(ShardedDatabase::shardPath(config.dbPath, i, config.to));
+        if (std::filesystem::exists(targets.back())) {
+            std::cerr << "Ya existe " << targets.back() << "; no se sobrescribe" << std::endl;
+            return 1;
+        }
+        removeFiles(stagingPath(targets.back()));
+    }
+
+    Clock::time_point started = Clock::now();
+    uint64_t copied = 0;
+    std::vector<uint64_t> perTarget(config.to, 0);
+    {
+        std::vector<std::unique_ptr<Database>> staged;
+        for (const std::string& target : targets) {
+            staged.push_back(std::make_unique<Database>(stagingPath(target)));
+            if (!staged.back()->initialize()) {
+                return 1;
+            }
+        }
+
+        std::vector<std::vector<StoredUser>> pending(config.to);
+        bool ok = true;
+        auto flush = [&](int shard) {
+            if (!pending[shard].empty()) {
+                ok = ok && staged[shard]->importUsers(pending[shard]);
+                pending[shard].clear();
+            }
+            return ok;
+        };
+        for (const std::string& source : sources) {
+            Database db(source);
+            if (!db.initialize()) {
+                return 1;
+            }
+            bool read = db.exportUsers([&](const StoredUser& user) {
+                int shard = ShardedDatabase::shardIndex(user.usuario, config.to);
+                pending[shard].push_back(user);
+                perTarget[shard]++;
+                copied++;
+                return pending[shard].size() < config.batchRows || flush(shard);
+            });
+            if (!read || !ok) {
+                std::cerr << "Error copiando " << source << "; el almacen original no se ha tocado" << std::endl;
+                for (const std::string& target : targets) {
+                    removeFiles(stagingPath(target));
+                }
+                return 1;
+            }
+        }
+        for (int shard = 0; shard < config.to; shard++) {
+            flush(shard);
+        }
+
+        uint64_t written = 0;
+        for (auto& db : staged) {
+            written += countUsers(*db);
+        }
+        if (!ok || written != copied) {
+            std::cerr << "Copiadas " << copied << " cuentas pero escritas " << written
+                      << "; el almacen original no se ha tocado" << std::endl;
+            staged.clear();
+            for (const std::string& target : targets) {
+                removeFiles(stagingPath(target));
+            }
+            return 1;
+        }
+    }
+
+    // The old store is only removed once every new shard is in place. A
+    // rename that fails moves the ones already swapped back to staging, so
+    // a retry does not find a half-written store at the final paths.
+    for (size_t i = 0; i < targets.size(); i++) {
+        std::error_code ec;
+        std::filesystem::rename(stagingPath(targets[i]), targets[i], ec);
+        if (!ec) {
+            continue;
+        }
+        std::cerr << "Error moviendo " << stagingPath(targets[i]) << " a " << targets[i] << ": " << ec.message()
+                  << "; el almacen original no se ha tocado" << std::endl;
+        while (i-- > 0) {
+            std::filesystem::rename(targets[i], stagingPath(targets[i]), ec);
+            if (ec) {
+                std::cerr << "No se pudo retirar " << targets[i] << ": " << ec.message() << "; borralo a mano"
+                          << std::endl;
+            }
+        }
+        for (const std::string& target : targets) {
+            removeFiles(stagingPath(target));
+        }
+        return 1;
+    }
+    if (!config.keep) {
+        for (const std::string& source : sources) {
+            removeFiles(source);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    std::printf("%llu cuentas de %d a %d shards en %.2fs\n", static_cast<unsigned long long>(copied),
+                config.from, config.to, seconds);
+    for (int i = 0; i < config.to; i++) {
+        std::printf("  %s: %llu\n", targets[i].c_str(), static_cast<unsigned long long>(perTarget[i]));
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include "Database.h"
+#include "LatencyHistogram.h"
+#include "LoginTrace.h"
+#include "PasswordValidator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// ============================================
+// Reproductor de trazas de login
+// ============================================
+//
+// Re-issues a LoginTrace against a Database at 1x, Nx or maximum speed.
+// Traces only hold hashed account keys, so every key is mapped to a
+// synthetic account; accounts that succeeded or failed on the password in
+// the trace are provisioned, unknown ones are not, and policy rejections
+// only exercise PasswordValidator. Latencies are measured from the
+// scheduled replay time (coordinated-omission corrected) and can be saved
+// and compared between two builds or configurations.
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const char* kReplayPassword = "Rp@Replay1";
+    const char* kWrongPassword = "Wr@Replay1";
+    const char* kPolicyFailPassword = "weak";
+
+    struct ReplayConfig {
+        std::string tracePath;
+        std::string dbPath = "replay.db";
+        bool provision = false;
+        double speed = 1.0;  // 0 = as fast as possible
+        unsigned threads = 4;
+        std::string histogramOut;
+        // Cheap by default, as in AuthLoadGen; both the provisioned hashes
+        // and the replay use it, so no login triggers a rehash.
+        HashCost hashCost = HashCost{4, 1, 1};
+    };
+
+    struct ReplayResult {
+        LatencyHistogram latency;
+        uint64_t mismatches = 0;
+    };
+
+    std::string replayEmail(uint64_t accountKey) {
+        char buffer[48];
+        std::snprintf(buffer, sizeof(buffer), "acct-%016llx@replay.test",
+                      static_cast<unsigned long long>(accountKey));
+        return buffer;
+    }
+
+    void printUsage() {
+        std::cout <<
+            "Uso:\n"
+            "  AuthReplay info --trace FILE\n"
+            "  AuthReplay replay --trace FILE [--db PATH] [--provision] [--speed X|max]\n"
+            "                    [--threads N] [--histogram FILE] [--hash-cost LN,R,P|calibrate]\n"
+            "  AuthReplay compare BASE.hist CANDIDATE.hist\n";
+    }
+
+    bool loadTrace(const std::string& path, std::vector<LoginTraceRecord>& records) {
+        LoginTraceReader reader;
+        if (!reader.open(path)) {
+            std::cerr << "No se pudo leer la traza " << path << std::endl;
+            return false;
+        }
+        LoginTraceRecord record;
+        while (reader.next(record)) {
+            records.push_back(record);
+        }
+        return true;
+    }
+
+    int runInfo(const std::string& tracePath) {
+        std::vector<LoginTraceRecord> records;
+        if (!loadTrace(tracePath, records)) {
+            return 1;
+        }
+        uint64_t perOutcome[kLoginOutcomeCount] = {};
+        std::unordered_map<uint64_t, uint64_t> perAccount;
+        for (const auto& record : records) {
+            int index = static_cast<int>(record.outcome);
+            if (index < kLoginOutcomeCount) {
+                perOutcome[index]++;
+            }
+            perAccount[record.accountKey]++;
+        }
+        uint64_t hottest = 0;
+        for (const auto& entry : perAccount) {
+            hottest = std::max(hottest, entry.second);
+        }
+        double seconds = records.empty() ? 0.0 : records.back().timestampNs / 1e9;
+
+        std::printf("Registros: %zu en %.2fs (%.1f/s)\n", records.size(), seconds,
+                    seconds > 0 ? records.size() / seconds : 0.0);
+        for (int i = 0; i < kLoginOutcomeCount; i++) {
+            std::printf("  %-16s %llu\n", loginOutcomeName(static_cast<LoginOutcome>(i)),
+                        static_cast<unsigned long long>(perOutcome[i]));
+        }
+        std::printf("Cuentas distintas: %zu  cuenta mas caliente: %llu peticiones\n",
+                    perAccount.size(), static_cast<unsigned long long>(hottest));
+        return 0;
+    }
+
+    DatabaseOptions replayOptions(const ReplayConfig& config) {
+        DatabaseOptions options;
+        options.hashCost = config.hashCost;
+        return options;
+    }
+
+    bool provisionReplayDatabase(const ReplayConfig& config, const std::vector<LoginTraceRecord>& records) {
+        std::unordered_set<uint64_t> known;
+        for (const auto& record : records) {
+            if (record.outcome == LoginOutcome::Success || record.outcome == LoginOutcome::WrongPassword) {
+                known.insert(record.accountKey);
+            }
+        }
+
+        std::filesystem::remove(config.dbPath);
+        Database db(config.dbPath, replayOptions(config));
+        if (!db.initialize()) {
+            return false;
+        }
+        std::vector<std::pair<std::string, std::string>> users;
+        users.reserve(known.size());
+        for (uint64_t key : known) {
+            users.emplace_back(replayEmail(key), kReplayPassword);
+        }
+        return db.addUsers(users);
+    }
+
+    void replayWorker(const ReplayConfig& config, const std::vector<LoginTraceRecord>& records,
+                      unsigned index, Clock::time_point start, ReplayResult& result) {
+        Database db(config.dbPath, replayOptions(config));
+        if (!db.initialize()) {
+            return;
+        }
+        std::this_thread::sleep_until(start);
+
+        for (size_t i = index; i < records.size(); i += config.threads) {
+            const LoginTraceRecord& record = records[i];
+            Clock::time_point intended;
+            if (config.speed > 0) {
+                intended = start + std::chrono::nanoseconds(
+                    static_cast<int64_t>(record.timestampNs / config.speed));
+                std::this_thread::sleep_until(intended);
+            } else {
+                intended = Clock::now();
+            }
+
+            std::string email = replayEmail(record.accountKey);
+            const char* password = kReplayPassword;
+            if (record.outcome == LoginOutcome::WrongPassword) {
+                password = kWrongPassword;
+            } else if (record.outcome == LoginOutcome::PolicyRejected) {
+                password = kPolicyFailPassword;
+            }
+
+            LoginOutcome outcome = LoginOutcome::PolicyRejected;
+            if (PasswordValidator::validate(password)) {
+                outcome = db.authenticate(email, password);
+            }
+            Clock::time_point done = Clock::now();
+
+            result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+            if (outcome != record.outcome) {
+                result.mismatches++;
+            }
+        }
+    }
+
+    int runReplay(const ReplayConfig& config) {
+        std::vector<LoginTraceRecord> records;
+        if (!loadTrace(config.tracePath, records)) {
+            return 1;
+        }
+        if (config.provision && !provisionReplayDatabase(config, records)) {
+            std::cerr << "Error provisionando " << config.dbPath << std::endl;
+            return 1;
+        }
+
+        std::vector<ReplayResult> results(config.threads);
+        std::vector<std::thread> workers;
+        Clock::time_point start = Clock::now() + std::chrono::milliseconds(50);
+        for (unsigned i = 0; i < config.threads; i++) {
+            workers.emplace_back(replayWorker, std::cref(config), std::cref(records), i, start, std::ref(results[i]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        ReplayResult total;
+        for (const auto& result : results) {
+            total.latency.merge(result.latency);
+            total.mismatches += result.mismatches;
+        }
+        std::printf("Reproducidas %llu peticiones en %.2fs (%.1f/s, ",
+                    static_cast<unsigned long long>(total.latency.count()), elapsed,
+                    total.latency.count() / elapsed);
+        if (config.speed > 0) {
+            std::printf("velocidad %gx)\n", config.speed);
+        } else {
+            std::printf("velocidad max)\n");
+        }
+        std::printf("Resultados distintos a la traza: %llu\n", static_cast<unsigned long long>(total.mismatches));
+        std::printf("Latencia p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus\n",
+                    total.latency.percentile(50) / 1000.0,
+                    total.latency.percentile(99) / 1000.0,
+                    total.latency.percentile(99.9) / 1000.0,
+                    total.latency.max() / 1000.0);
+
+        if (!config.histogramOut.empty() && !total.latency.saveToFile(config.histogramOut)) {
+            std::cerr << "No se pudo escribir " << config.histogramOut << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    int runCompare(const std::string& basePath, const std::string& candidatePath) {
+        LatencyHistogram base;
+        LatencyHistogram candidate;
+        if (!base.loadFromFile(basePath) || !candidate.loadFromFile(candidatePath)) {
+            std::cerr << "No se pudieron leer los histogramas" << std::endl;
+            return 1;
+        }
+
+        const double percentiles[] = {50, 90, 99, 99.9, 100};
+        std::printf("%-8s %14s %14s %9s\n", "pct", "base(us)", "candidato(us)", "cambio");
+        for (double p : percentiles) {
+            double a = base.percentile(p) / 1000.0;
+            double b = candidate.percentile(p) / 1000.0;
+            std::printf("p%-7g %14.1f %14.1f %+8.1f%%\n", p, a, b, a > 0 ? (b - a) / a * 100.0 : 0.0);
+        }
+        std::printf("%-8s %14llu %14llu\n", "n",
+                    static_cast<unsigned long long>(base.count()),
+                    static_cast<unsigned long long>(candidate.count()));
+        return 0;
+    }
+
+    bool parseReplayArgs(int argc, char** argv, ReplayConfig& config) {
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--provision") {
+                config.provision = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Falta valor para " << arg << std::endl;
+                return false;
+            }
+            const char* v = argv[++i];
+            if (arg == "--trace") {
+                config.tracePath = v;
+            } else if (arg == "--db") {
+                config.dbPath = v;
+            } else if (arg == "--speed") {
+                config.speed = std::strcmp(v, "max") == 0 ? 0.0 : std::atof(v);
+            } else if (arg == "--threads") {
+                config.threads = static_cast<unsigned>(std::atoi(v));
+            } else if (arg == "--histogram") {
+                config.histogramOut = v;
+            } else if (arg == "--hash-cost") {
+                if (std::strcmp(v, "calibrate") == 0) {
+                    config.hashCost.logN = 0;
+                } else if (std::sscanf(v, "%d,%d,%d", &config.hashCost.logN, &config.hashCost.r,
+                                       &config.hashCost.p) != 3 || config.hashCost.logN <= 0) {
+                    std::cerr << "--hash-cost espera LN,R,P o calibrate" << std::endl;
+                    return false;
+                }
+            } else {
+                std::cerr << "Opcion desconocida: " << arg << std::endl;
+                return false;
+            }
+        }
+        return !config.tracePath.empty() && config.threads > 0 && config.speed >= 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+    std::string command = argv[1];
+
+    if (command == "compare" && argc == 4) {
+        return runCompare(argv[2], argv[3]);
+    }
+
+    ReplayConfig config;
+    if (!parseReplayArgs(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+    if (command == "info") {
+        return runInfo(config.tracePath);
+    }
+    if (command == "replay") {
+        return runReplay(config);
+    }
+    printUsage();
+    return 1;
+}